@@ -0,0 +1,240 @@
+// eglgl.h - offscreen OpenGL context for the draw functions in pingpong.c,
+// for Linux boxes with no window system and possibly no GPU (CI, render
+// nodes), where the real driver's cost is what needs measuring.
+//
+// pingpong.c includes this instead of gl.h/windows.h when built with
+// -DPONG_EGLRENDER. eglglInit() opens Mesa's surfaceless EGL platform (the
+// default display if that is missing) and makes a desktop GL compatibility
+// context current on a pbuffer, so the game's immediate-mode drawing and
+// its GL 3.3 shader effects run unchanged on the GPU driver or on
+// llvmpipe. The WGL and GDI calls the game makes are stood in for here;
+// text uses the font in glyphs.h, drawn as textured quads and laid out like
+// softgl.h's, so the two renderers give the same picture.
+//
+// Link with -lEGL -lGL.
+
+#ifndef EGLGL_H
+#define EGLGL_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "glyphs.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+//              GDI / WGL declarations
+
+typedef void* HWND;
+typedef void* HDC;
+typedef void* HGLRC;
+typedef const void* HGDIOBJ;
+typedef const struct EgFont* HFONT;
+typedef uint32_t COLORREF;
+
+#define RGB(r,g,b)   ((COLORREF)(((r) & 0xFF) | (((g) & 0xFF) << 8) | (((b) & 0xFF) << 16)))
+#define TRANSPARENT  1
+
+//              State
+
+struct EgFont {
+    int height;
+};
+
+static const struct EgFont eg_fonts[] = {{24}, {32}};
+
+static EGLDisplay eg_display = EGL_NO_DISPLAY;
+static EGLSurface eg_surface = EGL_NO_SURFACE;
+static EGLContext eg_context = EGL_NO_CONTEXT;
+static int eg_width = 0, eg_height = 0;
+static GLuint eg_fontTexture = 0;
+
+static const struct EgFont* eg_font = &eg_fonts[0];
+static COLORREF eg_textColor = 0xFFFFFF;
+
+//              Context
+
+static EGLDisplay egOpenDisplay() {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (d != EGL_NO_DISPLAY && eglInitialize(d, NULL, NULL)) return d;
+    }
+    EGLDisplay d = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (d != EGL_NO_DISPLAY && eglInitialize(d, NULL, NULL)) return d;
+    return EGL_NO_DISPLAY;
+}
+
+// The glyph atlas as an alpha texture; the mosaic view draws from it too
+static void egBuildFont() {
+    static uint8_t alpha[GLYPH_ATLAS_H][GLYPH_ATLAS_W];
+    glyphAtlasPixels(alpha);
+    glGenTextures(1, &eg_fontTexture);
+    glBindTexture(GL_TEXTURE_2D, eg_fontTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, GLYPH_ATLAS_W, GLYPH_ATLAS_H, 0, GL_ALPHA, GL_UNSIGNED_BYTE, alpha);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// A width x height RGBA pbuffer with a GL 3.3 compatibility context (any
+// compatibility context if the driver refuses that) made current.
+// Returns 0 if EGL can't give one.
+int eglglInit(int width, int height) {
+    static const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    static const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    const EGLint surfaceAttribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    EGLConfig config;
+    EGLint count = 0;
+
+    if ((eg_display = egOpenDisplay()) == EGL_NO_DISPLAY) return 0;
+    if (!eglChooseConfig(eg_display, configAttribs, &config, 1, &count) || count < 1 ||
+        !eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(eg_display);
+        return 0;
+    }
+    eg_surface = eglCreatePbufferSurface(eg_display, config, surfaceAttribs);
+    eg_context = eglCreateContext(eg_display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (eg_context == EGL_NO_CONTEXT)
+        eg_context = eglCreateContext(eg_display, config, EGL_NO_CONTEXT, NULL);
+    if (eg_surface == EGL_NO_SURFACE || eg_context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(eg_display, eg_surface, eg_surface, eg_context)) {
+        if (eg_context != EGL_NO_CONTEXT) eglDestroyContext(eg_display, eg_context);
+        if (eg_surface != EGL_NO_SURFACE) eglDestroySurface(eg_display, eg_surface);
+        eglTerminate(eg_display);
+        eg_display = EGL_NO_DISPLAY;
+        return 0;
+    }
+
+    eg_width = width;
+    eg_height = height;
+    glViewport(0, 0, width, height);
+    egBuildFont();
+    return 1;
+}
+
+// Copy the frame into rgba (eg_width * eg_height pixels, row 0 at the top,
+// bytes R G B A like softgl's sw_fb). Waits for the GL to finish.
+void eglglRead(uint32_t* rgba) {
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, eg_width, eg_height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    for (int y = 0; y < eg_height / 2; y++) {
+        uint32_t* a = rgba + (size_t)y * eg_width;
+        uint32_t* b = rgba + (size_t)(eg_height - 1 - y) * eg_width;
+        for (int x = 0; x < eg_width; x++) {
+            uint32_t t = a[x];
+            a[x] = b[x];
+            b[x] = t;
+        }
+    }
+}
+
+void eglglShutdown() {
+    if (eg_display == EGL_NO_DISPLAY) return;
+    if (eg_fontTexture) glDeleteTextures(1, &eg_fontTexture);
+    eglMakeCurrent(eg_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(eg_display, eg_context);
+    eglDestroySurface(eg_display, eg_surface);
+    eglTerminate(eg_display);
+    eg_display = EGL_NO_DISPLAY;
+    eg_surface = EGL_NO_SURFACE;
+    eg_context = EGL_NO_CONTEXT;
+    eg_fontTexture = 0;
+}
+
+//              GDI / WGL stand-ins
+
+// The pbuffer is read back, never shown
+int SwapBuffers(HDC dc) { (void)dc; return 1; }
+// drawText() lets go of the context around GDI; here text is GL as well
+int wglMakeCurrent(HDC dc, HGLRC rc) { (void)dc; (void)rc; return 1; }
+int SetBkMode(HDC dc, int mode) { (void)dc; (void)mode; return TRANSPARENT; }
+
+void* wglGetProcAddress(const char* name) {
+    return (void*)eglGetProcAddress(name);
+}
+
+COLORREF SetTextColor(HDC dc, COLORREF color) {
+    (void)dc;
+    COLORREF old = eg_textColor;
+    eg_textColor = color;
+    return old;
+}
+
+HGDIOBJ SelectObject(HDC dc, HGDIOBJ obj) {
+    (void)dc;
+    HGDIOBJ old = eg_font;
+    if (obj) eg_font = obj;
+    return old;
+}
+
+// Fonts are picked by cell height; anything but 32 gets the 24 px face
+HFONT eglglCreateFont(int height) {
+    return height >= 32 ? &eg_fonts[1] : &eg_fonts[0];
+}
+
+// (x, y) is the top-left corner of the text in window pixels. Glyph cells
+// are scaled to the font height with nearest sampling and drawn opaque
+// where the glyph is set; GL state is left as it was found.
+int TextOutA(HDC dc, int x, int y, const char* s, int len) {
+    (void)dc;
+    if (len <= 0) return 1;
+    int h = eg_font->height;
+    int adv = (GLYPH_W * h + GLYPH_H / 2) / GLYPH_H;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_TEXTURE_BIT | GL_TRANSFORM_BIT);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, eg_width, eg_height, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glDisable(GL_BLEND);
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GREATER, 0.5f);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, eg_fontTexture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glColor4ub(eg_textColor & 0xFF, (eg_textColor >> 8) & 0xFF, (eg_textColor >> 16) & 0xFF, 255);
+
+    glBegin(GL_QUADS);
+    for (int k = 0; k < len; k++) {
+        unsigned ch = (unsigned char)s[k];
+        if (ch < 32 || ch > 126) ch = '?';
+        float u0, v0, u1, v1;
+        glyphAtlasCell(ch - 32, &u0, &v0, &u1, &v1);
+        float x0 = (float)(x + k * adv), x1 = x0 + adv, y0 = (float)y, y1 = y0 + h;
+        glTexCoord2f(u0, v0); glVertex2f(x0, y0);
+        glTexCoord2f(u1, v0); glVertex2f(x1, y0);
+        glTexCoord2f(u1, v1); glVertex2f(x1, y1);
+        glTexCoord2f(u0, v1); glVertex2f(x0, y1);
+    }
+    glEnd();
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glPopAttrib();
+    return 1;
+}
+
+#endif // EGLGL_H
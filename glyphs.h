@@ -0,0 +1,134 @@
+// glyphs.h - the bitmap font drawn by the GDI text stand-ins in softgl.h and
+// eglgl.h, so text looks the same from both renderers, and the layout of the
+// glyph atlas texture that eglgl.h's TextOutA and the mosaic view share.
+
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+#include <stdint.h>
+
+#define GLYPH_W 12
+#define GLYPH_H 24
+#define GLYPH_ATLAS_COLS 16                     // glyph cells a row in the atlas
+#define GLYPH_ATLAS_W (GLYPH_ATLAS_COLS * GLYPH_W)
+#define GLYPH_ATLAS_H (6 * GLYPH_H)
+
+// 12x24 bitmap glyphs for ASCII 32..126, rendered from DejaVu Sans Mono
+// Bold at 20 px; bit 15 is the leftmost pixel
+static const uint16_t font_glyphs[95][GLYPH_H] = {
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // ' '
+    {0x0000,0x0000,0x0000,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0000,0x0000,0x0700,0x0700,0x0700,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '!'
+    {0x0000,0x0000,0x0000,0x38E0,0x38E0,0x38E0,0x38E0,0x38E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '"'
+    {0x0000,0x0000,0x0000,0x0660,0x0E60,0x0CC0,0x0CC0,0x7FF0,0x7FF0,0x1980,0x1980,0x1980,0xFFE0,0xFFE0,0x3300,0x3300,0x7300,0x6700,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '#'
+    {0x0000,0x0000,0x0000,0x0400,0x0400,0x1F00,0x3F80,0x7580,0x7400,0x7400,0x7C00,0x3F80,0x0780,0x05C0,0x45C0,0x65C0,0x7F80,0x3F00,0x0400,0x0400,0x0400,0x0000,0x0000,0x0000}, // '$'
+    {0x0000,0x0000,0x0000,0x7800,0xFC00,0xCC00,0xCC00,0xFC20,0x78E0,0x0180,0x0600,0x1800,0x61E0,0x43F0,0x0330,0x0330,0x03F0,0x01E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '%'
+    {0x0000,0x0000,0x0000,0x0780,0x1FC0,0x1C40,0x1C00,0x1E00,0x0E00,0x1F00,0x3F10,0x7390,0x71D0,0x71F0,0x70F0,0x78F0,0x3FF0,0x0FB0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '&'
+    {0x0000,0x0000,0x0000,0x0700,0x0700,0x0700,0x0700,0x0700,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '\''
+    {0x0000,0x0000,0x0000,0x0180,0x0300,0x0300,0x0700,0x0700,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0700,0x0700,0x0300,0x0300,0x0180,0x0000,0x0000,0x0000}, // '('
+    {0x0000,0x0000,0x0000,0x0C00,0x0600,0x0600,0x0700,0x0700,0x0380,0x0380,0x0380,0x0380,0x0380,0x0380,0x0380,0x0380,0x0700,0x0700,0x0600,0x0600,0x0C00,0x0000,0x0000,0x0000}, // ')'
+    {0x0000,0x0000,0x0000,0x0600,0x0600,0x6660,0x7FE0,0x1F80,0x1F80,0x7FE0,0x6660,0x0600,0x0600,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '*'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0600,0x0600,0x0600,0x0600,0x7FE0,0x7FE0,0x0600,0x0600,0x0600,0x0600,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '+'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0700,0x0700,0x0700,0x0600,0x0E00,0x0C00,0x0000,0x0000,0x0000,0x0000}, // ','
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x1F80,0x1F80,0x1F80,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '-'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0E00,0x0E00,0x0E00,0x0E00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '.'
+    {0x0000,0x0000,0x0000,0x0060,0x00C0,0x00C0,0x0180,0x0180,0x0300,0x0300,0x0600,0x0600,0x0C00,0x0C00,0x1800,0x1800,0x3000,0x3000,0x6000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '/'
+    {0x0000,0x0000,0x0000,0x0F00,0x1F80,0x39C0,0x30E0,0x70E0,0x70E0,0x76E0,0x76E0,0x70E0,0x70E0,0x70E0,0x30E0,0x39C0,0x1F80,0x0F00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '0'
+    {0x0000,0x0000,0x0000,0x0F00,0x3F00,0x3700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x3FE0,0x3FE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '1'
+    {0x0000,0x0000,0x0000,0x3F00,0x7FC0,0x61E0,0x40E0,0x00E0,0x00E0,0x01C0,0x0380,0x0780,0x0F00,0x1E00,0x3C00,0x3800,0x7FE0,0x7FE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '2'
+    {0x0000,0x0000,0x0000,0x3F80,0x7FC0,0x61E0,0x40E0,0x00E0,0x01E0,0x0F80,0x0F80,0x01C0,0x00E0,0x00E0,0x40E0,0x61E0,0x7FC0,0x3F80,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '3'
+    {0x0000,0x0000,0x0000,0x0380,0x0780,0x0780,0x0F80,0x1F80,0x1B80,0x3380,0x3380,0x6380,0x7FE0,0x7FE0,0x0380,0x0380,0x0380,0x0380,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '4'
+    {0x0000,0x0000,0x0000,0x7FC0,0x7FC0,0x7000,0x7000,0x7000,0x7F00,0x7FC0,0x41C0,0x00E0,0x00E0,0x00E0,0x00E0,0x61C0,0x7FC0,0x3F00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '5'
+    {0x0000,0x0000,0x0000,0x0F80,0x1FC0,0x3840,0x3800,0x7000,0x7780,0x7FC0,0x79E0,0x70E0,0x70E0,0x70E0,0x70E0,0x39C0,0x3FC0,0x0F80,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '6'
+    {0x0000,0x0000,0x0000,0x7FE0,0x7FE0,0x00E0,0x01C0,0x01C0,0x0380,0x0380,0x0780,0x0700,0x0F00,0x0E00,0x0E00,0x1C00,0x1C00,0x3800,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '7'
+    {0x0000,0x0000,0x0000,0x1F80,0x3FC0,0x79E0,0x70E0,0x70E0,0x39C0,0x1F80,0x1F80,0x39C0,0x70E0,0x70E0,0x70E0,0x79E0,0x3FC0,0x1F80,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '8'
+    {0x0000,0x0000,0x0000,0x1F00,0x3FC0,0x79C0,0x70E0,0x70E0,0x70E0,0x70E0,0x79E0,0x3FE0,0x1EE0,0x00E0,0x01C0,0x21C0,0x3F80,0x1F00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '9'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0E00,0x0E00,0x0E00,0x0E00,0x0000,0x0000,0x0E00,0x0E00,0x0E00,0x0E00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // ':'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0E00,0x0E00,0x0E00,0x0E00,0x0000,0x0000,0x0E00,0x0E00,0x0E00,0x0C00,0x1C00,0x1800,0x0000,0x0000,0x0000,0x0000}, // ';'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0020,0x01E0,0x07E0,0x3F00,0x7800,0x7800,0x3F00,0x07E0,0x01E0,0x0020,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '<'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x7FE0,0x7FE0,0x0000,0x0000,0x7FE0,0x7FE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '='
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x4000,0x7800,0x7E00,0x0FC0,0x01E0,0x01E0,0x0FC0,0x7E00,0x7800,0x4000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '>'
+    {0x0000,0x0000,0x0000,0x1F00,0x3FC0,0x21C0,0x01C0,0x01C0,0x0380,0x0700,0x0E00,0x0E00,0x0E00,0x0E00,0x0000,0x0E00,0x0E00,0x0E00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '?'
+    {0x0000,0x0000,0x0000,0x0000,0x0F80,0x1FC0,0x38E0,0x6060,0x63E0,0xC7E0,0xCEE0,0xCC60,0xCC60,0xCC60,0xCEE0,0xC7E0,0x63E0,0x7000,0x3840,0x1FE0,0x0FC0,0x0000,0x0000,0x0000}, // '@'
+    {0x0000,0x0000,0x0000,0x0F00,0x0F00,0x0F00,0x0F00,0x1F80,0x1F80,0x1980,0x1980,0x39C0,0x3FC0,0x3FC0,0x39C0,0x31C0,0x70E0,0x70E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'A'
+    {0x0000,0x0000,0x0000,0x7F00,0x7F80,0x71C0,0x71C0,0x71C0,0x71C0,0x7F80,0x7F80,0x71C0,0x70E0,0x70E0,0x70E0,0x71E0,0x7FC0,0x7F80,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'B'
+    {0x0000,0x0000,0x0000,0x07C0,0x1FE0,0x3C60,0x3800,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x3800,0x3C60,0x1FE0,0x07C0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'C'
+    {0x0000,0x0000,0x0000,0x7E00,0x7F80,0x71C0,0x71C0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x71C0,0x71C0,0x7F80,0x7E00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'D'
+    {0x0000,0x0000,0x0000,0x7FE0,0x7FE0,0x7000,0x7000,0x7000,0x7000,0x7FC0,0x7FC0,0x7000,0x7000,0x7000,0x7000,0x7000,0x7FE0,0x7FE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'E'
+    {0x0000,0x0000,0x0000,0x7FE0,0x7FE0,0x7000,0x7000,0x7000,0x7000,0x7FC0,0x7FC0,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'F'
+    {0x0000,0x0000,0x0000,0x0F80,0x1FC0,0x3840,0x3800,0x7000,0x7000,0x7000,0x73E0,0x73E0,0x70E0,0x70E0,0x38E0,0x38E0,0x1FE0,0x0FC0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'G'
+    {0x0000,0x0000,0x0000,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x7FE0,0x7FE0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'H'
+    {0x0000,0x0000,0x0000,0x3FE0,0x3FE0,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x3FE0,0x3FE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'I'
+    {0x0000,0x0000,0x0000,0x0FE0,0x0FE0,0x00E0,0x00E0,0x00E0,0x00E0,0x00E0,0x00E0,0x00E0,0x00E0,0x00E0,0x40E0,0x61E0,0x7FC0,0x3F80,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'J'
+    {0x0000,0x0000,0x0000,0x70E0,0x71E0,0x71C0,0x7380,0x7700,0x7E00,0x7E00,0x7F00,0x7F80,0x7380,0x73C0,0x71C0,0x71E0,0x70E0,0x70F0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'K'
+    {0x0000,0x0000,0x0000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x7FE0,0x7FE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'L'
+    {0x0000,0x0000,0x0000,0x70E0,0x70E0,0x79E0,0x79E0,0x79E0,0x7FE0,0x76E0,0x76E0,0x76E0,0x76E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'M'
+    {0x0000,0x0000,0x0000,0x78E0,0x78E0,0x78E0,0x7CE0,0x7CE0,0x7CE0,0x76E0,0x76E0,0x76E0,0x73E0,0x73E0,0x73E0,0x71E0,0x71E0,0x71E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'N'
+    {0x0000,0x0000,0x0000,0x0F00,0x1F80,0x39C0,0x30C0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x30C0,0x39C0,0x1F80,0x0F00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'O'
+    {0x0000,0x0000,0x0000,0x7F80,0x7FC0,0x71E0,0x70E0,0x70E0,0x70E0,0x71E0,0x7FC0,0x7F80,0x7000,0x7000,0x7000,0x7000,0x7000,0x7000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'P'
+    {0x0000,0x0000,0x0000,0x0F00,0x1F80,0x39C0,0x30C0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x30E0,0x39C0,0x1FC0,0x0F80,0x01C0,0x0080,0x0000,0x0000,0x0000,0x0000}, // 'Q'
+    {0x0000,0x0000,0x0000,0x7F80,0x7FC0,0x71E0,0x70E0,0x70E0,0x70E0,0x71E0,0x7FC0,0x7F80,0x73C0,0x71C0,0x70E0,0x70E0,0x70E0,0x7070,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'R'
+    {0x0000,0x0000,0x0000,0x1F80,0x3FC0,0x78C0,0x7040,0x7000,0x7800,0x3F00,0x1FC0,0x07C0,0x01E0,0x00E0,0x40E0,0x61E0,0x7FC0,0x3F80,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'S'
+    {0x0000,0x0000,0x0000,0x7FF0,0x7FF0,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'T'
+    {0x0000,0x0000,0x0000,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x79E0,0x3FC0,0x1F80,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'U'
+    {0x0000,0x0000,0x0000,0x70E0,0x70E0,0x30C0,0x39C0,0x39C0,0x39C0,0x39C0,0x1980,0x1980,0x1F80,0x1F80,0x1F80,0x0F00,0x0F00,0x0F00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'V'
+    {0x0000,0x0000,0x0000,0xE070,0xE070,0xE070,0xE070,0x6660,0x6660,0x6F60,0x6F60,0x6F60,0x6F60,0x79E0,0x79E0,0x79E0,0x39C0,0x38C0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'W'
+    {0x0000,0x0000,0x0000,0x70E0,0x39C0,0x39C0,0x1F80,0x1F80,0x0F00,0x0F00,0x0600,0x0F00,0x0F00,0x1F80,0x1B80,0x39C0,0x39C0,0x70E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'X'
+    {0x0000,0x0000,0x0000,0xE030,0x7070,0x7070,0x38E0,0x3DE0,0x1DC0,0x0F80,0x0F80,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'Y'
+    {0x0000,0x0000,0x0000,0x7FE0,0x7FE0,0x00E0,0x01C0,0x03C0,0x0380,0x0700,0x0F00,0x0E00,0x1C00,0x3C00,0x3800,0x7000,0x7FE0,0x7FE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'Z'
+    {0x0000,0x0000,0x0000,0x0F80,0x0F80,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0F80,0x0F80,0x0000,0x0000,0x0000}, // '['
+    {0x0000,0x0000,0x0000,0x6000,0x3000,0x3000,0x1800,0x1800,0x0C00,0x0C00,0x0600,0x0600,0x0300,0x0300,0x0180,0x0180,0x00C0,0x00C0,0x0060,0x0000,0x0000,0x0000,0x0000,0x0000}, // '\\'
+    {0x0000,0x0000,0x0000,0x1F00,0x1F00,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x1F00,0x1F00,0x0000,0x0000,0x0000}, // ']'
+    {0x0000,0x0000,0x0000,0x0700,0x0F80,0x1DC0,0x38E0,0x7070,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '^'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0xFFF0,0xFFF0,0x0000}, // '_'
+    {0x0000,0x0000,0x3800,0x1C00,0x0E00,0x0700,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // '`'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x1F80,0x3FC0,0x20E0,0x00E0,0x1FE0,0x3FE0,0x70E0,0x70E0,0x71E0,0x3FE0,0x1EE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'a'
+    {0x0000,0x0000,0x0000,0x7000,0x7000,0x7000,0x7000,0x7780,0x7FC0,0x79E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x79E0,0x7FC0,0x7780,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'b'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0FC0,0x1FE0,0x3820,0x7000,0x7000,0x7000,0x7000,0x7000,0x3820,0x1FE0,0x0FC0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'c'
+    {0x0000,0x0000,0x0000,0x00E0,0x00E0,0x00E0,0x00E0,0x1EE0,0x3FE0,0x79E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x79E0,0x3FE0,0x1EE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'd'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0F80,0x3FC0,0x39E0,0x70E0,0x7FE0,0x7FE0,0x7000,0x7000,0x3820,0x3FE0,0x0FC0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'e'
+    {0x0000,0x0000,0x0000,0x07C0,0x0FC0,0x0E00,0x0E00,0x7FC0,0x7FC0,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'f'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x1EE0,0x3FE0,0x39E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x39E0,0x3FE0,0x1EE0,0x00E0,0x21E0,0x3FC0,0x1F80,0x0000,0x0000}, // 'g'
+    {0x0000,0x0000,0x0000,0x7000,0x7000,0x7000,0x7000,0x7780,0x7FC0,0x78E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'h'
+    {0x0000,0x0000,0x0700,0x0700,0x0700,0x0000,0x0000,0x3F00,0x3F00,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x7FF0,0x7FF0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'i'
+    {0x0000,0x0000,0x0700,0x0700,0x0700,0x0000,0x0000,0x3F00,0x3F00,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x0700,0x7E00,0x7C00,0x0000,0x0000}, // 'j'
+    {0x0000,0x0000,0x0000,0x7000,0x7000,0x7000,0x7000,0x71C0,0x7380,0x7700,0x7E00,0x7E00,0x7F00,0x7700,0x7380,0x7380,0x71C0,0x70E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'k'
+    {0x0000,0x0000,0x0000,0x7E00,0x7E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x07E0,0x03E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'l'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x7DC0,0x7FE0,0x6660,0x6660,0x6660,0x6660,0x6660,0x6660,0x6660,0x6660,0x6660,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'm'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x7780,0x7FC0,0x78E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'n'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0F00,0x3FC0,0x39C0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x39C0,0x3FC0,0x0F00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'o'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x7780,0x7FC0,0x79E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x79E0,0x7FC0,0x7780,0x7000,0x7000,0x7000,0x7000,0x0000,0x0000}, // 'p'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x1EE0,0x3FE0,0x79E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x79E0,0x3FE0,0x1EE0,0x00E0,0x00E0,0x00E0,0x00E0,0x0000,0x0000}, // 'q'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x1DC0,0x1FE0,0x1E20,0x1C00,0x1C00,0x1C00,0x1C00,0x1C00,0x1C00,0x1C00,0x1C00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'r'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x1F80,0x3FC0,0x7040,0x7000,0x7F00,0x3FC0,0x07E0,0x00E0,0x40E0,0x7FC0,0x3F80,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 's'
+    {0x0000,0x0000,0x0000,0x0000,0x0E00,0x0E00,0x0E00,0x7FE0,0x7FE0,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0E00,0x0FE0,0x07E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 't'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x70E0,0x71E0,0x3FE0,0x1EE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'u'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x70E0,0x70E0,0x39C0,0x39C0,0x39C0,0x1980,0x1F80,0x1F80,0x0F00,0x0F00,0x0F00,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'v'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0xC030,0xE070,0xE070,0x6660,0x6660,0x6F60,0x6F60,0x7FE0,0x39C0,0x39C0,0x39C0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'w'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x79E0,0x39C0,0x1F80,0x1F80,0x0F00,0x0F00,0x0F00,0x1F80,0x1980,0x39C0,0x79E0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'x'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x70E0,0x38E0,0x39C0,0x39C0,0x1DC0,0x1D80,0x1F80,0x0F80,0x0F00,0x0700,0x0700,0x0600,0x0E00,0x3C00,0x3C00,0x0000,0x0000}, // 'y'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x7FE0,0x7FE0,0x01E0,0x03C0,0x0780,0x0F00,0x1E00,0x3C00,0x7800,0x7FE0,0x7FE0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}, // 'z'
+    {0x0000,0x0000,0x0000,0x03E0,0x07E0,0x0700,0x0700,0x0700,0x0700,0x0700,0x0F00,0x3E00,0x3E00,0x0F00,0x0700,0x0700,0x0700,0x0700,0x0700,0x07E0,0x03E0,0x0000,0x0000,0x0000}, // '{'
+    {0x0000,0x0000,0x0000,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0600,0x0000}, // '|'
+    {0x0000,0x0000,0x0000,0x3E00,0x3F00,0x0700,0x0700,0x0700,0x0700,0x0700,0x0780,0x03E0,0x03E0,0x0780,0x0700,0x0700,0x0700,0x0700,0x0700,0x3F00,0x3E00,0x0000,0x0000,0x0000}, // '}'
+    {0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x3C20,0x7FE0,0x43C0,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000,0x0000}  // '~'
+};
+
+// The glyphs as one alpha image, a cell each in ASCII order from ' '
+static inline void glyphAtlasPixels(uint8_t alpha[GLYPH_ATLAS_H][GLYPH_ATLAS_W]) {
+    for (int g = 0; g < 95; g++) {
+        int ox = (g % GLYPH_ATLAS_COLS) * GLYPH_W, oy = (g / GLYPH_ATLAS_COLS) * GLYPH_H;
+        for (int y = 0; y < GLYPH_H; y++)
+            for (int x = 0; x < GLYPH_W; x++)
+                alpha[oy + y][ox + x] = (font_glyphs[g][y] & (0x8000 >> x)) ? 255 : 0;
+    }
+}
+
+// Texture coordinates of glyph g's cell in that image
+static inline void glyphAtlasCell(int g, float* u0, float* v0, float* u1, float* v1) {
+    *u0 = (float)(g % GLYPH_ATLAS_COLS) / GLYPH_ATLAS_COLS;
+    *u1 = *u0 + 1.0f / GLYPH_ATLAS_COLS;
+    *v0 = (float)(g / GLYPH_ATLAS_COLS) * GLYPH_H / GLYPH_ATLAS_H;
+    *v1 = *v0 + (float)GLYPH_H / GLYPH_ATLAS_H;
+}
+
+#endif // GLYPHS_H
@@ -1,14 +1,61 @@
+#ifdef PONG_SOFTRENDER
+#ifndef PONG_HEADLESS
+#define PONG_HEADLESS
+#endif
+#include "softgl.h"
+#endif
+#ifdef PONG_EGLRENDER
+#ifndef PONG_HEADLESS
+#define PONG_HEADLESS
+#endif
+#include "eglgl.h"
+#endif
+#ifndef PONG_HEADLESS
 #include <GL/gl.h>
 #include <GL/glu.h>
 #include <windows.h>
+#include "glyphs.h"
+#endif
+#if !defined(PONG_HEADLESS) || defined(PONG_SOFTRENDER) || defined(PONG_EGLRENDER)
+#define PONG_DRAWING
+#endif
+#if !defined(PONG_HEADLESS) || defined(PONG_EGLRENDER)
+#define PONG_REAL_GL
+#endif
 #include <stdlib.h>
 #include <time.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
+#include <stdint.h>
+#ifdef PONG_HEADLESS
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifndef PONG_HEADLESS
 #pragma comment(lib, "opengl32.lib")
 #pragma comment(lib, "glu32.lib")
 #pragma comment(linker, "/SUBSYSTEM:windows /ENTRY:WinMainCRTStartup")
+#endif
+
+// Building with -DPONG_HEADLESS leaves out the window, OpenGL drawing and
+// sound so the simulation can be driven by the tools in tools/.
+// -DPONG_SOFTRENDER (implies headless) keeps the draw functions and runs
+// them on the CPU rasteriser in softgl.h instead of WGL. -DPONG_EGLRENDER
+// (also headless) runs them on a real GL driver through an offscreen EGL
+// context from eglgl.h, GL 3.3 shader effects included (PONG_REAL_GL).
 
 //              Game constants
 #define WINDOW_WIDTH  1200
@@ -20,6 +67,68 @@
 #define MAX_PARTICLES 100
 #define MAX_TRAIL     20
 #define PI 3.14159265358979323846f
+#define ARENA_MIN_PLAYERS 4
+#define ARENA_MAX_PLAYERS 16
+#define ARENA_MAX_BALLS   64
+#define ARENA_RADIUS      380.0f    // circumradius of the arena polygon
+#define ARENA_BALL_RADIUS 10.0f
+#define ARENA_BALL_SPEED  9.0f
+#define ARENA_MAX_SPEED   20.0f     // below the 40-unit paddle zone, so no ball skips it
+#define FIX_SHIFT 16                // Q16.16 for the lockstep physics core
+#define FIX_ONE   (1 << FIX_SHIFT)
+#define FIX(x)    ((fix)((x) * FIX_ONE))  // constant expressions only
+#define TIMER_BITS     6
+#define TIMER_SLOTS    (1 << TIMER_BITS)
+#define TIMER_MASK     (TIMER_SLOTS - 1)
+#define TIMER_LEVELS   4                            // 64^4 ticks, about 3 days
+#define TIMER_OVERFLOW (TIMER_LEVELS * TIMER_SLOTS) // bucket past the top level
+#define TIMER_ARGS     3
+#define MAX_TIMERS     (TIMER_KINDS * TIMER_ARGS)
+#define LATENCY_HIST_MS     256     // 1 ms buckets, the last one collects the rest
+#define LATENCY_REACH       0.9f
+#define LATENCY_TIMEOUT_MS  500.0
+#define PERF_HISTORY        240     // frames in the overlay graph, 4 s at 60 fps
+#define PERF_GRAPH_MS       33.3f   // graph height, two 60 Hz frames
+#define QUALITY_LEVELS      4
+#define QUALITY_DOWN_FRAMES 15      // ~0.25 s over budget before shedding detail
+#define QUALITY_UP_FRAMES   120     // ~2 s of headroom before adding it back
+#define QUALITY_HEADROOM    0.6f    // headroom = under 60% of the budget
+#define NN_INPUTS     48        // padded to a multiple of 16 for the SIMD kernels
+#define NN_HIDDEN     32
+#define NN_POLICY_FILE "pong_policy.bin"
+#define PROFILE_FILE    "pong_profile.dat"
+#define PROFILE_MAGIC   0x46525050u   // "PPRF"
+#define PROFILE_VERSION 1
+#define PROFILE_MAX_ACH 256
+#define PROFILE_LOG_CAP 65536         // records replayed at most on startup
+#define HISTORY_FILE    "pong_history.pch"
+#define HISTORY_MAGIC   0x31484350u   // "PCH1"
+#define HISTORY_MAX_MATCHES 4096      // matches buffered per block
+#define HISTORY_MAX_ROWS    65536     // rows buffered per table per block
+#define LEADER_FILE     "pong_leaders.plb"
+#define LEADER_MAGIC    0x31424C50u   // "PLB1"
+#define LEADER_VERSION  1
+#define LEADER_MAP_SIZE (64u << 20)   // most the file grows to, about 2M entries
+#define LEADER_GROW     (1u << 20)
+#define LEADER_LEVELS   12            // skip list levels; 4^12 = 16M entries a board
+#define LEADER_QUEUE    64            // results waiting for the writer thread
+#define LEADER_POLL_MS  20            // how often the writer looks at the queue
+#define LEADER_WIN_POINTS 5           // a PvC win, as for the Hard Win achievement
+#define REPLAY_FILE     "pong_replay.prp"
+#define REPLAY_MAGIC    0x31505250u   // "PRP1"
+#define SHARE_NAME      "pingpong_state"
+#define SHARE_MAGIC     0x53505050u   // "PPPS"
+#define SHARE_VERSION   1
+#define LEVEL_FILE      "pong_arena.lvl"
+#define LEVEL_MAX_PIECES 1024
+#define LEVEL_MIN_RADIUS 2.0f       // thinner lets a ball at ARENA_MAX_SPEED pass through
+#define BVH_LEAF        4           // pieces in a leaf
+#define BVH_DEPTH       32          // deepest node; a median split of 1024 pieces is 9 deep
+#define BVH_CONTACTS    8           // pieces one ball can touch in a tick
+#define MOSAIC_MIN      16          // matches in the spectator grid
+#define MOSAIC_MAX      64
+#define MOSAIC_LABEL    12          // characters in a tile's score label
+#define MOSAIC_TILE_VERTS (6 * (4 + MAX_POWERUPS) + 3 * 3 * 16)  // rectangles, 3 balls of 16 segments
 
 // Different game screens / modes
 typedef enum {
@@ -27,7 +136,10 @@ typedef enum {
     MODE_PVP,
     MODE_PVC,
     MODE_DIFFICULTY_SELECT,
-    MODE_SPEED_SELECT
+    MODE_SPEED_SELECT,
+    MODE_ARENA_SELECT,
+    MODE_ARENA,
+    MODE_MOSAIC
 } GameMode;
 
 // Difficulty presets
@@ -41,7 +153,9 @@ typedef enum {
     CONTROL_KEYBOARD_1,     // A/D for bottom + arrows for top
     CONTROL_KEYBOARD_2,     // Arrows only
     CONTROL_MOUSE,          // Mouse movement
-    CONTROL_AUTO            // Computer / AI control
+    CONTROL_AUTO,           // Computer / AI control
+    CONTROL_NEURAL,         // Experimental learned policy from pong_policy.bin
+    CONTROL_EXTERNAL        // Target written by another process (see SharedState)
 } ControlMode;
 
 // Ball types / visual styles
@@ -65,23 +179,116 @@ typedef enum {
     POWERUP_SPLIT_BALL
 } PowerUpType;
 
+// Gameplay events achievements can subscribe to (value passed alongside)
+typedef enum {
+    GE_MATCH_START,         // new match / restart, value unused
+    GE_POINT_P1,            // bottom player scored, value = points gained
+    GE_POINT_P2,            // top player scored, value = points gained
+    GE_PADDLE_HIT,          // value = consecutive_hits after the hit
+    GE_BALL_SPEED,          // max_ball_speed grew, value = new top speed
+    GE_POWERUP,             // power-up collected, value = PowerUpType
+    GE_COUNT
+} GameEvent;
+
+#define GE_BIT(e) (1u << (e))
+
+// Timed gameplay effects (see timerAt). There is at most one pending timer
+// per (kind, arg); scheduling the same key again moves it.
+typedef enum {
+    TIMER_BIG_PADDLE,       // arg = player - 1
+    TIMER_SLOW_TIME,
+    TIMER_COMBO,
+    TIMER_BALL_EFFECT,      // arg = ball slot
+    TIMER_KINDS
+} TimerKind;
+
+// How an event moves an achievement's progress
+typedef enum {
+    ACH_COUNT,              // +1 per event
+    ACH_SUM,                // += event value
+    ACH_LEVEL               // progress = best event value seen
+} AchievementRule;
+
+// When progress is cleared
+typedef enum {
+    SCOPE_LIFETIME,         // never
+    SCOPE_MATCH             // on GE_MATCH_START
+} AchievementScope;
+
+#define ACH_ANY -1          // mode / difficulty filter wildcard
+
 // Achievement entry
 typedef struct {
     char name[50];
     char description[100];
     int unlocked;
-    int condition;
+    int condition;          // progress needed to unlock
     int progress;
+    unsigned advanceOn;     // GE_BIT mask of events that add progress
+    unsigned failOn;        // GE_BIT mask of events that void the scope
+    AchievementRule rule;
+    AchievementScope scope;
+    int mode;               // GameMode or ACH_ANY
+    int difficulty;         // DifficultyLevel or ACH_ANY
+    int soundFreq, soundMs; // unlock jingle
+    int failed;             // failOn fired in the current scope
 } Achievement;
 
-// Single particle (spark, explosion bit)
+// Entity storage: what the simulation reads every tick (hot) is kept apart
+// from what only effects and drawing use (cold), so a tick streams through
+// a few packed cache lines instead of striding over trails and colours.
+
+// Handle to a pooled entity: slot in the low 16 bits, generation above.
+// Freeing a slot bumps its generation, so old handles stop resolving.
+typedef uint32_t EntityId;
+#define ENTITY_NONE 0u
+
+// Sparse set: live entities are packed at dense indices [0, count), and
+// component arrays are indexed by dense index so systems loop over count.
+// slotOf[count..cap) doubles as the free list.
+typedef struct {
+    int count, cap;
+    int used;                           // slots handed out at least once
+    uint16_t slotOf[MAX_PARTICLES];     // dense index -> slot
+    uint16_t denseOf[MAX_PARTICLES];    // slot -> dense index
+    uint16_t gen[MAX_PARTICLES];
+} EntityPool;
+
+typedef struct {
+    int expire;             // sim_tick of the update() that fires it
+    int16_t next, prev;     // bucket list, -1 = end
+    int16_t bucket;         // level * TIMER_SLOTS + slot, or TIMER_OVERFLOW
+    uint8_t kind, arg;
+} TimerNode;
+
+// Hierarchical timer wheel over sim_tick. Level k buckets timers by bits
+// [6k, 6k+6) of their expiry, among timers that share all higher bits with
+// the current tick; crossing a level-k boundary re-buckets one slot of
+// level k into the levels below. Occupancy bitmaps let timerAdvance() skip
+// empty slots, so idle time costs nothing and schedule / cancel / expiry
+// are O(1). Heads and keys store node + 1 so a zeroed wheel is empty.
+typedef struct {
+    int tick;                               // next tick to process
+    uint64_t used[TIMER_LEVELS];            // non-empty slots per level
+    int16_t head[TIMER_OVERFLOW + 1];
+    int16_t byKey[TIMER_KINDS][TIMER_ARGS];
+    int16_t freeHead;
+    int fresh;                              // nodes handed out at least once
+    TimerNode node[MAX_TIMERS];
+} TimerWheel;
+
+// Particle (spark, explosion bit): motion, stepped every tick
 typedef struct {
     float x, y;
     float vx, vy;
     float life;
     float size;
+} ParticleBody;
+
+// Particle colour, read only when drawing
+typedef struct {
     float r, g, b;
-} Particle;
+} ParticleTint;
 
 // One point in ball's trail effect
 typedef struct {
@@ -90,26 +297,420 @@ typedef struct {
     float size;
 } TrailPoint;
 
-// Main ball structure
+// Ball physics
 typedef struct {
     float x, y;
     float vx, vy;
     float radius;
     BallType type;
     int active;
-    float effectTimer;
-    TrailPoint trail[MAX_TRAIL];
-    int trailIndex;
+    // Straight-line path since the last bounce: x/y are recomputed each
+    // tick as origin + v * (sim_tick - originTick), so any engine that
+    // evaluates the same expression lands on bit-identical positions
+    float originX, originY;
+    int originTick;
 } Ball;
 
+// Ball effects, same slot as in balls[]
+typedef struct {
+    int trailIndex;
+    TrailPoint trail[MAX_TRAIL];
+} BallFx;
+
 // Floating power-up cube
 typedef struct {
     float x, y;
     PowerUpType type;
     int active;
+} PowerUp;
+
+// Power-up animation, same slot as in powerups[]
+typedef struct {
     float size;
     float rotation;
-} PowerUp;
+} PowerUpFx;
+
+// AI tuning knobs for one difficulty level (see updateAI)
+typedef struct {
+    float reaction;          // how fast the paddle follows its target
+    float accuracy;          // share of the ball's travel that is predicted
+    float errChance;         // chance per tick of a deliberate mistake
+    float maxErr;            // size of that mistake
+    float speedMult;
+    float anticipate;        // reserved, not read by updateAI yet
+    float adapt;             // boost during long rallies
+    float bounceBlend;       // weight of the wall-bounce prediction
+    float snapDist;          // snap onto close balls within this distance (0 = never)
+    int   rallyHits;         // rally length that triggers the adapt boost
+    float rallyReactionMax;
+    int   learnHits;         // total hits before long-term learning kicks in
+    float learnRate;
+    float learnMax;
+    float learnReactionMax;
+} AIParams;
+
+// Cosmetic detail for one quality level (see qualityFrame)
+typedef struct {
+    int particleEvery;      // keep every n-th requested particle
+    int trailPoints;        // newest trail points drawn
+    int ballStep;           // degrees per segment of the ball fans
+    int circleDiv;          // drawCircle() segment count is divided by this
+} QualityLevel;
+
+// Governor state and counters
+typedef struct {
+    int level;              // index into qualityLevels, QUALITY_LEVELS - 1 = full
+    float frameMs;          // smoothed cost of a gameplay frame
+    unsigned frames;        // frames measured
+    unsigned overBudget;    // frames whose smoothed cost was above budget
+    unsigned stepsDown, stepsUp;
+    int streak;             // consecutive frames over (> 0) or well under (< 0)
+    int upHold;             // frames of headroom needed before stepping up
+    unsigned lastUp;        // frames count at the last step up
+} QualityStats;
+
+// Input-to-present latency probe (F8). A sample starts when an input asks
+// a local paddle to move and ends at the first present whose drawn paddle
+// has covered LATENCY_REACH of the way.
+typedef struct {
+    int on;
+    int player;                 // paddle of the pending sample, 0 = none
+    double inputMs;             // when that input arrived
+    float from, goal;
+    float shownX[2];            // paddle x in the last presented frame
+    unsigned samples, dropped;
+    double sumMs;
+    unsigned hist[LATENCY_HIST_MS];
+} LatencyProbe;
+
+// N-player arena: paddle k guards edge k of a regular polygon centred on
+// the origin, edge 0 at the bottom and the rest counter-clockwise. A
+// paddle's position is its offset along the edge from the edge midpoint.
+// Kept as parallel arrays so the per-tick loops over balls and paddles
+// stay tight with 16 paddles and dozens of balls.
+typedef struct {
+    int players, balls;
+    float apothem, edge, paddleW;           // centre-to-edge distance, edge length
+    float nx[ARENA_MAX_PLAYERS], ny[ARENA_MAX_PLAYERS];    // outward edge normals
+    float pos[ARENA_MAX_PLAYERS], target[ARENA_MAX_PLAYERS];
+    uint8_t human[ARENA_MAX_PLAYERS];
+    int score[ARENA_MAX_PLAYERS], conceded[ARENA_MAX_PLAYERS];
+    float bx[ARENA_MAX_BALLS], by[ARENA_MAX_BALLS];
+    float bvx[ARENA_MAX_BALLS], bvy[ARENA_MAX_BALLS];
+    int8_t lastHit[ARENA_MAX_BALLS];        // paddle that touched it last, -1 = none
+    int8_t goal[ARENA_MAX_BALLS];           // this tick: edge it left through, -1 = none
+    uint8_t hit[ARENA_MAX_BALLS];           // this tick: bounced off a paddle
+    uint16_t probes[ARENA_MAX_BALLS];       // this tick: BVH nodes and pieces tested
+    unsigned hits, goals;
+    unsigned long long probed;
+} Arena;
+
+// Static arena pieces. Every piece is a capsule, the segment a + t d for t
+// in [0, 1] swept by radius r: a bumper has no length and kicks the ball
+// away, a wall is a long thin one and a spinner is a wall turning about its
+// centre by spin radians a tick. The pieces sit in a bounding volume
+// hierarchy built once at load; spinners refit the boxes above their leaf
+// every tick, so the tree keeps its shape and only the bounds move.
+typedef enum {
+    PIECE_BUMPER,
+    PIECE_WALL,
+    PIECE_SPINNER
+} PieceKind;
+
+typedef struct {
+    uint8_t kind;
+    float cx, cy, half, angle, angle0, spin;    // placement
+    float ax, ay, dx, dy, invLen2, r;           // current segment, 1/|d|^2 (0 for a bumper)
+    float minX, minY, maxX, maxY;
+} Piece;
+
+typedef struct {
+    float minX, minY, maxX, maxY;
+    int left, right;            // children, -1 in a leaf
+    int first, count;           // a leaf's pieces, in Level.order
+    int parent, depth;
+} BvhNode;
+
+typedef struct {
+    int pieces, movers, nodes;
+    Piece piece[LEVEL_MAX_PIECES];
+    uint16_t order[LEVEL_MAX_PIECES];       // piece indices grouped by leaf
+    uint16_t leafOf[LEVEL_MAX_PIECES];
+    uint16_t mover[LEVEL_MAX_PIECES];       // the spinners
+    BvhNode node[2 * LEVEL_MAX_PIECES];
+    uint8_t stale[2 * LEVEL_MAX_PIECES];    // during a refit: box needs redoing
+    uint16_t marked[2 * LEVEL_MAX_PIECES], refit[2 * LEVEL_MAX_PIECES];
+} Level;
+
+// Lockstep physics core (F5). Q16.16 fixed point, integer sqrt and a
+// sine table, so the same seed and inputs give the same state bit for bit
+// whatever the compiler, flags or FPU. Plays the classic rules for one ball
+// without power-ups, ball types or combos. Only int32 fields, so a batch
+// of matches can be laid out as integer SIMD lanes.
+typedef int32_t fix;
+
+typedef struct {
+    fix bx, by, bvx, bvy;
+    fix paddleX[2], targetX[2];             // 0 = bottom, 1 = top
+    fix left, right, bottom, top;
+    fix radius, paddleW, paddleH;
+    fix ballSpeed, maxSpeed;                // serve / top-return speed, bottom-return cap
+    fix keyStep, accel;                     // keyboard target step, paddle smoothing
+    int32_t score[2];
+    int32_t rally, hits;                    // top-paddle returns: this point, this match
+    int32_t difficulty, aiMask;             // bit k = paddle k is computer controlled
+    uint32_t rng, tick;
+} FixMatch;
+
+// Performance overlay (F7). The counters are plain fields: update() and
+// display() both run on the window thread, and drawing threads inside
+// softgl never touch them. Draw calls and vertices are counted always
+// (one increment each); ticks and AI are only timed while the overlay is
+// on. perfFrame() folds everything into the history once per frame.
+typedef struct {
+    int on;
+    unsigned drawCalls, vertices;   // this frame so far
+    float tickMs, aiMs;             // slowest tick / AI step since the last frame
+    float aiTickMs;                 // AI time inside the tick being run
+    int head, filled;               // ring position / valid entries
+    float frameHist[PERF_HISTORY], tickHist[PERF_HISTORY];
+    float submitHist[PERF_HISTORY];     // CPU time up to the swap
+    double lastPresent;             // frameClockMs() after the last gameplay SwapBuffers()
+    float presentMs;                // interval between the last two presents
+    unsigned shownDrawCalls, shownVertices;
+    float shownAiMs;
+    float overlayMs, shownOverlayMs;    // cost of drawing the overlay itself
+} PerfStats;
+
+// Quantised MLP paddle policy: NN_INPUTS -> NN_HIDDEN -> NN_HIDDEN -> 1.
+// Experimental: it is slower than updateAI() and loses to it (see nntrain).
+// Weights are int8 on disk and widened to int16 on load so the kernels can
+// use madd. Activations are int8-range values (0..127) kept in int16.
+typedef struct {
+    int loaded;
+    int16_t w1[NN_HIDDEN][NN_INPUTS];
+    int16_t w2[NN_HIDDEN][NN_HIDDEN];
+    int16_t w3[NN_HIDDEN];
+    int32_t b1[NN_HIDDEN], b2[NN_HIDDEN], b3;
+    float s1, s2, s3;            // accumulator -> real value
+} NNPolicy;
+
+// Persistent profile: everything that survives a restart. Two copies sit
+// in the file header (A/B); the valid one with the newest generation wins
+typedef struct {
+    uint32_t magic, version, generation;
+    uint32_t powerups;
+    uint32_t hits;
+    float maxSpeed;
+    uint32_t unlocked[PROFILE_MAX_ACH / 32];    // keyed by achievements[] index
+    int32_t progress[PROFILE_MAX_ACH];
+    uint32_t crc;                               // over all fields above
+} ProfileSnapshot;
+
+// One change appended to the profile log after the active snapshot
+typedef struct {
+    uint32_t generation;        // records from older generations are stale
+    uint16_t type;              // ProfileRecordType
+    uint16_t key;               // ProfileStat or achievement index
+    uint32_t value;
+    uint32_t crc;               // over the fields above and the log position
+} ProfileRecord;
+
+typedef enum {
+    PREC_STAT,
+    PREC_PROGRESS,
+    PREC_UNLOCK
+} ProfileRecordType;
+
+typedef enum {
+    PSTAT_POWERUPS,
+    PSTAT_HITS,
+    PSTAT_MAX_SPEED             // float bits
+} ProfileStat;
+
+// Leaderboards: one board per metric for PvP / PvC x difficulty
+typedef enum {
+    LB_SCORE,                   // points at match end (PvC: yours, PvP: the winner's)
+    LB_RALLY,                   // longest run of consecutive_hits
+    LB_SPEED,                   // top ball speed x 100
+    LB_HARD_WIN,                // ticks to a PvC Hard win, fewest first
+    LB_METRICS
+} LeaderMetric;
+
+#define LEADER_BOARDS (LB_METRICS * 2 * 2)
+
+// A board entry in the file, followed by height LeaderLinks. Entries are
+// appended in insertion order and never move or go away.
+typedef struct {
+    uint32_t key;               // ranked high to low; see leaderKey()
+    uint32_t seq;               // insertion number; of equal keys the earlier ranks first
+    uint32_t when;              // unix time
+    uint8_t board, height;
+    uint16_t check;             // low half of checksum32 over the fields above
+} LeaderNode;
+
+// Skip list link: the next node on this level (file offset, 0 = none) and
+// how many entries it steps over, which gives ranks on the way down.
+// Widths of links to the end are not kept up.
+typedef struct {
+    uint32_t next, width;
+} LeaderLink;
+
+typedef struct {
+    uint32_t magic, version;
+    uint32_t used;              // bytes in use; the next node goes here
+    uint32_t seq;               // entries ever inserted
+    uint32_t clean;             // 0 while open for writing, 1 after leaderClose()
+    uint32_t writing;           // odd while an insert relinks (readers retry)
+    uint32_t rng;               // for node heights
+    uint32_t head[LEADER_BOARDS];   // each board's full-height head node
+    uint32_t count[LEADER_BOARDS];
+} LeaderHeader;
+
+// A result waiting for the writer thread
+typedef struct {
+    uint32_t board, value, when;
+} LeaderResult;
+
+// What leaderTop() returns
+typedef struct {
+    uint32_t value;             // in the metric's own units
+    uint32_t when;
+} LeaderEntry;
+
+#define PROFILE_SLOT_SIZE 4096
+#define PROFILE_LOG_SIZE  (PROFILE_LOG_CAP * sizeof(ProfileRecord))
+#define PROFILE_FILE_SIZE (2 * PROFILE_SLOT_SIZE + 2 * PROFILE_LOG_SIZE)
+
+// Match history tables. Rows are buffered column by column and written
+// as one compressed block per flush (see historyFlush)
+typedef enum {
+    HT_MATCH,                   // one row per match
+    HT_HIT,                     // one row per paddle hit
+    HT_POINT,                   // one row per point scored
+    HT_PICKUP,                  // one row per power-up collected
+    HT_COUNT
+} HistoryTable;
+
+typedef enum {
+    HENC_RAW8,                  // bytes as-is
+    HENC_RLE8,                  // (run, byte) pairs
+    HENC_VARINT,                // LEB128 uint32
+    HENC_DELTA                  // zigzag LEB128 of the difference to the previous row
+} HistoryEncoding;
+
+typedef struct {
+    const char* name;
+    HistoryTable table;
+    int width;                  // 1 = uint8_t column, 4 = uint32_t column
+    HistoryEncoding enc;        // byte columns pick RAW8 or RLE8, whichever is shorter
+    void* data;
+} HistoryColumn;
+
+typedef struct {
+    int rows[HT_COUNT];
+    // HT_MATCH
+    uint8_t  matchMode[HISTORY_MAX_MATCHES], matchDifficulty[HISTORY_MAX_MATCHES];
+    uint8_t  matchScore1[HISTORY_MAX_MATCHES], matchScore2[HISTORY_MAX_MATCHES];
+    uint32_t matchTicks[HISTORY_MAX_MATCHES];
+    uint32_t matchRows[HT_COUNT][HISTORY_MAX_MATCHES];     // rows of each child table
+    // HT_HIT: ticks are relative to the start of the match
+    uint32_t hitTick[HISTORY_MAX_ROWS];
+    uint8_t  hitPlayer[HISTORY_MAX_ROWS];
+    uint8_t  hitOffset[HISTORY_MAX_ROWS];   // int8: update()'s `hit` * 127
+    // HT_POINT
+    uint32_t pointTick[HISTORY_MAX_ROWS];
+    uint8_t  pointScorer[HISTORY_MAX_ROWS];
+    uint8_t  pointValue[HISTORY_MAX_ROWS];
+    uint32_t pointRally[HISTORY_MAX_ROWS];  // paddle hits since the previous point
+    uint8_t  pointCombo[HISTORY_MAX_ROWS];  // consecutive_hits when the point fell
+    uint8_t  pointBonus[HISTORY_MAX_ROWS];  // 1 = EXTRA_POINTS power-up, not a rally end
+    // HT_PICKUP
+    uint32_t pickupTick[HISTORY_MAX_ROWS];
+    uint8_t  pickupType[HISTORY_MAX_ROWS];
+} HistoryBuffer;
+
+// Replay stream: a ReplayHeader per match, then one byte per update() tick
+// (REPLAY_KEY_* / REPLAY_MOUSE* bits) or a REPLAY_OP byte for something that
+// happened between ticks
+typedef struct {
+    uint32_t magic;
+    uint32_t seed;              // srand() and fx_seed at match start
+    uint8_t  mode, difficulty;  // GameMode, DifficultyLevel
+    uint8_t  p1Control, p2Control;
+    uint16_t width, height;     // window size (sets the ortho bounds)
+    float    pvpBallSpeed;
+    float    powerupTimer;      // not reset by initGame()
+    float    animationTime;
+} ReplayHeader;
+
+typedef enum {
+    REPLAY_KEY_A     = 0x01,
+    REPLAY_KEY_D     = 0x02,
+    REPLAY_KEY_LEFT  = 0x04,
+    REPLAY_KEY_RIGHT = 0x08,
+    REPLAY_MOUSE1    = 0x10,            // f32 player1_target_x follows
+    REPLAY_MOUSE2    = 0x20,            // f32 player2_target_x follows
+    REPLAY_OP        = 0x80,
+    REPLAY_SERVE     = REPLAY_OP | 1,   // serveBall()
+    REPLAY_RESTART   = REPLAY_OP | 2,   // restartMatch()
+    REPLAY_RESIZE    = REPLAY_OP | 3,   // u16 width, u16 height follow
+    REPLAY_CONTROL   = REPLAY_OP | 4    // u8 player2_control follows
+} ReplayByte;
+
+// Everything update() reads and writes for one match, so many matches can
+// take turns on the globals (see matchSave / matchLoad). Cold components
+// (particles, trails, animation) are not included: step such matches with
+// sim_cosmetics = 0
+typedef struct {
+    Ball balls[3];
+    PowerUp powerups[MAX_POWERUPS];
+    int activeBalls;
+    int score[2];
+    float paddleX[2], targetX[2], paddleSpeed[2];
+    int bigPaddle[2];
+    int paddleWidth, paddleHeight;
+    float ballSpeed, pvpBallSpeed;
+    float powerupTimer;
+    float slowTimeFactor;
+    int comboMultiplier, consecutiveHits, totalHits;
+    int timerCount;
+    struct { int expire; uint8_t kind, arg; } timers[MAX_TIMERS];
+    int tick;
+    GameMode mode;
+    DifficultyLevel difficulty;
+    ControlMode control[2];
+    int running;
+} MatchState;
+
+// Live state for other processes: a shared-memory segment named
+// SHARE_NAME. The game copies the match into frame once per tick under a
+// seqlock: seq is odd while the copy is in progress, so a reader copies
+// frame and keeps it only if seq was even and unchanged around the copy.
+// Readers never block the game. A bot sets claim[k] to drive paddle k + 1
+// from the next match on and writes the paddle's target x like the mouse.
+typedef struct {
+    uint32_t magic, version, size;          // size = sizeof(SharedState)
+    uint32_t seq;
+    MatchState frame;
+    uint32_t claim[2];                      // written by bots
+    float target[2];                        // written by bots
+} SharedState;
+
+// Spectator grid of independent AI-vs-AI matches (menu 5), stepped on the
+// globals like envs and drawn straight from their states
+typedef struct {
+    int count, cols, rows;
+    MatchState match[MOSAIC_MAX];
+    ControlMode control[2];         // the player's, put back after every step
+    DifficultyLevel difficulty;
+} Mosaic;
+
+// One vertex of the mosaic batches: world position, atlas coordinate, colour
+typedef struct {
+    float x, y, u, v;
+    uint8_t rgba[4];
+} MosaicVertex;
 
 //              Global game state
 
@@ -127,7 +728,9 @@ static int player2_score = 0;
 static int paddle_height = PADDLE_HEIGHT;
 static int paddle_width  = PADDLE_WIDTH;
 static float paddle_velocity = 15.0f;
+#ifndef PONG_HEADLESS
 static float paddle_edge_offset = 20.0f;
+#endif
 
 static float player1_paddle_x = 0;      // bottom paddle
 static float player2_paddle_x = 0;      // top paddle
@@ -136,7 +739,23 @@ static float player1_paddle_speed = 1.0f;
 static float player2_paddle_speed = 1.0f;
 
 static Ball balls[3];
+static BallFx ball_fx[3];
 static int activeBalls = 1;
+static Arena arena;
+#ifdef PONG_DRAWING
+static int arena_players = 6;       // picked on the arena screen
+#endif
+static Level level;
+static int level_brute = 0;         // test every piece instead of walking the BVH (benchmarks)
+static FixMatch fixed_match;
+static int fixed_physics = 0;       // 1 = update() runs the fixed-point core
+static Mosaic mosaic;
+#ifndef PONG_HEADLESS
+static int mosaic_count = 36;       // matches the menu's mosaic starts with
+#endif
+#ifdef PONG_DRAWING
+static int mosaic_naive = 0;        // draw every tile the way display() draws a match (benchmarks)
+#endif
 
 static float ball_speed = 15.0f;
 static int game_running = 0;
@@ -148,43 +767,178 @@ static float pvp_ball_speed = 15.0f;
 
 static int combo_multiplier = 1;
 static int consecutive_hits = 0;
-static float combo_timer = 0.0f;
 
 static PowerUp powerups[MAX_POWERUPS];
+static PowerUpFx powerup_fx[MAX_POWERUPS];
 static float powerup_timer = 0.0f;
 
 static int player1_big_paddle = 0;
 static int player2_big_paddle = 0;
-static float powerup_duration = 0.0f;
 
 static int needsRedraw = 1;
 static float animation_time = 0.0f;
 
+static int sim_tick = 0;            // fixed-step ticks simulated so far
+static int sim_cosmetics = 1;       // 0 = skip particles, trails, animation
+static int sim_spectate = 0;        // 1 = no sound, profile, history, achievements or shared state
+static unsigned fx_seed = 1;        // particles use their own RNG, not rand()
+
+// Cheapest first; the last row is the full look
+static const QualityLevel qualityLevels[QUALITY_LEVELS] = {
+    { 4,  3, 45, 4 },
+    { 2,  5, 30, 2 },
+    { 1,  8, 20, 1 },
+    { 1, MAX_TRAIL, 15, 1 }
+};
+static QualityStats quality = { QUALITY_LEVELS - 1, 0, 0, 0, 0, 0, 0, QUALITY_UP_FRAMES, 0 };
+static int quality_auto = 0;            // the game turns the governor on
+static float quality_budgetMs = 12.0f;  // of the 16 ms tick, leaving room for update()
+static unsigned particle_requests = 0;
+
 static float slow_time_factor = 1.0f;
-static float slow_time_timer = 0.0f;
 
+static TimerWheel timers;
+
+#ifndef PONG_HEADLESS
 static int fullscreen = 0;
 static RECT windowRect;
 static DWORD windowStyle;
 static DWORD windowExStyle;
+#endif
+
+static EntityPool particle_pool = { .cap = MAX_PARTICLES };
+static ParticleBody particle_body[MAX_PARTICLES];
+static ParticleTint particle_tint[MAX_PARTICLES];
+
+// List of unlockable achievements. Each row is evaluated only when one of
+// its advanceOn/failOn events fires; a "win" is reaching 5 points in PvC.
+static Achievement achievements[] = {
+    {"First Blood",      "Score your first point",              0, 1,  0,
+        GE_BIT(GE_POINT_P1) | GE_BIT(GE_POINT_P2), 0,
+        ACH_COUNT, SCOPE_LIFETIME, ACH_ANY,  ACH_ANY,          800,  300, 0},
+    {"Combo Master",     "Get 5 hits in a row",                 0, 5,  0,
+        GE_BIT(GE_PADDLE_HIT), 0,
+        ACH_LEVEL, SCOPE_LIFETIME, ACH_ANY,  ACH_ANY,          1000, 300, 0},
+    {"Speed Demon",      "Reach ball speed 20",                 0, 20, 0,
+        GE_BIT(GE_BALL_SPEED), 0,
+        ACH_LEVEL, SCOPE_LIFETIME, ACH_ANY,  ACH_ANY,          1200, 300, 0},
+    {"Power Collector",  "Collect 10 powerups",                 0, 10, 0,
+        GE_BIT(GE_POWERUP), 0,
+        ACH_COUNT, SCOPE_LIFETIME, ACH_ANY,  ACH_ANY,          700,  300, 0},
+    {"Hard Win",         "Win on Hard difficulty",              0, 5,  0,
+        GE_BIT(GE_POINT_P1), 0,
+        ACH_SUM,   SCOPE_MATCH,    MODE_PVC, DIFFICULTY_HARD,  2000, 500, 0},
+    {"Perfect Game",     "Win without missing a ball",          0, 5,  0,
+        GE_BIT(GE_POINT_P1), GE_BIT(GE_POINT_P2),
+        ACH_SUM,   SCOPE_MATCH,    MODE_PVC, ACH_ANY,          1800, 500, 0},
+    {"Long Rally",       "Rally of 20 hits",                    0, 20, 0,
+        GE_BIT(GE_PADDLE_HIT), 0,
+        ACH_LEVEL, SCOPE_LIFETIME, ACH_ANY,  ACH_ANY,          1600, 400, 0}
+};
+
+#define ACHIEVEMENT_COUNT ((int)(sizeof(achievements) / sizeof(achievements[0])))
 
-static Particle particles[MAX_PARTICLES];
-
-// List of unlockable achievements
-static Achievement achievements[7] = {
-    {"First Blood",      "Score your first point",              0, 1,  0},
-    {"Combo Master",     "Get 5 hits in a row",                 0, 5,  0},
-    {"Speed Demon",      "Reach ball speed 20",                 0, 20, 0},
-    {"Power Collector",  "Collect 10 powerups",                 0, 10, 0},
-    {"Hard Win",         "Win on Hard difficulty",              0, 1,  0},
-    {"Perfect Game",     "Win without missing a ball",          0, 1,  0},
-    {"Long Rally",       "Rally of 20 hits",                    0, 20, 0}
+// Per-event subscriber lists, built once from the table above
+static unsigned short achSubs[GE_COUNT][ACHIEVEMENT_COUNT];
+static int achSubCount[GE_COUNT];
+static int achIndexBuilt = 0;
+
+// AI presets indexed by DifficultyLevel (tools/tune.c can regenerate these)
+static AIParams aiParams[2] = {
+    // reaction accuracy errChance maxErr speedMult anticipate adapt bounceBlend snapDist
+    // rallyHits rallyReactionMax learnHits learnRate learnMax learnReactionMax
+    {0.95f, 0.85f, 0.3f, 50.0f, 1.2f, 0.6f, 0.15f, 0.3f,  0.0f, 5, 1.2f, 50, 0.005f, 0.3f, 1.3f}, // Medium
+    {1.1f,  0.95f, 0.0f,  0.0f, 1.6f, 0.8f, 0.2f,  0.6f, 50.0f, 5, 1.2f, 50, 0.005f, 0.3f, 1.3f}  // Hard
 };
 
+static NNPolicy nnPolicy;
+
 static int achievements_unlocked = 0;
 static int powerups_collected = 0;
 static float max_ball_speed = 0;
 static int total_hits = 0;
+static int lifetime_hits = 0;
+
+// Memory-mapped profile file (NULL when no profile is open)
+static unsigned char* profile_base = NULL;
+static ProfileSnapshot profile_live;    // snapshot + replayed log
+static int profile_slot = 0;            // header slot holding the live generation
+static int profile_count = 0;           // records appended since that snapshot
+static uint32_t profile_top = 0;        // highest generation stamped anywhere in the file
+#ifdef _WIN32
+static HANDLE profile_file = NULL, profile_map = NULL;
+#else
+static int profile_fd = -1;
+#endif
+
+// Shared state export (NULL when no segment is open)
+static SharedState* share = NULL;
+static ControlMode share_saved[2];      // controls a claim replaced
+#ifdef _WIN32
+static HANDLE share_map = NULL;
+#endif
+
+// Match history (recording is off while history_path is NULL)
+static const char* history_path = NULL;
+static int history_block_matches = 1;  // flush after this many matches
+static HistoryBuffer history;
+static int history_start = 0;           // sim_tick when the match began
+static int history_first[HT_COUNT];     // first row of the match in each table
+static int history_rally = 0;
+static int history_mode = 0, history_difficulty = 0;
+
+// Leaderboards (off while leader is NULL)
+static LeaderHeader* leader = NULL;
+static uint32_t leader_size = 0;        // file bytes backing the mapping
+static LeaderResult leader_queue[LEADER_QUEUE];
+static unsigned leader_queued = 0;      // advanced by the game thread
+static unsigned leader_done = 0;        // advanced by the writer thread
+static unsigned leader_dropped = 0;     // results lost to a full queue
+static int leader_running = 0;          // the writer thread was started
+static int leader_quit = 0;
+#ifdef _WIN32
+static HANDLE leader_file = NULL, leader_map = NULL, leader_thread = NULL;
+#else
+static int leader_fd = -1;
+static pthread_t leader_thread;
+#endif
+
+// The match being played, for the leaderboards
+static int leader_start = 0;            // sim_tick when it began
+static int leader_mode = 0, leader_difficulty = 0;
+static int match_rally = 0;             // longest consecutive_hits
+static float match_top_speed = 0;
+static int match_win_tick = -1;         // sim_tick of a PvC Hard win
+
+// Replay recording (off while replay_path is NULL)
+static const char* replay_path = NULL;
+static FILE* replay_file = NULL;
+static int replay_active = 0;           // a header has been written for this match
+static int replay_mouseMoved = 0;       // mouse targets changed since the last tick
+
+static const HistoryColumn historyColumns[] = {
+    {"match.mode",       HT_MATCH,  1, HENC_RAW8,   history.matchMode},
+    {"match.difficulty", HT_MATCH,  1, HENC_RAW8,   history.matchDifficulty},
+    {"match.score1",     HT_MATCH,  1, HENC_RAW8,   history.matchScore1},
+    {"match.score2",     HT_MATCH,  1, HENC_RAW8,   history.matchScore2},
+    {"match.ticks",      HT_MATCH,  4, HENC_VARINT, history.matchTicks},
+    {"match.hits",       HT_MATCH,  4, HENC_VARINT, history.matchRows[HT_HIT]},
+    {"match.points",     HT_MATCH,  4, HENC_VARINT, history.matchRows[HT_POINT]},
+    {"match.pickups",    HT_MATCH,  4, HENC_VARINT, history.matchRows[HT_PICKUP]},
+    {"hit.tick",         HT_HIT,    4, HENC_DELTA,  history.hitTick},
+    {"hit.player",       HT_HIT,    1, HENC_RAW8,   history.hitPlayer},
+    {"hit.offset",       HT_HIT,    1, HENC_RAW8,   history.hitOffset},
+    {"point.tick",       HT_POINT,  4, HENC_DELTA,  history.pointTick},
+    {"point.scorer",     HT_POINT,  1, HENC_RAW8,   history.pointScorer},
+    {"point.value",      HT_POINT,  1, HENC_RAW8,   history.pointValue},
+    {"point.rally",      HT_POINT,  4, HENC_VARINT, history.pointRally},
+    {"point.combo",      HT_POINT,  1, HENC_RAW8,   history.pointCombo},
+    {"point.bonus",      HT_POINT,  1, HENC_RAW8,   history.pointBonus},
+    {"pickup.tick",      HT_PICKUP, 4, HENC_DELTA,  history.pickupTick},
+    {"pickup.type",      HT_PICKUP, 1, HENC_RAW8,   history.pickupType}
+};
+
+#define HISTORY_COLUMNS ((int)(sizeof(historyColumns) / sizeof(historyColumns[0])))
 
 static ControlMode player1_control = CONTROL_KEYBOARD_1;
 static ControlMode player2_control = CONTROL_KEYBOARD_2;
@@ -192,25 +946,55 @@ static ControlMode player2_control = CONTROL_KEYBOARD_2;
 // Keyboard press tracking
 static int key_d_pressed = 0;
 static int key_a_pressed = 0;
-static int key_o_pressed = 0;
+static int key_left_pressed  = 0;
+static int key_right_pressed = 0;
+#ifndef PONG_HEADLESS
+static int key_o_pressed = 0;       // only the window code reads these
 static int key_l_pressed = 0;
 static int key_up_pressed    = 0;
 static int key_down_pressed  = 0;
 static int key_w_pressed = 0;
 static int key_s_pressed = 0;
-static int key_left_pressed  = 0;
-static int key_right_pressed = 0;
+#endif
 
 // Smooth paddle movement targets
 static float player1_target_x = 0;
 static float player2_target_x = 0;
 static float paddle_acceleration = 0.2f;
 
+// Late latch (F9): draw local paddles at the input read right before the
+// frame is submitted rather than at the smoothed simulation position
+#ifdef PONG_DRAWING
+static int late_latch = 1;
+#endif
+#ifndef PONG_HEADLESS
+static double last_tick_ms = 0;     // frameClockMs() after the last update()
+#endif
+static LatencyProbe latency;
+static PerfStats perf;
+
+#ifdef PONG_REAL_GL
+// F6: balls and power-ups through the GL 3.3 shaders when the driver has
+// them, or through the fixed-function drawBall() / drawPowerUp()
+static int shader_fx = 1;
+#endif
+
+#ifdef PONG_DRAWING
+// Every immediate-mode primitive and vertex passes through these, so the
+// overlay's counts cost one increment each
+#define glBegin(mode)    (perf.drawCalls++, glBegin(mode))
+#define glVertex2f(x, y) (perf.vertices++, glVertex2f(x, y))
+#endif
+
+#ifndef PONG_HEADLESS
 HWND hwnd;
+#endif
+#ifdef PONG_DRAWING
 HDC hdc;
 HGLRC hrc;
 HFONT gameFont;
 HFONT largeFont;
+#endif
 
 //              Function prototypes
 
@@ -221,31 +1005,115 @@ void drawText(const char* text, float x, float y, int useLargeFont);
 void drawCenterLine();
 void drawPaddle(float x, float y, int isBig, int player);
 void drawBall(Ball* ball);
-void drawPowerUp(PowerUp p);
+void drawPowerUp(int slot);
+void initShaderEffects();
+int  drawShadedEffects();
+void gpuTimerBegin();
+float gpuTimerEnd();
 void resetBall(Ball* ball);
+void anchorBall(Ball* ball);
+void setBallVelocity(Ball* ball, float vx, float vy);
 void spawnPowerUp();
 void updateAI(int player);
+void updateNeuralAI(int player);
+int  loadPolicy(const char* path);
+void matchObserve(int player, float* out);
+void nnFeatures(int player, int16_t* out);
+void nnForwardBatch(const int16_t (*in)[NN_INPUTS], float* out, int count);
 void playSound(int frequency, int duration);
 void drawMenu();
 void drawDifficultyMenu();
 void drawSpeedMenu();
 void updatePowerUps();
 void checkPowerUpCollision(Ball* ball);
-void updateCombo();
+void timerAt(int expire, TimerKind kind, int arg);
+void timerCancelKey(TimerKind kind, int arg);
+int  timerExpiry(TimerKind kind, int arg);
+int  timerNext();
+void timerAdvance(int tick);
+void timerClear();
+int  countdownTicks(float seconds);
 void redraw();
 void drawCircle(float cx, float cy, float r, int segments);
 void display();
 void update();
+int  advanceTicks(int maxTicks, int stopOnScore);
+void qualityFrame(float ms);
+double frameClockMs();
+void perfTick(double ms);
+void perfPresent();
+void drawPerfOverlay(double submitMs);
 void updateParticles();
 void drawParticles();
-void updateTrail(Ball* ball);
-void drawTrail(Ball* ball);
+void clearParticles();
+void updateTrail(int slot);
+void drawTrail(int slot);
 void drawAchievements();
-void checkAchievements();
-void addParticle(float x, float y, float r, float g, float b);
+void raiseGameEvent(GameEvent e, int value);
+int  profileOpen(const char* path);
+void profileRecord(ProfileRecordType type, int key, uint32_t value);
+void profileCompact();
+void profileClose();
+void historyHit(int player, float hit);
+void historyPoint(int scorer, int points, int bonus);
+void historyPickup(int type);
+void historyEndMatch();
+int  leaderOpen(const char* path);
+void leaderClose();
+int  leaderBoard(LeaderMetric metric, int mode, int difficulty);
+void leaderSubmit(int board, uint32_t value);
+int  leaderTop(int board, LeaderEntry* out, int n);
+uint32_t leaderRank(int board, uint32_t value);
+void leaderEndMatch();
+void historyFlush();
+void replayBeginMatch();
+void replayTick();
+void replayOp(int op, const void* data, int len);
+void replayResize();
+void replayClose();
+void serveBall();
+void restartMatch();
+void matchSave(MatchState* s);
+void matchLoad(const MatchState* s);
+int  shareOpen(const char* name, int create);
+void shareClose();
+void sharePublish();
+int  shareRead(const SharedState* s, MatchState* out);
+void shareInput();
+void shareClaims();
+EntityId addParticle(float x, float y, float r, float g, float b);
+void removeParticle(EntityId id);
+EntityId poolAdd(EntityPool* pool);
+int  poolIndex(const EntityPool* pool, EntityId id);
+int  poolRemoveAt(EntityPool* pool, int index);
+void poolClear(EntityPool* pool);
 void updateControls(float deltaTime);
+float latchedPaddleX(int player);
+void latencyInput(int player, float goal);
+void latencyKeys();
+void latencyPresent(float x1, float x2);
+int  latencyPercentile(float p);
 void updateOrthoBounds();
 void correctPaddlePositions();
+void initArena(int players, int balls, int humans);
+void updateArena();
+void updateArenaAI();
+int  arenaEdgeOf(float x, float y);
+int  levelLoad(const char* path);
+void mosaicInit(int count);
+void mosaicStep();
+void mosaicRestore();
+void levelScatter(int pieces, unsigned seed, float radius);
+void levelClear();
+void drawArena();
+void drawArenaScores();
+void drawArenaMenu();
+void drawMosaic();
+void drawMosaicText();
+void fixInit(FixMatch* m, uint32_t seed, int aiMask);
+void fixStep(FixMatch* m, int dir0, int dir1);
+uint64_t fixHash(const FixMatch* m);
+void updateFixed();
 
 //              Implementation
 
@@ -285,11 +1153,17 @@ void correctPaddlePositions() {
 
 // Basic Windows beep sound with sanity checks
 void playSound(int frequency, int duration) {
+#ifndef PONG_HEADLESS
+    if (sim_spectate) return;       // Beep() blocks; mosaic matches stay silent
     if (frequency < 37  || frequency > 32767) frequency = 1000;
     if (duration   < 1   || duration   > 5000)  duration   = 100;
     Beep(frequency, duration);
+#else
+    (void)frequency; (void)duration;
+#endif
 }
 
+#ifndef PONG_HEADLESS
 // Initialize OpenGL context, fonts, blending, initial state
 void initOpenGL() {
     PIXELFORMATDESCRIPTOR pfd = {
@@ -327,8 +1201,8 @@ void initOpenGL() {
                             DEFAULT_PITCH|FF_DONTCARE, "Arial");
 
     // Clear powerups & particles
-    for (int i = 0; i < MAX_POWERUPS;  i++) powerups[i].active = 0;
-    for (int i = 0; i < MAX_PARTICLES; i++) particles[i].life = 0.0f;
+    for (int i = 0; i < MAX_POWERUPS; i++) powerups[i].active = 0;
+    clearParticles();
 
     initBalls();
 
@@ -347,23 +1221,86 @@ void initOpenGL() {
     glMatrixMode(GL_MODELVIEW);
 
     correctPaddlePositions();
+    initShaderEffects();
+}
+#endif // PONG_HEADLESS
+
+#ifdef PONG_SOFTRENDER
+// Software counterpart of initOpenGL(): the same GL state, but frames go
+// to softgl's in-memory framebuffer (sw_fb) when swFinish() is called
+int initSoftRenderer(int width, int height, int threads) {
+    if (!swInit(width, height, threads)) return 0;
+    windowWidth = width;
+    windowHeight = height;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    gameFont  = swCreateFont(24);
+    largeFont = swCreateFont(32);
+
+    updateOrthoBounds();
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+
+    correctPaddlePositions();
+    return 1;
+}
+#endif // PONG_SOFTRENDER
+
+#ifdef PONG_EGLRENDER
+// initOpenGL() for the offscreen EGL context: the same GL state and shader
+// effects, drawn into eglgl's pbuffer
+int initEglRenderer(int width, int height) {
+    if (!eglglInit(width, height)) return 0;
+    windowWidth = width;
+    windowHeight = height;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_LINE_SMOOTH);
+    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glShadeModel(GL_SMOOTH);
+
+    gameFont  = eglglCreateFont(24);
+    largeFont = eglglCreateFont(32);
+
+    updateOrthoBounds();
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+
+    correctPaddlePositions();
+    initShaderEffects();
+    return 1;
 }
+#endif // PONG_EGLRENDER
 
 // Reset ball array — only first one active initially
 void initBalls() {
     for (int i = 0; i < 3; i++) {
-        balls[i].active     = (i == 0);
-        balls[i].type       = BALL_NORMAL;
-        balls[i].trailIndex = 0;
+        balls[i].active  = (i == 0);
+        balls[i].type    = BALL_NORMAL;
+        ball_fx[i].trailIndex = 0;
         for (int j = 0; j < MAX_TRAIL; j++)
-            balls[i].trail[j].life = 0.0f;
+            ball_fx[i].trail[j].life = 0.0f;
     }
     activeBalls = 1;
 }
 
 // Reset scores, paddles, timers, spawn initial ball
 void initGame() {
+    historyEndMatch();
+    leaderEndMatch();
+    shareClaims();
+    replayBeginMatch();
     player1_score = player2_score = 0;
+    raiseGameEvent(GE_MATCH_START, 0);
     player1_paddle_x = player2_paddle_x = 0;
     player1_target_x = player2_target_x = 0;
     player1_paddle_speed = player2_paddle_speed = 1.0f;
@@ -377,12 +1314,10 @@ void initGame() {
 
     combo_multiplier = 1;
     consecutive_hits = 0;
-    combo_timer = 0.0f;
-    powerup_duration = 0.0f;
     player1_big_paddle = player2_big_paddle = 0;
     slow_time_factor = 1.0f;
-    slow_time_timer = 0.0f;
     total_hits = 0;
+    timerClear();
 
     for (int i = 0; i < MAX_POWERUPS; i++)
         powerups[i].active = 0;
@@ -394,8 +1329,28 @@ void initGame() {
             resetBall(&balls[i]);
 }
 
+// Put the main ball in play (match start, or resuming from pause)
+void serveBall() {
+    resetBall(&balls[0]);
+    game_running = 1;
+    replayOp(REPLAY_SERVE, NULL, 0);
+}
+
+// R key: zero the scores and re-serve, keeping paddles and power-ups
+void restartMatch() {
+    historyEndMatch();
+    leaderEndMatch();
+    player1_score = player2_score = 0;
+    raiseGameEvent(GE_MATCH_START, 0);
+    for (int j = 0; j < 3; j++) if (balls[j].active) resetBall(&balls[j]);
+    replayOp(REPLAY_RESTART, NULL, 0);
+}
+
+#ifdef PONG_DRAWING
 // Draw filled circle (used for balls, glows, effects)
 void drawCircle(float cx, float cy, float r, int segments) {
+    segments /= qualityLevels[quality.level].circleDiv;
+    if (segments < 6) segments = 6;
     glBegin(GL_TRIANGLE_FAN);
     glVertex2f(cx, cy);
     for (int i = 0; i <= segments; i++) {
@@ -432,77 +1387,208 @@ void drawText(const char* text, float x, float y, int useLarge) {
     glMatrixMode(GL_PROJECTION); glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
 }
+#endif // PONG_DRAWING
 
-// Spawn one particle with random direction
-void addParticle(float x, float y, float r, float g, float b) {
-    for (int i = 0; i < MAX_PARTICLES; i++) {
-        if (particles[i].life <= 0.0f) {
-            particles[i].x = x; particles[i].y = y;
-            particles[i].vx = (rand() % 100 - 50) / 50.0f;
-            particles[i].vy = (rand() % 100 - 50) / 50.0f;
-            particles[i].life = 1.0f;
-            particles[i].size = (rand() % 5 + 2);
-            particles[i].r = r; particles[i].g = g; particles[i].b = b;
-            break;
-        }
+// Cosmetic random numbers, kept apart from rand() so effects never change
+// the gameplay random sequence
+static int fxRand() {
+    fx_seed = fx_seed * 1103515245u + 12345u;
+    return (int)((fx_seed >> 16) & 0x7FFF);
+}
+
+//              Quality governor
+
+// Monotonic milliseconds, for frame timing only
+double frameClockMs() {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000.0 / freq.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec * 1e-6;
+#endif
+}
+
+// Feed the cost of one gameplay frame. With quality_auto set, detail is
+// shed after QUALITY_DOWN_FRAMES frames over budget and restored after
+// quality.upHold frames of headroom. A step down soon after a step up
+// doubles upHold, so a level that cannot hold the budget is retried less
+// and less often instead of flickering.
+void qualityFrame(float ms) {
+    QualityStats* q = &quality;
+    q->frames++;
+    q->frameMs = (q->frames == 1) ? ms : q->frameMs + (ms - q->frameMs) * 0.1f;
+    if (q->frameMs > quality_budgetMs) q->overBudget++;
+    if (!quality_auto) return;
+
+    if (q->frameMs > quality_budgetMs)                          q->streak = (q->streak > 0) ? q->streak + 1 : 1;
+    else if (q->frameMs < quality_budgetMs * QUALITY_HEADROOM) q->streak = (q->streak < 0) ? q->streak - 1 : -1;
+    else                                                        q->streak = 0;
+
+    if (q->streak >= QUALITY_DOWN_FRAMES && q->level > 0) {
+        if (q->stepsUp && q->frames - q->lastUp < (unsigned)q->upHold)
+            q->upHold = (q->upHold < QUALITY_UP_FRAMES * 16) ? q->upHold * 2 : q->upHold;
+        q->level--;
+        q->stepsDown++;
+    } else if (q->streak <= -q->upHold && q->level < QUALITY_LEVELS - 1) {
+        q->level++;
+        q->stepsUp++;
+        q->lastUp = q->frames;
+    } else return;
+
+    // Restart the average at the new level
+    q->streak = 0;
+    q->frameMs = ms;
+}
+
+//              Entity pools
+
+// Claim a slot; the new entity gets dense index pool->count - 1.
+// Returns ENTITY_NONE when the pool is full.
+EntityId poolAdd(EntityPool* pool) {
+    if (pool->count == pool->cap) return ENTITY_NONE;
+    if (pool->count == pool->used) {
+        pool->slotOf[pool->used] = (uint16_t)pool->used;
+        pool->gen[pool->used++] = 1;
     }
+    int slot = pool->slotOf[pool->count];
+    pool->denseOf[slot] = (uint16_t)pool->count++;
+    return ((EntityId)pool->gen[slot] << 16) | (EntityId)slot;
+}
+
+// Dense index of a live entity, or -1 for a stale or empty handle
+int poolIndex(const EntityPool* pool, EntityId id) {
+    int slot = (int)(id & 0xFFFF);
+    if (slot >= pool->used || pool->gen[slot] != (uint16_t)(id >> 16)) return -1;
+    int index = pool->denseOf[slot];
+    return (index < pool->count && pool->slotOf[index] == slot) ? index : -1;
+}
+
+static void poolRetire(EntityPool* pool, int slot) {
+    if (++pool->gen[slot] == 0) pool->gen[slot] = 1;
+}
+
+// Free the entity at a dense index by moving the last one into its place.
+// Returns the index the caller must copy its components from (the old
+// last index), which equals index when nothing moved.
+int poolRemoveAt(EntityPool* pool, int index) {
+    int last = --pool->count;
+    int slot = pool->slotOf[index], moved = pool->slotOf[last];
+    poolRetire(pool, slot);
+    pool->slotOf[index] = (uint16_t)moved;
+    pool->denseOf[moved] = (uint16_t)index;
+    pool->slotOf[last] = (uint16_t)slot;
+    return last;
+}
+
+void poolClear(EntityPool* pool) {
+    for (int i = 0; i < pool->count; i++) poolRetire(pool, pool->slotOf[i]);
+    pool->count = 0;
+}
+
+//              Particles
+
+// Spawn one particle with random direction
+EntityId addParticle(float x, float y, float r, float g, float b) {
+    if (!sim_cosmetics) return ENTITY_NONE;
+    if (++particle_requests % qualityLevels[quality.level].particleEvery) return ENTITY_NONE;
+    EntityId id = poolAdd(&particle_pool);
+    if (id == ENTITY_NONE) return id;
+
+    int i = particle_pool.count - 1;
+    ParticleBody* p = &particle_body[i];
+    p->x = x; p->y = y;
+    p->vx = (fxRand() % 100 - 50) / 50.0f;
+    p->vy = (fxRand() % 100 - 50) / 50.0f;
+    p->life = 1.0f;
+    p->size = (fxRand() % 5 + 2);
+    particle_tint[i] = (ParticleTint){ r, g, b };
+    return id;
+}
+
+static void removeParticleAt(int i) {
+    int from = poolRemoveAt(&particle_pool, i);
+    particle_body[i] = particle_body[from];
+    particle_tint[i] = particle_tint[from];
+}
+
+void removeParticle(EntityId id) {
+    int i = poolIndex(&particle_pool, id);
+    if (i >= 0) removeParticleAt(i);
+}
+
+void clearParticles() {
+    poolClear(&particle_pool);
 }
 
+// Step live particles; burnt-out ones are swapped out of the packed range
 void updateParticles() {
-    for (int i = 0; i < MAX_PARTICLES; i++) {
-        if (particles[i].life > 0.0f) {
-            particles[i].x += particles[i].vx;
-            particles[i].y += particles[i].vy;
-            particles[i].vy -= 0.05f;           // light gravity
-            particles[i].life -= 0.02f;
-            particles[i].size *= 0.98f;
-        }
+    for (int i = 0; i < particle_pool.count; ) {
+        ParticleBody* p = &particle_body[i];
+        p->x += p->vx;
+        p->y += p->vy;
+        p->vy -= 0.05f;                 // light gravity
+        p->life -= 0.02f;
+        p->size *= 0.98f;
+        if (p->life > 0.0f) i++;
+        else removeParticleAt(i);
     }
 }
 
+#ifdef PONG_DRAWING
 void drawParticles() {
     glPointSize(3.0f);
     glBegin(GL_POINTS);
-    for (int i = 0; i < MAX_PARTICLES; i++) {
-        if (particles[i].life > 0.0f) {
-            float a = particles[i].life;
-            glColor4f(particles[i].r, particles[i].g, particles[i].b, a);
-            glVertex2f(particles[i].x, particles[i].y);
-        }
+    for (int i = 0; i < particle_pool.count; i++) {
+        const ParticleTint* c = &particle_tint[i];
+        glColor4f(c->r, c->g, c->b, particle_body[i].life);
+        glVertex2f(particle_body[i].x, particle_body[i].y);
     }
     glEnd();
 }
+#endif // PONG_DRAWING
 
 // Add current position to ball's trail (circular buffer)
-void updateTrail(Ball* ball) {
-    ball->trailIndex = (ball->trailIndex + 1) % MAX_TRAIL;
-    TrailPoint* p = &ball->trail[ball->trailIndex];
+void updateTrail(int slot) {
+    const Ball* ball = &balls[slot];
+    BallFx* fx = &ball_fx[slot];
+    fx->trailIndex = (fx->trailIndex + 1) % MAX_TRAIL;
+    TrailPoint* p = &fx->trail[fx->trailIndex];
     p->x = ball->x;
     p->y = ball->y;
     p->life = 1.0f;
     p->size = ball->radius;
 
     for (int i = 0; i < MAX_TRAIL; i++)
-        if (ball->trail[i].life > 0.0f) {
-            ball->trail[i].life -= 0.1f;
-            ball->trail[i].size *= 0.95f;
+        if (fx->trail[i].life > 0.0f) {
+            fx->trail[i].life -= 0.1f;
+            fx->trail[i].size *= 0.95f;
         }
 }
 
+#ifdef PONG_DRAWING
 // Draw trail — currently only for fire ball
-void drawTrail(Ball* ball) {
-    if (ball->type != BALL_FIRE) return;
+void drawTrail(int slot) {
+    if (balls[slot].type != BALL_FIRE) return;
 
+    const BallFx* fx = &ball_fx[slot];
+    int points = qualityLevels[quality.level].trailPoints;
     glBegin(GL_TRIANGLE_STRIP);
     for (int i = 0; i < MAX_TRAIL; i++) {
-        int idx = (ball->trailIndex + i) % MAX_TRAIL;
-        if (ball->trail[idx].life > 0.0f) {
-            float a = ball->trail[idx].life * 0.5f;
-            float s = ball->trail[idx].size;
+        int idx = (fx->trailIndex + i) % MAX_TRAIL;
+        int age = (fx->trailIndex - idx + MAX_TRAIL) % MAX_TRAIL;
+        const TrailPoint* t = &fx->trail[idx];
+        if (t->life > 0.0f && age < points) {
+            float a = t->life * 0.5f;
+            float s = t->size;
             glColor4f(1.0f, 0.5f, 0.0f, a);
-            glVertex2f(ball->trail[idx].x - s, ball->trail[idx].y);
+            glVertex2f(t->x - s, t->y);
             glColor4f(1.0f, 0.0f, 0.0f, a * 0.5f);
-            glVertex2f(ball->trail[idx].x + s, ball->trail[idx].y);
+            glVertex2f(t->x + s, t->y);
         }
     }
     glEnd();
@@ -575,6 +1661,8 @@ void drawPaddle(float x, float y_unused, int isBig, int player) {
 void drawBall(Ball* ball) {
     if (!ball->active) return;
 
+    int step = qualityLevels[quality.level].ballStep;
+
     glPushMatrix();
     glTranslatef(ball->x, ball->y, 0);
     glRotatef(animation_time * 50.0f, 0,0,1);
@@ -584,7 +1672,7 @@ void drawBall(Ball* ball) {
             glBegin(GL_TRIANGLE_FAN);
             glColor3f(1.0f, 0.5f, 0.0f);
             glVertex2f(0,0);
-            for (int i = 0; i <= 360; i += 15) {
+            for (int i = 0; i <= 360; i += step) {
                 float a = i * PI / 180.0f;
                 float r = ball->radius * (0.9f + sinf(animation_time*3.0f + a)*0.1f);
                 glColor3f(1.0f, 0.6f - i/720.0f, 0.2f - i/1440.0f);
@@ -597,7 +1685,7 @@ void drawBall(Ball* ball) {
             glBegin(GL_TRIANGLE_FAN);
             glColor3f(1.0f, 0.8f, 0.0f);
             glVertex2f(0,0);
-            for (int i = 0; i <= 360; i += 15) {
+            for (int i = 0; i <= 360; i += step) {
                 float a = i * PI / 180.0f;
                 float r = ball->radius * (0.8f + sinf(animation_time*5.0f + a)*0.2f);
                 glColor3f(1.0f, 0.3f + 0.5f*sinf(animation_time*2.0f + a), 0.0f);
@@ -610,7 +1698,7 @@ void drawBall(Ball* ball) {
             glBegin(GL_TRIANGLE_FAN);
             glColor3f(0.6f, 0.8f, 1.0f);
             glVertex2f(0,0);
-            for (int i = 0; i <= 360; i += 15) {
+            for (int i = 0; i <= 360; i += step) {
                 float a = i * PI / 180.0f;
                 float r = ball->radius * (0.9f + sinf(animation_time*2.0f + a)*0.1f);
                 glColor3f(0.4f + 0.2f*sinf(animation_time + a),
@@ -625,7 +1713,7 @@ void drawBall(Ball* ball) {
             glBegin(GL_TRIANGLE_FAN);
             glColor3f(0.8f, 0.0f, 0.8f);
             glVertex2f(0,0);
-            for (int i = 0; i <= 360; i += 15) {
+            for (int i = 0; i <= 360; i += step) {
                 float a = i * PI / 180.0f;
                 float r = ball->radius * (0.85f + sinf(animation_time*4.0f + a)*0.15f);
                 glColor3f(0.6f + 0.2f*sinf(animation_time*3.0f + a), 0.0f,
@@ -634,6 +1722,9 @@ void drawBall(Ball* ball) {
             }
             glEnd();
             break;
+
+        default:
+            break;
     }
 
     // Small white highlight
@@ -641,7 +1732,7 @@ void drawBall(Ball* ball) {
     drawCircle(ball->radius * 0.3f, ball->radius * 0.3f, ball->radius * 0.2f, 16);
 
     // Slow-motion ring effect
-    if (ball->type == BALL_NORMAL && slow_time_timer > 0) {
+    if (ball->type == BALL_NORMAL && timerExpiry(TIMER_SLOW_TIME, 0) >= 0) {
         glColor4f(1.0f, 1.0f, 1.0f, 0.3f);
         drawCircle(0, 0, ball->radius * 1.5f, 32);
     }
@@ -650,14 +1741,15 @@ void drawBall(Ball* ball) {
 }
 
 // Draw rotating glowing power-up cube
-void drawPowerUp(PowerUp p) {
-    if (!p.active) return;
+void drawPowerUp(int slot) {
+    const PowerUp* p = &powerups[slot];
+    if (!p->active) return;
 
     glPushMatrix();
-    glTranslatef(p.x, p.y, 0);
-    glRotatef(p.rotation, 0,0,1);
+    glTranslatef(p->x, p->y, 0);
+    glRotatef(powerup_fx[slot].rotation, 0,0,1);
 
-    switch (p.type) {
+    switch (p->type) {
         case POWERUP_BIG_PADDLE:     glColor3f(0.0f,1.0f,0.0f); break;
         case POWERUP_SLOW_BALL:      glColor3f(0.0f,0.5f,1.0f); break;
         case POWERUP_EXTRA_POINTS:   glColor3f(1.0f,1.0f,0.0f); break;
@@ -668,7 +1760,7 @@ void drawPowerUp(PowerUp p) {
         default:                     glColor3f(0.7f,0.7f,0.7f);
     }
 
-    float s = p.size + sinf(animation_time * 3.0f) * 0.2f;
+    float s = powerup_fx[slot].size + sinf(animation_time * 3.0f) * 0.2f;
     glScalef(s, s, s);
 
     glBegin(GL_QUADS);
@@ -687,6 +1779,344 @@ void drawPowerUp(PowerUp p) {
     glPopMatrix();
 }
 
+//              Shader effects (GL 3.3)
+//
+// Balls and power-ups as instanced quads: the CPU writes five floats per
+// entity, and the wobble, colour animation, spin and pulse are computed in
+// the shaders from animation_time. The shaders use GL 3.3 core features
+// only, but the rest of the frame is still fixed-function, so they run in
+// the compatibility context initOpenGL() or initEglRenderer() creates.
+// Without GL 3.3, when a shader fails to build, or in softgl builds,
+// drawBall() and drawPowerUp() draw them instead.
+
+#ifdef PONG_REAL_GL
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER     0x8892
+#define GL_STREAM_DRAW      0x88E0
+#define GL_FRAGMENT_SHADER  0x8B30
+#define GL_VERTEX_SHADER    0x8B31
+#define GL_COMPILE_STATUS   0x8B81
+#define GL_LINK_STATUS      0x8B82
+#endif
+#ifndef GL_TIME_ELAPSED
+#define GL_QUERY_RESULT     0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#define GL_TIME_ELAPSED     0x88BF
+#endif
+
+// Entry points past GL 1.1, fetched at run time
+#define SHADER_PROCS(X) \
+    X(GLuint, glCreateShader,      (GLenum type)) \
+    X(void,   glShaderSource,      (GLuint shader, GLsizei count, const char* const* src, const GLint* len)) \
+    X(void,   glCompileShader,     (GLuint shader)) \
+    X(void,   glGetShaderiv,       (GLuint shader, GLenum name, GLint* value)) \
+    X(void,   glDeleteShader,      (GLuint shader)) \
+    X(GLuint, glCreateProgram,     (void)) \
+    X(void,   glAttachShader,      (GLuint program, GLuint shader)) \
+    X(void,   glLinkProgram,       (GLuint program)) \
+    X(void,   glGetProgramiv,      (GLuint program, GLenum name, GLint* value)) \
+    X(void,   glUseProgram,        (GLuint program)) \
+    X(GLint,  glGetUniformLocation, (GLuint program, const char* name)) \
+    X(void,   glUniform1i,         (GLint loc, GLint v)) \
+    X(void,   glUniform1f,         (GLint loc, GLfloat v)) \
+    X(void,   glUniform4f,         (GLint loc, GLfloat x, GLfloat y, GLfloat z, GLfloat w)) \
+    X(void,   glGenBuffers,        (GLsizei n, GLuint* buffers)) \
+    X(void,   glBindBuffer,        (GLenum target, GLuint buffer)) \
+    X(void,   glBufferData,        (GLenum target, ptrdiff_t size, const void* data, GLenum usage)) \
+    X(void,   glGenVertexArrays,   (GLsizei n, GLuint* arrays)) \
+    X(void,   glBindVertexArray,   (GLuint array)) \
+    X(void,   glEnableVertexAttribArray, (GLuint index)) \
+    X(void,   glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean norm, GLsizei stride, const void* offset)) \
+    X(void,   glVertexAttribDivisor, (GLuint index, GLuint divisor)) \
+    X(void,   glDrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instances)) \
+    X(void,   glGenQueries,        (GLsizei n, GLuint* ids)) \
+    X(void,   glBeginQuery,        (GLenum target, GLuint id)) \
+    X(void,   glEndQuery,          (GLenum target)) \
+    X(void,   glGetQueryObjectiv,  (GLuint id, GLenum name, GLint* value)) \
+    X(void,   glGetQueryObjectui64v, (GLuint id, GLenum name, uint64_t* value))
+
+#define SHADER_PROC_DECLARE(ret, name, args) static ret (APIENTRY *p##name) args;
+SHADER_PROCS(SHADER_PROC_DECLARE)
+
+static struct {
+    int ready;
+    GLuint program, vao, vbo;
+    GLint uOrtho, uTime, uPixel, uKind, uSlowRing, uBlend;
+} shaderFx;
+
+// GPU time of a frame's GL work, from GL_TIME_ELAPSED queries. Two queries
+// alternate and each is read back when its turn comes round again, two
+// frames later, so reading never stalls; a result that still isn't in
+// leaves that frame untimed rather than wait for it.
+static struct {
+    int ready, running, next;
+    GLuint query[2];
+    int pending[2];             // issued and not read back yet
+    float ms;                   // newest result, 0 until there is one
+} gpuTimer;
+
+// One quad per instance from gl_VertexID. Per-type constants are picked
+// here once per vertex; local is the position in the entity's spinning
+// frame, so the fragment shader never rotates anything.
+static const char* shaderFxVertex =
+    "#version 330 core\n"
+    "layout(location = 0) in vec4 place;     // x, y, radius or size, rotation in degrees\n"
+    "layout(location = 1) in float type;\n"
+    "uniform vec4 ortho;                     // left, right, bottom, top\n"
+    "uniform float time, pixel;\n"
+    "uniform int kind;                       // 0 = balls, 1 = power-ups\n"
+    "out vec2 local;\n"
+    "flat out int shape;\n"
+    "flat out float size;                    // ball radius, power-up scale\n"
+    "flat out vec3 wobble;                   // radius base, amplitude and speed\n"
+    "flat out vec3 core;                     // ball centre colour, power-up fill\n"
+    "const vec3 fills[8] = vec3[8](vec3(0.7), vec3(0.0, 1.0, 0.0), vec3(0.0, 0.5, 1.0),\n"
+    "    vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 1.0), vec3(0.5, 0.5, 1.0), vec3(0.8), vec3(1.0, 0.5, 0.0));\n"
+    "void main() {\n"
+    "    shape = int(type);\n"
+    "    float angle, extent;\n"
+    "    if (kind == 0) {\n"
+    "        size = place.z;\n"
+    "        angle = time * 50.0;\n"
+    "        extent = size * 1.5;\n"
+    "        if (shape == 1)      { wobble = vec3(0.8, 0.2, 5.0);   core = vec3(1.0, 0.8, 0.0); }\n"
+    "        else if (shape == 2) { wobble = vec3(0.9, 0.1, 2.0);   core = vec3(0.6, 0.8, 1.0); }\n"
+    "        else if (shape == 3) { wobble = vec3(0.85, 0.15, 4.0); core = vec3(0.8, 0.0, 0.8); }\n"
+    "        else                 { wobble = vec3(0.9, 0.1, 3.0);   core = vec3(1.0, 0.5, 0.0); }\n"
+    "    } else {\n"
+    "        size = place.z + sin(time * 3.0) * 0.2;\n"
+    "        angle = place.w;\n"
+    "        extent = (10.0 * abs(size) + pixel) * 1.415;\n"
+    "        wobble = vec3(0.0);\n"
+    "        core = fills[clamp(shape, 0, 7)];\n"
+    "    }\n"
+    "    vec2 offset = (vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0) * extent;\n"
+    "    float a = radians(angle);\n"
+    "    local = mat2(cos(a), -sin(a), sin(a), cos(a)) * offset;\n"
+    "    vec2 world = place.xy + offset;\n"
+    "    gl_Position = vec4((world - ortho.xz) / (ortho.yw - ortho.xz) * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+// Same layers drawBall() / drawPowerUp() stack, composited per pixel: the
+// wobbling fan (centre colour blended towards the animated edge colour),
+// the highlight, the slow-time ring; the cube fill and its 2-pixel outline
+static const char* shaderFxFragment =
+    "#version 330 core\n"
+    "in vec2 local;\n"
+    "flat in int shape;\n"
+    "flat in float size;\n"
+    "flat in vec3 wobble;\n"
+    "flat in vec3 core;\n"
+    "uniform float time, pixel;\n"
+    "uniform int kind, slowRing, blend;\n"
+    "out vec4 color;\n"
+    "vec4 over(vec4 dst, vec3 c, float a) {\n"
+    "    if (blend == 0) return vec4(c, a);\n"
+    "    float outA = a + dst.a * (1.0 - a);\n"
+    "    return vec4((c * a + dst.rgb * dst.a * (1.0 - a)) / outA, outA);\n"
+    "}\n"
+    "void ball() {\n"
+    "    float d = length(local);\n"
+    "    float a = atan(local.y, local.x);\n"
+    "    if (a < 0.0) a += 6.28318531;\n"
+    "    vec4 dst = vec4(0.0);\n"
+    "    bool hit = false;\n"
+    "    float r = size * (wobble.x + sin(time * wobble.z + a) * wobble.y);\n"
+    "    if (shape <= 3 && d < r) {\n"
+    "        vec3 edge;\n"
+    "        if (shape == 1)      edge = vec3(1.0, 0.3 + 0.5 * sin(time * 2.0 + a), 0.0);\n"
+    "        else if (shape == 2) edge = vec3(0.4 + 0.2 * sin(time + a), 0.6 + 0.2 * sin(time * 1.5 + a), 1.0);\n"
+    "        else if (shape == 3) edge = vec3(0.6 + 0.2 * sin(time * 3.0 + a), 0.0, 0.6 + 0.2 * sin(time * 2.0 + a));\n"
+    "        else                 edge = vec3(1.0, 0.6 - degrees(a) / 720.0, 0.2 - degrees(a) / 1440.0);\n"
+    "        dst = over(dst, mix(core, clamp(edge, 0.0, 1.0), d / r), 1.0);\n"
+    "        hit = true;\n"
+    "    }\n"
+    "    if (distance(local, vec2(0.3 * size)) < 0.2 * size) { dst = over(dst, vec3(1.0), 0.6); hit = true; }\n"
+    "    if (slowRing != 0 && shape == 0 && d < 1.5 * size) { dst = over(dst, vec3(1.0), 0.3); hit = true; }\n"
+    "    if (!hit) discard;\n"
+    "    color = dst;\n"
+    "}\n"
+    "void powerUp() {\n"
+    "    vec2 p = local / size;\n"
+    "    float m = max(abs(p.x), abs(p.y));\n"
+    "    float line = pixel / abs(size);     // half the outline, in cube units\n"
+    "    if (m > 10.0 + line) discard;\n"
+    "    color = vec4(m >= 10.0 - line ? vec3(1.0) : core, 1.0);\n"
+    "}\n"
+    "void main() {\n"
+    "    if (kind == 0) ball(); else powerUp();\n"
+    "}\n";
+
+// wglGetProcAddress() reports failure as NULL or, on some drivers, 1-3 / -1
+static void* shaderProc(const char* name) {
+    void* p = (void*)wglGetProcAddress(name);
+    return ((uintptr_t)p <= 3 || (intptr_t)p == -1) ? NULL : p;
+}
+
+static int loadShaderProcs() {
+#define SHADER_PROC_LOAD(ret, name, args) \
+    if (!(p##name = (ret (APIENTRY *) args)shaderProc(#name))) return 0;
+    SHADER_PROCS(SHADER_PROC_LOAD)
+#undef SHADER_PROC_LOAD
+    return 1;
+}
+
+static GLuint compileShader(GLenum type, const char* src) {
+    GLuint shader = pglCreateShader(type);
+    GLint ok = 0;
+    pglShaderSource(shader, 1, &src, NULL);
+    pglCompileShader(shader);
+    pglGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) { pglDeleteShader(shader); return 0; }
+    return shader;
+}
+
+// Needs the GL context current; leaves shaderFx.ready at 0 on any failure
+void initShaderEffects() {
+    const char* version = (const char*)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (!version || sscanf(version, "%d.%d", &major, &minor) != 2) return;
+    if (major < 3 || (major == 3 && minor < 3) || !loadShaderProcs()) return;
+    pglGenQueries(2, gpuTimer.query);
+    gpuTimer.ready = 1;
+
+    GLuint vs = compileShader(GL_VERTEX_SHADER, shaderFxVertex);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, shaderFxFragment);
+    GLint linked = 0;
+    if (vs && fs) {
+        shaderFx.program = pglCreateProgram();
+        pglAttachShader(shaderFx.program, vs);
+        pglAttachShader(shaderFx.program, fs);
+        pglLinkProgram(shaderFx.program);
+        pglGetProgramiv(shaderFx.program, GL_LINK_STATUS, &linked);
+    }
+    if (vs) pglDeleteShader(vs);
+    if (fs) pglDeleteShader(fs);
+    if (!linked) return;
+
+    shaderFx.uOrtho    = pglGetUniformLocation(shaderFx.program, "ortho");
+    shaderFx.uTime     = pglGetUniformLocation(shaderFx.program, "time");
+    shaderFx.uPixel    = pglGetUniformLocation(shaderFx.program, "pixel");
+    shaderFx.uKind     = pglGetUniformLocation(shaderFx.program, "kind");
+    shaderFx.uSlowRing = pglGetUniformLocation(shaderFx.program, "slowRing");
+    shaderFx.uBlend    = pglGetUniformLocation(shaderFx.program, "blend");
+
+    pglGenVertexArrays(1, &shaderFx.vao);
+    pglGenBuffers(1, &shaderFx.vbo);
+    pglBindVertexArray(shaderFx.vao);
+    pglBindBuffer(GL_ARRAY_BUFFER, shaderFx.vbo);
+    pglEnableVertexAttribArray(0);
+    pglEnableVertexAttribArray(1);
+    pglVertexAttribDivisor(0, 1);
+    pglVertexAttribDivisor(1, 1);
+    pglBindVertexArray(0);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    shaderFx.ready = 1;
+}
+
+// Draw count instances starting at instance first of the bound buffer
+static void drawShadedInstances(int kind, int first, int count) {
+    if (!count) return;
+    uintptr_t offset = (uintptr_t)first * 5 * sizeof(float);
+    pglVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (const void*)offset);
+    pglVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (const void*)(offset + 4 * sizeof(float)));
+    pglUniform1i(shaderFx.uKind, kind);
+    pglDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    perf.drawCalls++;
+    perf.vertices += 4 * count;
+}
+#endif // PONG_REAL_GL
+
+// Start timing this frame's GL work on the GPU (GL 3.3 only). Only while
+// the governor is on: it is the one reader, and llvmpipe rounds some
+// blends differently with a query running, which would move the glbench
+// hashes.
+void gpuTimerBegin() {
+#ifdef PONG_REAL_GL
+    if (!gpuTimer.ready || !quality_auto) return;
+    int q = gpuTimer.next;
+    if (gpuTimer.pending[q]) {
+        GLint done = 0;
+        pglGetQueryObjectiv(gpuTimer.query[q], GL_QUERY_RESULT_AVAILABLE, &done);
+        if (!done) return;
+        uint64_t ns = 0;
+        pglGetQueryObjectui64v(gpuTimer.query[q], GL_QUERY_RESULT, &ns);
+        // Mesa's llvmpipe returns hours for its very first query
+        if (ns < 1000000000u) gpuTimer.ms = (float)(ns * 1e-6);
+        gpuTimer.pending[q] = 0;
+    }
+    pglBeginQuery(GL_TIME_ELAPSED, gpuTimer.query[q]);
+    gpuTimer.running = 1;
+#endif
+}
+
+// Stop timing; returns the newest GPU frame time, 0 without GL 3.3
+float gpuTimerEnd() {
+#ifndef PONG_REAL_GL
+    return 0;
+#else
+    if (gpuTimer.running) {
+        pglEndQuery(GL_TIME_ELAPSED);
+        gpuTimer.pending[gpuTimer.next] = 1;
+        gpuTimer.next ^= 1;
+        gpuTimer.running = 0;
+    }
+    return gpuTimer.ms;
+#endif
+}
+
+// Trails, then all balls and all power-ups in one instanced draw each.
+// Returns 0 when the fixed-function functions have to draw them instead.
+int drawShadedEffects() {
+#ifndef PONG_REAL_GL
+    return 0;
+#else
+    if (!shaderFx.ready || !shader_fx) return 0;
+
+    float inst[(3 + MAX_POWERUPS) * 5];
+    int nBalls = 0, nPowerUps = 0;
+    for (int i = 0; i < 3; i++) {
+        if (!balls[i].active) continue;
+        drawTrail(i);
+        float* v = &inst[nBalls++ * 5];
+        v[0] = balls[i].x;
+        v[1] = balls[i].y;
+        v[2] = balls[i].radius;
+        v[3] = 0;
+        v[4] = (float)balls[i].type;
+    }
+    for (int i = 0; i < MAX_POWERUPS; i++) {
+        if (!powerups[i].active) continue;
+        float* v = &inst[(nBalls + nPowerUps++) * 5];
+        v[0] = powerups[i].x;
+        v[1] = powerups[i].y;
+        v[2] = powerup_fx[i].size;
+        v[3] = powerup_fx[i].rotation;
+        v[4] = (float)powerups[i].type;
+    }
+    if (!nBalls && !nPowerUps) return 1;
+
+    pglUseProgram(shaderFx.program);
+    pglUniform4f(shaderFx.uOrtho, orthoLeft, orthoRight, orthoBottom, orthoTop);
+    pglUniform1f(shaderFx.uTime, animation_time);
+    pglUniform1f(shaderFx.uPixel, (orthoRight - orthoLeft) / windowWidth);
+    pglUniform1i(shaderFx.uSlowRing, timerExpiry(TIMER_SLOW_TIME, 0) >= 0);
+    pglUniform1i(shaderFx.uBlend, glIsEnabled(GL_BLEND));
+    pglBindVertexArray(shaderFx.vao);
+    pglBindBuffer(GL_ARRAY_BUFFER, shaderFx.vbo);
+    pglBufferData(GL_ARRAY_BUFFER, (nBalls + nPowerUps) * 5 * sizeof(float), inst, GL_STREAM_DRAW);
+
+    drawShadedInstances(0, 0, nBalls);
+    drawShadedInstances(1, nBalls, nPowerUps);
+
+    pglBindVertexArray(0);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglUseProgram(0);
+    return 1;
+#endif
+}
+#endif // PONG_DRAWING
+
 // Place ball back in center with random angle
 void resetBall(Ball* ball) {
     ball->x = (float)((rand() % 200) - 100);
@@ -700,10 +2130,29 @@ void resetBall(Ball* ball) {
 
     ball->radius = BALL_RADIUS;
     ball->type = BALL_NORMAL;
-    ball->effectTimer = 0.0f;
+    anchorBall(ball);
 
+    timerCancelKey(TIMER_BALL_EFFECT, (int)(ball - balls));
+    BallFx* fx = &ball_fx[ball - balls];
     for (int i = 0; i < MAX_TRAIL; i++)
-        ball->trail[i].life = 0.0f;
+        fx->trail[i].life = 0.0f;
+}
+
+// Start a new straight path from the ball's current position
+void anchorBall(Ball* ball) {
+    ball->originX = ball->x;
+    ball->originY = ball->y;
+    ball->originTick = sim_tick;
+}
+
+// Change velocity mid-flight: re-base the path at the current tick first
+void setBallVelocity(Ball* ball, float vx, float vy) {
+    float n = (float)(sim_tick - ball->originTick);
+    ball->originX = ball->originX + ball->vx * n;
+    ball->originY = ball->originY + ball->vy * n;
+    ball->originTick = sim_tick;
+    ball->vx = vx;
+    ball->vy = vy;
 }
 
 // Try to spawn one new random power-up
@@ -714,8 +2163,8 @@ void spawnPowerUp() {
             powerups[i].y = (float)((rand() % 500) - 250);
             powerups[i].type = (rand() % 7) + 1;
             powerups[i].active = 1;
-            powerups[i].size = 1.0f;
-            powerups[i].rotation = 0.0f;
+            powerup_fx[i].size = 1.0f;
+            powerup_fx[i].rotation = 0.0f;
             break;
         }
     }
@@ -725,36 +2174,32 @@ void spawnPowerUp() {
 void updateAI(int player) {
     // Skip if this paddle isn't AI-controlled
     if (currentMode == MODE_PVP) {
-        if (player == 1 && player1_control != CONTROL_AUTO) return;
-        if (player == 2 && player2_control != CONTROL_AUTO) return;
+        if (player == 1 && player1_control != CONTROL_AUTO && player1_control != CONTROL_NEURAL) return;
+        if (player == 2 && player2_control != CONTROL_AUTO && player2_control != CONTROL_NEURAL) return;
     } else if (currentMode == MODE_PVC) {
         if (player != 2) return;
     } else return;
 
     // Difficulty tuning values
-    float reaction = 0.95f, accuracy = 0.85f, errChance = 0.3f, maxErr = 50.0f;
-    float speedMult = 1.2f, anticipate = 0.6f, adapt = 0.15f;
-
-    if (currentDifficulty == DIFFICULTY_HARD) {
-        reaction = 1.1f; accuracy = 0.95f; errChance = 0.0f; maxErr = 0.0f;
-        speedMult = 1.6f; anticipate = 0.8f; adapt = 0.2f;
-    }
+    const AIParams* p = &aiParams[currentDifficulty];
+    float reaction = p->reaction, accuracy = p->accuracy;
+    float errChance = p->errChance, maxErr = p->maxErr;
+    float speedMult = p->speedMult, adapt = p->adapt;
 
     // Learn from long rallies
-    if (consecutive_hits > 5) {
+    if (consecutive_hits > p->rallyHits) {
         accuracy = fminf(1.0f, accuracy + adapt * 0.1f);
-        reaction = fminf(1.2f, reaction + adapt * 0.05f);
+        reaction = fminf(p->rallyReactionMax, reaction + adapt * 0.05f);
     }
-    if (total_hits > 50) {
-        float learn = fminf(0.3f, total_hits * 0.005f);
+    if (total_hits > p->learnHits) {
+        float learn = fminf(p->learnMax, total_hits * p->learnRate);
         accuracy = fminf(1.0f, accuracy + learn * 0.05f);
-        reaction = fminf(1.3f, reaction + learn * 0.02f);
+        reaction = fminf(p->learnReactionMax, reaction + learn * 0.02f);
     }
 
     // Find closest ball heading towards this paddle
     Ball* target = NULL;
     float minTime = 9999.0f;
-    float ballSpd = 0;
 
     for (int i = 0; i < 3; i++) {
         if (!balls[i].active) continue;
@@ -778,7 +2223,6 @@ void updateAI(int player) {
         if (incoming && t < minTime) {
             minTime = t;
             target = b;
-            ballSpd = sqrtf(b->vx*b->vx + b->vy*b->vy);
         }
     }
 
@@ -809,13 +2253,11 @@ void updateAI(int player) {
                     break;
                 }
             }
-            predict = (currentDifficulty == DIFFICULTY_MEDIUM)
-                ? predict * 0.7f + cx * 0.3f
-                : predict * 0.4f + cx * 0.6f;
+            predict = predict * (1.0f - p->bounceBlend) + cx * p->bounceBlend;
         }
 
         // Add human-like mistake on medium
-        if (currentDifficulty != DIFFICULTY_HARD && (rand() % 100 < errChance * 100)) {
+        if (errChance > 0 && (int)maxErr > 0 && (rand() % 100 < errChance * 100)) {
             float err = ((rand() % (int)maxErr*2) - maxErr) * (1.0f + minTime*0.5f);
             predict += err;
         }
@@ -827,7 +2269,7 @@ void updateAI(int player) {
         if (fabsf(dist) > 20) step *= 1.5f;
 
         // Snap instantly on very close balls in hard mode
-        if (currentDifficulty == DIFFICULTY_HARD && fabsf(dist) < 50 && minTime < 0.3f)
+        if (fabsf(dist) < p->snapDist && minTime < 0.3f)
             *targetX = predict;
         else if (fabsf(dist) > 2.0f)
             *targetX += (dist > 0 ? step : -step);
@@ -840,579 +2282,4035 @@ void updateAI(int player) {
     if (*targetX > r) *targetX = r;
 }
 
-// Check if any achievement should be unlocked now
-void checkAchievements() {
-    if (!achievements[0].unlocked && (player1_score > 0 || player2_score > 0)) {
-        achievements[0].unlocked = 1; achievements_unlocked++; playSound(800,300);
-    }
-    if (!achievements[1].unlocked && consecutive_hits >= 5) {
-        achievements[1].unlocked = 1; achievements_unlocked++; playSound(1000,300);
+// Load int8 policy weights. Layout (little-endian):
+//   "PNN1", u8 inputs, u8 hidden, u16 reserved,
+//   then per layer: f32 scale, i32 bias[out], i8 weights[out][in]
+int loadPolicy(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+
+    unsigned char hdr[8];
+    int ok = fread(hdr, 1, 8, f) == 8 && memcmp(hdr, "PNN1", 4) == 0 &&
+             hdr[4] == NN_INPUTS && hdr[5] == NN_HIDDEN;
+
+    int8_t w[NN_HIDDEN * NN_INPUTS];
+    struct { int32_t* bias; int16_t* dst; float* scale; int nOut, nIn; } layers[3] = {
+        {nnPolicy.b1, &nnPolicy.w1[0][0], &nnPolicy.s1, NN_HIDDEN, NN_INPUTS},
+        {nnPolicy.b2, &nnPolicy.w2[0][0], &nnPolicy.s2, NN_HIDDEN, NN_HIDDEN},
+        {&nnPolicy.b3, nnPolicy.w3,       &nnPolicy.s3, 1,         NN_HIDDEN}
+    };
+
+    for (int l = 0; ok && l < 3; l++) {
+        int n = layers[l].nOut * layers[l].nIn;
+        ok = fread(layers[l].scale, sizeof(float), 1, f) == 1 &&
+             fread(layers[l].bias, sizeof(int32_t), layers[l].nOut, f) == (size_t)layers[l].nOut &&
+             fread(w, 1, n, f) == (size_t)n;
+        for (int i = 0; ok && i < n; i++)
+            layers[l].dst[i] = w[i];
     }
-    if (!achievements[2].unlocked && max_ball_speed >= 20.0f) {
-        achievements[2].unlocked = 1; achievements_unlocked++; playSound(1200,300);
+    fclose(f);
+
+    nnPolicy.loaded = ok;
+    return ok;
+}
+
+// Dot product of two int16 vectors, n a multiple of 16
+static int32_t nnDot(const int16_t* a, const int16_t* b, int n) {
+#if defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 16)
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(
+            _mm256_loadu_si256((const __m256i*)(a + i)),
+            _mm256_loadu_si256((const __m256i*)(b + i))));
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 8)
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(
+            _mm_loadu_si128((const __m128i*)(a + i)),
+            _mm_loadu_si128((const __m128i*)(b + i))));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+    return _mm_cvtsi128_si32(acc);
+#else
+    int32_t acc = 0;
+    for (int i = 0; i < n; i++) acc += a[i] * b[i];
+    return acc;
+#endif
+}
+
+// Hidden layer: clipped ReLU to [0,1], requantised to 0..127.
+// The SIMD paths finish 8 (AVX2) or 4 (SSE2) neurons per pass so the
+// clamp and requantise run vectorised too.
+static inline void nnHidden(const int16_t* w, const int32_t* bias, float scale,
+                     const int16_t* in, int nIn, int16_t* out) {
+#if defined(__AVX2__)
+    const __m256 vs = _mm256_set1_ps(scale), zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f), q = _mm256_set1_ps(127.0f), half = _mm256_set1_ps(0.5f);
+    for (int j = 0; j < NN_HIDDEN; j += 8) {
+        __m256i a[8];
+        for (int k = 0; k < 8; k++) {
+            const int16_t* row = w + (j + k) * nIn;
+            a[k] = _mm256_setzero_si256();
+            for (int i = 0; i < nIn; i += 16)
+                a[k] = _mm256_add_epi32(a[k], _mm256_madd_epi16(
+                    _mm256_loadu_si256((const __m256i*)(row + i)),
+                    _mm256_loadu_si256((const __m256i*)(in + i))));
+        }
+        __m256i s0 = _mm256_hadd_epi32(_mm256_hadd_epi32(a[0], a[1]), _mm256_hadd_epi32(a[2], a[3]));
+        __m256i s1 = _mm256_hadd_epi32(_mm256_hadd_epi32(a[4], a[5]), _mm256_hadd_epi32(a[6], a[7]));
+        __m256i sum = _mm256_add_epi32(_mm256_permute2x128_si256(s0, s1, 0x20),
+                                       _mm256_permute2x128_si256(s0, s1, 0x31));
+        sum = _mm256_add_epi32(sum, _mm256_loadu_si256((const __m256i*)(bias + j)));
+
+        __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(sum), vs);
+        v = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+        __m256i r = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, q), half));
+        r = _mm256_permute4x64_epi64(_mm256_packs_epi32(r, r), 0x08);
+        _mm_storeu_si128((__m128i*)(out + j), _mm256_castsi256_si128(r));
     }
-    if (!achievements[3].unlocked && powerups_collected >= 10) {
-        achievements[3].unlocked = 1; achievements_unlocked++; playSound(700,300);
+#elif defined(__SSE2__)
+    const __m128 vs = _mm_set1_ps(scale), zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f), q = _mm_set1_ps(127.0f), half = _mm_set1_ps(0.5f);
+    for (int j = 0; j < NN_HIDDEN; j += 4) {
+        __m128i a[4];
+        for (int k = 0; k < 4; k++) {
+            const int16_t* row = w + (j + k) * nIn;
+            a[k] = _mm_setzero_si128();
+            for (int i = 0; i < nIn; i += 8)
+                a[k] = _mm_add_epi32(a[k], _mm_madd_epi16(
+                    _mm_loadu_si128((const __m128i*)(row + i)),
+                    _mm_loadu_si128((const __m128i*)(in + i))));
+        }
+        // 4x4 transpose-and-add: one lane per neuron
+        __m128i u0 = _mm_add_epi32(_mm_unpacklo_epi32(a[0], a[1]), _mm_unpackhi_epi32(a[0], a[1]));
+        __m128i u1 = _mm_add_epi32(_mm_unpacklo_epi32(a[2], a[3]), _mm_unpackhi_epi32(a[2], a[3]));
+        __m128i sum = _mm_add_epi32(_mm_unpacklo_epi64(u0, u1), _mm_unpackhi_epi64(u0, u1));
+        sum = _mm_add_epi32(sum, _mm_loadu_si128((const __m128i*)(bias + j)));
+
+        __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(sum), vs);
+        v = _mm_min_ps(_mm_max_ps(v, zero), one);
+        __m128i r = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, q), half));
+        _mm_storel_epi64((__m128i*)(out + j), _mm_packs_epi32(r, r));
     }
-    if (!achievements[4].unlocked && currentDifficulty == DIFFICULTY_HARD &&
-        currentMode == MODE_PVC && player1_score >= 5) {
-        achievements[4].unlocked = 1; achievements_unlocked++; playSound(2000,500);
+#else
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        float v = (nnDot(w + j * nIn, in, nIn) + bias[j]) * scale;
+        v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+        out[j] = (int16_t)(v * 127.0f + 0.5f);
     }
-    if (!achievements[6].unlocked && consecutive_hits >= 20) {
-        achievements[6].unlocked = 1; achievements_unlocked++; playSound(1600,400);
+#endif
+}
+
+// Evaluate the policy for many feature vectors in one call (several AI
+// paddles or parallel matches). Output is the paddle target in [-1, 1].
+void nnForwardBatch(const int16_t (*in)[NN_INPUTS], float* out, int count) {
+    int16_t h1[NN_HIDDEN], h2[NN_HIDDEN];
+    for (int k = 0; k < count; k++) {
+        nnHidden(&nnPolicy.w1[0][0], nnPolicy.b1, nnPolicy.s1, in[k], NN_INPUTS, h1);
+        nnHidden(&nnPolicy.w2[0][0], nnPolicy.b2, nnPolicy.s2, h1, NN_HIDDEN, h2);
+        float v = (nnDot(nnPolicy.w3, h2, NN_HIDDEN) + nnPolicy.b3) * nnPolicy.s3;
+        out[k] = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
     }
 }
 
-void drawAchievements() {
-    if (achievements_unlocked == 0) return;
+// NN_INPUTS values seen from `player`'s side (own goal always at the
+// bottom), each in [-1, 1]
+void matchObserve(int player, float* f) {
+    float sy = (player == 1) ? 1.0f : -1.0f;
+    float fx = 1.0f / orthoRight, fy = 1.0f / orthoTop;
+    int n = 0;
 
-    glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity();
-    glOrtho(0, windowWidth, 0, windowHeight, -1,1);
-    glMatrixMode(GL_MODELVIEW); glPushMatrix(); glLoadIdentity();
+    for (int i = 0; i < 3; i++) {
+        Ball* b = &balls[i];
+        if (!b->active) { for (int k = 0; k < 5; k++) f[n++] = 0; continue; }
+        f[n++] = 1.0f;
+        f[n++] = b->x * fx;
+        f[n++] = b->y * fy * sy;
+        f[n++] = b->vx / 30.0f;
+        f[n++] = b->vy / 30.0f * sy;
+    }
 
-    wglMakeCurrent(NULL, NULL);
-    SetBkMode(hdc, TRANSPARENT);
-    SetTextColor(hdc, RGB(255,255,0));
+    f[n++] = ((player == 1) ? player1_paddle_x : player2_paddle_x) * fx;
+    f[n++] = ((player == 1) ? player1_target_x : player2_target_x) * fx;
+    f[n++] = ((player == 1) ? player2_paddle_x : player1_paddle_x) * fx;
+    f[n++] = (player == 1) ? player1_big_paddle : player2_big_paddle;
+    f[n++] = (player == 1) ? player2_big_paddle : player1_big_paddle;
+    f[n++] = (slow_time_factor < 1.0f) ? 1.0f : 0.0f;
 
-    char buf[100];
-    sprintf(buf, "ACHIEVEMENTS: %d/7", achievements_unlocked);
-    TextOutA(hdc, 10, windowHeight - 30, buf, (int)strlen(buf));
+    for (int i = 0; i < MAX_POWERUPS; i++) {
+        if (!powerups[i].active) { for (int k = 0; k < 4; k++) f[n++] = 0; continue; }
+        f[n++] = 1.0f;
+        f[n++] = powerups[i].x * fx;
+        f[n++] = powerups[i].y * fy * sy;
+        f[n++] = powerups[i].type / 7.0f;
+    }
+    while (n < NN_INPUTS) f[n++] = 0;
 
-    wglMakeCurrent(hdc, hrc);
+    for (int i = 0; i < NN_INPUTS; i++)
+        f[i] = f[i] < -1.0f ? -1.0f : (f[i] > 1.0f ? 1.0f : f[i]);
+}
 
-    glPopMatrix(); glMatrixMode(GL_PROJECTION); glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
+// matchObserve() quantised to [-1, 1] * 127 for the int8 policy
+void nnFeatures(int player, int16_t* out) {
+    float f[NN_INPUTS];
+    matchObserve(player, f);
+    for (int i = 0; i < NN_INPUTS; i++)
+        out[i] = (int16_t)(f[i] * 127.0f + (f[i] < 0.0f ? -0.5f : 0.5f));
 }
 
-// Check if ball touched any active power-up
-void checkPowerUpCollision(Ball* ball) {
-    for (int i = 0; i < MAX_POWERUPS; i++) {
-        if (!powerups[i].active) continue;
+// Experimental learned paddle controller; falls back to updateAI() without
+// weights. About 20x the cost of updateAI() per call and a weaker player,
+// so the classic AI stays the default.
+void updateNeuralAI(int player) {
+    if (!nnPolicy.loaded) { updateAI(player); return; }
 
-        float dx = ball->x - powerups[i].x;
-        float dy = ball->y - powerups[i].y;
-        float dist = sqrtf(dx*dx + dy*dy);
+    int16_t in[1][NN_INPUTS];
+    float out;
+    nnFeatures(player, in[0]);
+    nnForwardBatch(in, &out, 1);
 
-        if (dist < ball->radius + 15) {
-            powerups_collected++;
+    float half = orthoRight - paddle_width/2;
+    float* targetX = (player == 1) ? &player1_target_x : &player2_target_x;
+    *targetX = out * half;
+}
 
-            switch (powerups[i].type) {
-                case POWERUP_BIG_PADDLE:
-                    if (ball->vy > 0) player1_big_paddle = 1;
-                    else              player2_big_paddle = 1;
-                    powerup_duration = 10.0f;
-                    playSound(800,200);
-                    break;
+// Index each achievement under the events it listens to
+static void buildAchievementIndex() {
+    for (int e = 0; e < GE_COUNT; e++) {
+        achSubCount[e] = 0;
+        for (int i = 0; i < ACHIEVEMENT_COUNT; i++) {
+            const Achievement* a = &achievements[i];
+            unsigned mask = a->advanceOn | a->failOn;
+            if (a->scope == SCOPE_MATCH) mask |= GE_BIT(GE_MATCH_START);
+            if (mask & GE_BIT(e)) achSubs[e][achSubCount[e]++] = (unsigned short)i;
+        }
+    }
+    achIndexBuilt = 1;
+}
 
-                case POWERUP_SLOW_BALL:
-                    ball_speed *= 0.7f;
-                    for (int j = 0; j < 3; j++)
-                        if (balls[j].active) {
-                            balls[j].vx *= 0.7f;
-                            balls[j].vy *= 0.7f;
-                        }
-                    playSound(600,200);
-                    break;
+// Feed one gameplay event to the achievements subscribed to it
+void raiseGameEvent(GameEvent e, int value) {
+    if (sim_spectate) return;
+    if (!achIndexBuilt) buildAchievementIndex();
+
+    for (int k = 0; k < achSubCount[e]; k++) {
+        int idx = achSubs[e][k];
+        Achievement* a = &achievements[idx];
+        if (a->unlocked) continue;
+
+        if (e == GE_MATCH_START) {
+            a->progress = 0;
+            a->failed = 0;
+            continue;
+        }
+        if (a->mode != ACH_ANY && a->mode != (int)currentMode) continue;
+        if (a->difficulty != ACH_ANY && a->difficulty != (int)currentDifficulty) continue;
+        if (a->failOn & GE_BIT(e)) { a->failed = 1; continue; }
+        if (a->failed) continue;
+
+        int before = a->progress;
+        switch (a->rule) {
+            case ACH_COUNT: a->progress++; break;
+            case ACH_SUM:   a->progress += value; break;
+            case ACH_LEVEL: if (value > a->progress) a->progress = value; break;
+        }
+
+        if (a->progress >= a->condition) {
+            a->unlocked = 1;
+            achievements_unlocked++;
+            profileRecord(PREC_UNLOCK, idx, 1);
+            playSound(a->soundFreq, a->soundMs);
+        }
+        else if (a->scope == SCOPE_LIFETIME && a->progress != before) {
+            profileRecord(PREC_PROGRESS, idx, (uint32_t)a->progress);
+        }
+    }
+}
+
+//              Persistent profile
+//
+// File layout: two ProfileSnapshot slots, then two logs of PROFILE_LOG_CAP
+// ProfileRecords, log n holding the records made on top of slot n. The game
+// only ever stores into the mapping (no fsync on the tick path); the OS
+// writes pages back on its own. When the log fills up, the live state is
+// written to the other slot under a new generation and appends move to that
+// slot's log, so startup never replays more than PROFILE_LOG_CAP records.
+// A torn or stale record ends replay at the last good one.
+
+static uint32_t crc32_table[256];
+
+static uint32_t checksum32(const void* data, size_t len, uint32_t crc) {
+    if (!crc32_table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crc32_table[i] = c;
+        }
+    }
+    const unsigned char* p = data;
+    crc = ~crc;
+    while (len--) crc = crc32_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static ProfileSnapshot* profileSlot(int slot) {
+    return (ProfileSnapshot*)(profile_base + slot * PROFILE_SLOT_SIZE);
+}
+
+static ProfileRecord* profileLog(int slot) {
+    return (ProfileRecord*)(profile_base + 2 * PROFILE_SLOT_SIZE + slot * PROFILE_LOG_SIZE);
+}
+
+// Block until a slot and its log are on disk
+static void profileSync(int slot) {
+#ifdef _WIN32
+    FlushViewOfFile(profileSlot(slot), sizeof(ProfileSnapshot));
+    FlushViewOfFile(profileLog(slot), PROFILE_LOG_SIZE);
+    FlushFileBuffers(profile_file);
+#else
+    msync(profile_base, 2 * PROFILE_SLOT_SIZE, MS_SYNC);
+    msync(profileLog(slot), PROFILE_LOG_SIZE, MS_SYNC);
+#endif
+}
+
+static uint32_t profileRecordCrc(const ProfileRecord* r, int index) {
+    return checksum32(r, offsetof(ProfileRecord, crc), (uint32_t)index);
+}
+
+static int profileSlotValid(const ProfileSnapshot* s) {
+    return s->magic == PROFILE_MAGIC && s->version == PROFILE_VERSION &&
+           s->crc == checksum32(s, offsetof(ProfileSnapshot, crc), 0);
+}
+
+static void profileApply(ProfileSnapshot* s, const ProfileRecord* r) {
+    switch (r->type) {
+        case PREC_STAT:
+            if (r->key == PSTAT_POWERUPS) s->powerups = r->value;
+            else if (r->key == PSTAT_HITS) s->hits = r->value;
+            else if (r->key == PSTAT_MAX_SPEED) memcpy(&s->maxSpeed, &r->value, sizeof(float));
+            break;
+        case PREC_PROGRESS:
+            if (r->key < PROFILE_MAX_ACH) s->progress[r->key] = (int32_t)r->value;
+            break;
+        case PREC_UNLOCK:
+            if (r->key < PROFILE_MAX_ACH) s->unlocked[r->key / 32] |= 1u << (r->key % 32);
+            break;
+    }
+}
+
+// Map the profile file, recover the newest consistent state and copy it
+// into the game globals. Returns 0 if the file can't be mapped.
+int profileOpen(const char* path) {
+#ifdef _WIN32
+    profile_file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                               NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (profile_file == INVALID_HANDLE_VALUE) { profile_file = NULL; return 0; }
+    profile_map = CreateFileMappingA(profile_file, NULL, PAGE_READWRITE, 0,
+                                     (DWORD)PROFILE_FILE_SIZE, NULL);
+    if (!profile_map) { CloseHandle(profile_file); profile_file = NULL; return 0; }
+    profile_base = MapViewOfFile(profile_map, FILE_MAP_ALL_ACCESS, 0, 0, PROFILE_FILE_SIZE);
+    if (!profile_base) {
+        CloseHandle(profile_map); CloseHandle(profile_file);
+        profile_map = profile_file = NULL;
+        return 0;
+    }
+#else
+    profile_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (profile_fd < 0) return 0;
+    void* m = MAP_FAILED;
+    if (ftruncate(profile_fd, PROFILE_FILE_SIZE) == 0)
+        m = mmap(NULL, PROFILE_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, profile_fd, 0);
+    if (m == MAP_FAILED) { close(profile_fd); profile_fd = -1; return 0; }
+    profile_base = m;
+#endif
+
+    // Newest valid snapshot
+    ProfileSnapshot* a = profileSlot(0);
+    ProfileSnapshot* b = profileSlot(1);
+    profile_top = a->generation > b->generation ? a->generation : b->generation;
+    for (int i = 0; i < 2 * PROFILE_LOG_CAP; i++)
+        if (profileLog(0)[i].generation > profile_top) profile_top = profileLog(0)[i].generation;
+    int va = profileSlotValid(a), vb = profileSlotValid(b);
+    if (va && (!vb || a->generation >= b->generation)) profile_slot = 0;
+    else if (vb) profile_slot = 1;
+    else profile_slot = -1;
+
+    if (profile_slot >= 0) {
+        profile_live = *profileSlot(profile_slot);
+
+        // Replay the log tail written under that generation
+        ProfileRecord* log = profileLog(profile_slot);
+        profile_count = 0;
+        while (profile_count < PROFILE_LOG_CAP) {
+            ProfileRecord* r = &log[profile_count];
+            if (r->generation != profile_live.generation ||
+                r->crc != profileRecordCrc(r, profile_count)) break;
+            profileApply(&profile_live, r);
+            profile_count++;
+        }
+    }
+    else {
+        // New or unreadable file: start over from an empty profile
+        memset(&profile_live, 0, sizeof(profile_live));
+        profile_live.magic = PROFILE_MAGIC;
+        profile_live.version = PROFILE_VERSION;
+        profile_slot = 1;
+        profileCompact();
+    }
+
+    powerups_collected = (int)profile_live.powerups;
+    lifetime_hits = (int)profile_live.hits;
+    max_ball_speed = profile_live.maxSpeed;
+    achievements_unlocked = 0;
+    for (int i = 0; i < ACHIEVEMENT_COUNT && i < PROFILE_MAX_ACH; i++) {
+        Achievement* ach = &achievements[i];
+        ach->unlocked = (profile_live.unlocked[i / 32] >> (i % 32)) & 1;
+        if (ach->scope == SCOPE_LIFETIME) ach->progress = profile_live.progress[i];
+        achievements_unlocked += ach->unlocked;
+    }
+    return 1;
+}
+
+// Append one change. Plain stores into the mapping; never blocks on disk.
+void profileRecord(ProfileRecordType type, int key, uint32_t value) {
+    if (!profile_base || sim_spectate) return;
+    if (profile_count >= PROFILE_LOG_CAP) profileCompact();
+
+    ProfileRecord* r = &profileLog(profile_slot)[profile_count];
+    r->generation = profile_live.generation;
+    r->type = (uint16_t)type;
+    r->key = (uint16_t)key;
+    r->value = value;
+    r->crc = profileRecordCrc(r, profile_count);
+    profileApply(&profile_live, r);
+    profile_count++;
+}
+
+// Fold the log into the inactive header slot and start a new generation
+// in that slot's log. The live slot and its log are left as they are, so a
+// crash before the new slot reaches disk recovers them instead, losing only
+// what was appended since. The inactive pair is only overwritten once the
+// live one is synced; it was queued a whole log ago, so that rarely waits.
+// The new generation is above every one already in the file (torn slots
+// and stale log records included), so no leftover record can match it.
+void profileCompact() {
+    if (!profile_base) return;
+
+    int slot = 1 - profile_slot;
+    profileSync(profile_slot);
+    profile_live.generation = ++profile_top;
+    profile_live.crc = checksum32(&profile_live, offsetof(ProfileSnapshot, crc), 0);
+    *profileSlot(slot) = profile_live;
+    profile_slot = slot;
+    profile_count = 0;
+
+#ifdef _WIN32
+    FlushViewOfFile(profile_base, 2 * PROFILE_SLOT_SIZE);          // queues the write
+#else
+    msync(profile_base, 2 * PROFILE_SLOT_SIZE, MS_ASYNC);
+#endif
+}
+
+// Compact and flush synchronously; called once on shutdown (WM_DESTROY)
+void profileClose() {
+    if (!profile_base) return;
+    profileCompact();
+#ifdef _WIN32
+    FlushViewOfFile(profile_base, 0);
+    FlushFileBuffers(profile_file);
+    UnmapViewOfFile(profile_base);
+    CloseHandle(profile_map);
+    CloseHandle(profile_file);
+    profile_map = profile_file = NULL;
+#else
+    msync(profile_base, PROFILE_FILE_SIZE, MS_SYNC);
+    munmap(profile_base, PROFILE_FILE_SIZE);
+    close(profile_fd);
+    profile_fd = -1;
+#endif
+    profile_base = NULL;
+}
+
+//              Match history
+//
+// Recording a row is a few stores into HistoryBuffer; nothing is encoded or
+// written until a match ends. A block on disk is:
+//   u32 magic, u32 block bytes, u32 rows[HT_COUNT], u32 payload crc,
+//   u32 column count, then per historyColumns[] entry: u8 encoding,
+//   u32 bytes, data
+// Blocks are self-contained, so files can simply be concatenated.
+
+void historyHit(int player, float hit) {
+    if (!history_path || sim_spectate) return;
+    history_rally++;
+    int n = history.rows[HT_HIT];
+    if (n >= HISTORY_MAX_ROWS) return;
+    int q = (int)(hit * 127.0f);
+    if (q >  127) q =  127;
+    if (q < -127) q = -127;
+    history.hitTick[n] = (uint32_t)(sim_tick - history_start);
+    history.hitPlayer[n] = (uint8_t)player;
+    history.hitOffset[n] = (uint8_t)(int8_t)q;
+    history.rows[HT_HIT] = n + 1;
+}
+
+void historyPoint(int scorer, int points, int bonus) {
+    if (!history_path || sim_spectate) return;
+    int n = history.rows[HT_POINT];
+    if (n < HISTORY_MAX_ROWS) {
+        history.pointTick[n] = (uint32_t)(sim_tick - history_start);
+        history.pointScorer[n] = (uint8_t)scorer;
+        history.pointValue[n] = (uint8_t)points;
+        history.pointRally[n] = (uint32_t)history_rally;
+        history.pointCombo[n] = (uint8_t)(consecutive_hits > 255 ? 255 : consecutive_hits);
+        history.pointBonus[n] = (uint8_t)bonus;
+        history.rows[HT_POINT] = n + 1;
+    }
+    if (!bonus) history_rally = 0;
+}
+
+void historyPickup(int type) {
+    if (!history_path || sim_spectate) return;
+    int n = history.rows[HT_PICKUP];
+    if (n >= HISTORY_MAX_ROWS) return;
+    history.pickupTick[n] = (uint32_t)(sim_tick - history_start);
+    history.pickupType[n] = (uint8_t)type;
+    history.rows[HT_PICKUP] = n + 1;
+}
+
+static void historyBeginMatch() {
+    history_start = sim_tick;
+    history_rally = 0;
+    history_mode = currentMode;
+    history_difficulty = currentDifficulty;
+    for (int t = 0; t < HT_COUNT; t++) history_first[t] = history.rows[t];
+}
+
+// Close the current match row (if anything happened) and start a new one
+void historyEndMatch() {
+    if (!history_path) return;
+
+    int rows = 0;
+    for (int t = HT_HIT; t < HT_COUNT; t++) rows += history.rows[t] - history_first[t];
+
+    if (rows > 0) {
+        int m = history.rows[HT_MATCH]++;
+        history.matchMode[m] = (uint8_t)history_mode;
+        history.matchDifficulty[m] = (uint8_t)history_difficulty;
+        history.matchScore1[m] = (uint8_t)(player1_score > 255 ? 255 : player1_score);
+        history.matchScore2[m] = (uint8_t)(player2_score > 255 ? 255 : player2_score);
+        history.matchTicks[m] = (uint32_t)(sim_tick - history_start);
+        for (int t = HT_HIT; t < HT_COUNT; t++)
+            history.matchRows[t][m] = (uint32_t)(history.rows[t] - history_first[t]);
+
+        historyBeginMatch();
+
+        int full = history.rows[HT_MATCH] >= history_block_matches ||
+                   history.rows[HT_MATCH] >= HISTORY_MAX_MATCHES;
+        for (int t = HT_HIT; t < HT_COUNT; t++)
+            if (history.rows[t] > HISTORY_MAX_ROWS / 2) full = 1;
+        if (full) historyFlush();
+    }
+    else {
+        historyBeginMatch();
+    }
+}
+
+static uint8_t* historyPutVarint(uint8_t* o, uint32_t v) {
+    while (v >= 0x80) { *o++ = (uint8_t)(v | 0x80); v >>= 7; }
+    *o++ = (uint8_t)v;
+    return o;
+}
+
+// Encode one column at o; returns the end of the encoded bytes
+static uint8_t* historyEncode(const HistoryColumn* c, int rows, uint8_t* o) {
+    uint8_t* encByte = o;
+    uint8_t* lenPos = o + 1;
+    uint8_t* d = o + 5;
+    uint8_t* e = d;
+    HistoryEncoding enc = c->enc;
+
+    if (c->width == 1) {
+        const uint8_t* v = c->data;
+        int runs = 0;
+        for (int i = 0; i < rows; ) {
+            int j = i;
+            while (j < rows && j - i < 255 && v[j] == v[i]) j++;
+            runs++;
+            i = j;
+        }
+        if (runs * 2 < rows) {
+            enc = HENC_RLE8;
+            for (int i = 0; i < rows; ) {
+                int j = i;
+                while (j < rows && j - i < 255 && v[j] == v[i]) j++;
+                *e++ = (uint8_t)(j - i);
+                *e++ = v[i];
+                i = j;
+            }
+        }
+        else {
+            enc = HENC_RAW8;
+            memcpy(e, v, rows);
+            e += rows;
+        }
+    }
+    else {
+        const uint32_t* v = c->data;
+        uint32_t prev = 0;
+        for (int i = 0; i < rows; i++) {
+            uint32_t x = v[i];
+            if (enc == HENC_DELTA) {
+                int32_t dlt = (int32_t)(x - prev);
+                prev = x;
+                x = ((uint32_t)dlt << 1) ^ (uint32_t)(dlt >> 31);
+            }
+            e = historyPutVarint(e, x);
+        }
+    }
+
+    uint32_t len = (uint32_t)(e - d);
+    *encByte = (uint8_t)enc;
+    memcpy(lenPos, &len, 4);
+    return e;
+}
+
+// Encode everything buffered into one block and append it to history_path
+void historyFlush() {
+    if (!history_path || history.rows[HT_MATCH] == 0) return;
+
+    // Only whole matches go to disk; rows of the match in progress stay
+    int keep[HT_COUNT];
+    for (int t = 0; t < HT_COUNT; t++) keep[t] = history.rows[t] - history_first[t];
+    int rows[HT_COUNT];
+    for (int t = 0; t < HT_COUNT; t++) rows[t] = history_first[t];
+    rows[HT_MATCH] = history.rows[HT_MATCH];
+
+    size_t cap = 32;
+    for (int i = 0; i < HISTORY_COLUMNS; i++)
+        cap += 5 + (size_t)rows[historyColumns[i].table] * (historyColumns[i].width == 1 ? 2 : 5);
+    uint8_t* buf = malloc(cap);
+    if (!buf) return;
+
+    uint8_t* o = buf + 32;
+    for (int i = 0; i < HISTORY_COLUMNS; i++)
+        o = historyEncode(&historyColumns[i], rows[historyColumns[i].table], o);
+
+    uint32_t head[8] = {HISTORY_MAGIC, (uint32_t)(o - buf)};
+    for (int t = 0; t < HT_COUNT; t++) head[2 + t] = (uint32_t)rows[t];
+    head[6] = checksum32(buf + 32, (size_t)(o - buf - 32), 0);
+    head[7] = HISTORY_COLUMNS;
+    memcpy(buf, head, sizeof(head));
+
+    FILE* f = fopen(history_path, "ab");
+    if (f) {
+        fwrite(buf, 1, (size_t)(o - buf), f);
+        fclose(f);
+    }
+    free(buf);
+
+    // Move the unfinished match's rows to the front
+    #define HISTORY_SHIFT(col, t) memmove(col, col + history_first[t], keep[t] * sizeof(col[0]))
+    HISTORY_SHIFT(history.hitTick, HT_HIT);
+    HISTORY_SHIFT(history.hitPlayer, HT_HIT);
+    HISTORY_SHIFT(history.hitOffset, HT_HIT);
+    HISTORY_SHIFT(history.pointTick, HT_POINT);
+    HISTORY_SHIFT(history.pointScorer, HT_POINT);
+    HISTORY_SHIFT(history.pointValue, HT_POINT);
+    HISTORY_SHIFT(history.pointRally, HT_POINT);
+    HISTORY_SHIFT(history.pointCombo, HT_POINT);
+    HISTORY_SHIFT(history.pointBonus, HT_POINT);
+    HISTORY_SHIFT(history.pickupTick, HT_PICKUP);
+    HISTORY_SHIFT(history.pickupType, HT_PICKUP);
+    #undef HISTORY_SHIFT
+    for (int t = 0; t < HT_COUNT; t++) {
+        history.rows[t] = keep[t];
+        history_first[t] = 0;
+    }
+    history.rows[HT_MATCH] = 0;
+}
+
+//              Leaderboards
+//
+// One file holds every board: a LeaderHeader, a full-height head node per
+// board, then entries appended one after another. Each board is a skip
+// list through its entries, best first, whose link widths give an entry's
+// rank on the way down, so inserts and rank queries are O(log n) and the
+// top K is the first K on the bottom level. The file is mapped at its
+// largest size up front and grown underneath, so nodes never move.
+//
+// The game thread only queues results (leaderSubmit), a few plain stores
+// with no system call; a writer thread polls the queue and inserts them.
+// Readers walk the lists without locking and retry if an
+// insert relinked under them, as with the shared state segment. clean is
+// 0 while the file is open; a file that wasn't closed has its lists
+// rebuilt from the entries, up to the first one whose check is wrong.
+
+static LeaderNode* leaderNode(uint32_t offset) {
+    return (LeaderNode*)((uint8_t*)leader + offset);
+}
+
+static LeaderLink* leaderLinks(LeaderNode* n) {
+    return (LeaderLink*)(n + 1);
+}
+
+static uint16_t leaderCheck(const LeaderNode* n) {
+    return (uint16_t)checksum32(n, offsetof(LeaderNode, check), 0);
+}
+
+#define LEADER_HEAD_BYTES (sizeof(LeaderNode) + LEADER_LEVELS * sizeof(LeaderLink))
+#define LEADER_FIRST_NODE (sizeof(LeaderHeader) + LEADER_BOARDS * LEADER_HEAD_BYTES)
+
+int leaderBoard(LeaderMetric metric, int mode, int difficulty) {
+    return ((int)metric * 2 + (mode == MODE_PVC)) * 2 + (difficulty == DIFFICULTY_HARD);
+}
+
+// Boards rank high keys first, so times are stored inverted. Its own inverse.
+static uint32_t leaderKey(int board, uint32_t value) {
+    return board / 4 == LB_HARD_WIN ? ~value : value;
+}
+
+// Make room for bytes more at the end of the file
+static int leaderReserve(uint32_t bytes) {
+    uint32_t need = leader->used + bytes;
+    if (need > LEADER_MAP_SIZE) return 0;
+    if (need <= leader_size) return 1;
+#ifdef _WIN32
+    return 0;                           // mapped at full size by leaderOpen()
+#else
+    uint32_t size = (need + LEADER_GROW - 1) / LEADER_GROW * LEADER_GROW;
+    if (ftruncate(leader_fd, size) != 0) return 0;
+    leader_size = size;
+    return 1;
+#endif
+}
+
+// 1 level, then each more with chance 1/4
+static int leaderHeight() {
+    uint32_t x = leader->rng;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    leader->rng = x;
+    int h = 1;
+    while (h < LEADER_LEVELS && (x & 3) == 0) { h++; x >>= 2; }
+    return h;
+}
+
+// Link the entry at offset into its board (writer thread only). A new
+// entry goes after the ones with an equal key. Returns its rank.
+static uint32_t leaderLink(uint32_t offset) {
+    LeaderNode* n = leaderNode(offset);
+    LeaderLink* nl = leaderLinks(n);
+    LeaderNode* x = leaderNode(leader->head[n->board]);
+    LeaderNode* update[LEADER_LEVELS];
+    uint32_t rank[LEADER_LEVELS], pos = 0;
+
+    for (int lvl = LEADER_LEVELS - 1; lvl >= 0; lvl--) {
+        LeaderLink* l = &leaderLinks(x)[lvl];
+        while (l->next && leaderNode(l->next)->key >= n->key) {
+            pos += l->width;
+            x = leaderNode(l->next);
+            l = &leaderLinks(x)[lvl];
+        }
+        update[lvl] = x;
+        rank[lvl] = pos;
+    }
+
+    __atomic_store_n(&leader->writing, leader->writing + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (int lvl = 0; lvl < LEADER_LEVELS; lvl++) {
+        LeaderLink* l = &leaderLinks(update[lvl])[lvl];
+        if (lvl < n->height) {
+            uint32_t skipped = pos - rank[lvl];     // entries between update[lvl] and n
+            nl[lvl].next = l->next;
+            nl[lvl].width = l->width - skipped;
+            l->next = offset;
+            l->width = skipped + 1;
+        } else {
+            l->width++;
+        }
+    }
+    leader->count[n->board]++;
+    __atomic_store_n(&leader->writing, leader->writing + 1, __ATOMIC_RELEASE);
+    return pos + 1;
+}
+
+// Append an entry and link it (writer thread only). Returns its rank, or
+// 0 when the file is full.
+static uint32_t leaderInsert(int board, uint32_t value, uint32_t when) {
+    int height = leaderHeight();
+    uint32_t bytes = sizeof(LeaderNode) + height * sizeof(LeaderLink);
+    if (!leaderReserve(bytes)) return 0;
+
+    uint32_t offset = leader->used;
+    LeaderNode* n = leaderNode(offset);
+    n->key = leaderKey(board, value);
+    n->seq = leader->seq++;
+    n->when = when;
+    n->board = (uint8_t)board;
+    n->height = (uint8_t)height;
+    n->check = leaderCheck(n);
+    memset(leaderLinks(n), 0, height * sizeof(LeaderLink));
+    __atomic_store_n(&leader->used, offset + bytes, __ATOMIC_RELEASE);
+    return leaderLink(offset);
+}
+
+// Empty boards with their head nodes
+static void leaderFormat() {
+    memset(leader, 0, LEADER_FIRST_NODE);
+    leader->magic = LEADER_MAGIC;
+    leader->version = LEADER_VERSION;
+    leader->rng = 0x9E3779B9u;
+    for (int b = 0; b < LEADER_BOARDS; b++) {
+        leader->head[b] = (uint32_t)(sizeof(LeaderHeader) + b * LEADER_HEAD_BYTES);
+        leaderNode(leader->head[b])->height = LEADER_LEVELS;
+    }
+    leader->used = LEADER_FIRST_NODE;
+}
+
+// Relink every entry in file order, which is insertion order, so the
+// boards come back as they were
+static void leaderRebuild() {
+    uint32_t end = leader->used < leader_size ? leader->used : leader_size;
+    for (int b = 0; b < LEADER_BOARDS; b++) {
+        memset(leaderLinks(leaderNode(leader->head[b])), 0, LEADER_LEVELS * sizeof(LeaderLink));
+        leader->count[b] = 0;
+    }
+    uint32_t offset = LEADER_FIRST_NODE;
+    leader->seq = 0;
+    while (offset + sizeof(LeaderNode) <= end) {
+        LeaderNode* n = leaderNode(offset);
+        uint32_t bytes = sizeof(LeaderNode) + n->height * sizeof(LeaderLink);
+        if (n->check != leaderCheck(n) || n->board >= LEADER_BOARDS || n->height < 1 ||
+            n->height > LEADER_LEVELS || offset + bytes > end) break;
+        memset(leaderLinks(n), 0, n->height * sizeof(LeaderLink));
+        leaderLink(offset);
+        leader->seq = n->seq + 1;
+        offset += bytes;
+    }
+    leader->used = offset;
+}
+
+static void leaderDrain() {
+    while (leader_done != __atomic_load_n(&leader_queued, __ATOMIC_ACQUIRE)) {
+        const LeaderResult* r = &leader_queue[leader_done % LEADER_QUEUE];
+        leaderInsert((int)r->board, r->value, r->when);
+        __atomic_store_n(&leader_done, leader_done + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void leaderWriter() {
+    while (!__atomic_load_n(&leader_quit, __ATOMIC_ACQUIRE)) {
+        leaderDrain();
+#ifdef _WIN32
+        Sleep(LEADER_POLL_MS);
+#else
+        struct timespec t = {0, LEADER_POLL_MS * 1000000L};
+        nanosleep(&t, NULL);
+#endif
+    }
+    leaderDrain();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI leaderThread(LPVOID arg) {
+    (void)arg;
+    leaderWriter();
+    return 0;
+}
+#else
+static void* leaderThread(void* arg) {
+    (void)arg;
+    leaderWriter();
+    return NULL;
+}
+#endif
+
+// Map the leaderboard file, repair it if the last run didn't close it and
+// start the writer. Returns 0 if the file can't be mapped.
+int leaderOpen(const char* path) {
+    void* m;
+#ifdef _WIN32
+    // Windows can't grow a file under a view, so it is sized in full here
+    leader_file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                              NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (leader_file == INVALID_HANDLE_VALUE) { leader_file = NULL; return 0; }
+    leader_map = CreateFileMappingA(leader_file, NULL, PAGE_READWRITE, 0, LEADER_MAP_SIZE, NULL);
+    if (!leader_map) { CloseHandle(leader_file); leader_file = NULL; return 0; }
+    m = MapViewOfFile(leader_map, FILE_MAP_ALL_ACCESS, 0, 0, LEADER_MAP_SIZE);
+    if (!m) {
+        CloseHandle(leader_map); CloseHandle(leader_file);
+        leader_map = leader_file = NULL;
+        return 0;
+    }
+    leader_size = LEADER_MAP_SIZE;
+#else
+    leader_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (leader_fd < 0) return 0;
+    off_t size = lseek(leader_fd, 0, SEEK_END);
+    if (size < LEADER_GROW) size = LEADER_GROW;
+    if (size > LEADER_MAP_SIZE) size = LEADER_MAP_SIZE;
+    m = MAP_FAILED;
+    if (ftruncate(leader_fd, size) == 0)
+        m = mmap(NULL, LEADER_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, leader_fd, 0);
+    if (m == MAP_FAILED) { close(leader_fd); leader_fd = -1; return 0; }
+    leader_size = (uint32_t)size;
+#endif
+    leader = m;
+
+    if (leader->magic != LEADER_MAGIC || leader->version != LEADER_VERSION) leaderFormat();
+    else if (!leader->clean) leaderRebuild();
+    leader->clean = 0;
+
+    leader_queued = leader_done = 0;
+    leader_quit = 0;
+#ifdef _WIN32
+    leader_thread = CreateThread(NULL, 0, leaderThread, NULL, 0, NULL);
+    leader_running = leader_thread != NULL;
+#else
+    leader_running = pthread_create(&leader_thread, NULL, leaderThread, NULL) == 0;
+#endif
+    if (!leader_running) {
+        leaderClose();
+        return 0;
+    }
+    return 1;
+}
+
+// Insert what is still queued, then flush and unmap synchronously
+void leaderClose() {
+    if (!leader) return;
+#ifdef _WIN32
+    if (leader_running) {
+        __atomic_store_n(&leader_quit, 1, __ATOMIC_RELEASE);
+        WaitForSingleObject(leader_thread, INFINITE);
+        CloseHandle(leader_thread);
+        leader_thread = NULL;
+    }
+    // The entries reach the disk before the flag that says they are whole
+    FlushViewOfFile(leader, 0);
+    FlushFileBuffers(leader_file);
+    leader->clean = 1;
+    FlushViewOfFile(leader, sizeof(LeaderHeader));
+    FlushFileBuffers(leader_file);
+    UnmapViewOfFile(leader);
+    CloseHandle(leader_map);
+    CloseHandle(leader_file);
+    leader_map = leader_file = NULL;
+#else
+    if (leader_running) {
+        __atomic_store_n(&leader_quit, 1, __ATOMIC_RELEASE);
+        pthread_join(leader_thread, NULL);
+    }
+    msync(leader, leader_size, MS_SYNC);
+    leader->clean = 1;
+    msync(leader, sizeof(LeaderHeader), MS_SYNC);
+    munmap(leader, LEADER_MAP_SIZE);
+    close(leader_fd);
+    leader_fd = -1;
+#endif
+    leader = NULL;
+    leader_running = 0;
+}
+
+// Queue a result for the writer thread. Never waits and never wakes it:
+// with the queue full the result is dropped and counted in leader_dropped.
+void leaderSubmit(int board, uint32_t value) {
+    if (!leader) return;
+    unsigned q = leader_queued;
+    if (q - __atomic_load_n(&leader_done, __ATOMIC_ACQUIRE) >= LEADER_QUEUE) {
+        leader_dropped++;
+        return;
+    }
+    leader_queue[q % LEADER_QUEUE] = (LeaderResult){(uint32_t)board, value, (uint32_t)time(NULL)};
+    __atomic_store_n(&leader_queued, q + 1, __ATOMIC_RELEASE);
+}
+
+// The best n entries of a board into out; returns how many there were
+int leaderTop(int board, LeaderEntry* out, int n) {
+    if (!leader) return 0;
+    for (;;) {
+        uint32_t w = __atomic_load_n(&leader->writing, __ATOMIC_ACQUIRE);
+        if (w & 1) continue;
+        int got = 0;
+        uint32_t offset = leaderLinks(leaderNode(leader->head[board]))[0].next;
+        while (offset && got < n) {
+            LeaderNode* e = leaderNode(offset);
+            out[got].value = leaderKey(board, e->key);
+            out[got].when = e->when;
+            got++;
+            offset = leaderLinks(e)[0].next;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&leader->writing, __ATOMIC_RELAXED) == w) return got;
+    }
+}
+
+// The place value would take on a board: 1 + the entries strictly better
+uint32_t leaderRank(int board, uint32_t value) {
+    if (!leader) return 0;
+    uint32_t key = leaderKey(board, value);
+    for (;;) {
+        uint32_t w = __atomic_load_n(&leader->writing, __ATOMIC_ACQUIRE);
+        if (w & 1) continue;
+        LeaderNode* x = leaderNode(leader->head[board]);
+        uint32_t pos = 0;
+        for (int lvl = LEADER_LEVELS - 1; lvl >= 0; lvl--) {
+            LeaderLink* l = &leaderLinks(x)[lvl];
+            while (l->next && leaderNode(l->next)->key > key) {
+                pos += l->width;
+                x = leaderNode(l->next);
+                l = &leaderLinks(x)[lvl];
+            }
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&leader->writing, __ATOMIC_RELAXED) == w) return pos + 1;
+    }
+}
+
+// Submit the match that just ended and start tracking the next
+void leaderEndMatch() {
+    if (leader && (leader_mode == MODE_PVP || leader_mode == MODE_PVC) && sim_tick > leader_start) {
+        int best = leader_mode == MODE_PVC ? player1_score
+                 : (player1_score > player2_score ? player1_score : player2_score);
+        if (best > 0)
+            leaderSubmit(leaderBoard(LB_SCORE, leader_mode, leader_difficulty), (uint32_t)best);
+        if (match_rally > 0)
+            leaderSubmit(leaderBoard(LB_RALLY, leader_mode, leader_difficulty), (uint32_t)match_rally);
+        if (match_top_speed > 0)
+            leaderSubmit(leaderBoard(LB_SPEED, leader_mode, leader_difficulty),
+                         (uint32_t)(match_top_speed * 100 + 0.5f));
+        if (match_win_tick >= 0)
+            leaderSubmit(leaderBoard(LB_HARD_WIN, leader_mode, leader_difficulty),
+                         (uint32_t)(match_win_tick - leader_start));
+    }
+    leader_start = sim_tick;
+    leader_mode = currentMode;
+    leader_difficulty = currentDifficulty;
+    match_rally = 0;
+    match_top_speed = 0;
+    match_win_tick = -1;
+}
+
+//              Replay recording
+//
+// A match is replayed by reseeding with the header's seed, calling
+// initGame() and feeding the stream back: tick bytes set the key flags (and
+// mouse targets) before each update(), ops call the same functions the
+// window procedure did. Everything else in update() is deterministic. The
+// stream is buffered by stdio and flushed when the match ends.
+
+void replayBeginMatch() {
+    if (replay_file) fflush(replay_file);
+    replay_active = 0;
+    if (!replay_path || (currentMode != MODE_PVP && currentMode != MODE_PVC)) return;
+    if (!replay_file && !(replay_file = fopen(replay_path, "ab"))) {
+        replay_path = NULL;
+        return;
+    }
+
+    // initGame() draws from rand() right after this, so the seed pins it
+    unsigned seed = ((unsigned)rand() << 15) ^ (unsigned)rand();
+    srand(seed);
+    fx_seed = seed;
+
+    ReplayHeader h = {REPLAY_MAGIC, seed,
+                      (uint8_t)currentMode, (uint8_t)currentDifficulty,
+                      (uint8_t)player1_control, (uint8_t)player2_control,
+                      (uint16_t)windowWidth, (uint16_t)windowHeight,
+                      pvp_ball_speed, powerup_timer, animation_time};
+    fwrite(&h, sizeof(h), 1, replay_file);
+    replay_active = 1;
+    replay_mouseMoved = 0;
+}
+
+// Called at the top of update(): the inputs updateControls() is about to read
+void replayTick() {
+    if (!replay_active) return;
+    int b = 0;
+    if (key_a_pressed)     b |= REPLAY_KEY_A;
+    if (key_d_pressed)     b |= REPLAY_KEY_D;
+    if (key_left_pressed)  b |= REPLAY_KEY_LEFT;
+    if (key_right_pressed) b |= REPLAY_KEY_RIGHT;
+    if (replay_mouseMoved) {
+        if (player1_control == CONTROL_MOUSE || player1_control == CONTROL_EXTERNAL) b |= REPLAY_MOUSE1;
+        if (player2_control == CONTROL_MOUSE || player2_control == CONTROL_EXTERNAL) b |= REPLAY_MOUSE2;
+        replay_mouseMoved = 0;
+    }
+    fputc(b, replay_file);
+    if (b & REPLAY_MOUSE1) fwrite(&player1_target_x, sizeof(float), 1, replay_file);
+    if (b & REPLAY_MOUSE2) fwrite(&player2_target_x, sizeof(float), 1, replay_file);
+}
+
+void replayOp(int op, const void* data, int len) {
+    if (!replay_active) return;
+    fputc(op, replay_file);
+    if (len) fwrite(data, 1, (size_t)len, replay_file);
+}
+
+void replayResize() {
+    uint16_t size[2] = {(uint16_t)windowWidth, (uint16_t)windowHeight};
+    replayOp(REPLAY_RESIZE, size, sizeof(size));
+}
+
+void replayClose() {
+    if (replay_file) fclose(replay_file);
+    replay_file = NULL;
+    replay_active = 0;
+}
+
+//              Match state
+
+void matchSave(MatchState* s) {
+    memcpy(s->balls, balls, sizeof(balls));
+    memcpy(s->powerups, powerups, sizeof(powerups));
+    s->activeBalls = activeBalls;
+    s->score[0] = player1_score;              s->score[1] = player2_score;
+    s->paddleX[0] = player1_paddle_x;         s->paddleX[1] = player2_paddle_x;
+    s->targetX[0] = player1_target_x;         s->targetX[1] = player2_target_x;
+    s->paddleSpeed[0] = player1_paddle_speed; s->paddleSpeed[1] = player2_paddle_speed;
+    s->bigPaddle[0] = player1_big_paddle;     s->bigPaddle[1] = player2_big_paddle;
+    s->paddleWidth = paddle_width;
+    s->paddleHeight = paddle_height;
+    s->ballSpeed = ball_speed;
+    s->pvpBallSpeed = pvp_ball_speed;
+    s->powerupTimer = powerup_timer;
+    s->slowTimeFactor = slow_time_factor;
+    s->timerCount = 0;
+    for (int k = 0; k < TIMER_KINDS; k++)
+        for (int a = 0; a < TIMER_ARGS; a++) {
+            int expire = timerExpiry((TimerKind)k, a);
+            if (expire < 0) continue;
+            s->timers[s->timerCount].expire = expire;
+            s->timers[s->timerCount].kind = (uint8_t)k;
+            s->timers[s->timerCount++].arg = (uint8_t)a;
+        }
+    s->comboMultiplier = combo_multiplier;
+    s->consecutiveHits = consecutive_hits;
+    s->totalHits = total_hits;
+    s->tick = sim_tick;
+    s->mode = currentMode;
+    s->difficulty = currentDifficulty;
+    s->control[0] = player1_control;
+    s->control[1] = player2_control;
+    s->running = game_running;
+}
+
+void matchLoad(const MatchState* s) {
+    memcpy(balls, s->balls, sizeof(balls));
+    memcpy(powerups, s->powerups, sizeof(powerups));
+    activeBalls = s->activeBalls;
+    player1_score = s->score[0];              player2_score = s->score[1];
+    player1_paddle_x = s->paddleX[0];         player2_paddle_x = s->paddleX[1];
+    player1_target_x = s->targetX[0];         player2_target_x = s->targetX[1];
+    player1_paddle_speed = s->paddleSpeed[0]; player2_paddle_speed = s->paddleSpeed[1];
+    player1_big_paddle = s->bigPaddle[0];     player2_big_paddle = s->bigPaddle[1];
+    paddle_width = s->paddleWidth;
+    paddle_height = s->paddleHeight;
+    ball_speed = s->ballSpeed;
+    pvp_ball_speed = s->pvpBallSpeed;
+    powerup_timer = s->powerupTimer;
+    slow_time_factor = s->slowTimeFactor;
+    combo_multiplier = s->comboMultiplier;
+    consecutive_hits = s->consecutiveHits;
+    total_hits = s->totalHits;
+    sim_tick = s->tick;
+    currentMode = s->mode;
+    currentDifficulty = s->difficulty;
+    player1_control = s->control[0];
+    player2_control = s->control[1];
+    game_running = s->running;
+
+    timerClear();
+    for (int i = 0; i < s->timerCount; i++)
+        timerAt(s->timers[i].expire, (TimerKind)s->timers[i].kind, s->timers[i].arg);
+}
+
+//              State export
+
+// Map the segment; create = 1 for the game, 0 for readers and bots, which
+// fail if no game has created it. Returns 0 if it can't be mapped.
+int shareOpen(const char* name, int create) {
+    void* m;
+#ifdef _WIN32
+    char path[64];
+    snprintf(path, sizeof(path), "Local\\%s", name);
+    share_map = create
+        ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)sizeof(SharedState), path)
+        : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path);
+    if (!share_map) return 0;
+    m = MapViewOfFile(share_map, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedState));
+    if (!m) { CloseHandle(share_map); share_map = NULL; return 0; }
+#else
+    char path[64];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, O_RDWR | (create ? O_CREAT : 0), 0600);
+    if (fd < 0) return 0;
+    m = MAP_FAILED;
+    if (!create || ftruncate(fd, sizeof(SharedState)) == 0)
+        m = mmap(NULL, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return 0;
+#endif
+    share = m;
+
+    if (create) {
+        // A fresh segment is zero-filled; one left by an earlier run keeps
+        // its claims so attached bots carry over
+        share->magic = SHARE_MAGIC;
+        share->version = SHARE_VERSION;
+        share->size = sizeof(SharedState);
+        if (share->seq & 1) share->seq++;
+    } else if (share->magic != SHARE_MAGIC || share->version != SHARE_VERSION ||
+               share->size != sizeof(SharedState)) {
+        shareClose();
+        return 0;
+    }
+    return 1;
+}
+
+void shareClose() {
+    if (!share) return;
+#ifdef _WIN32
+    UnmapViewOfFile(share);
+    CloseHandle(share_map);
+    share_map = NULL;
+#else
+    munmap(share, sizeof(SharedState));
+#endif
+    share = NULL;
+}
+
+// Once per tick, after update() has finished with the match: one
+// MatchState-sized write between the two seq stores
+void sharePublish() {
+    if (!share || sim_spectate) return;
+    uint32_t seq = share->seq;
+    __atomic_store_n(&share->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    matchSave(&share->frame);
+    __atomic_store_n(&share->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Copy a consistent frame; returns the number of attempts it took
+int shareRead(const SharedState* s, MatchState* out) {
+    for (int tries = 1;; tries++) {
+        uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;
+        memcpy(out, &s->frame, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq) return tries;
+    }
+}
+
+// Bot targets for claimed paddles, read at the top of update() where the
+// mouse targets would have been set, so replays record them the same way
+void shareInput() {
+    if (!share) return;
+    ControlMode control[2] = {player1_control, player2_control};
+    float* target[2] = {&player1_target_x, &player2_target_x};
+    for (int k = 0; k < 2; k++) {
+        if (control[k] != CONTROL_EXTERNAL) continue;
+        float t;
+        __atomic_load(&share->target[k], &t, __ATOMIC_ACQUIRE);
+        if (t != *target[k]) {
+            *target[k] = t;
+            replay_mouseMoved = 1;
+        }
+    }
+}
+
+// Hand paddles to bots that claimed them, or back when released. Only at
+// match start, so a replay header always names the controls in use. The
+// computer paddle in PvC can't be claimed.
+void shareClaims() {
+    if (!share) return;
+    ControlMode* control[2] = {&player1_control, &player2_control};
+    for (int k = 0; k < 2; k++) {
+        int claimed = __atomic_load_n(&share->claim[k], __ATOMIC_ACQUIRE) != 0;
+        if (k == 1 && currentMode != MODE_PVP) claimed = 0;
+        if (claimed && *control[k] != CONTROL_EXTERNAL) {
+            share_saved[k] = *control[k];
+            *control[k] = CONTROL_EXTERNAL;
+        } else if (!claimed && *control[k] == CONTROL_EXTERNAL) {
+            *control[k] = share_saved[k];
+        }
+    }
+}
+
+//              Timer wheel
+
+// Ticks until a countdown that starts at seconds and loses 0.016 per tick
+// reaches zero, counted the same float way the countdowns always were
+int countdownTicks(float seconds) {
+    float v = seconds;
+    int n = 0;
+    do { v -= 0.016f; n++; } while (v > 0);
+    return n;
+}
+
+static int timerBucket(int expire, int tick) {
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        int shift = TIMER_BITS * (level + 1);
+        if ((expire >> shift) == (tick >> shift))
+            return level * TIMER_SLOTS + ((expire >> (TIMER_BITS * level)) & TIMER_MASK);
+    }
+    return TIMER_OVERFLOW;
+}
+
+static void timerLink(int n) {
+    TimerNode* t = &timers.node[n];
+    int b = timerBucket(t->expire, timers.tick);
+    t->bucket = (int16_t)b;
+    t->prev = -1;
+    t->next = (int16_t)(timers.head[b] - 1);
+    if (t->next >= 0) timers.node[t->next].prev = (int16_t)n;
+    timers.head[b] = (int16_t)(n + 1);
+    if (b < TIMER_OVERFLOW) timers.used[b / TIMER_SLOTS] |= 1ull << (b % TIMER_SLOTS);
+}
+
+static void timerUnlink(int n) {
+    TimerNode* t = &timers.node[n];
+    int b = t->bucket;
+    if (t->next >= 0) timers.node[t->next].prev = t->prev;
+    if (t->prev >= 0) timers.node[t->prev].next = t->next;
+    else              timers.head[b] = (int16_t)(t->next + 1);
+    if (!timers.head[b] && b < TIMER_OVERFLOW)
+        timers.used[b / TIMER_SLOTS] &= ~(1ull << (b % TIMER_SLOTS));
+}
+
+// Drop a linked node: unlink, clear its key and put it on the free list
+static void timerFree(int n) {
+    TimerNode* t = &timers.node[n];
+    timerUnlink(n);
+    timers.byKey[t->kind][t->arg] = 0;
+    t->next = (int16_t)(timers.freeHead - 1);
+    timers.freeHead = (int16_t)(n + 1);
+}
+
+// Schedule (kind, arg) to fire in the update() running at tick expire,
+// replacing any pending timer with the same key. expire must be at least
+// sim_tick (timers.tick); earlier values fire on the next update().
+void timerAt(int expire, TimerKind kind, int arg) {
+    int n = timers.byKey[kind][arg] - 1;
+    if (n >= 0) {
+        timerUnlink(n);
+    } else if (timers.freeHead) {
+        n = timers.freeHead - 1;
+        timers.freeHead = (int16_t)(timers.node[n].next + 1);
+    } else {
+        n = timers.fresh++;
+    }
+    TimerNode* t = &timers.node[n];
+    t->expire = expire > timers.tick ? expire : timers.tick;
+    t->kind = (uint8_t)kind;
+    t->arg = (uint8_t)arg;
+    timers.byKey[kind][arg] = (int16_t)(n + 1);
+    timerLink(n);
+}
+
+void timerCancelKey(TimerKind kind, int arg) {
+    if (timers.byKey[kind][arg]) timerFree(timers.byKey[kind][arg] - 1);
+}
+
+// Tick a pending timer fires on, or -1
+int timerExpiry(TimerKind kind, int arg) {
+    int n = timers.byKey[kind][arg] - 1;
+    return n >= 0 ? timers.node[n].expire : -1;
+}
+
+// Drop every timer; the wheel restarts at sim_tick
+void timerClear() {
+    memset(&timers, 0, sizeof(timers));
+    timers.tick = sim_tick;
+}
+
+static void timerFire(const TimerNode* t) {
+    switch ((TimerKind)t->kind) {
+        case TIMER_BIG_PADDLE:
+            if (t->arg == 0) player1_big_paddle = 0;
+            else             player2_big_paddle = 0;
+            break;
+        case TIMER_SLOW_TIME:
+            slow_time_factor = 1.0f;
+            break;
+        case TIMER_COMBO:
+            combo_multiplier = 1;
+            consecutive_hits = 0;
+            needsRedraw = 1;
+            break;
+        case TIMER_BALL_EFFECT:     // nothing draws the effect yet
+        case TIMER_KINDS:
+            break;
+    }
+}
+
+// Move the timers of one bucket down to the levels below
+static void timerRebucket(int b) {
+    int n = timers.head[b] - 1;
+    timers.head[b] = 0;
+    if (b < TIMER_OVERFLOW) timers.used[b / TIMER_SLOTS] &= ~(1ull << (b % TIMER_SLOTS));
+    while (n >= 0) {
+        int next = timers.node[n].next;
+        timerLink(n);
+        n = next;
+    }
+}
+
+// Fire every timer due up to and including tick
+void timerAdvance(int tick) {
+    while (timers.tick <= tick) {
+        int t = timers.tick;
+        if (!(t & TIMER_MASK)) {
+            // Entering a new block: cascade from the highest boundary down
+            int top = 1;
+            while (top < TIMER_LEVELS && !(t & ((1 << (TIMER_BITS * (top + 1))) - 1))) top++;
+            if (top == TIMER_LEVELS) timerRebucket(TIMER_OVERFLOW);
+            for (int level = top < TIMER_LEVELS ? top : TIMER_LEVELS - 1; level >= 1; level--)
+                timerRebucket(level * TIMER_SLOTS + ((t >> (TIMER_BITS * level)) & TIMER_MASK));
+        }
+
+        int slot = t & TIMER_MASK;
+        timers.tick = t + 1;
+        while (timers.used[0] & (1ull << slot)) {
+            int n = timers.head[slot] - 1;
+            TimerNode fired = timers.node[n];
+            timerFree(n);
+            timerFire(&fired);
+        }
+
+        // Skip to the next occupied slot or the end of the block
+        if (timers.tick & TIMER_MASK) {
+            uint64_t later = timers.used[0] & (~0ull << (timers.tick & TIMER_MASK));
+            int next = later ? (t & ~TIMER_MASK) + __builtin_ctzll(later) : (t | TIMER_MASK) + 1;
+            timers.tick = next < tick + 1 ? next : tick + 1;
+        }
+    }
+}
+
+// Earliest pending expiry, or INT_MAX when no timer is pending. Only the
+// first occupied slot of each level can hold the minimum.
+int timerNext() {
+    int best = 0x7FFFFFFF;
+    for (int level = 0; level <= TIMER_LEVELS; level++) {
+        int b;
+        if (level == TIMER_LEVELS) {
+            b = TIMER_OVERFLOW;
+            if (!timers.head[b]) break;
+        } else {
+            int index = (timers.tick >> (TIMER_BITS * level)) & TIMER_MASK;
+            uint64_t later = timers.used[level] & (~0ull << index);
+            if (!later) continue;
+            b = level * TIMER_SLOTS + __builtin_ctzll(later);
+        }
+        for (int n = timers.head[b] - 1; n >= 0; n = timers.node[n].next)
+            if (timers.node[n].expire < best) best = timers.node[n].expire;
+    }
+    return best;
+}
+
+#ifdef PONG_DRAWING
+void drawAchievements() {
+    if (achievements_unlocked == 0) return;
+
+    glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity();
+    glOrtho(0, windowWidth, 0, windowHeight, -1,1);
+    glMatrixMode(GL_MODELVIEW); glPushMatrix(); glLoadIdentity();
+
+    wglMakeCurrent(NULL, NULL);
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, RGB(255,255,0));
+
+    char buf[100];
+    sprintf(buf, "ACHIEVEMENTS: %d/%d", achievements_unlocked, ACHIEVEMENT_COUNT);
+    TextOutA(hdc, 10, windowHeight - 30, buf, (int)strlen(buf));
+
+    wglMakeCurrent(hdc, hrc);
+
+    glPopMatrix(); glMatrixMode(GL_PROJECTION); glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+#endif // PONG_DRAWING
+
+// Check if ball touched any active power-up
+void checkPowerUpCollision(Ball* ball) {
+    for (int i = 0; i < MAX_POWERUPS; i++) {
+        if (!powerups[i].active) continue;
+
+        float dx = ball->x - powerups[i].x;
+        float dy = ball->y - powerups[i].y;
+        float dist = sqrtf(dx*dx + dy*dy);
+
+        if (dist < ball->radius + 15) {
+            powerups_collected++;
+            profileRecord(PREC_STAT, PSTAT_POWERUPS, (uint32_t)powerups_collected);
+
+            switch (powerups[i].type) {
+                case POWERUP_BIG_PADDLE:
+                    // Each player's big paddle runs out on its own
+                    if (ball->vy > 0) player1_big_paddle = 1;
+                    else              player2_big_paddle = 1;
+                    timerAt(sim_tick - 1 + countdownTicks(10.0f), TIMER_BIG_PADDLE, ball->vy > 0 ? 0 : 1);
+                    playSound(800,200);
+                    break;
+
+                case POWERUP_SLOW_BALL:
+                    ball_speed *= 0.7f;
+                    for (int j = 0; j < 3; j++)
+                        if (balls[j].active)
+                            setBallVelocity(&balls[j], balls[j].vx * 0.7f, balls[j].vy * 0.7f);
+                    playSound(600,200);
+                    break;
 
                 case POWERUP_EXTRA_POINTS:
-                    if (ball->vy > 0) player1_score += 2;
-                    else              player2_score += 2;
-                    combo_multiplier = 2; combo_timer = 5.0f;
+                    if (ball->vy > 0) { player1_score += 2; raiseGameEvent(GE_POINT_P1, 2); historyPoint(1, 2, 1); }
+                    else              { player2_score += 2; raiseGameEvent(GE_POINT_P2, 2); historyPoint(2, 2, 1); }
+                    combo_multiplier = 2;
+                    timerAt(sim_tick - 1 + countdownTicks(5.0f), TIMER_COMBO, 0);
                     playSound(1000,200);
                     break;
 
-                case POWERUP_SLOW_TIME:
-                    slow_time_factor = 0.5f;
-                    slow_time_timer = 5.0f;
-                    playSound(700,200);
-                    break;
+                case POWERUP_SLOW_TIME:
+                    slow_time_factor = 0.5f;
+                    timerAt(sim_tick - 1 + countdownTicks(5.0f), TIMER_SLOW_TIME, 0);
+                    playSound(700,200);
+                    break;
+
+                case POWERUP_FAST_PADDLE:
+                    if (ball->vy > 0) player1_paddle_speed = 1.5f;
+                    else              player2_paddle_speed = 1.5f;
+                    playSound(900,200);
+                    break;
+
+                case POWERUP_INVISIBLE_BALL:
+                    ball->type = BALL_NORMAL;
+                    timerAt(sim_tick - 1 + countdownTicks(5.0f), TIMER_BALL_EFFECT, (int)(ball - balls));
+                    playSound(500,200);
+                    break;
+
+                case POWERUP_SPLIT_BALL:
+                    for (int j = 0; j < 3; j++) {
+                        if (!balls[j].active && activeBalls < 3) {
+                            balls[j].active = 1;
+                            balls[j].x = ball->x;
+                            balls[j].y = ball->y;
+                            balls[j].vx = -ball->vx;
+                            balls[j].vy = -ball->vy;
+                            balls[j].radius = ball->radius;
+                            balls[j].type = ball->type;
+                            anchorBall(&balls[j]);
+                            activeBalls++;
+                            break;
+                        }
+                    }
+                    playSound(1200,200);
+                    break;
+
+                default:
+                    break;
+            }
+
+            powerups[i].active = 0;
+            needsRedraw = 1;
+            raiseGameEvent(GE_POWERUP, powerups[i].type);
+            historyPickup(powerups[i].type);
+        }
+    }
+}
+
+// Manage power-up timers and spawning
+void updatePowerUps() {
+    powerup_timer += 0.016f;
+    if (powerup_timer >= 8.0f) {
+        spawnPowerUp();
+        powerup_timer = 0.0f;
+    }
+
+    for (int i = 0; i < MAX_POWERUPS && sim_cosmetics; i++) {
+        if (powerups[i].active) {
+            powerup_fx[i].size = 0.8f + sinf(animation_time * 3.0f + i) * 0.2f;
+            powerup_fx[i].rotation += 1.0f;
+        }
+    }
+}
+
+void redraw() {
+#ifndef PONG_HEADLESS
+    InvalidateRect(hwnd, NULL, FALSE);
+#endif
+}
+
+#ifdef PONG_DRAWING
+//              Menu screens
+
+void drawDifficultyMenu() {
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glMatrixMode(GL_PROJECTION); glLoadIdentity();
+    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
+    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+
+    // Dark background
+    glBegin(GL_QUADS);
+    glColor3f(0.1f,0.1f,0.2f); glVertex2f(orthoLeft, orthoTop);
+    glVertex2f(orthoRight, orthoTop);
+    glColor3f(0.05f,0.05f,0.15f);
+    glVertex2f(orthoRight, orthoBottom);
+    glVertex2f(orthoLeft, orthoBottom);
+    glEnd();
+
+    // Random twinkling dots
+    glPointSize(2.0f);
+    glBegin(GL_POINTS);
+    for (int i = 0; i < 50; i++) {
+        float rx = rand() / (float)RAND_MAX;
+        float ry = rand() / (float)RAND_MAX;
+        float br = 0.5f + 0.5f * sinf(animation_time * 2.0f + i);
+        glColor3f(br, br, br);
+        glVertex2f(orthoLeft + (orthoRight-orthoLeft)*rx,
+                   orthoBottom + (orthoTop-orthoBottom)*ry);
+    }
+    glEnd();
+
+    SwapBuffers(hdc);
+
+    drawText("SELECT DIFFICULTY", -180, 300, 1);
+
+    const char* opts[] = {"1 - MEDIUM", "2 - HARD"};
+    const char* desc[] = {"Challenging AI", "Extreme challenge!"};
+    float ys[] = {200, 150};
+
+    for (int i = 0; i < 2; i++) {
+        if (currentDifficulty == i) {
+            char buf[100]; sprintf(buf, "> %s <", opts[i]);
+            drawText(buf, -100, ys[i], 0);
+        } else {
+            drawText(opts[i], -80, ys[i], 0);
+        }
+        drawText(desc[i], -150, ys[i]-30, 0);
+    }
+
+    drawText("PRESS ENTER TO START", -150, -100, 0);
+    drawText("PRESS ESC TO GO BACK",  -150, -150, 0);
+
+    float spd = (currentDifficulty == DIFFICULTY_MEDIUM) ? 16.0f : 18.0f;
+    char buf[50]; sprintf(buf, "BALL SPEED: %.1f", spd);
+    drawText(buf, -120, -200, 0);
+
+    // Best results against the computer at this difficulty
+    char rec[LB_METRICS][16];
+    for (int m = 0; m < LB_METRICS; m++) {
+        LeaderEntry e;
+        if (!leaderTop(leaderBoard((LeaderMetric)m, MODE_PVC, currentDifficulty), &e, 1)) strcpy(rec[m], "-");
+        else if (m == LB_SPEED)    sprintf(rec[m], "%.1f", e.value / 100.0f);
+        else if (m == LB_HARD_WIN) sprintf(rec[m], "%.1fs", e.value * 0.016f);
+        else                       sprintf(rec[m], "%u", e.value);
+    }
+    char line[128];
+    sprintf(line, "BEST  SCORE %s  RALLY %s  SPEED %s%s%s", rec[LB_SCORE], rec[LB_RALLY], rec[LB_SPEED],
+            currentDifficulty == DIFFICULTY_HARD ? "  WIN " : "",
+            currentDifficulty == DIFFICULTY_HARD ? rec[LB_HARD_WIN] : "");
+    drawText(line, -230, -250, 0);
+}
+
+void drawSpeedMenu() {
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glMatrixMode(GL_PROJECTION); glLoadIdentity();
+    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
+    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+
+    // Reddish dark bg
+    glBegin(GL_QUADS);
+    glColor3f(0.2f,0.1f,0.1f); glVertex2f(orthoLeft, orthoTop);
+    glVertex2f(orthoRight, orthoTop);
+    glColor3f(0.1f,0.05f,0.05f);
+    glVertex2f(orthoRight, orthoBottom);
+    glVertex2f(orthoLeft, orthoBottom);
+    glEnd();
+
+    SwapBuffers(hdc);
+
+    drawText("SELECT BALL SPEED FOR PvP", -220, 300, 1);
+
+    char buf[100];
+    sprintf(buf, "CURRENT SPEED: %.1f", pvp_ball_speed);
+    drawText(buf, -120, 200, 1);
+
+    drawText("UP ARROW - INCREASE SPEED",   -180, 100, 0);
+    drawText("DOWN ARROW - DECREASE SPEED", -180, 70,  0);
+
+    float ratio = (pvp_ball_speed - 6.0f) / (25.0f - 6.0f);
+    float barW = 400.0f * ratio;
+
+    SwapBuffers(hdc);
+
+    // Bar background
+    glColor3f(0.3f,0.3f,0.3f);
+    glBegin(GL_QUADS);
+    glVertex2f(-200,150); glVertex2f(200,150);
+    glVertex2f(200,170);  glVertex2f(-200,170);
+    glEnd();
+
+    // Gradient bar
+    glBegin(GL_QUADS);
+    glColor3f(1,0,0);    glVertex2f(-200,150);
+    glColor3f(0,1,0);    glVertex2f(-200+barW,150);
+    glColor3f(0,0.5f,0); glVertex2f(-200+barW,170);
+    glColor3f(0.5f,0,0); glVertex2f(-200,170);
+    glEnd();
+
+    SwapBuffers(hdc);
+
+    drawText("ENTER - START GAME",    -120, 0,   0);
+    drawText("ESC - BACK TO MENU",    -120, -30, 0);
+    drawText("SLOW", -220, 180, 0);
+    drawText("FAST", 180,  180, 0);
+
+    // Sparks for high speed
+    if (pvp_ball_speed > 15.0f) {
+        glColor4f(1,0,0,0.3f);
+        glPointSize(3.0f);
+        glBegin(GL_POINTS);
+        for (int i = 0; i < 20; i++) {
+            float x = -500 + fmod(animation_time*100 + i*20, 1000);
+            float y = (rand()%400) - 200;
+            glVertex2f(x,y);
+        }
+        glEnd();
+        SwapBuffers(hdc);
+    }
+}
+#endif // PONG_DRAWING
+
+// Handle input → update paddle target positions smoothly
+void updateControls(float dt) {
+    float base = paddle_velocity * 1.5f;
+    double aiStart = perf.on ? frameClockMs() : 0;
+
+    // Bottom player controls
+    switch (player1_control) {
+        case CONTROL_KEYBOARD_1:
+            if (key_d_pressed)     player1_target_x += base * player1_paddle_speed * dt * 40;
+            if (key_a_pressed)     player1_target_x -= base * player1_paddle_speed * dt * 40;
+            break;
+        case CONTROL_KEYBOARD_2:
+            if (key_right_pressed) player1_target_x += base * player1_paddle_speed * dt * 40;
+            if (key_left_pressed)  player1_target_x -= base * player1_paddle_speed * dt * 40;
+            break;
+        case CONTROL_AUTO:
+            updateAI(1);
+            break;
+        case CONTROL_NEURAL:
+            updateNeuralAI(1);
+            break;
+        case CONTROL_MOUSE:
+        case CONTROL_EXTERNAL:
+            break;
+    }
+
+    // Top player controls (PvP only)
+    if (currentMode == MODE_PVP) {
+        switch (player2_control) {
+            case CONTROL_KEYBOARD_1:
+                if (key_right_pressed) player2_target_x += base * player2_paddle_speed * dt * 40;
+                if (key_left_pressed)  player2_target_x -= base * player2_paddle_speed * dt * 40;
+                break;
+            case CONTROL_KEYBOARD_2:
+                if (key_right_pressed) player2_target_x += base * player2_paddle_speed * dt * 40;
+                if (key_left_pressed)  player2_target_x -= base * player2_paddle_speed * dt * 40;
+                break;
+            case CONTROL_AUTO:
+                updateAI(2);
+                break;
+            case CONTROL_NEURAL:
+                updateNeuralAI(2);
+                break;
+            case CONTROL_MOUSE:
+            case CONTROL_EXTERNAL:
+                break;
+        }
+    } else if (currentMode == MODE_PVC) {
+        if (player2_control == CONTROL_NEURAL) updateNeuralAI(2);
+        else                                   updateAI(2);
+    }
+    if (perf.on) perf.aiTickMs += (float)(frameClockMs() - aiStart);
+
+    // Smooth interpolation
+    player1_paddle_x += (player1_target_x - player1_paddle_x) * paddle_acceleration;
+    player2_paddle_x += (player2_target_x - player2_paddle_x) * paddle_acceleration;
+
+    // Clamp everything
+    float ml = orthoLeft  + paddle_width/2;
+    float mr = orthoRight - paddle_width/2;
+
+    player1_target_x = fmaxf(ml, fminf(mr, player1_target_x));
+    player2_target_x = fmaxf(ml, fminf(mr, player2_target_x));
+    player1_paddle_x = fmaxf(ml, fminf(mr, player1_paddle_x));
+    player2_paddle_x = fmaxf(ml, fminf(mr, player2_paddle_x));
+}
+
+//              Late latch
+
+// Paddles moved by a person at this machine in the current mode
+static int isLocalPaddle(int player) {
+    ControlMode c = (player == 1) ? player1_control : player2_control;
+    if (currentMode != MODE_PVP && !(currentMode == MODE_PVC && player == 1)) return 0;
+    return c != CONTROL_AUTO && c != CONTROL_NEURAL && c != CONTROL_EXTERNAL;
+}
+
+// -1, 0 or 1 from the held keys, mapped as in updateControls()
+static int keyDirection(int player) {
+    ControlMode c = (player == 1) ? player1_control : player2_control;
+    if (c == CONTROL_KEYBOARD_1 && player == 1) return key_d_pressed - key_a_pressed;
+    if (c == CONTROL_KEYBOARD_1 || c == CONTROL_KEYBOARD_2) return key_right_pressed - key_left_pressed;
+    return 0;
+}
+
+// Paddle x for drawing. With late_latch on, a local paddle goes where its
+// input points right now: the cursor, or the keyboard target advanced by
+// the time since the last tick. Collisions still use the simulation.
+float latchedPaddleX(int player) {
+    float x = (player == 1) ? player1_paddle_x : player2_paddle_x;
+#ifndef PONG_HEADLESS
+    if (!late_latch || !game_running || !isLocalPaddle(player)) return x;
+
+    ControlMode c = (player == 1) ? player1_control : player2_control;
+    float target = (player == 1) ? player1_target_x : player2_target_x;
+    if (c == CONTROL_MOUSE) {
+        POINT p;
+        if (!GetCursorPos(&p) || !ScreenToClient(hwnd, &p)) return x;
+        // Both on the mouse: the cursor's half of the window picks the paddle
+        if (player1_control == CONTROL_MOUSE && player2_control == CONTROL_MOUSE &&
+            (p.y > windowHeight / 2) != (player == 1)) return x;
+        target = orthoLeft + (orthoRight - orthoLeft) * p.x / windowWidth;
+    } else {
+        float speed = (player == 1) ? player1_paddle_speed : player2_paddle_speed;
+        float ticks = (float)((frameClockMs() - last_tick_ms) / 16.0);
+        ticks = fmaxf(0.0f, fminf(1.0f, ticks));
+        target += keyDirection(player) * paddle_velocity * 1.5f * speed *
+                  0.016f * slow_time_factor * 40 * ticks;
+    }
+    float half = paddle_width / 2.0f;
+    return fmaxf(orthoLeft + half, fminf(orthoRight - half, target));
+#else
+    return x;
+#endif
+}
+
+// An input asked a paddle to move towards goal
+void latencyInput(int player, float goal) {
+    if (!latency.on || latency.player || !isLocalPaddle(player)) return;
+    float from = latency.shownX[player - 1];
+    if (fabsf(goal - from) < 1.0f) return;
+    latency.player = player;
+    latency.inputMs = frameClockMs();
+    latency.from = from;
+    latency.goal = goal;
+}
+
+// Start a sample for a freshly pressed movement key (one tick of travel)
+void latencyKeys() {
+    for (int player = 1; player <= 2; player++) {
+        int dir = keyDirection(player);
+        float speed = (player == 1) ? player1_paddle_speed : player2_paddle_speed;
+        if (dir)
+            latencyInput(player, latency.shownX[player - 1] +
+                         dir * paddle_velocity * 1.5f * speed * 0.016f * slow_time_factor * 40);
+    }
+}
+
+// A frame showing the paddles at x1 / x2 has just been presented
+void latencyPresent(float x1, float x2) {
+    latency.shownX[0] = x1;
+    latency.shownX[1] = x2;
+    if (!latency.player) return;
+
+    double ms = frameClockMs() - latency.inputMs;
+    float shown = latency.shownX[latency.player - 1];
+    if ((shown - latency.from) / (latency.goal - latency.from) >= LATENCY_REACH) {
+        int bucket = (int)ms;
+        latency.hist[bucket < LATENCY_HIST_MS ? bucket : LATENCY_HIST_MS - 1]++;
+        latency.sumMs += ms;
+        latency.samples++;
+        latency.player = 0;
+    } else if (ms > LATENCY_TIMEOUT_MS) {
+        latency.dropped++;                  // reversed before it got there
+        latency.player = 0;
+    }
+}
+
+int latencyPercentile(float p) {
+    unsigned want = (unsigned)(latency.samples * p), seen = 0;
+    for (int i = 0; i < LATENCY_HIST_MS; i++) {
+        seen += latency.hist[i];
+        if (seen > want) return i;
+    }
+    return LATENCY_HIST_MS - 1;
+}
+
+//              Performance overlay
+
+// A gameplay frame was just presented. Gaps over a second (a pause, a
+// menu) are not frame times and keep the previous interval.
+void perfPresent() {
+    double now = frameClockMs();
+    if (perf.lastPresent && now - perf.lastPresent < 1000) perf.presentMs = (float)(now - perf.lastPresent);
+    perf.lastPresent = now;
+}
+
+// A tick just ran for ms; keep the slowest of the frame
+void perfTick(double ms) {
+    if ((float)ms > perf.tickMs) perf.tickMs = (float)ms;
+    if (perf.aiTickMs > perf.aiMs) perf.aiMs = perf.aiTickMs;
+    perf.aiTickMs = 0;
+}
+
+#ifdef PONG_DRAWING
+static int perfCompare(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+// Percentile p of a history ring; order does not matter, only the filled part
+static float perfPercentile(const float* hist, float p) {
+    float v[PERF_HISTORY];
+    int n = perf.filled;
+    if (!n) return 0;
+    memcpy(v, hist, sizeof(float) * n);
+    qsort(v, n, sizeof(float), perfCompare);
+    return v[(int)((n - 1) * p)];
+}
+
+static float perfMean(const float* hist) {
+    float sum = 0;
+    for (int i = 0; i < perf.filled; i++) sum += hist[i];
+    return perf.filled ? sum / perf.filled : 0;
+}
+
+// One bar per frame, oldest on the left; full height is PERF_GRAPH_MS
+static void drawPerfBars(const float* hist, float x, float y, float h) {
+    glBegin(GL_LINES);
+    for (int i = 0; i < perf.filled; i++) {
+        float ms = hist[(perf.head - perf.filled + i + PERF_HISTORY) % PERF_HISTORY];
+        float top = fminf(ms / PERF_GRAPH_MS, 1.0f) * h;
+        glVertex2f(x + i * 2, y);
+        glVertex2f(x + i * 2, y + top);
+    }
+    glEnd();
+}
+
+// Fold this frame's counters into the history and draw the graph: the
+// interval between presents in green (the newest one ended with the last
+// frame's swap), tick cost in orange, the quality budget and a full 60 Hz
+// frame as lines. Runs after display() has measured the frame, so neither
+// its time nor its draw calls show up in the numbers it draws.
+void drawPerfOverlay(double submitMs) {
+    double start = frameClockMs();
+
+    perf.frameHist[perf.head] = perf.presentMs;
+    perf.submitHist[perf.head] = (float)submitMs;
+    perf.tickHist[perf.head] = perf.tickMs;
+    perf.head = (perf.head + 1) % PERF_HISTORY;
+    if (perf.filled < PERF_HISTORY) perf.filled++;
+    perf.shownDrawCalls = perf.drawCalls;
+    perf.shownVertices = perf.vertices;
+    perf.shownAiMs = perf.aiMs;
+    perf.shownOverlayMs = perf.overlayMs;
+    perf.tickMs = perf.aiMs = perf.overlayMs = 0;
+
+    float w = PERF_HISTORY * 2, h = 120;
+    float x = orthoRight - w - 20, y = orthoTop - h - 50;
+
+    glColor4f(0, 0, 0, 0.6f);
+    glBegin(GL_QUADS);
+    glVertex2f(x,     y);     glVertex2f(x + w, y);
+    glVertex2f(x + w, y + h); glVertex2f(x,     y + h);
+    glEnd();
+
+    glColor4f(0.2f, 1.0f, 0.3f, 0.9f);
+    drawPerfBars(perf.frameHist, x, y, h);
+    glColor4f(1.0f, 0.6f, 0.1f, 0.9f);
+    drawPerfBars(perf.tickHist, x + 1, y, h);
+
+    float budget = y + quality_budgetMs / PERF_GRAPH_MS * h;
+    float vsync  = y + 16.7f / PERF_GRAPH_MS * h;
+    glBegin(GL_LINES);
+    glColor4f(1, 1, 0, 0.6f); glVertex2f(x, budget); glVertex2f(x + w, budget);
+    glColor4f(1, 0, 0, 0.6f); glVertex2f(x, vsync);  glVertex2f(x + w, vsync);
+    glEnd();
+
+    perf.overlayMs += (float)(frameClockMs() - start);
+}
+
+// Numbers under the graph, drawn after the swap like the other HUD text
+static void drawPerfText() {
+    double start = frameClockMs();
+    float x = orthoRight - PERF_HISTORY * 2 - 20, y = orthoTop - 200;
+    char line[120];
+
+    int live = 0, pending = 0;
+    for (int i = 0; i < MAX_POWERUPS; i++) live += powerups[i].active;
+    for (int k = 0; k < TIMER_KINDS; k++)
+        for (int a = 0; a < TIMER_ARGS; a++) pending += timerExpiry((TimerKind)k, a) >= 0;
+
+    // frameHist is present to present; SUBMIT is the CPU time up to the swap
+    sprintf(line, "FRAME %.2f ms  p99 %.2f  SUBMIT %.2f", perfMean(perf.frameHist),
+            perfPercentile(perf.frameHist, 0.99f), perfMean(perf.submitHist));
+    drawText(line, x, y, 0);
+    // tickHist holds the slowest tick of each frame; mean and p99 are over those
+    sprintf(line, "TICK MAX %.3f  p99 %.3f  AI %.3f", perfMean(perf.tickHist),
+            perfPercentile(perf.tickHist, 0.99f), perf.shownAiMs);
+    drawText(line, x, y - 25, 0);
+    sprintf(line, "DRAW CALLS %u  VERTICES %u", perf.shownDrawCalls, perf.shownVertices);
+    drawText(line, x, y - 50, 0);
+    sprintf(line, "BALLS %d  POWER-UPS %d  PARTICLES %d",
+            currentMode == MODE_ARENA ? arena.balls : activeBalls, live, particle_pool.count);
+    drawText(line, x, y - 75, 0);
+    sprintf(line, "TIMERS %d  QUALITY %d%s  OVERLAY %.2f ms", pending, quality.level,
+            quality_auto ? " AUTO" : "", perf.shownOverlayMs);
+    drawText(line, x, y - 100, 0);
+
+    perf.overlayMs += (float)(frameClockMs() - start);
+}
+
+// Player k's colour: hues spread evenly round the wheel
+static void arenaColor(int k, float alpha) {
+    float h = (float)k / arena.players * 6.0f;
+    float f = h - floorf(h);
+    float r, g, b;
+    switch ((int)h % 6) {
+        case 0:  r = 1;     g = f;     b = 0;     break;
+        case 1:  r = 1 - f; g = 1;     b = 0;     break;
+        case 2:  r = 0;     g = 1;     b = f;     break;
+        case 3:  r = 0;     g = 1 - f; b = 1;     break;
+        case 4:  r = f;     g = 0;     b = 1;     break;
+        default: r = 1;     g = 0;     b = 1 - f; break;
+    }
+    glColor4f(0.3f + 0.7f * r, 0.3f + 0.7f * g, 0.3f + 0.7f * b, alpha);
+}
+
+// Polygon walls, one paddle per edge and the balls tinted by their last hitter
+void drawArena() {
+    const Arena* A = &arena;
+
+    glColor4f(0.4f, 0.4f, 0.5f, 0.8f);
+    glBegin(GL_LINE_LOOP);
+    for (int k = 0; k < A->players; k++) {
+        float a = -PI / 2 + (2.0f * k - 1) * PI / A->players;   // corner before edge k
+        glVertex2f(cosf(a) * ARENA_RADIUS, sinf(a) * ARENA_RADIUS);
+    }
+    glEnd();
+
+    glBegin(GL_QUADS);
+    for (int k = 0; k < A->players; k++) {
+        float nx = A->nx[k], ny = A->ny[k], tx = -ny, ty = nx;
+        float c = A->pos[k], w = A->paddleW / 2;
+        float in = A->apothem - paddle_height, out = A->apothem;
+        arenaColor(k, 1.0f);
+        glVertex2f(nx * in  + tx * (c - w), ny * in  + ty * (c - w));
+        glVertex2f(nx * in  + tx * (c + w), ny * in  + ty * (c + w));
+        glVertex2f(nx * out + tx * (c + w), ny * out + ty * (c + w));
+        glVertex2f(nx * out + tx * (c - w), ny * out + ty * (c - w));
+    }
+    glEnd();
+
+    // Level pieces: the capsule's body, then a disc at each end
+    glBegin(GL_QUADS);
+    for (int j = 0; j < level.pieces; j++) {
+        const Piece* p = &level.piece[j];
+        if (p->kind == PIECE_BUMPER) continue;
+        float s = p->r * sqrtf(p->invLen2), ox = -p->dy * s, oy = p->dx * s;
+        if (p->kind == PIECE_SPINNER) glColor4f(0.3f, 0.8f, 1.0f, 1.0f);
+        else glColor4f(0.55f, 0.55f, 0.65f, 1.0f);
+        glVertex2f(p->ax + ox, p->ay + oy);
+        glVertex2f(p->ax + p->dx + ox, p->ay + p->dy + oy);
+        glVertex2f(p->ax + p->dx - ox, p->ay + p->dy - oy);
+        glVertex2f(p->ax - ox, p->ay - oy);
+    }
+    glEnd();
+    for (int j = 0; j < level.pieces; j++) {
+        const Piece* p = &level.piece[j];
+        if (p->kind == PIECE_BUMPER) {
+            glColor4f(1.0f, 0.6f, 0.2f, 1.0f);
+            drawCircle(p->cx, p->cy, p->r, 20);
+            continue;
+        }
+        if (p->kind == PIECE_SPINNER) glColor4f(0.3f, 0.8f, 1.0f, 1.0f);
+        else glColor4f(0.55f, 0.55f, 0.65f, 1.0f);
+        drawCircle(p->ax, p->ay, p->r, 8);
+        drawCircle(p->ax + p->dx, p->ay + p->dy, p->r, 8);
+    }
+
+    for (int i = 0; i < A->balls; i++) {
+        if (A->lastHit[i] >= 0) arenaColor(A->lastHit[i], 1.0f);
+        else glColor4f(1, 1, 1, 1);
+        drawCircle(A->bx[i], A->by[i], ARENA_BALL_RADIUS, 16);
+    }
+}
+
+// Score beside each edge, drawn after the swap like the classic score line
+void drawArenaScores() {
+    const Arena* A = &arena;
+    char buf[64];
+    for (int k = 0; k < A->players; k++) {
+        float x = A->nx[k] * A->apothem * 0.82f, y = A->ny[k] * A->apothem * 0.82f;
+        sprintf(buf, "%s%d %d/-%d", A->human[k] ? "YOU " : "P", k + 1, A->score[k], A->conceded[k]);
+        drawText(buf, x - 30, y, 0);
+    }
+    sprintf(buf, "ARENA %d PLAYERS  %d BALLS%s", A->players, A->balls,
+            game_running ? "" : "  (SPACE TO PLAY)");
+    drawText(buf, -550, orthoTop - 30, 0);
+}
+
+void drawArenaMenu() {
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glMatrixMode(GL_PROJECTION); glLoadIdentity();
+    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
+    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+
+    glBegin(GL_QUADS);
+    glColor3f(0.1f,0.1f,0.2f); glVertex2f(orthoLeft, orthoTop);
+    glVertex2f(orthoRight, orthoTop);
+    glColor3f(0.05f,0.05f,0.1f);
+    glVertex2f(orthoRight, orthoBottom);
+    glVertex2f(orthoLeft, orthoBottom);
+    glEnd();
+
+    // Preview of the polygon for the chosen player count
+    glColor3f(0.5f,0.5f,0.8f);
+    glBegin(GL_LINE_LOOP);
+    for (int k = 0; k < arena_players; k++) {
+        float a = -PI / 2 + (2.0f * k - 1) * PI / arena_players;
+        glVertex2f(cosf(a) * 120, sinf(a) * 120 - 120);
+    }
+    glEnd();
+
+    SwapBuffers(hdc);
+
+    drawText("ARENA", -60, 300, 1);
+
+    char buf[100];
+    sprintf(buf, "PLAYERS: %d", arena_players);
+    drawText(buf, -80, 200, 1);
+
+    drawText("UP ARROW - MORE PLAYERS",   -180, 130, 0);
+    drawText("DOWN ARROW - FEWER PLAYERS", -180, 100, 0);
+    drawText("YOU GUARD THE BOTTOM EDGE WITH A/D OR LEFT/RIGHT", -300, 60, 0);
+    drawText("ENTER - START GAME",    -120, 20,  0);
+    drawText("ESC - BACK TO MENU",    -120, -10, 0);
+
+    if (level.pieces) sprintf(buf, "LEVEL: %d PIECES FROM " LEVEL_FILE, level.pieces);
+    else sprintf(buf, "OPEN ARENA (NO " LEVEL_FILE ")");
+    drawText(buf, -200, -280, 0);
+}
+
+// Mosaic tiles: every match scaled into its cell of the grid. All tiles go
+// into one triangle batch, and on a real GL the score labels into one batch
+// of quads from a glyph atlas, so a frame is the same two draw calls for 16
+// matches or 64. Detail follows the tile's size on screen: balls get 4, 8
+// or 16 segments by their radius in pixels, and labels are left out once
+// they would be too small to read.
+
+static MosaicVertex mosaic_verts[MOSAIC_MAX * MOSAIC_TILE_VERTS];
+static int mosaic_vertCount;
+
+// By BallType and PowerUpType, the base colours drawBall() and drawPowerUp() use
+static const uint8_t mosaic_ballColors[5][4] = {
+    {255, 128, 0, 255}, {255, 204, 0, 255}, {153, 204, 255, 255}, {204, 0, 204, 255}, {255, 128, 0, 255}
+};
+static const uint8_t mosaic_powerUpColors[8][4] = {
+    {179, 179, 179, 255}, {0, 255, 0, 255}, {0, 128, 255, 255}, {255, 255, 0, 255},
+    {255, 0, 255, 255}, {128, 128, 255, 255}, {204, 204, 204, 255}, {255, 128, 0, 255}
+};
+
+static void mosaicPut(float x, float y, const uint8_t* rgba) {
+    MosaicVertex* v = &mosaic_verts[mosaic_vertCount++];
+    v->x = x;
+    v->y = y;
+    v->u = v->v = 0;
+    memcpy(v->rgba, rgba, 4);
+}
+
+// Axis-aligned rectangle as two triangles, bottom edge lo and top edge hi
+static void mosaicRect(float x0, float y0, float x1, float y1, const uint8_t* lo, const uint8_t* hi) {
+    mosaicPut(x0, y0, lo); mosaicPut(x1, y0, lo); mosaicPut(x1, y1, hi);
+    mosaicPut(x0, y0, lo); mosaicPut(x1, y1, hi); mosaicPut(x0, y1, hi);
+}
+
+static void mosaicDisc(float cx, float cy, float r, int segments, const uint8_t* rgba) {
+    float px = cx + r, py = cy;
+    for (int i = 1; i <= segments; i++) {
+        float a = 2.0f * PI * i / segments;
+        float qx = cx + cosf(a) * r, qy = cy + sinf(a) * r;
+        mosaicPut(cx, cy, rgba); mosaicPut(px, py, rgba); mosaicPut(qx, qy, rgba);
+        px = qx;
+        py = qy;
+    }
+}
+
+// Tiles keep the window's shape: a match is drawn at this fraction of it
+static float mosaicScale() {
+    return 1.0f / (mosaic.cols > mosaic.rows ? mosaic.cols : mosaic.rows);
+}
+
+// Where tile i sits: world (x, y) of the match lands at (ox + x * s, oy + y * s)
+static void mosaicTile(int i, float* ox, float* oy, float* s) {
+    float w = orthoRight - orthoLeft, h = orthoTop - orthoBottom;
+    float cx = orthoLeft + (i % mosaic.cols + 0.5f) * w / mosaic.cols;
+    float cy = orthoTop  - (i / mosaic.cols + 0.5f) * h / mosaic.rows;
+    *s = mosaicScale();
+    *ox = cx - (orthoLeft + orthoRight) * 0.5f * *s;
+    *oy = cy - (orthoBottom + orthoTop) * 0.5f * *s;
+}
+
+// Label cell height in pixels for the current grid, 0 = too small to draw
+static int mosaicLabelHeight() {
+    int h = (int)(windowHeight * mosaicScale() / 6);
+    if (h > GLYPH_H) h = GLYPH_H;
+    return h < 8 ? 0 : h;
+}
+
+// Centre line, paddles, power-ups and balls of one match. No background:
+// like display() the tiles are the cleared frame, so a tile costs pixels
+// only where something is drawn.
+static void mosaicTileGeometry(const MatchState* m, float ox, float oy, float s, float pixel) {
+    static const uint8_t line[4] = {90, 90, 90, 255};
+    static const uint8_t blueLo[4] = {51, 102, 255, 255}, blueHi[4] = {26, 51, 204, 255};
+    static const uint8_t redLo[4] = {255, 102, 51, 255}, redHi[4] = {204, 51, 26, 255};
+
+    float lineH = 2.0f * s > pixel * 0.5f ? 2.0f * s : pixel * 0.5f;
+    mosaicRect(ox + (orthoLeft + 20) * s, oy - lineH, ox + (orthoRight - 20) * s, oy + lineH, line, line);
+
+    float h = (float)m->paddleHeight;
+    for (int p = 0; p < 2; p++) {
+        float w = m->bigPaddle[p] ? m->paddleWidth * 1.5f : (float)m->paddleWidth;
+        float x = m->paddleX[p];
+        if (x < orthoLeft + w / 2)  x = orthoLeft + w / 2;
+        if (x > orthoRight - w / 2) x = orthoRight - w / 2;
+        float y0 = p == 0 ? orthoBottom : orthoTop - 2 * h;
+        mosaicRect(ox + (x - w / 2) * s, oy + y0 * s, ox + (x + w / 2) * s, oy + (y0 + 2 * h) * s,
+                   p == 0 ? blueLo : redLo, p == 0 ? blueHi : redHi);
+    }
+
+    for (int k = 0; k < MAX_POWERUPS; k++) {
+        const PowerUp* u = &m->powerups[k];
+        if (!u->active) continue;
+        const uint8_t* c = mosaic_powerUpColors[(unsigned)u->type < 8 ? u->type : 0];
+        mosaicRect(ox + (u->x - 10) * s, oy + (u->y - 10) * s, ox + (u->x + 10) * s, oy + (u->y + 10) * s, c, c);
+    }
+
+    for (int k = 0; k < 3; k++) {
+        const Ball* b = &m->balls[k];
+        if (!b->active) continue;
+        float r = b->radius * s, rPixels = r / pixel;
+        int segments = rPixels < 3 ? 4 : (rPixels < 8 ? 8 : 16);
+        mosaicDisc(ox + b->x * s, oy + b->y * s, r, segments, mosaic_ballColors[(unsigned)b->type < 5 ? b->type : 0]);
+    }
+}
+
+#ifdef PONG_REAL_GL
+static MosaicVertex mosaic_glyphs[MOSAIC_MAX * MOSAIC_LABEL * 4];
+
+// The glyphs.h atlas texture. EGL builds already have it for TextOutA;
+// under WGL (text through GDI) it is made on the first mosaic frame.
+static GLuint mosaicAtlas() {
+#ifdef PONG_EGLRENDER
+    return eg_fontTexture;
+#else
+    static GLuint atlas = 0;
+    if (!atlas) {
+        static uint8_t alpha[GLYPH_ATLAS_H][GLYPH_ATLAS_W];
+        glyphAtlasPixels(alpha);
+        glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, GLYPH_ATLAS_W, GLYPH_ATLAS_H, 0, GL_ALPHA, GL_UNSIGNED_BYTE, alpha);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return atlas;
+#endif
+}
+
+// Text as atlas quads; (x, y) is the top-left corner, h the cell height,
+// all in world units. Returns the new quad count.
+static int mosaicLabel(int n, const char* text, float x, float y, float h) {
+    static const uint8_t white[4] = {255, 255, 255, 255};
+    float adv = h * GLYPH_W / GLYPH_H;
+    for (const char* p = text; *p; p++, x += adv) {
+        unsigned ch = (unsigned char)*p;
+        if (ch == ' ') continue;
+        if (ch < 32 || ch > 126) ch = '?';
+        float u0, v0, u1, v1;
+        glyphAtlasCell(ch - 32, &u0, &v0, &u1, &v1);
+        MosaicVertex* q = &mosaic_glyphs[n++ * 4];
+        float xs[4] = {x, x + adv, x + adv, x}, ys[4] = {y, y, y - h, y - h};
+        float us[4] = {u0, u1, u1, u0}, vs[4] = {v0, v0, v1, v1};
+        for (int k = 0; k < 4; k++) {
+            q[k].x = xs[k]; q[k].y = ys[k];
+            q[k].u = us[k]; q[k].v = vs[k];
+            memcpy(q[k].rgba, white, 4);
+        }
+    }
+    return n;
+}
+#endif
+
+// Hand a batch to GL: one glDrawArrays on a real driver; softgl has no
+// vertex arrays and takes SW_MAX_VERTS a glBegin, in whole primitives
+static void mosaicSubmit(const MosaicVertex* v, int count, GLenum mode, int textured) {
+    if (!count) return;
+#ifdef PONG_REAL_GL
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(MosaicVertex), &v->x);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(MosaicVertex), v->rgba);
+    if (textured) {
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(MosaicVertex), &v->u);
+    }
+    glDrawArrays(mode, 0, count);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    perf.drawCalls++;
+    perf.vertices += count;
+#else
+    (void)textured;
+    int per = mode == GL_QUADS ? 4 : 3;
+    int chunk = SW_MAX_VERTS - SW_MAX_VERTS % per;
+    for (int first = 0; first < count; first += chunk) {
+        int end = first + chunk < count ? first + chunk : count;
+        glBegin(mode);
+        for (int i = first; i < end; i++) {
+            glColor4f(v[i].rgba[0] / 255.0f, v[i].rgba[1] / 255.0f, v[i].rgba[2] / 255.0f, v[i].rgba[3] / 255.0f);
+            glVertex2f(v[i].x, v[i].y);
+        }
+        glEnd();
+    }
+#endif
+}
+
+// The mosaic_naive baseline: every tile through its own viewport and
+// projection and the same per-object draw functions display() uses
+static void drawMosaicNaive() {
+    float w = windowWidth * mosaicScale(), h = windowHeight * mosaicScale();
+    int running = game_running;
+    for (int i = 0; i < mosaic.count; i++) {
+        float cx = (i % mosaic.cols + 0.5f) * windowWidth / mosaic.cols;
+        float cy = (mosaic.rows - i / mosaic.cols - 0.5f) * windowHeight / mosaic.rows;
+        glViewport((int)(cx - w / 2), (int)(cy - h / 2), (int)w, (int)h);
+        glMatrixMode(GL_PROJECTION); glLoadIdentity();
+        glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
+        glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+
+        matchLoad(&mosaic.match[i]);
+        drawCenterLine();
+        drawPaddle(player1_paddle_x, 0, player1_big_paddle, 1);
+        drawPaddle(player2_paddle_x, 0, player2_big_paddle, 2);
+        for (int k = 0; k < 3; k++) drawBall(&balls[k]);
+        for (int k = 0; k < MAX_POWERUPS; k++) drawPowerUp(k);
+    }
+    glViewport(0, 0, windowWidth, windowHeight);
+    glMatrixMode(GL_PROJECTION); glLoadIdentity();
+    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
+    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+    mosaicRestore();
+    game_running = running;
+}
+
+// Everything before the swap; display() has cleared and set the projection
+void drawMosaic() {
+    if (mosaic_naive) { drawMosaicNaive(); return; }
+
+    static const uint8_t grid[4] = {64, 64, 102, 255};
+    float pixel = (orthoRight - orthoLeft) / windowWidth;
+    mosaic_vertCount = 0;
+
+    // Cell borders, a pixel wide; no more of them than there are tiles
+    for (int c = 1; c < mosaic.cols; c++) {
+        float x = orthoLeft + c * (orthoRight - orthoLeft) / mosaic.cols;
+        mosaicRect(x - pixel * 0.5f, orthoBottom, x + pixel * 0.5f, orthoTop, grid, grid);
+    }
+    for (int r = 1; r < mosaic.rows; r++) {
+        float y = orthoTop - r * (orthoTop - orthoBottom) / mosaic.rows;
+        mosaicRect(orthoLeft, y - pixel * 0.5f, orthoRight, y + pixel * 0.5f, grid, grid);
+    }
+
+    for (int i = 0; i < mosaic.count; i++) {
+        float ox, oy, s;
+        mosaicTile(i, &ox, &oy, &s);
+        mosaicTileGeometry(&mosaic.match[i], ox, oy, s, pixel);
+    }
+    mosaicSubmit(mosaic_verts, mosaic_vertCount, GL_TRIANGLES, 0);
+
+#ifdef PONG_REAL_GL
+    int labelPixels = mosaicLabelHeight();
+    if (!labelPixels) return;
+    GLuint atlas = mosaicAtlas();
+
+    int quads = 0;
+    char text[MOSAIC_LABEL + 1];
+    for (int i = 0; i < mosaic.count; i++) {
+        float ox, oy, s;
+        mosaicTile(i, &ox, &oy, &s);
+        const MatchState* m = &mosaic.match[i];
+        snprintf(text, sizeof(text), "%d:%d", m->score[0], m->score[1]);
+        quads = mosaicLabel(quads, text, ox + orthoLeft * s + 4 * pixel, oy + orthoTop * s - 3 * pixel,
+                            labelPixels * pixel);
+    }
+
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+    glDisable(GL_BLEND);
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GREATER, 0.5f);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    mosaicSubmit(mosaic_glyphs, quads * 4, GL_QUADS, 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPopAttrib();
+#endif
+}
+
+// After the swap: the labels drawText() has to draw, one call per tile. On
+// a real GL that is only the naive baseline; softgl has no textures, so
+// there labels come through GDI when the tiles have room for its 24 px face.
+void drawMosaicText() {
+#ifdef PONG_REAL_GL
+    if (!mosaic_naive) return;
+#else
+    if (!mosaic_naive && mosaicLabelHeight() < GLYPH_H) return;
+#endif
+    float pixel = (orthoRight - orthoLeft) / windowWidth;
+    char text[MOSAIC_LABEL + 1];
+    for (int i = 0; i < mosaic.count; i++) {
+        float ox, oy, s;
+        mosaicTile(i, &ox, &oy, &s);
+        snprintf(text, sizeof(text), "%d:%d", mosaic.match[i].score[0], mosaic.match[i].score[1]);
+        drawText(text, ox + orthoLeft * s + 4 * pixel, oy + orthoTop * s - (3 + GLYPH_H) * pixel, 0);
+    }
+}
+
+// Finish a gameplay frame: charge its cost to the quality governor, draw
+// the overlay, present, and note when the frame went out for the overlay.
+// The cost is the CPU time to here or the GPU time of the frame's GL work,
+// whichever is longer; a vsync wait inside SwapBuffers() counts as
+// neither. The overlay is drawn after the measurement and left out of it.
+static void presentFrame(double frameStart) {
+    double frameMs = frameClockMs() - frameStart;
+    float gpuMs = gpuTimerEnd();
+    if (perf.on) drawPerfOverlay(frameMs);
+    qualityFrame(fmaxf((float)frameMs, gpuMs));
+    SwapBuffers(hdc);
+    perfPresent();
+}
+
+// Main rendering when in gameplay mode
+void display() {
+    if (currentMode == MODE_MENU)           { drawMenu(); return; }
+    if (currentMode == MODE_DIFFICULTY_SELECT) { drawDifficultyMenu(); return; }
+    if (currentMode == MODE_SPEED_SELECT)   { drawSpeedMenu(); return; }
+    if (currentMode == MODE_ARENA_SELECT)   { drawArenaMenu(); return; }
+
+    double frameStart = frameClockMs();
+    perf.drawCalls = perf.vertices = 0;
+    gpuTimerBegin();
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glMatrixMode(GL_PROJECTION); glLoadIdentity();
+    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
+    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+
+    if (currentMode == MODE_ARENA) {
+        drawArena();
+        presentFrame(frameStart);
+        drawArenaScores();
+        if (perf.on) drawPerfText();
+        return;
+    }
+    if (currentMode == MODE_MOSAIC) {
+        drawMosaic();
+        presentFrame(frameStart);
+        drawMosaicText();
+        if (perf.on) drawPerfText();
+        return;
+    }
+
+    drawCenterLine();
+    float paddle1 = latchedPaddleX(1), paddle2 = latchedPaddleX(2);
+    drawPaddle(paddle1, 0, player1_big_paddle, 1);
+    drawPaddle(paddle2, 0, player2_big_paddle, 2);
+
+    if (!drawShadedEffects()) {
+        for (int i = 0; i < 3; i++)
+            if (balls[i].active) {
+                drawTrail(i);
+                drawBall(&balls[i]);
+            }
+
+        for (int i = 0; i < MAX_POWERUPS; i++)
+            if (powerups[i].active)
+                drawPowerUp(i);
+    }
+
+    drawParticles();
+    presentFrame(frameStart);
+    latencyPresent(paddle1, paddle2);
+
+    char s1[50], s2[50];
+    sprintf(s1, "PLAYER 1: %d", player1_score);
+    sprintf(s2, "PLAYER 2: %d", player2_score);
+    drawText(s1, -550, orthoBottom + 30, 0);
+    drawText(s2, -550, orthoTop - 30, 0);
+
+    if (latency.on) {
+        char s3[120];
+        if (latency.samples)
+            sprintf(s3, "LATCH %s  INPUT-TO-PRESENT avg %.1f  p50 %d  p99 %d ms  (%u samples, %u dropped)",
+                    late_latch ? "ON" : "OFF", latency.sumMs / latency.samples,
+                    latencyPercentile(0.5f), latencyPercentile(0.99f), latency.samples, latency.dropped);
+        else
+            sprintf(s3, "LATCH %s  INPUT-TO-PRESENT: move a paddle", late_latch ? "ON" : "OFF");
+        drawText(s3, -550, orthoBottom + 60, 0);
+    }
+
+    if (perf.on) drawPerfText();
+}
+
+// Fancy animated main menu
+void drawMenu() {
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glMatrixMode(GL_PROJECTION); glLoadIdentity();
+    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
+    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+
+    float t = animation_time;
+
+    glBegin(GL_QUADS);
+    glColor3f(0.1f + 0.05f*sinf(t*0.5f), 0.1f + 0.05f*sinf(t*0.7f+1), 0.2f + 0.05f*sinf(t*0.3f+2));
+    glVertex2f(orthoLeft, orthoTop);
+
+    glColor3f(0.15f + 0.05f*sinf(t*0.6f), 0.15f + 0.05f*sinf(t*0.8f+0.5f), 0.25f + 0.05f*sinf(t*0.4f+1.5f));
+    glVertex2f(orthoRight, orthoTop);
+
+    glColor3f(0.05f + 0.05f*sinf(t*0.4f), 0.05f + 0.05f*sinf(t*0.6f+2), 0.15f + 0.05f*sinf(t*0.2f+3));
+    glVertex2f(orthoRight, orthoBottom);
+
+    glColor3f(0.0f + 0.05f*sinf(t*0.3f), 0.0f + 0.05f*sinf(t*0.5f+1.5f), 0.1f + 0.05f*sinf(t*0.1f+2.5f));
+    glVertex2f(orthoLeft, orthoBottom);
+    glEnd();
+
+    SwapBuffers(hdc);
+
+    drawText("PING PONG", -80, 300, 1);
+
+    const char* items[] = {
+        "1 - PLAYER VS PLAYER",
+        "2 - PLAYER VS COMPUTER",
+        "3 - SELECT BALL SPEED (PvP)",
+        "4 - ARENA (4-16 PLAYERS)",
+        "5 - MOSAIC (16-64 AI MATCHES)"
+    };
+    float ys[] = {150, 100, 50, 0, -50};
+
+    for (int i = 0; i < 5; i++)
+        drawText(items[i], -180, ys[i], 0);
+
+    drawText("PRESS SPACE TO START SELECTED GAME", -250, -200, 0);
+    drawText("ESC - EXIT", -180, -230, 0);
+
+    char buf[100];
+    sprintf(buf, "ACHIEVEMENTS: %d/%d   MAX SPEED: %.1f   HITS: %d",
+            achievements_unlocked, ACHIEVEMENT_COUNT, max_ball_speed, lifetime_hits);
+    drawText(buf, -200, 380, 0);
+}
+#endif // PONG_DRAWING
+
+// Main game loop logic — physics, collisions, scoring
+void update() {
+    if (!game_running) return;
+    if (currentMode == MODE_ARENA) {
+        updateArena();
+        redraw();
+        return;
+    }
+    if (currentMode == MODE_MOSAIC) {
+        mosaicStep();
+        redraw();
+        return;
+    }
+    shareInput();
+    if (fixed_physics) {
+        updateFixed();
+        sharePublish();
+        redraw();
+        return;
+    }
+
+    needsRedraw = 1;
+    float dt = 0.016f * slow_time_factor;
+
+    replayTick();
+    updateControls(dt);
+    updatePowerUps();
+    timerAdvance(sim_tick);
+    if (sim_cosmetics) {
+        updateParticles();
+        animation_time += dt;
+    }
+    sim_tick++;
+
+    for (int i = 0; i < 3; i++) {
+        if (!balls[i].active) continue;
+        Ball* b = &balls[i];
+
+        float n = (float)(sim_tick - b->originTick);
+        b->x = b->originX + b->vx * n;
+        b->y = b->originY + b->vy * n;
+
+        if (sim_cosmetics) updateTrail(i);
+
+        float spd = sqrtf(b->vx*b->vx + b->vy*b->vy);
+        if (spd > match_top_speed) match_top_speed = spd;
+        if (spd > max_ball_speed) {
+            max_ball_speed = spd;
+            uint32_t bits;
+            memcpy(&bits, &spd, sizeof(bits));
+            profileRecord(PREC_STAT, PSTAT_MAX_SPEED, bits);
+            raiseGameEvent(GE_BALL_SPEED, (int)spd);
+        }
+
+        // Left/right wall bounce
+        if (b->x + b->radius > orthoRight) {
+            b->x = orthoRight - b->radius;
+            b->vx = -b->vx;
+            anchorBall(b);
+            addParticle(b->x, b->y, 1,1,1);
+            playSound(300,50);
+        }
+        if (b->x - b->radius < orthoLeft) {
+            b->x = orthoLeft + b->radius;
+            b->vx = -b->vx;
+            anchorBall(b);
+            addParticle(b->x, b->y, 1,1,1);
+            playSound(300,50);
+        }
+
+        checkPowerUpCollision(b);
+
+        float p1y = orthoBottom + paddle_height;
+        float p2y = orthoTop    - paddle_height;
+
+        // Bottom paddle hit
+        int w = player1_big_paddle ? (int)(paddle_width*1.5f) : paddle_width;
+        if (b->y - b->radius < p1y + paddle_height && b->vy < 0) {
+            if (b->x >= player1_paddle_x - w/2 && b->x <= player1_paddle_x + w/2) {
+                b->y = p1y + paddle_height + b->radius;
+
+                float hit = (b->x - player1_paddle_x) / (w / 2.0f);
+                historyHit(1, hit);
+
+                float base = fabsf(b->vy);
+                b->vy = base * 1.2f;
+                b->vx = hit * 8.0f + b->vx * 0.5f;
+
+                float len = sqrtf(b->vx*b->vx + b->vy*b->vy);
+                float maxS = (currentMode == MODE_PVP) ? 25.0f : 30.0f;
+
+                if (len > maxS) {
+                    b->vx = (b->vx / len) * maxS;
+                    b->vy = (b->vy / len) * maxS;
+                } else {
+                    b->vx *= 1.05f;
+                    b->vy *= 1.05f;
+                }
+                anchorBall(b);
+            }
+        }
+
+        // Top paddle hit
+        w = player2_big_paddle ? (int)(paddle_width*1.5f) : paddle_width;
+        if (b->y + b->radius > p2y - paddle_height && b->vy > 0) {
+            if (b->x >= player2_paddle_x - w/2 && b->x <= player2_paddle_x + w/2) {
+                b->y = p2y - paddle_height - b->radius;
+
+                float hit = (b->x - player2_paddle_x) / (w / 2.0f);
+                historyHit(2, hit);
+
+                b->vy = -fabsf(b->vy) - 1.5f;
+                b->vx += hit * 3.0f;
+
+                float len = sqrtf(b->vx*b->vx + b->vy*b->vy);
+                b->vx = (b->vx / len) * ball_speed;
+                b->vy = (b->vy / len) * ball_speed;
+
+                consecutive_hits++;
+                if (consecutive_hits > match_rally) match_rally = consecutive_hits;
+                total_hits++;
+                lifetime_hits++;
+                profileRecord(PREC_STAT, PSTAT_HITS, (uint32_t)lifetime_hits);
+                raiseGameEvent(GE_PADDLE_HIT, consecutive_hits);
+                if (consecutive_hits >= 3) {
+                    combo_multiplier = 2;
+                    timerAt(sim_tick - 1 + countdownTicks(3.0f), TIMER_COMBO, 0);
+                }
+
+                switch (b->type) {
+                    case BALL_FIRE:    addParticle(b->x,b->y,1,0,0); ball_speed += 0.5f; break;
+                    case BALL_ICE:     player1_paddle_speed = 0.5f; addParticle(b->x,b->y,0.5f,0.8f,1); break;
+                    case BALL_MAGNETIC:b->vx += (player2_paddle_x - b->x) * 0.1f; break;
+                    default: break;
+                }
+                anchorBall(b);
+
+                addParticle(b->x, b->y, 1.0f, 0.2f, 0.1f);
+                playSound(500 + (int)(fabsf(hit)*200), 100);
+            }
+        }
+
+        // Score & respawn logic
+        if (b->y < orthoBottom) {
+            player2_score += combo_multiplier;
+            raiseGameEvent(GE_POINT_P2, combo_multiplier);
+            historyPoint(2, combo_multiplier, 0);
+            b->active = 0;
+            activeBalls--;
+            if (activeBalls <= 0) {
+                resetBall(&balls[0]);
+                balls[0].active = 1;
+                activeBalls = 1;
+            }
+            combo_multiplier = 1;
+            consecutive_hits = 0;
+            playSound(200,200);
+        }
+
+        if (b->y > orthoTop) {
+            player1_score += combo_multiplier;
+            raiseGameEvent(GE_POINT_P1, combo_multiplier);
+            historyPoint(1, combo_multiplier, 0);
+            b->active = 0;
+            activeBalls--;
+            if (activeBalls <= 0) {
+                resetBall(&balls[0]);
+                balls[0].active = 1;
+                activeBalls = 1;
+            }
+            combo_multiplier = 1;
+            consecutive_hits = 0;
+            playSound(200,200);
+        }
+    }
+
+    if (match_win_tick < 0 && currentMode == MODE_PVC && currentDifficulty == DIFFICULTY_HARD &&
+        player1_score >= LEADER_WIN_POINTS && player2_score < LEADER_WIN_POINTS)
+        match_win_tick = sim_tick;
+
+    sharePublish();
+    if (needsRedraw) redraw();
+}
 
-                case POWERUP_FAST_PADDLE:
-                    if (ball->vy > 0) player1_paddle_speed = 1.5f;
-                    else              player2_paddle_speed = 1.5f;
-                    playSound(900,200);
-                    break;
+//              Arena level
 
-                case POWERUP_INVISIBLE_BALL:
-                    ball->type = BALL_NORMAL;
-                    ball->effectTimer = 5.0f;
-                    playSound(500,200);
-                    break;
+// Plain compares: box updates run per spinner per tick, and fminf() is a
+// libm call that also sorts out NaNs, which bounds never hold
+static inline float boxMin(float a, float b) { return a < b ? a : b; }
+static inline float boxMax(float a, float b) { return a > b ? a : b; }
 
-                case POWERUP_SPLIT_BALL:
-                    for (int j = 0; j < 3; j++) {
-                        if (!balls[j].active && activeBalls < 3) {
-                            balls[j].active = 1;
-                            balls[j].x = ball->x;
-                            balls[j].y = ball->y;
-                            balls[j].vx = -ball->vx;
-                            balls[j].vy = -ball->vy;
-                            balls[j].radius = ball->radius;
-                            balls[j].type = ball->type;
-                            activeBalls++;
-                            break;
-                        }
-                    }
-                    playSound(1200,200);
-                    break;
-            }
+static void pieceBounds(Piece* p) {
+    float x1 = p->ax + p->dx, y1 = p->ay + p->dy;
+    p->minX = boxMin(p->ax, x1) - p->r;
+    p->maxX = boxMax(p->ax, x1) + p->r;
+    p->minY = boxMin(p->ay, y1) - p->r;
+    p->maxY = boxMax(p->ay, y1) + p->r;
+}
 
-            powerups[i].active = 0;
-            needsRedraw = 1;
-            checkAchievements();
-        }
+// Lay the segment out from the centre, half length and angle
+static void piecePlace(Piece* p) {
+    float c = cosf(p->angle) * p->half, s = sinf(p->angle) * p->half;
+    p->ax = p->cx - c;
+    p->ay = p->cy - s;
+    p->dx = 2 * c;
+    p->dy = 2 * s;
+    p->invLen2 = p->half > 0 ? 1.0f / (p->dx * p->dx + p->dy * p->dy) : 0;
+    pieceBounds(p);
+}
+
+static void levelAdd(PieceKind kind, float cx, float cy, float half, float angle, float spin, float r) {
+    if (level.pieces >= LEVEL_MAX_PIECES) return;
+    Piece* p = &level.piece[level.pieces++];
+    memset(p, 0, sizeof(*p));
+    p->kind = (uint8_t)kind;
+    p->cx = cx;
+    p->cy = cy;
+    p->half = half;
+    p->angle = p->angle0 = angle;
+    p->spin = spin;
+    p->r = fmaxf(r, LEVEL_MIN_RADIUS);
+    piecePlace(p);
+}
+
+static void bvhLeafBounds(BvhNode* n) {
+    n->minX = n->minY = 1e30f;
+    n->maxX = n->maxY = -1e30f;
+    for (int j = n->first; j < n->first + n->count; j++) {
+        const Piece* p = &level.piece[level.order[j]];
+        n->minX = boxMin(n->minX, p->minX);
+        n->minY = boxMin(n->minY, p->minY);
+        n->maxX = boxMax(n->maxX, p->maxX);
+        n->maxY = boxMax(n->maxY, p->maxY);
     }
 }
 
-// Manage power-up timers and spawning
-void updatePowerUps() {
-    powerup_timer += 0.016f;
-    if (powerup_timer >= 8.0f) {
-        spawnPowerUp();
-        powerup_timer = 0.0f;
+static void bvhUnion(BvhNode* n) {
+    const BvhNode* a = &level.node[n->left];
+    const BvhNode* b = &level.node[n->right];
+    n->minX = boxMin(a->minX, b->minX);
+    n->minY = boxMin(a->minY, b->minY);
+    n->maxX = boxMax(a->maxX, b->maxX);
+    n->maxY = boxMax(a->maxY, b->maxY);
+}
+
+static int bvh_axis;    // 0 = x, 1 = y, for bvhCompare during a build
+
+static int bvhCompare(const void* a, const void* b) {
+    int i = *(const uint16_t*)a, j = *(const uint16_t*)b;
+    const Piece* p = &level.piece[i];
+    const Piece* q = &level.piece[j];
+    float u = bvh_axis ? p->cy : p->cx, v = bvh_axis ? q->cy : q->cx;
+    if (u != v) return u < v ? -1 : 1;
+    return i - j;
+}
+
+// Split pieces [first, first + count) of level.order at the median centre
+// along the wider side, down to BVH_LEAF a leaf. Children always get higher
+// ids than their parent.
+static int bvhBuild(int first, int count, int parent) {
+    int id = level.nodes++;
+    BvhNode* n = &level.node[id];
+    n->parent = parent;
+    n->depth = parent < 0 ? 0 : level.node[parent].depth + 1;
+    n->first = first;
+    n->count = count;
+    n->left = n->right = -1;
+    bvhLeafBounds(n);
+    if (count <= BVH_LEAF) {
+        for (int j = first; j < first + count; j++) level.leafOf[level.order[j]] = (uint16_t)id;
+        return id;
     }
 
-    for (int i = 0; i < MAX_POWERUPS; i++) {
-        if (powerups[i].active) {
-            powerups[i].size = 0.8f + sinf(animation_time * 3.0f + i) * 0.2f;
-            powerups[i].rotation += 1.0f;
-        }
+    float lo[2] = {1e30f, 1e30f}, hi[2] = {-1e30f, -1e30f};
+    for (int j = first; j < first + count; j++) {
+        const Piece* p = &level.piece[level.order[j]];
+        lo[0] = boxMin(lo[0], p->cx); hi[0] = boxMax(hi[0], p->cx);
+        lo[1] = boxMin(lo[1], p->cy); hi[1] = boxMax(hi[1], p->cy);
     }
+    bvh_axis = hi[1] - lo[1] > hi[0] - lo[0];
+    qsort(level.order + first, count, sizeof(level.order[0]), bvhCompare);
+
+    int left = bvhBuild(first, count / 2, id);
+    int right = bvhBuild(first + count / 2, count - count / 2, id);
+    n = &level.node[id];
+    n->left = left;
+    n->right = right;
+    n->count = 0;
+    return id;
+}
 
-    if (powerup_duration > 0) {
-        powerup_duration -= 0.016f;
-        if (powerup_duration <= 0)
-            player1_big_paddle = player2_big_paddle = 0;
+// Every box from its pieces, leaves first
+static void bvhRefitAll() {
+    for (int id = level.nodes - 1; id >= 0; id--) {
+        BvhNode* n = &level.node[id];
+        if (n->left < 0) bvhLeafBounds(n);
+        else bvhUnion(n);
     }
+}
 
-    if (slow_time_timer > 0) {
-        slow_time_timer -= 0.016f;
-        if (slow_time_timer <= 0)
-            slow_time_factor = 1.0f;
+static void levelBuild() {
+    level.nodes = level.movers = 0;
+    for (int i = 0; i < level.pieces; i++) {
+        level.order[i] = (uint16_t)i;
+        if (level.piece[i].spin != 0) level.mover[level.movers++] = (uint16_t)i;
     }
+    if (level.pieces) bvhBuild(0, level.pieces, -1);
 }
 
-void updateCombo() {
-    if (combo_timer > 0) {
-        combo_timer -= 0.016f;
-        if (combo_timer <= 0) {
-            combo_multiplier = 1;
-            consecutive_hits = 0;
-            needsRedraw = 1;
-        }
+void levelClear() {
+    level.pieces = level.movers = level.nodes = 0;
+}
+
+// One piece a line, # starts a comment. Arena units from the centre (the
+// polygon's corners are ARENA_RADIUS out), thickness is the full width:
+//   bumper  x y radius
+//   wall    x0 y0 x1 y1 [thickness]
+//   spinner x y length degrees_per_second [thickness]
+// Unknown or short lines are skipped. Returns the number of pieces, or -1
+// (and no pieces) if the file can't be read.
+int levelLoad(const char* path) {
+    levelClear();
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[256], kind[16] = "";
+    while (fgets(line, sizeof(line), f)) {
+        char* comment = strchr(line, '#');
+        if (comment) *comment = 0;
+        float v[5] = {0};
+        int n = sscanf(line, "%15s %f %f %f %f %f", kind, &v[0], &v[1], &v[2], &v[3], &v[4]) - 1;
+        if (!strcmp(kind, "bumper") && n >= 3)
+            levelAdd(PIECE_BUMPER, v[0], v[1], 0, 0, 0, v[2]);
+        else if (!strcmp(kind, "wall") && n >= 4)
+            levelAdd(PIECE_WALL, (v[0] + v[2]) / 2, (v[1] + v[3]) / 2,
+                     hypotf(v[2] - v[0], v[3] - v[1]) / 2, atan2f(v[3] - v[1], v[2] - v[0]), 0,
+                     (n >= 5 ? v[4] : 8) / 2);
+        else if (!strcmp(kind, "spinner") && n >= 4)
+            levelAdd(PIECE_SPINNER, v[0], v[1], v[2] / 2, 0, v[3] * PI / 180 * 0.016f,
+                     (n >= 5 ? v[4] : 8) / 2);
+        kind[0] = 0;
     }
+    fclose(f);
+    levelBuild();
+    return level.pieces;
 }
 
-void redraw() {
-    InvalidateRect(hwnd, NULL, FALSE);
+// A random mix of pieces over the ring from 60 units out to radius, for
+// benchmarks. Draws from its own generator, so rand() is left alone.
+void levelScatter(int pieces, unsigned seed, float radius) {
+    levelClear();
+    unsigned s = seed;
+    #define SCATTER_RAND() ((s = s * 1103515245u + 12345u) >> 16 & 0x7FFF) / 32767.0f
+    for (int i = 0; i < pieces; i++) {
+        float d = 60 + (radius - 60) * sqrtf(SCATTER_RAND());
+        float a = SCATTER_RAND() * 2 * PI;
+        float kind = SCATTER_RAND(), size = SCATTER_RAND(), turn = SCATTER_RAND() * PI;
+        float x = cosf(a) * d, y = sinf(a) * d;
+        if (kind < 0.5f)
+            levelAdd(PIECE_BUMPER, x, y, 0, 0, 0, 6 + size * 8);
+        else if (kind < 0.85f)
+            levelAdd(PIECE_WALL, x, y, 10 + size * 25, turn, 0, 3);
+        else
+            levelAdd(PIECE_SPINNER, x, y, 15 + size * 25, turn,
+                     (size < 0.5f ? -1 : 1) * (30 + size * 90) * PI / 180 * 0.016f, 3);
+    }
+    #undef SCATTER_RAND
+    levelBuild();
 }
 
-//              Menu screens
+// Spinners back to where the level put them, for a new match
+static void levelReset() {
+    for (int m = 0; m < level.movers; m++) {
+        Piece* p = &level.piece[level.mover[m]];
+        p->angle = p->angle0;
+        piecePlace(p);
+    }
+    bvhRefitAll();
+}
 
-void drawDifficultyMenu() {
-    glClear(GL_COLOR_BUFFER_BIT);
+// Turn the spinners, then refit the boxes on the paths from their leaves
+// to the root, each box once and deepest first so children are done before
+// their parent; the rest of the tree doesn't move
+static void levelStep() {
+    for (int m = 0; m < level.movers; m++) {
+        Piece* p = &level.piece[level.mover[m]];
+        p->angle += p->spin;
+        if (p->angle > PI) p->angle -= 2 * PI;
+        else if (p->angle < -PI) p->angle += 2 * PI;
+        piecePlace(p);
+    }
+    int n = 0, at[BVH_DEPTH + 1] = {0};
+    for (int m = 0; m < level.movers; m++) {
+        for (int id = level.leafOf[level.mover[m]]; id >= 0 && !level.stale[id]; id = level.node[id].parent) {
+            level.stale[id] = 1;
+            level.marked[n++] = (uint16_t)id;
+            at[level.node[id].depth]++;
+        }
+    }
+    for (int d = 0, sum = 0; d <= BVH_DEPTH; d++) {     // counting sort, deepest first
+        int c = at[BVH_DEPTH - d];
+        at[BVH_DEPTH - d] = sum;
+        sum += c;
+    }
+    for (int k = 0; k < n; k++) level.refit[at[level.node[level.marked[k]].depth]++] = level.marked[k];
+    for (int k = 0; k < n; k++) {
+        BvhNode* node = &level.node[level.refit[k]];
+        if (node->left < 0) bvhLeafBounds(node);
+        else bvhUnion(node);
+        level.stale[level.refit[k]] = 0;
+    }
+}
 
-    glMatrixMode(GL_PROJECTION); glLoadIdentity();
-    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
-    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+static int pieceTouches(const Piece* p, float x, float y) {
+    float t = ((x - p->ax) * p->dx + (y - p->ay) * p->dy) * p->invLen2;
+    t = boxMax(0, boxMin(1, t));
+    float ex = x - (p->ax + p->dx * t), ey = y - (p->ay + p->dy * t);
+    float reach = p->r + ARENA_BALL_RADIUS;
+    return ex * ex + ey * ey < reach * reach;
+}
 
-    // Dark background
-    glBegin(GL_QUADS);
-    glColor3f(0.1f,0.1f,0.2f); glVertex2f(orthoLeft, orthoTop);
-    glVertex2f(orthoRight, orthoTop);
-    glColor3f(0.05f,0.05f,0.15f);
-    glVertex2f(orthoRight, orthoBottom);
-    glVertex2f(orthoLeft, orthoBottom);
-    glEnd();
+// Keep the BVH_CONTACTS lowest piece indices, sorted
+static int contactAdd(int* found, int n, int j) {
+    if (n == BVH_CONTACTS && j > found[n - 1]) return n;
+    int k = n < BVH_CONTACTS ? n++ : n - 1;
+    while (k > 0 && found[k - 1] > j) { found[k] = found[k - 1]; k--; }
+    found[k] = j;
+    return n;
+}
 
-    // Random twinkling dots
-    glPointSize(2.0f);
-    glBegin(GL_POINTS);
-    for (int i = 0; i < 50; i++) {
-        float rx = rand() / (float)RAND_MAX;
-        float ry = rand() / (float)RAND_MAX;
-        float br = 0.5f + 0.5f * sinf(animation_time * 2.0f + i);
-        glColor3f(br, br, br);
-        glVertex2f(orthoLeft + (orthoRight-orthoLeft)*rx,
-                   orthoBottom + (orthoTop-orthoBottom)*ry);
+// Push ball i out of the pieces it overlaps and bounce it off those it is
+// moving into; a bumper kicks it away faster. The BVH (or with level_brute
+// a scan of every piece) only gathers the pieces, and they are resolved in
+// piece order, so both give the same ball. Writes nothing but ball i.
+static void levelCollide(Arena* A, int i) {
+    float x = A->bx[i], y = A->by[i], vx = A->bvx[i], vy = A->bvy[i];
+    const float R = ARENA_BALL_RADIUS;
+    int found[BVH_CONTACTS], n = 0, probes = 0;
+
+    if (level_brute) {
+        for (int j = 0; j < level.pieces; j++) {
+            probes++;
+            if (pieceTouches(&level.piece[j], x, y)) n = contactAdd(found, n, j);
+        }
+    } else {
+        int stack[BVH_DEPTH + 1], top = 0;
+        stack[top++] = 0;
+        while (top) {
+            const BvhNode* b = &level.node[stack[--top]];
+            probes++;
+            if (x < b->minX - R || x > b->maxX + R || y < b->minY - R || y > b->maxY + R) continue;
+            if (b->left >= 0) {
+                stack[top++] = b->right;
+                stack[top++] = b->left;
+                continue;
+            }
+            for (int j = b->first; j < b->first + b->count; j++) {
+                probes++;
+                if (pieceTouches(&level.piece[level.order[j]], x, y)) n = contactAdd(found, n, level.order[j]);
+            }
+        }
     }
-    glEnd();
+    A->probes[i] = (uint16_t)probes;
+
+    for (int c = 0; c < n; c++) {
+        const Piece* p = &level.piece[found[c]];
+        float t = ((x - p->ax) * p->dx + (y - p->ay) * p->dy) * p->invLen2;
+        t = boxMax(0, boxMin(1, t));
+        float qx = p->ax + p->dx * t, qy = p->ay + p->dy * t;
+        float ex = x - qx, ey = y - qy, reach = p->r + R;
+        float d2 = ex * ex + ey * ey;
+        if (d2 >= reach * reach) continue;
+
+        float d = sqrtf(d2), nx = 0, ny = 1;
+        if (d > 1e-4f) { nx = ex / d; ny = ey / d; }
+        else if (p->invLen2 > 0) { float s = sqrtf(p->invLen2); nx = -p->dy * s; ny = p->dx * s; }
+        x = qx + nx * reach;
+        y = qy + ny * reach;
+
+        // Bounce relative to the surface, which moves on a spinner
+        float ux = -p->spin * (qy - p->cy), uy = p->spin * (qx - p->cx);
+        float vn = (vx - ux) * nx + (vy - uy) * ny;
+        if (vn >= 0) continue;
+        vx -= 2 * vn * nx;
+        vy -= 2 * vn * ny;
+        float speed = sqrtf(vx * vx + vy * vy);
+        float want = p->kind == PIECE_BUMPER ? fmaxf(speed, ARENA_BALL_SPEED) * 1.1f : speed;
+        want = fminf(want, ARENA_MAX_SPEED);
+        if (speed > 0) { vx *= want / speed; vy *= want / speed; }
+    }
+    A->bx[i] = x;
+    A->by[i] = y;
+    A->bvx[i] = vx;
+    A->bvy[i] = vy;
+}
 
-    SwapBuffers(hdc);
+//              Arena mode
+
+// Lay out a regular polygon for players paddles and serve balls from the
+// centre. The first humans paddles take keyboard input, the rest are AI.
+void initArena(int players, int balls, int humans) {
+    Arena* A = &arena;
+    if (players < ARENA_MIN_PLAYERS) players = ARENA_MIN_PLAYERS;
+    if (players > ARENA_MAX_PLAYERS) players = ARENA_MAX_PLAYERS;
+    if (balls < 1) balls = 1;
+    if (balls > ARENA_MAX_BALLS) balls = ARENA_MAX_BALLS;
+
+    memset(A, 0, sizeof(*A));
+    A->players = players;
+    A->balls = balls;
+    A->apothem = ARENA_RADIUS * cosf(PI / players);
+    A->edge = 2.0f * ARENA_RADIUS * sinf(PI / players);
+    A->paddleW = fminf((float)PADDLE_WIDTH, A->edge * 0.4f);
+    for (int k = 0; k < players; k++) {
+        float a = -PI / 2 + 2.0f * PI * k / players;
+        A->nx[k] = cosf(a);
+        A->ny[k] = sinf(a);
+        A->human[k] = k < humans;
+    }
+    for (int i = 0; i < balls; i++) {
+        float a = (rand() % 3600) * (2.0f * PI / 3600);
+        A->bx[i] = A->by[i] = 0;
+        A->bvx[i] = cosf(a) * ARENA_BALL_SPEED;
+        A->bvy[i] = sinf(a) * ARENA_BALL_SPEED;
+        A->lastHit[i] = -1;
+    }
+    levelReset();
+}
 
-    drawText("SELECT DIFFICULTY", -180, 300, 1);
+// Edge whose sector (the wedge from the centre through it) holds x, y
+int arenaEdgeOf(float x, float y) {
+    int n = arena.players;
+    int k = (int)floorf((atan2f(y, x) + PI / 2 + PI / n) * n / (2.0f * PI));
+    k %= n;
+    return k < 0 ? k + n : k;
+}
 
-    const char* opts[] = {"1 - MEDIUM", "2 - HARD"};
-    const char* desc[] = {"Challenging AI", "Extreme challenge!"};
-    float ys[] = {200, 150};
+// Every computer paddle heads for the ball that reaches its edge first,
+// leading it by the difficulty's accuracy. One pass over paddle x ball.
+void updateArenaAI() {
+    Arena* A = &arena;
+    const AIParams* p = &aiParams[currentDifficulty];
+    float face = A->apothem - paddle_height - ARENA_BALL_RADIUS;   // where balls meet paddles
+    float half = A->edge / 2;
+
+    for (int k = 0; k < A->players; k++) {
+        if (A->human[k]) continue;
+        float nx = A->nx[k], ny = A->ny[k];
+        float best = 1e9f, aim = 0;
+
+        for (int i = 0; i < A->balls; i++) {
+            float vn = A->bvx[i] * nx + A->bvy[i] * ny;
+            if (vn <= 0.01f) continue;
+            float t = (face - (A->bx[i] * nx + A->by[i] * ny)) / vn;
+            if (t < 0 || t >= best) continue;
+            // The polygon is convex, so the edge the path crosses within its
+            // span is the one the ball reaches
+            float s = -(A->bx[i] + A->bvx[i] * t) * ny + (A->by[i] + A->bvy[i] * t) * nx;
+            if (fabsf(s) > half) continue;
+            float now = -A->bx[i] * ny + A->by[i] * nx;
+            best = t;
+            aim = now + (s - now) * p->accuracy;
+        }
 
-    for (int i = 0; i < 2; i++) {
-        if (currentDifficulty == i) {
-            char buf[100]; sprintf(buf, "> %s <", opts[i]);
-            drawText(buf, -100, ys[i], 0);
+        if (best == 1e9f) {
+            A->target[k] += (0 - A->target[k]) * 0.05f * p->reaction;
         } else {
-            drawText(opts[i], -80, ys[i], 0);
+            float dist = aim - A->target[k];
+            float step = paddle_velocity * p->reaction * p->speedMult * 0.05f;
+            if (fabsf(dist) > 20) step *= 1.5f;
+            if (fabsf(dist) < p->snapDist && best < 0.3f)
+                A->target[k] = aim;
+            else if (fabsf(dist) > 2.0f)
+                A->target[k] += (dist > 0 ? step : -step);
         }
-        drawText(desc[i], -150, ys[i]-30, 0);
     }
+}
 
-    drawText("PRESS ENTER TO START", -150, -100, 0);
-    drawText("PRESS ESC TO GO BACK",  -150, -150, 0);
+// Paddles follow their targets
+static void arenaMovePaddles() {
+    Arena* A = &arena;
+    float reach = A->edge / 2 - A->paddleW / 2;
 
-    float spd = (currentDifficulty == DIFFICULTY_MEDIUM) ? 16.0f : 18.0f;
-    char buf[50]; sprintf(buf, "BALL SPEED: %.1f", spd);
-    drawText(buf, -120, -200, 0);
+    for (int k = 0; k < A->players; k++) {
+        if (A->human[k]) {
+            int dir = (key_d_pressed || key_right_pressed) - (key_a_pressed || key_left_pressed);
+            A->target[k] += dir * paddle_velocity * 1.5f * 0.016f * 40;
+        }
+        A->target[k] = fmaxf(-reach, fminf(reach, A->target[k]));
+        A->pos[k] += (A->target[k] - A->pos[k]) * paddle_acceleration;
+    }
 }
 
-void drawSpeedMenu() {
-    glClear(GL_COLOR_BUFFER_BIT);
+// Balls against the level's pieces and then the single paddle
+// whose sector each is in. Only the ball's own fields change; hits, goals
+// and BVH probes are left per ball for arenaSettle().
+static void arenaMoveBalls() {
+    Arena* A = &arena;
+    float face = A->apothem - paddle_height;
+
+    for (int i = 0; i < A->balls; i++) {
+        A->hit[i] = 0;
+        A->goal[i] = -1;
+        A->bx[i] += A->bvx[i];
+        A->by[i] += A->bvy[i];
+        if (level.pieces) levelCollide(A, i);
+        float x = A->bx[i], y = A->by[i];
+
+        int k = arenaEdgeOf(x, y);
+        float nx = A->nx[k], ny = A->ny[k];
+        float d = x * nx + y * ny;
+        float vn = A->bvx[i] * nx + A->bvy[i] * ny;
+        if (vn <= 0 || d + ARENA_BALL_RADIUS < face) continue;
+
+        float hit = ((-x * ny + y * nx) - A->pos[k]) / (A->paddleW / 2);
+        if (d - ARENA_BALL_RADIUS <= A->apothem && fabsf(hit) <= 1.0f) {
+            // Mirror off the paddle face, add spin from where it struck
+            float speed = sqrtf(A->bvx[i] * A->bvx[i] + A->bvy[i] * A->bvy[i]);
+            float vx = A->bvx[i] - 2 * vn * nx - ny * hit * 3.0f;
+            float vy = A->bvy[i] - 2 * vn * ny + nx * hit * 3.0f;
+            float scale = fminf(speed * 1.05f, ARENA_MAX_SPEED) / sqrtf(vx * vx + vy * vy);
+            A->bvx[i] = vx * scale;
+            A->bvy[i] = vy * scale;
+            A->bx[i] += nx * (face - ARENA_BALL_RADIUS - d);
+            A->by[i] += ny * (face - ARENA_BALL_RADIUS - d);
+            A->lastHit[i] = (int8_t)k;
+            A->hit[i] = 1;
+        } else if (d - ARENA_BALL_RADIUS > A->apothem) {
+            A->goal[i] = (int8_t)k;
+        }
+    }
+}
 
-    glMatrixMode(GL_PROJECTION); glLoadIdentity();
-    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
-    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+// Scores and serves in ball order, once every ball has moved
+static void arenaSettle() {
+    Arena* A = &arena;
+    for (int i = 0; i < A->balls; i++) {
+        A->hits += A->hit[i];
+        if (level.pieces) A->probed += A->probes[i];
+        int k = A->goal[i];
+        if (k < 0) continue;
+
+        A->conceded[k]++;
+        if (A->lastHit[i] >= 0 && A->lastHit[i] != k) A->score[A->lastHit[i]]++;
+        A->goals++;
+
+        float a = (rand() % 3600) * (2.0f * PI / 3600);
+        A->bx[i] = A->by[i] = 0;
+        A->bvx[i] = cosf(a) * ARENA_BALL_SPEED;
+        A->bvy[i] = sinf(a) * ARENA_BALL_SPEED;
+        A->lastHit[i] = -1;
+    }
+}
 
-    // Reddish dark bg
-    glBegin(GL_QUADS);
-    glColor3f(0.2f,0.1f,0.1f); glVertex2f(orthoLeft, orthoTop);
-    glVertex2f(orthoRight, orthoTop);
-    glColor3f(0.1f,0.05f,0.05f);
-    glVertex2f(orthoRight, orthoBottom);
-    glVertex2f(orthoLeft, orthoBottom);
-    glEnd();
+// One arena tick: AI, paddles and spinners, then the balls. A ball leaving
+// through an edge is a point against that edge's player and a point for
+// whoever touched it last.
+void updateArena() {
+    double aiStart = perf.on ? frameClockMs() : 0;
+
+    updateArenaAI();
+    arenaMovePaddles();
+    if (perf.on) perf.aiTickMs += (float)(frameClockMs() - aiStart);
+    if (level.movers) levelStep();
+    arenaMoveBalls();
+    arenaSettle();
+}
 
-    SwapBuffers(hdc);
+//              Mosaic view
+//
+// A grid of PvP matches between two computer paddles, for watching batch
+// runs and tournaments at a glance. Each match is a MatchState that takes
+// its turn on the globals for one update(), like the envs, with
+// sim_spectate set: the matches make no sound (Beep() blocks the window
+// thread) and leave the player's profile, history, achievements and shared
+// state alone. drawMosaic() reads the states.
+
+// Back to the mosaic screen and the player's settings after the matches
+// have had the globals
+void mosaicRestore() {
+    currentMode = MODE_MOSAIC;
+    currentDifficulty = mosaic.difficulty;
+    player1_control = mosaic.control[0];
+    player2_control = mosaic.control[1];
+    game_running = 1;
+    sim_spectate = 0;
+}
 
-    drawText("SELECT BALL SPEED FOR PvP", -220, 300, 1);
+// count fresh matches (1..MOSAIC_MAX) in a near-square grid, running
+void mosaicInit(int count) {
+    mosaic.count = count < 1 ? 1 : (count > MOSAIC_MAX ? MOSAIC_MAX : count);
+    for (mosaic.cols = 1; mosaic.cols * mosaic.cols < mosaic.count; mosaic.cols++) {}
+    mosaic.rows = (mosaic.count + mosaic.cols - 1) / mosaic.cols;
+    mosaic.control[0] = player1_control;
+    mosaic.control[1] = player2_control;
+    mosaic.difficulty = currentDifficulty;
+
+    // Ends the player's match; the mosaic gets no replay or leaderboard entry
+    currentMode = MODE_MOSAIC;
+    sim_spectate = 1;
+    initGame();
+
+    MatchState start;
+    currentMode = MODE_PVP;
+    ball_speed = pvp_ball_speed;
+    player1_control = player2_control = CONTROL_AUTO;
+    game_running = 1;
+    matchSave(&start);
+    for (int i = 0; i < mosaic.count; i++) {
+        matchLoad(&start);
+        resetBall(&balls[0]);       // serves draw from rand(), so the matches part ways
+        matchSave(&mosaic.match[i]);
+    }
+    mosaicRestore();
+}
 
-    char buf[100];
-    sprintf(buf, "CURRENT SPEED: %.1f", pvp_ball_speed);
-    drawText(buf, -120, 200, 1);
+// One tick of every match. The lifetime counters update() bumps are the
+// player's, so they are put back too.
+void mosaicStep() {
+    int cosmetics = sim_cosmetics, hits = lifetime_hits, pickups = powerups_collected;
+    float topSpeed = max_ball_speed;
+
+    sim_cosmetics = 0;
+    sim_spectate = 1;
+    for (int i = 0; i < mosaic.count; i++) {
+        matchLoad(&mosaic.match[i]);
+        update();
+        matchSave(&mosaic.match[i]);
+    }
 
-    drawText("UP ARROW - INCREASE SPEED",   -180, 100, 0);
-    drawText("DOWN ARROW - DECREASE SPEED", -180, 70,  0);
+    sim_cosmetics = cosmetics;
+    lifetime_hits = hits;
+    powerups_collected = pickups;
+    max_ball_speed = topSpeed;
+    mosaicRestore();
+}
 
-    float ratio = (pvp_ball_speed - 6.0f) / (25.0f - 6.0f);
-    float barW = 400.0f * ratio;
+//              Fixed-point lockstep physics
+
+static inline fix fixMul(fix a, fix b) { return (fix)(((int64_t)a * b) >> FIX_SHIFT); }
+static inline fix fixDiv(fix a, fix b) { return (fix)((int64_t)a * FIX_ONE / b); }
+static inline fix fixAbs(fix a) { return a < 0 ? -a : a; }
+static inline fix fixMin(fix a, fix b) { return a < b ? a : b; }
+static inline fix fixMax(fix a, fix b) { return a > b ? a : b; }
+// Exact for every float the game uses: scaling by 2^16 is exact and the
+// truncation is the same on every FPU
+static inline fix fixFromFloat(float f) { return (fix)(f * FIX_ONE); }
+static inline float fixToFloat(fix a) { return a * (1.0f / FIX_ONE); }
+
+// sin(d) for whole degrees 0..90
+static const fix fixSinTable[91] = {
+        0,  1144,  2287,  3430,  4572,  5712,  6850,  7987,
+     9121, 10252, 11380, 12505, 13626, 14742, 15855, 16962,
+    18064, 19161, 20252, 21336, 22415, 23486, 24550, 25607,
+    26656, 27697, 28729, 29753, 30767, 31772, 32768, 33754,
+    34729, 35693, 36647, 37590, 38521, 39441, 40348, 41243,
+    42126, 42995, 43852, 44695, 45525, 46341, 47143, 47930,
+    48703, 49461, 50203, 50931, 51643, 52339, 53020, 53684,
+    54332, 54963, 55578, 56175, 56756, 57319, 57865, 58393,
+    58903, 59396, 59870, 60326, 60764, 61183, 61584, 61966,
+    62328, 62672, 62997, 63303, 63589, 63856, 64104, 64332,
+    64540, 64729, 64898, 65048, 65177, 65287, 65376, 65446,
+    65496, 65526, 65536
+};
 
-    SwapBuffers(hdc);
+static fix fixSinDeg(int d) {
+    d %= 360;
+    if (d < 0) d += 360;
+    if (d <= 90)  return  fixSinTable[d];
+    if (d <= 180) return  fixSinTable[180 - d];
+    if (d <= 270) return -fixSinTable[d - 180];
+    return -fixSinTable[360 - d];
+}
 
-    // Bar background
-    glColor3f(0.3f,0.3f,0.3f);
-    glBegin(GL_QUADS);
-    glVertex2f(-200,150); glVertex2f(200,150);
-    glVertex2f(200,170);  glVertex2f(-200,170);
-    glEnd();
+static fix fixCosDeg(int d) { return fixSinDeg(d + 90); }
 
-    // Gradient bar
-    glBegin(GL_QUADS);
-    glColor3f(1,0,0);    glVertex2f(-200,150);
-    glColor3f(0,1,0);    glVertex2f(-200+barW,150);
-    glColor3f(0,0.5f,0); glVertex2f(-200+barW,170);
-    glColor3f(0.5f,0,0); glVertex2f(-200,170);
-    glEnd();
+// Bit-by-bit square root, floor(sqrt(v))
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t r = 0, bit = 1ULL << 62;
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) { v -= r + bit; r = (r >> 1) + bit; }
+        else r >>= 1;
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
 
-    SwapBuffers(hdc);
+// Length of (x, y): the squares are Q32.32, so the root is Q16.16
+static fix fixLength(fix x, fix y) {
+    return (fix)isqrt64((uint64_t)((int64_t)x * x + (int64_t)y * y));
+}
 
-    drawText("ENTER - START GAME",    -120, 0,   0);
-    drawText("ESC - BACK TO MENU",    -120, -30, 0);
-    drawText("SLOW", -220, 180, 0);
-    drawText("FAST", 180,  180, 0);
+static uint32_t fixRandom(FixMatch* m) {
+    uint32_t x = m->rng;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return m->rng = x;
+}
 
-    // Sparks for high speed
-    if (pvp_ball_speed > 15.0f) {
-        glColor4f(1,0,0,0.3f);
-        glPointSize(3.0f);
-        glBegin(GL_POINTS);
-        for (int i = 0; i < 20; i++) {
-            float x = -500 + fmod(animation_time*100 + i*20, 1000);
-            float y = (rand()%400) - 200;
-            glVertex2f(x,y);
-        }
-        glEnd();
-        SwapBuffers(hdc);
+// aiParams converted field by field, so no float arithmetic can round
+// differently between builds
+typedef struct {
+    fix reaction, accuracy, errChance, maxErr, speedMult, adapt, bounceBlend, snapDist;
+    fix rallyReactionMax, learnRate, learnMax, learnReactionMax;
+    int rallyHits, learnHits;
+} FixAIParams;
+
+static FixAIParams fixAiParams[2];
+
+// Same serve as resetBall(), drawn from the match's own generator
+static void fixServe(FixMatch* m) {
+    m->bx = (fix)(fixRandom(m) % 200 - 100) * FIX_ONE;
+    m->by = 0;
+    int angle = (int)(fixRandom(m) % 60) - 30;
+    fix dir = (fixRandom(m) % 2) ? FIX_ONE : -FIX_ONE;
+    m->bvy = fixMul(fixMul(m->ballSpeed, fixCosDeg(angle)), dir);
+    m->bvx = fixMul(m->ballSpeed, fixSinDeg(angle));
+}
+
+// New match with the current field, paddle and speed settings. Everything
+// after this depends only on the seed and the per-tick inputs.
+void fixInit(FixMatch* m, uint32_t seed, int aiMask) {
+    for (int d = 0; d < 2; d++) {
+        const AIParams* a = &aiParams[d];
+        FixAIParams* f = &fixAiParams[d];
+        f->reaction = fixFromFloat(a->reaction);
+        f->accuracy = fixFromFloat(a->accuracy);
+        f->errChance = fixFromFloat(a->errChance);
+        f->maxErr = fixFromFloat(a->maxErr);
+        f->speedMult = fixFromFloat(a->speedMult);
+        f->adapt = fixFromFloat(a->adapt);
+        f->bounceBlend = fixFromFloat(a->bounceBlend);
+        f->snapDist = fixFromFloat(a->snapDist);
+        f->rallyReactionMax = fixFromFloat(a->rallyReactionMax);
+        f->learnRate = fixFromFloat(a->learnRate);
+        f->learnMax = fixFromFloat(a->learnMax);
+        f->learnReactionMax = fixFromFloat(a->learnReactionMax);
+        f->rallyHits = a->rallyHits;
+        f->learnHits = a->learnHits;
     }
+
+    memset(m, 0, sizeof(*m));
+    m->left = fixFromFloat(orthoLeft);
+    m->right = fixFromFloat(orthoRight);
+    m->bottom = fixFromFloat(orthoBottom);
+    m->top = fixFromFloat(orthoTop);
+    m->radius = BALL_RADIUS * FIX_ONE;
+    m->paddleW = paddle_width * FIX_ONE;
+    m->paddleH = paddle_height * FIX_ONE;
+    m->ballSpeed = fixFromFloat(ball_speed);
+    m->maxSpeed = (currentMode == MODE_PVP) ? 25 * FIX_ONE : 30 * FIX_ONE;
+    // paddle_velocity * 1.5 * dt * 40 with dt = 0.016, as in updateControls()
+    m->keyStep = fixMul(fixFromFloat(paddle_velocity), FIX(0.96));
+    m->accel = fixFromFloat(paddle_acceleration);
+    m->difficulty = currentDifficulty;
+    m->aiMask = aiMask;
+    m->rng = seed ? seed : 1;
+    fixServe(m);
 }
 
-// Handle input → update paddle target positions smoothly
-void updateControls(float dt) {
-    float base = paddle_velocity * 1.5f;
+// updateAI() for paddle k in fixed point
+static void fixAI(FixMatch* m, int k) {
+    const FixAIParams* p = &fixAiParams[m->difficulty];
+    fix reaction = p->reaction, accuracy = p->accuracy;
 
-    // Bottom player controls
-    switch (player1_control) {
-        case CONTROL_KEYBOARD_1:
-            if (key_d_pressed)     player1_target_x += base * player1_paddle_speed * dt * 40;
-            if (key_a_pressed)     player1_target_x -= base * player1_paddle_speed * dt * 40;
-            break;
-        case CONTROL_KEYBOARD_2:
-            if (key_right_pressed) player1_target_x += base * player1_paddle_speed * dt * 40;
-            if (key_left_pressed)  player1_target_x -= base * player1_paddle_speed * dt * 40;
-            break;
-        case CONTROL_AUTO:
-            updateAI(1);
-            break;
-        case CONTROL_MOUSE:
-            break;
+    if (m->rally > p->rallyHits) {
+        accuracy = fixMin(FIX_ONE, accuracy + fixMul(p->adapt, FIX(0.1)));
+        reaction = fixMin(p->rallyReactionMax, reaction + fixMul(p->adapt, FIX(0.05)));
+    }
+    if (m->hits > p->learnHits) {
+        fix learn = fixMin(p->learnMax, m->hits * p->learnRate);
+        accuracy = fixMin(FIX_ONE, accuracy + fixMul(learn, FIX(0.05)));
+        reaction = fixMin(p->learnReactionMax, reaction + fixMul(learn, FIX(0.02)));
     }
 
-    // Top player controls (PvP only)
-    if (currentMode == MODE_PVP) {
-        switch (player2_control) {
-            case CONTROL_KEYBOARD_1:
-                if (key_right_pressed) player2_target_x += base * player2_paddle_speed * dt * 40;
-                if (key_left_pressed)  player2_target_x -= base * player2_paddle_speed * dt * 40;
-                break;
-            case CONTROL_KEYBOARD_2:
-                if (key_right_pressed) player2_target_x += base * player2_paddle_speed * dt * 40;
-                if (key_left_pressed)  player2_target_x -= base * player2_paddle_speed * dt * 40;
-                break;
-            case CONTROL_AUTO:
-                updateAI(2);
-                break;
-            case CONTROL_MOUSE:
-                break;
+    fix line = k == 0 ? m->bottom + m->paddleH : m->top - m->paddleH;
+    int incoming = k == 0 ? (m->bvy < 0 && m->by > line) : (m->bvy > 0 && m->by < line);
+    fix* targetX = &m->targetX[k];
+
+    if (!incoming) {
+        *targetX += fixMul(fixMul(-*targetX, FIX(0.05)), reaction);
+    } else {
+        fix t = fixDiv(line - m->by, m->bvy);
+        fix predict = m->bx + fixMul(fixMul(m->bvx, t), accuracy);
+
+        if (fixAbs(m->bvx) > FIX(0.1)) {
+            fix tLeft = t, cx = m->bx, cvx = m->bvx;
+            while (tLeft > 0) {
+                fix tWall = (cvx > 0)
+                    ? fixDiv(m->right - m->radius - cx, cvx)
+                    : fixDiv(m->left + m->radius - cx, cvx);
+
+                if (tWall > 0 && tWall <= tLeft) {
+                    cx += fixMul(cvx, tWall);
+                    cvx = -fixMul(cvx, FIX(0.98));
+                    tLeft -= tWall;
+                } else {
+                    cx += fixMul(cvx, tLeft);
+                    break;
+                }
+            }
+            predict = fixMul(predict, FIX_ONE - p->bounceBlend) + fixMul(cx, p->bounceBlend);
         }
-    } else if (currentMode == MODE_PVC) {
-        updateAI(2);
+
+        int maxErr = p->maxErr >> FIX_SHIFT;
+        if (p->errChance > 0 && maxErr > 0 &&
+            (fix)(fixRandom(m) % 100) * FIX_ONE < p->errChance * 100) {
+            fix err = (fix)((fixRandom(m) % maxErr) * 2) * FIX_ONE - p->maxErr;
+            predict += fixMul(err, FIX_ONE + t / 2);
+        }
+
+        fix dist = predict - *targetX;
+        fix step = fixMul(fixMul(fixMul(fixFromFloat(paddle_velocity), reaction), p->speedMult), FIX(0.05));
+        if (fixAbs(dist) > 20 * FIX_ONE) step += step / 2;
+
+        if (fixAbs(dist) < p->snapDist && t < FIX(0.3))
+            *targetX = predict;
+        else if (fixAbs(dist) > 2 * FIX_ONE)
+            *targetX += (dist > 0 ? step : -step);
+    }
+}
+
+// One tick. dir0 / dir1 are the human inputs for the bottom / top paddle
+// (-1 left, 0, +1 right) and are ignored for computer paddles.
+void fixStep(FixMatch* m, int dir0, int dir1) {
+    int dir[2] = {dir0, dir1};
+    fix ml = m->left + m->paddleW / 2, mr = m->right - m->paddleW / 2;
+
+    for (int k = 0; k < 2; k++) {
+        if (m->aiMask & (1 << k)) fixAI(m, k);
+        else m->targetX[k] += dir[k] * m->keyStep;
+        m->targetX[k] = fixMax(ml, fixMin(mr, m->targetX[k]));
+        m->paddleX[k] += fixMul(m->targetX[k] - m->paddleX[k], m->accel);
     }
+    m->tick++;
 
-    // Smooth interpolation
-    player1_paddle_x += (player1_target_x - player1_paddle_x) * paddle_acceleration;
-    player2_paddle_x += (player2_target_x - player2_paddle_x) * paddle_acceleration;
+    m->bx += m->bvx;
+    m->by += m->bvy;
 
-    // Clamp everything
-    float ml = orthoLeft  + paddle_width/2;
-    float mr = orthoRight - paddle_width/2;
+    if (m->bx + m->radius > m->right) { m->bx = m->right - m->radius; m->bvx = -m->bvx; }
+    if (m->bx - m->radius < m->left)  { m->bx = m->left + m->radius;  m->bvx = -m->bvx; }
 
-    player1_target_x = fmaxf(ml, fminf(mr, player1_target_x));
-    player2_target_x = fmaxf(ml, fminf(mr, player2_target_x));
-    player1_paddle_x = fmaxf(ml, fminf(mr, player1_paddle_x));
-    player2_paddle_x = fmaxf(ml, fminf(mr, player2_paddle_x));
-}
+    fix face0 = m->bottom + 2 * m->paddleH, face1 = m->top - 2 * m->paddleH;
+    fix w = m->paddleW / 2;
 
-// Main rendering when in gameplay mode
-void display() {
-    if (currentMode == MODE_MENU)           { drawMenu(); return; }
-    if (currentMode == MODE_DIFFICULTY_SELECT) { drawDifficultyMenu(); return; }
-    if (currentMode == MODE_SPEED_SELECT)   { drawSpeedMenu(); return; }
+    if (m->by - m->radius < face0 && m->bvy < 0 &&
+        m->bx >= m->paddleX[0] - w && m->bx <= m->paddleX[0] + w) {
+        m->by = face0 + m->radius;
+        fix hit = fixDiv(m->bx - m->paddleX[0], w);
+        m->bvy = fixMul(fixAbs(m->bvy), FIX(1.2));
+        m->bvx = hit * 8 + m->bvx / 2;
 
-    glClear(GL_COLOR_BUFFER_BIT);
+        fix len = fixLength(m->bvx, m->bvy);
+        if (len > m->maxSpeed) {
+            m->bvx = fixMul(fixDiv(m->bvx, len), m->maxSpeed);
+            m->bvy = fixMul(fixDiv(m->bvy, len), m->maxSpeed);
+        } else {
+            m->bvx = fixMul(m->bvx, FIX(1.05));
+            m->bvy = fixMul(m->bvy, FIX(1.05));
+        }
+    }
 
-    glMatrixMode(GL_PROJECTION); glLoadIdentity();
-    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
-    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+    if (m->by + m->radius > face1 && m->bvy > 0 &&
+        m->bx >= m->paddleX[1] - w && m->bx <= m->paddleX[1] + w) {
+        m->by = face1 - m->radius;
+        fix hit = fixDiv(m->bx - m->paddleX[1], w);
+        m->bvy = -fixAbs(m->bvy) - FIX(1.5);
+        m->bvx += hit * 3;
+
+        fix len = fixLength(m->bvx, m->bvy);
+        m->bvx = fixMul(fixDiv(m->bvx, len), m->ballSpeed);
+        m->bvy = fixMul(fixDiv(m->bvy, len), m->ballSpeed);
+        m->rally++;
+        m->hits++;
+    }
 
-    drawCenterLine();
-    drawPaddle(player1_paddle_x, 0, player1_big_paddle, 1);
-    drawPaddle(player2_paddle_x, 0, player2_big_paddle, 2);
+    if (m->by < m->bottom || m->by > m->top) {
+        m->score[m->by < m->bottom ? 1 : 0]++;
+        m->rally = 0;
+        fixServe(m);
+    }
+}
 
-    for (int i = 0; i < 3; i++)
-        if (balls[i].active) {
-            drawTrail(&balls[i]);
-            drawBall(&balls[i]);
+// FNV-1a over the whole state; FixMatch has no padding
+uint64_t fixHash(const FixMatch* m) {
+    const unsigned char* p = (const unsigned char*)m;
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < sizeof(*m); i++) { h ^= p[i]; h *= 1099511628211ULL; }
+    return h;
+}
+
+// Game tick in fixed-point mode: gather the same inputs updateControls()
+// reads, step the core and copy the result into the float state that
+// drawing and the HUD use
+void updateFixed() {
+    FixMatch* m = &fixed_match;
+    int dir[2] = {0, 0};
+    ControlMode control[2] = {player1_control, player2_control};
+    float target[2] = {player1_target_x, player2_target_x};
+
+    for (int k = 0; k < 2; k++) {
+        switch (control[k]) {
+            case CONTROL_KEYBOARD_1:
+                dir[k] = k == 0 ? key_d_pressed - key_a_pressed : key_right_pressed - key_left_pressed;
+                break;
+            case CONTROL_KEYBOARD_2:
+                dir[k] = key_right_pressed - key_left_pressed;
+                break;
+            case CONTROL_MOUSE:
+            case CONTROL_EXTERNAL: {
+                // Quantised to a direction so the input stays one value per tick
+                float d = target[k] - fixToFloat(m->targetX[k]);
+                dir[k] = d > 4.0f ? 1 : d < -4.0f ? -1 : 0;
+                break;
+            }
+            default:
+                break;
         }
+    }
+    fixStep(m, dir[0], dir[1]);
+    sim_tick++;
+    needsRedraw = 1;
 
-    for (int i = 0; i < MAX_POWERUPS; i++)
-        if (powerups[i].active)
-            drawPowerUp(powerups[i]);
+    Ball* b = &balls[0];
+    b->x = b->originX = fixToFloat(m->bx);
+    b->y = b->originY = fixToFloat(m->by);
+    b->vx = fixToFloat(m->bvx);
+    b->vy = fixToFloat(m->bvy);
+    b->originTick = sim_tick;
+    player1_paddle_x = fixToFloat(m->paddleX[0]);
+    player2_paddle_x = fixToFloat(m->paddleX[1]);
+    if (control[0] != CONTROL_MOUSE && control[0] != CONTROL_EXTERNAL)
+        player1_target_x = fixToFloat(m->targetX[0]);
+    if (control[1] != CONTROL_MOUSE && control[1] != CONTROL_EXTERNAL)
+        player2_target_x = fixToFloat(m->targetX[1]);
+    player1_score = m->score[0];
+    player2_score = m->score[1];
+}
 
-    drawParticles();
+#ifdef PONG_HEADLESS
+//              Event-driven engine (headless)
+//
+// advanceTicks() reaches the same gameplay state as calling update() once
+// per tick, but only runs update() on ticks where something can happen: a
+// wall or paddle-zone crossing, a power-up contact, a spawn or a timer
+// running out. Ball positions are analytic in between, the power-up spawn
+// countdown is replayed from a cached sequence, effect timers come from the
+// timer wheel, and paddles are only stepped while they can move (AI, keys
+// held, smoothing not settled). Cosmetic state (particles, trails,
+// animation_time, power-up spin) is not advanced.
+//
+// eventsim measures 2.3-3x over update() with AI paddles, which still step
+// every tick, and 9-14x with idle paddles. Power-ups on the field and
+// multi-ball add an event per contact and stay near the low end.
+
+#define EV_BALLS    3
+#define EV_TIMERS   1
+#define EV_WHEEL    (EV_BALLS + EV_TIMERS)
+#define EV_ENTITIES (EV_WHEEL + 1)
+#define EV_NEVER    0x7FFFFFFF
+#define EV_HORIZON  (1 << 20)       // resync at least this often
+#define EV_SEQ_MAX  1024
+#define EV_HEAP_MAX 64
+
+// Float timer that update() steps by a constant every tick
+typedef struct {
+    float* value;
+    float step;                 // > 0 counts up to limit, < 0 counts down to 0
+    float limit;
+    int anchorTick;
+    int len;                    // seq[len] is the value on the firing tick
+    float seq[EV_SEQ_MAX + 1];
+} EvTimer;
 
-    SwapBuffers(hdc);
+typedef struct {
+    int tick;
+    int entity;
+    unsigned version;
+} EvEntry;
 
-    char s1[50], s2[50];
-    sprintf(s1, "PLAYER 1: %d", player1_score);
-    sprintf(s2, "PLAYER 2: %d", player2_score);
-    drawText(s1, -550, orthoBottom + 30, 0);
-    drawText(s2, -550, orthoTop - 30, 0);
+static EvTimer evTimers[EV_TIMERS] = {
+    {&powerup_timer, 0.016f, 8.0f}
+};
+static EvEntry evHeap[EV_HEAP_MAX];
+static int evHeapSize = 0;
+static unsigned evVersion[EV_ENTITIES];
+
+static void evPush(int tick, int entity) {
+    if (tick == EV_NEVER) return;
+    if (evHeapSize == EV_HEAP_MAX) {
+        // Drop stale entries; each entity has at most one live one
+        int n = 0;
+        for (int i = 0; i < evHeapSize; i++)
+            if (evHeap[i].version == evVersion[evHeap[i].entity]) evHeap[n++] = evHeap[i];
+        evHeapSize = 0;
+        for (int i = 0; i < n; i++) evPush(evHeap[i].tick, evHeap[i].entity);
+    }
+    int i = evHeapSize++;
+    EvEntry e = {tick, entity, evVersion[entity]};
+    while (i > 0 && evHeap[(i - 1) / 2].tick > tick) {
+        evHeap[i] = evHeap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    evHeap[i] = e;
 }
 
-// Fancy animated main menu
-void drawMenu() {
-    glClear(GL_COLOR_BUFFER_BIT);
+static void evPop() {
+    EvEntry last = evHeap[--evHeapSize];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= evHeapSize) break;
+        if (c + 1 < evHeapSize && evHeap[c + 1].tick < evHeap[c].tick) c++;
+        if (evHeap[c].tick >= last.tick) break;
+        evHeap[i] = evHeap[c];
+        i = c;
+    }
+    if (evHeapSize > 0) evHeap[i] = last;
+}
 
-    glMatrixMode(GL_PROJECTION); glLoadIdentity();
-    glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
-    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+// Earliest live entry, dropping invalidated ones on the way
+static int evTop() {
+    while (evHeapSize > 0 && evHeap[0].version != evVersion[evHeap[0].entity])
+        evPop();
+    return evHeapSize > 0 ? evHeap[0].tick : EV_NEVER;
+}
 
-    float t = animation_time;
+//              Timers
+
+static void evAnchorTimer(EvTimer* t) {
+    float v = *t->value;
+    t->anchorTick = sim_tick;
+    t->seq[0] = v;
+    t->len = 0;
+    if (t->step < 0 && v <= 0) return;          // countdown not running
+    while (t->len < EV_SEQ_MAX) {
+        v = (t->step > 0) ? v + t->step : v - (-t->step);
+        t->seq[++t->len] = v;
+        if (t->step > 0 ? v >= t->limit : v <= 0) break;
+    }
+}
 
-    glBegin(GL_QUADS);
-    glColor3f(0.1f + 0.05f*sinf(t*0.5f), 0.1f + 0.05f*sinf(t*0.7f+1), 0.2f + 0.05f*sinf(t*0.3f+2));
-    glVertex2f(orthoLeft, orthoTop);
+static float evTimerValue(const EvTimer* t, int tick) {
+    int k = tick - t->anchorTick;
+    return t->seq[k < t->len ? k : t->len];
+}
 
-    glColor3f(0.15f + 0.05f*sinf(t*0.6f), 0.15f + 0.05f*sinf(t*0.8f+0.5f), 0.25f + 0.05f*sinf(t*0.4f+1.5f));
-    glVertex2f(orthoRight, orthoTop);
+// Tick on which update() fires the timer (or a resync for long sequences)
+static int evTimerTick(const EvTimer* t) {
+    int tick = t->anchorTick + t->len;
+    return tick > sim_tick ? tick : EV_NEVER;
+}
 
-    glColor3f(0.05f + 0.05f*sinf(t*0.4f), 0.05f + 0.05f*sinf(t*0.6f+2), 0.15f + 0.05f*sinf(t*0.2f+3));
-    glVertex2f(orthoRight, orthoBottom);
+// Re-anchor when update() did something other than the expected step
+static int evTimerChanged(EvTimer* t) {
+    int k = sim_tick - t->anchorTick;
+    if (k >= 0 && k <= t->len && *t->value == t->seq[k] &&
+        !(k == t->len && k == EV_SEQ_MAX)) return 0;
+    evAnchorTimer(t);
+    return 1;
+}
 
-    glColor3f(0.0f + 0.05f*sinf(t*0.3f), 0.0f + 0.05f*sinf(t*0.5f+1.5f), 0.1f + 0.05f*sinf(t*0.1f+2.5f));
-    glVertex2f(orthoLeft, orthoBottom);
-    glEnd();
+// Tick after the update() that fires the earliest wheel timer
+static int evWheelTick() {
+    int expire = timerNext();
+    if (expire == EV_NEVER) return EV_NEVER;
+    return expire >= sim_tick ? expire + 1 : sim_tick + 1;
+}
 
-    SwapBuffers(hdc);
+//              Balls
 
-    drawText("PING PONG", -80, 300, 1);
+// Same expression as the position update in update()
+static float evPathX(const Ball* b, int tick) {
+    float n = (float)(tick - b->originTick);
+    return b->originX + b->vx * n;
+}
 
-    const char* items[] = {
-        "1 - PLAYER VS PLAYER",
-        "2 - PLAYER VS COMPUTER",
-        "3 - SELECT BALL SPEED (PvP)"
-    };
-    float ys[] = {150, 100, 50};
+static float evPathY(const Ball* b, int tick) {
+    float n = (float)(tick - b->originTick);
+    return b->originY + b->vy * n;
+}
 
-    for (int i = 0; i < 3; i++)
-        drawText(items[i], -180, ys[i], 0);
+static int evWallHit(const Ball* b, int tick) {
+    float x = evPathX(b, tick);
+    return x + b->radius > orthoRight || x - b->radius < orthoLeft;
+}
 
-    drawText("PRESS SPACE TO START SELECTED GAME", -250, -200, 0);
-    drawText("ESC - EXIT", -180, -230, 0);
+static int evZoneHit(const Ball* b, int tick) {
+    float y = evPathY(b, tick);
+    float p1y = orthoBottom + paddle_height;
+    float p2y = orthoTop    - paddle_height;
+    return (y - b->radius < p1y + paddle_height && b->vy < 0) ||
+           (y + b->radius > p2y - paddle_height && b->vy > 0) ||
+           y < orthoBottom || y > orthoTop;
+}
 
-    char buf[100];
-    sprintf(buf, "ACHIEVEMENTS: %d/7   MAX SPEED: %.1f", achievements_unlocked, max_ball_speed);
-    drawText(buf, -200, 380, 0);
+static int evPowerUpHit(const Ball* b, int tick, const PowerUp* p) {
+    float dx = evPathX(b, tick) - p->x;
+    float dy = evPathY(b, tick) - p->y;
+    return sqrtf(dx*dx + dy*dy) < b->radius + 15;
 }
 
-// Main game loop logic — physics, collisions, scoring
-void update() {
-    if (!game_running) return;
+// First tick >= from at which a monotone crossing predicate holds, starting
+// a couple of ticks before the analytic estimate
+static int evScan(const Ball* b, int from, double est, int (*hit)(const Ball*, int)) {
+    if (est > (double)from + EV_HORIZON) return from + EV_HORIZON;
+    int t = (est - 2 > from) ? (int)floor(est) - 2 : from;
+    if (t < from) t = from;
+    while (!hit(b, t) && t < from + EV_HORIZON) t++;
+    return t;
+}
 
-    needsRedraw = 1;
-    float dt = 0.016f * slow_time_factor;
+static int evBallTick(const Ball* b, int from) {
+    if (!b->active) return EV_NEVER;
 
-    updateControls(dt);
-    updatePowerUps();
-    updateCombo();
-    updateParticles();
+    double ox = b->originX, oy = b->originY, ot = b->originTick;
+    double best = EV_NEVER;
 
-    animation_time += dt;
+    // Side walls
+    if (b->vx != 0) {
+        double wall = (b->vx > 0) ? orthoRight - b->radius : orthoLeft + b->radius;
+        best = evScan(b, from, ot + (wall - ox) / b->vx, evWallHit);
+    } else if (evWallHit(b, from)) {
+        best = from;
+    }
 
-    for (int i = 0; i < 3; i++) {
-        if (!balls[i].active) continue;
-        Ball* b = &balls[i];
+    // Paddle zones (the step is run on every tick inside them)
+    double zone = (b->vy < 0) ? orthoBottom + 2 * paddle_height + b->radius
+                              : orthoTop    - 2 * paddle_height - b->radius;
+    int z = (b->vy != 0) ? evScan(b, from, ot + (zone - oy) / b->vy, evZoneHit)
+                         : (evZoneHit(b, from) ? from : from + EV_HORIZON);
+    if (z < best) best = z;
+
+    // Power-ups: solve |o + v t - c| = R, then check the ticks around it
+    for (int k = 0; k < MAX_POWERUPS; k++) {
+        const PowerUp* p = &powerups[k];
+        if (!p->active) continue;
+        double dx = ox - p->x, dy = oy - p->y, R = b->radius + 15 + 0.01;
+        double qa = (double)b->vx * b->vx + (double)b->vy * b->vy;
+        double qb = 2 * (dx * b->vx + dy * b->vy);
+        double qc = dx * dx + dy * dy - R * R;
+        int lo, hi;
+        if (qa == 0) {
+            if (qc > 0) continue;
+            lo = from; hi = from;
+        } else {
+            double disc = qb * qb - 4 * qa * qc;
+            if (disc < 0) continue;
+            double s = sqrt(disc);
+            double tIn  = ot + (-qb - s) / (2 * qa);
+            double tOut = ot + (-qb + s) / (2 * qa);
+            if (tOut + 1 < from || tIn - 1 > best) continue;
+            lo = (tIn - 1 > from) ? (int)floor(tIn) - 1 : from;
+            hi = (int)ceil(tOut) + 1;
+        }
+        for (int t = lo; t <= hi && t < best; t++)
+            if (evPowerUpHit(b, t, p)) { best = t; break; }
+    }
 
-        if (b->effectTimer > 0) b->effectTimer -= dt;
+    return (int)best;
+}
 
-        b->x += b->vx;
-        b->y += b->vy;
+//              Main loop
 
-        updateTrail(b);
+// Same conditions under which updateControls() would leave paddles alone
+static int evPaddlesIdle() {
+    if (currentMode == MODE_PVC) return 0;
+    if (player1_control == CONTROL_AUTO || player1_control == CONTROL_NEURAL) return 0;
+    if (player2_control == CONTROL_AUTO || player2_control == CONTROL_NEURAL) return 0;
+    if (key_a_pressed || key_d_pressed || key_left_pressed || key_right_pressed) return 0;
 
-        float spd = sqrtf(b->vx*b->vx + b->vy*b->vy);
-        if (spd > max_ball_speed) {
-            max_ball_speed = spd;
-            checkAchievements();
-        }
+    float ml = orthoLeft  + paddle_width/2;
+    float mr = orthoRight - paddle_width/2;
+    return player1_paddle_x == player1_target_x && player2_paddle_x == player2_target_x &&
+           player1_paddle_x >= ml && player1_paddle_x <= mr &&
+           player2_paddle_x >= ml && player2_paddle_x <= mr;
+}
 
-        // Left/right wall bounce
-        if (b->x + b->radius > orthoRight) {
-            b->x = orthoRight - b->radius;
-            b->vx = -b->vx;
-            addParticle(b->x, b->y, 1,1,1);
-            playSound(300,50);
-        }
-        if (b->x - b->radius < orthoLeft) {
-            b->x = orthoLeft + b->radius;
-            b->vx = -b->vx;
-            addParticle(b->x, b->y, 1,1,1);
-            playSound(300,50);
+static void evMaterializeBalls(int tick) {
+    for (int i = 0; i < EV_BALLS; i++)
+        if (balls[i].active) {
+            balls[i].x = evPathX(&balls[i], tick);
+            balls[i].y = evPathY(&balls[i], tick);
         }
+}
 
-        checkPowerUpCollision(b);
-
-        float p1y = orthoBottom + paddle_height;
-        float p2y = orthoTop    - paddle_height;
-
-        // Bottom paddle hit
-        int w = player1_big_paddle ? (int)(paddle_width*1.5f) : paddle_width;
-        if (b->y - b->radius < p1y + paddle_height && b->vy < 0) {
-            if (b->x >= player1_paddle_x - w/2 && b->x <= player1_paddle_x + w/2) {
-                b->y = p1y + paddle_height + b->radius;
+static void evReschedule(int entity, int tick) {
+    evVersion[entity]++;
+    evPush(tick, entity);
+}
 
-                float hit = (b->x - player1_paddle_x) / (w / 2.0f);
+// Advance up to maxTicks ticks; with stopOnScore, return right after the
+// first tick that changes a score. Returns the number of ticks advanced.
+int advanceTicks(int maxTicks, int stopOnScore) {
+    if (!game_running || maxTicks <= 0) return 0;
 
-                float base = fabsf(b->vy);
-                b->vy = base * 1.2f;
-                b->vx = hit * 8.0f + b->vx * 0.5f;
+    int start = sim_tick, end = sim_tick + maxTicks;
+    sim_cosmetics = 0;
 
-                float len = sqrtf(b->vx*b->vx + b->vy*b->vy);
-                float maxS = (currentMode == MODE_PVP) ? 25.0f : 30.0f;
+    // Keep cached timer sequences that still match, rebuild the rest
+    for (int i = 0; i < EV_TIMERS; i++) {
+        EvTimer* t = &evTimers[i];
+        int k = sim_tick - t->anchorTick;
+        if (!(k >= 0 && k <= t->len && *t->value == t->seq[k]))
+            evAnchorTimer(t);
+    }
 
-                if (len > maxS) {
-                    b->vx = (b->vx / len) * maxS;
-                    b->vy = (b->vy / len) * maxS;
-                } else {
-                    b->vx *= 1.05f;
-                    b->vy *= 1.05f;
-                }
+    evHeapSize = 0;
+    for (int i = 0; i < EV_BALLS; i++)
+        evReschedule(i, balls[i].active ? sim_tick + 1 : EV_NEVER);
+    for (int i = 0; i < EV_TIMERS; i++)
+        evReschedule(EV_BALLS + i, evTimerTick(&evTimers[i]));
+    evReschedule(EV_WHEEL, evWheelTick());
+
+    while (sim_tick < end) {
+        int next = evTop();
+        int quietUntil = (next <= end) ? next - 1 : end;
+
+        // Quiet ticks: only paddles can move
+        while (sim_tick < quietUntil) {
+            if (evPaddlesIdle()) {
+                sim_tick = quietUntil;
+                break;
             }
+            evMaterializeBalls(sim_tick);
+            updateControls(0.016f * slow_time_factor);
+            sim_tick++;
+        }
+        if (next > end) break;
+
+        // Event tick: run the real step
+        Ball before[EV_BALLS];
+        PowerUp pbefore[MAX_POWERUPS];
+        for (int i = 0; i < EV_TIMERS; i++)
+            *evTimers[i].value = evTimerValue(&evTimers[i], sim_tick);
+        evMaterializeBalls(sim_tick);
+        memcpy(before, balls, sizeof(before));
+        memcpy(pbefore, powerups, sizeof(pbefore));
+        int scoreBefore = player1_score + player2_score;
+
+        update();
+
+        int due[EV_ENTITIES] = {0};
+        while (evTop() == sim_tick) {
+            due[evHeap[0].entity] = 1;
+            evPop();
         }
 
-        // Top paddle hit
-        w = player2_big_paddle ? (int)(paddle_width*1.5f) : paddle_width;
-        if (b->y + b->radius > p2y - paddle_height && b->vy > 0) {
-            if (b->x >= player2_paddle_x - w/2 && b->x <= player2_paddle_x + w/2) {
-                b->y = p2y - paddle_height - b->radius;
+        int powerupsChanged = 0;
+        for (int k = 0; k < MAX_POWERUPS; k++)
+            if (powerups[k].active != pbefore[k].active ||
+                (powerups[k].active && (powerups[k].x != pbefore[k].x || powerups[k].y != pbefore[k].y)))
+                powerupsChanged = 1;
+
+        for (int i = 0; i < EV_BALLS; i++) {
+            const Ball* a = &before[i];
+            const Ball* b = &balls[i];
+            int changed = a->active != b->active || a->vx != b->vx || a->vy != b->vy ||
+                          a->originX != b->originX || a->originY != b->originY ||
+                          a->originTick != b->originTick || a->radius != b->radius;
+            // A changed ball gets one more real step so speed stats catch up
+            if (changed)
+                evReschedule(i, b->active ? sim_tick + 1 : EV_NEVER);
+            else if (due[i] || powerupsChanged)
+                evReschedule(i, evBallTick(b, sim_tick + 1));
+        }
 
-                float hit = (b->x - player2_paddle_x) / (w / 2.0f);
+        for (int i = 0; i < EV_TIMERS; i++)
+            if (evTimerChanged(&evTimers[i]) || due[EV_BALLS + i])
+                evReschedule(EV_BALLS + i, evTimerTick(&evTimers[i]));
+        evReschedule(EV_WHEEL, evWheelTick());
 
-                b->vy = -fabsf(b->vy) - 1.5f;
-                b->vx += hit * 3.0f;
+        if (stopOnScore && player1_score + player2_score != scoreBefore) break;
+    }
 
-                float len = sqrtf(b->vx*b->vx + b->vy*b->vy);
-                b->vx = (b->vx / len) * ball_speed;
-                b->vy = (b->vy / len) * ball_speed;
+    for (int i = 0; i < EV_TIMERS; i++)
+        *evTimers[i].value = evTimerValue(&evTimers[i], sim_tick);
+    evMaterializeBalls(sim_tick);
+    sim_cosmetics = 1;
+    return sim_tick - start;
+}
 
-                consecutive_hits++;
-                total_hits++;
-                if (consecutive_hits >= 3) {
-                    combo_multiplier = 2;
-                    combo_timer = 3.0f;
-                }
+//              Vectorised environments (headless)
+//
+// Many PvC matches stepped in lockstep for reinforcement learning. The
+// agent plays the bottom paddle against updateAI(). Each env is a
+// MatchState that takes its turn on the globals for one update(), the same
+// way tools/server.c steps rooms, so the game rules are the real ones. An
+// action is the paddle target as a share of the reachable half-width,
+// like the output of the learned policy; the observation is
+// matchObserve(1). An episode is one point: reward +points for scoring,
+// -points for conceding, and the env resets itself straight away. A rally
+// that outlasts ENV_MAX_TICKS ends the episode too, with no reward.
+
+#define ENV_OBS NN_INPUTS
+#define ENV_MAX_TICKS (60 * 60)     // one minute of play
 
-                switch (b->type) {
-                    case BALL_FIRE:    addParticle(b->x,b->y,1,0,0); ball_speed += 0.5f; break;
-                    case BALL_ICE:     player1_paddle_speed = 0.5f; addParticle(b->x,b->y,0.5f,0.8f,1); break;
-                    case BALL_MAGNETIC:b->vx += (player2_paddle_x - b->x) * 0.1f; break;
-                }
+typedef struct {
+    int count;
+    MatchState* state;          // count matches
+    int* ticks;                 // ticks into the current episode
+    MatchState start;           // a fresh match, copied in on every reset
+} VecEnv;
+
+// Allocates every env once; returns 0 when out of memory
+int envCreate(VecEnv* e, int count, DifficultyLevel difficulty, unsigned seed) {
+    e->count = count;
+    e->state = malloc(sizeof(MatchState) * (size_t)count);
+    e->ticks = calloc((size_t)count, sizeof(int));
+    if (!e->state || !e->ticks) {
+        free(e->state);
+        free(e->ticks);
+        return 0;
+    }
 
-                addParticle(b->x, b->y, 1.0f, 0.2f, 0.1f);
-                playSound(500 + (int)(fabsf(hit)*200), 100);
-            }
-        }
+    srand(seed);
+    fx_seed = seed;
+    currentMode = MODE_PVC;
+    currentDifficulty = difficulty;
+    player1_control = CONTROL_EXTERNAL;
+    player2_control = CONTROL_AUTO;
+    sim_cosmetics = 0;
+    sim_tick = 0;
+    initGame();
+    game_running = 1;
+    matchSave(&e->start);
+    return 1;
+}
 
-        // Score & respawn logic
-        if (b->y < orthoBottom) {
-            player2_score += combo_multiplier;
-            b->active = 0;
-            activeBalls--;
-            if (activeBalls <= 0) {
-                resetBall(&balls[0]);
-                balls[0].active = 1;
-                activeBalls = 1;
-            }
-            combo_multiplier = 1;
-            consecutive_hits = 0;
-            playSound(200,200);
-        }
+void envDestroy(VecEnv* e) {
+    free(e->state);
+    free(e->ticks);
+    e->state = NULL;
+    e->ticks = NULL;
+}
 
-        if (b->y > orthoTop) {
-            player1_score += combo_multiplier;
-            b->active = 0;
-            activeBalls--;
-            if (activeBalls <= 0) {
-                resetBall(&balls[0]);
-                balls[0].active = 1;
-                activeBalls = 1;
-            }
-            combo_multiplier = 1;
-            consecutive_hits = 0;
-            playSound(200,200);
-        }
+// New episode for env i; leaves it loaded on the globals
+static void envResetOne(VecEnv* e, int i) {
+    matchLoad(&e->start);
+    resetBall(&balls[0]);
+    e->ticks[i] = 0;
+}
+
+// Reset every env and write count x ENV_OBS observations
+void envReset(VecEnv* e, float* obs) {
+    for (int i = 0; i < e->count; i++) {
+        envResetOne(e, i);
+        matchSave(&e->state[i]);
+        matchObserve(1, obs + (size_t)i * ENV_OBS);
     }
+}
 
-    if (needsRedraw) redraw();
+// One tick of every env. actions[i] in [-1, 1]; writes the next
+// observations, rewards and done flags. A done env has already been reset
+// and obs holds the first observation of its next episode.
+void envStepAll(VecEnv* e, const float* actions, float* obs, float* reward, uint8_t* done) {
+    for (int i = 0; i < e->count; i++) {
+        matchLoad(&e->state[i]);
+        int p1 = player1_score, p2 = player2_score;
+
+        float a = actions[i];
+        a = a < -1.0f ? -1.0f : (a > 1.0f ? 1.0f : a);
+        player1_target_x = a * (orthoRight - paddle_width / 2);
+        update();
+        e->ticks[i]++;
+
+        reward[i] = (float)((player1_score - p1) - (player2_score - p2));
+        done[i] = player1_score != p1 || player2_score != p2 || e->ticks[i] >= ENV_MAX_TICKS;
+        if (done[i]) envResetOne(e, i);
+
+        matchSave(&e->state[i]);
+        matchObserve(1, obs + (size_t)i * ENV_OBS);
+    }
 }
+#endif // PONG_HEADLESS
 
+#ifndef PONG_HEADLESS
 // Windows message handler
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     static int mouseX, mouseY;
@@ -1457,6 +6355,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
                     glMatrixMode(GL_MODELVIEW);
                     correctPaddlePositions();
+                    replayResize();
                     fullscreen = 1;
                 } else {
                     SetWindowLong(hwnd, GWL_STYLE,   windowStyle);
@@ -1475,6 +6374,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     glOrtho(orthoLeft, orthoRight, orthoBottom, orthoTop, -1,1);
                     glMatrixMode(GL_MODELVIEW);
                     correctPaddlePositions();
+                    replayResize();
                     fullscreen = 0;
                 }
                 needsRedraw = 1;
@@ -1487,6 +6387,8 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     case '1': currentMode = MODE_PVP; initGame(); needsRedraw=1; break;
                     case '2': currentMode = MODE_DIFFICULTY_SELECT; needsRedraw=1; break;
                     case '3': currentMode = MODE_SPEED_SELECT; needsRedraw=1; break;
+                    case '4': currentMode = MODE_ARENA_SELECT; levelLoad(LEVEL_FILE); needsRedraw=1; break;
+                    case '5': mosaicInit(mosaic_count); SetTimer(hwnd,1,16,NULL); needsRedraw=1; break;
                     case VK_SPACE:
                         if ((currentMode == MODE_PVP || currentMode == MODE_PVC) && !game_running) {
                             resetBall(&balls[0]);
@@ -1495,7 +6397,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                             needsRedraw = 1;
                         }
                         break;
-                    case VK_ESCAPE: PostQuitMessage(0); break;
+                    case VK_ESCAPE: DestroyWindow(hwnd); break;   // WM_DESTROY closes the files
                 }
             }
             else if (currentMode == MODE_DIFFICULTY_SELECT) {
@@ -1518,29 +6420,109 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     case VK_ESCAPE: currentMode = MODE_MENU; needsRedraw=1; break;
                 }
             }
+            else if (currentMode == MODE_ARENA_SELECT) {
+                switch (wParam) {
+                    case VK_UP:
+                        if (arena_players < ARENA_MAX_PLAYERS) { arena_players++; playSound(600,100); }
+                        needsRedraw=1; break;
+                    case VK_DOWN:
+                        if (arena_players > ARENA_MIN_PLAYERS) { arena_players--; playSound(400,100); }
+                        needsRedraw=1; break;
+                    case VK_RETURN:
+                        currentMode = MODE_ARENA;
+                        initArena(arena_players, arena_players / 2, 1);
+                        game_running = 0;
+                        needsRedraw=1; break;
+                    case VK_ESCAPE: currentMode = MODE_MENU; needsRedraw=1; break;
+                }
+            }
             else {
                 switch (wParam) {
                     case 'M': case 'm':
                         game_running = 0; KillTimer(hwnd,1);
+                        fixed_physics = 0;
                         currentMode = MODE_MENU; initGame(); needsRedraw=1; break;
                     case 'R': case 'r':
-                        if (game_running) {
-                            player1_score = player2_score = 0;
-                            for (int j=0; j<3; j++) if (balls[j].active) resetBall(&balls[j]);
+                        if (currentMode == MODE_ARENA) {
+                            initArena(arena.players, arena.balls, 1);
+                            needsRedraw=1;
+                        } else if (currentMode == MODE_MOSAIC) {
+                            mosaicInit(mosaic.count);
+                            needsRedraw=1;
+                        } else if (fixed_physics) {
+                            fixInit(&fixed_match, (uint32_t)rand(), fixed_match.aiMask);
+                            needsRedraw=1;
+                        } else if (game_running) {
+                            restartMatch();
                             needsRedraw=1;
                         }
                         break;
                     case VK_SPACE:
                         if (!game_running) {
-                            resetBall(&balls[0]);
-                            game_running = 1;
+                            if (currentMode == MODE_ARENA || currentMode == MODE_MOSAIC || fixed_physics) game_running = 1;
+                            else serveBall();
                             SetTimer(hwnd,1,16,NULL);
                         } else {
                             game_running = 0;
                             KillTimer(hwnd,1);
                         }
                         needsRedraw=1; break;
-                    case VK_ESCAPE: PostQuitMessage(0); break;
+                    case 'N': case 'n':
+                        // Swap the computer paddle between heuristic and experimental learned AI
+                        if (currentMode == MODE_PVC && nnPolicy.loaded) {
+                            player2_control = (player2_control == CONTROL_NEURAL)
+                                ? CONTROL_AUTO : CONTROL_NEURAL;
+                            uint8_t control = (uint8_t)player2_control;
+                            replayOp(REPLAY_CONTROL, &control, 1);
+                            playSound(player2_control == CONTROL_NEURAL ? 900 : 600, 100);
+                        }
+                        break;
+                    case VK_F5:
+                        // Switch physics; either way a fresh match starts
+                        if (currentMode != MODE_ARENA && currentMode != MODE_MOSAIC) {
+                            fixed_physics = !fixed_physics;
+                            if (fixed_physics) {
+                                int ai1 = player1_control == CONTROL_AUTO || player1_control == CONTROL_NEURAL;
+                                int ai2 = currentMode == MODE_PVC ||
+                                          player2_control == CONTROL_AUTO || player2_control == CONTROL_NEURAL;
+                                initGame();
+                                fixInit(&fixed_match, (uint32_t)rand(), ai1 | ai2 << 1);
+                            } else {
+                                restartMatch();
+                            }
+                        }
+                        needsRedraw=1; break;
+                    case VK_UP: case VK_DOWN:
+                        // A square grid one side bigger or smaller, restarted
+                        if (currentMode == MODE_MOSAIC) {
+                            int side = mosaic.cols + (wParam == VK_UP ? 1 : -1);
+                            if (side * side >= MOSAIC_MIN && side * side <= MOSAIC_MAX) {
+                                mosaic_count = side * side;
+                                mosaicInit(mosaic_count);
+                                playSound(wParam == VK_UP ? 600 : 400, 100);
+                            }
+                            needsRedraw=1;
+                        }
+                        break;
+                    case VK_F9:
+                        late_latch = !late_latch;
+                        needsRedraw=1; break;
+                    case VK_F6:
+                        shader_fx = !shader_fx;
+                        needsRedraw=1; break;
+                    case VK_F8: {
+                        int on = !latency.on;
+                        memset(&latency, 0, sizeof(latency));
+                        latency.on = on;
+                        needsRedraw=1; break;
+                    }
+                    case VK_F7: {
+                        int on = !perf.on;
+                        memset(&perf, 0, sizeof(perf));
+                        perf.on = on;
+                        needsRedraw=1; break;
+                    }
+                    case VK_ESCAPE: DestroyWindow(hwnd); break;
                 }
 
                 // Update key states
@@ -1556,6 +6538,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     case 'W': case 'w': key_w_pressed = 1; break;
                     case 'S': case 's': key_s_pressed = 1; break;
                 }
+                if (!(lParam & (1 << 30))) latencyKeys();   // not an auto-repeat
             }
 
             if (needsRedraw) redraw();
@@ -1584,9 +6567,10 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             lastMouseX = mouseX;
 
             if (currentMode != MODE_MENU && currentMode != MODE_DIFFICULTY_SELECT &&
-                currentMode != MODE_SPEED_SELECT && !game_running) {
-                resetBall(&balls[0]);
-                game_running = 1;
+                currentMode != MODE_SPEED_SELECT && currentMode != MODE_ARENA_SELECT &&
+                !game_running) {
+                if (currentMode == MODE_ARENA || currentMode == MODE_MOSAIC || fixed_physics) game_running = 1;
+                else serveBall();
                 SetTimer(hwnd, 1, 16, NULL);
                 needsRedraw = 1;
                 redraw();
@@ -1612,6 +6596,10 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                         player2_target_x = glX;
                 }
 
+                if (player1_control == CONTROL_MOUSE && player1_target_x == glX) latencyInput(1, glX);
+                if (player2_control == CONTROL_MOUSE && player2_target_x == glX) latencyInput(2, glX);
+
+                replay_mouseMoved = 1;
                 needsRedraw = 1;
             }
 
@@ -1619,9 +6607,13 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             return 0;
         }
 
-        case WM_TIMER:
+        case WM_TIMER: {
+            double tickStart = perf.on ? frameClockMs() : 0;
             update();
+            last_tick_ms = frameClockMs();
+            if (perf.on) perfTick(last_tick_ms - tickStart);
             return 0;
+        }
 
         case WM_DESTROY:
             if (gameFont)  DeleteObject(gameFont);
@@ -1631,6 +6623,13 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 wglDeleteContext(hrc);
             }
             if (hdc) ReleaseDC(hwnd, hdc);
+            profileClose();
+            shareClose();
+            historyEndMatch();
+            historyFlush();
+            leaderEndMatch();
+            leaderClose();
+            replayClose();
             PostQuitMessage(0);
             return 0;
 
@@ -1648,6 +6647,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             glMatrixMode(GL_MODELVIEW);
 
             correctPaddlePositions();
+            replayResize();
             needsRedraw = 1;
             redraw();
             return 0;
@@ -1689,6 +6689,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     UpdateWindow(hwnd);
 
     initOpenGL();
+    loadPolicy(NN_POLICY_FILE);
+    profileOpen(PROFILE_FILE);
+    shareOpen(SHARE_NAME, 1);
+    leaderOpen(LEADER_FILE);
+    history_path = HISTORY_FILE;
+    replay_path = REPLAY_FILE;
+    quality_auto = 1;
 
     MSG msg = {0};
     while (GetMessage(&msg, NULL, 0, 0)) {
@@ -1697,4 +6704,5 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif // PONG_HEADLESS
\ No newline at end of file
@@ -0,0 +1,749 @@
+// softgl.h - CPU rasteriser for the OpenGL 1.x / GDI subset used by the
+// draw functions in pingpong.c, so frames can be produced without a window
+// or GPU (thumbnails, golden images, video export).
+//
+// pingpong.c includes this instead of gl.h/windows.h when built with
+// -DPONG_SOFTRENDER. Draw calls are recorded into a command list; the
+// frame is rasterised by swFinish() into an RGBA framebuffer, split into
+// tiles that worker threads take in turn. Within a tile commands run in
+// submission order, so blending matches the GL result. Spans are filled
+// four pixels at a time with SSE2 when available.
+//
+// Supported: glBegin/glEnd with points, lines, line strips/loops,
+// triangles, strips, fans and quads; smooth colour; SRC_ALPHA /
+// ONE_MINUS_SRC_ALPHA blending; 2D matrix stacks (ortho, translate, rotate
+// about z, scale); glClear; TextOutA with the bitmap font in glyphs.h.
+// Line smoothing is ignored.
+
+#ifndef SOFTGL_H
+#define SOFTGL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#include "glyphs.h"
+
+//              GL / GDI declarations
+
+typedef unsigned int GLenum;
+typedef unsigned int GLbitfield;
+typedef float GLfloat;
+typedef double GLdouble;
+typedef int GLint;
+typedef int GLsizei;
+
+#define GL_POINTS               0x0000
+#define GL_LINES                0x0001
+#define GL_LINE_LOOP            0x0002
+#define GL_LINE_STRIP           0x0003
+#define GL_TRIANGLES            0x0004
+#define GL_TRIANGLE_STRIP       0x0005
+#define GL_TRIANGLE_FAN         0x0006
+#define GL_QUADS                0x0007
+#define GL_SRC_ALPHA            0x0302
+#define GL_ONE_MINUS_SRC_ALPHA  0x0303
+#define GL_LINE_SMOOTH          0x0B20
+#define GL_LINE_SMOOTH_HINT     0x0C52
+#define GL_BLEND                0x0BE2
+#define GL_NICEST               0x1102
+#define GL_MODELVIEW            0x1700
+#define GL_PROJECTION           0x1701
+#define GL_SMOOTH               0x1D01
+#define GL_COLOR_BUFFER_BIT     0x4000
+
+typedef void* HWND;
+typedef void* HDC;
+typedef void* HGLRC;
+typedef const void* HGDIOBJ;
+typedef const struct SwFont* HFONT;
+typedef uint32_t COLORREF;
+
+#define RGB(r,g,b)   ((COLORREF)(((r) & 0xFF) | (((g) & 0xFF) << 8) | (((b) & 0xFF) << 16)))
+#define TRANSPARENT  1
+
+//              Limits
+
+#define SW_TILE_W       128
+#define SW_TILE_H       64
+#define SW_MAX_VERTS    4096    // per glBegin/glEnd
+#define SW_MAX_THREADS  64
+#define SW_STACK_DEPTH  32
+
+//              State
+
+// 2D affine transform: x' = a*x + c*y + e, y' = b*x + d*y + f
+typedef struct {
+    float a, b, c, d, e, f;
+} SwMatrix;
+
+typedef struct {
+    float x, y;                 // framebuffer pixels, y down
+    float c[4];                 // r, g, b, a
+} SwVertex;
+
+typedef enum {
+    SW_CMD_CLEAR,
+    SW_CMD_TRI,
+    SW_CMD_TEXT
+} SwCommandType;
+
+typedef struct {
+    SwCommandType type;
+    int x0, y0, x1, y1;         // pixel bounds, [x0,x1) x [y0,y1)
+    int blend;
+    int flat;
+    uint32_t color;             // CLEAR, TEXT and flat opaque TRI
+    // TRI: edge functions E = A*x + B*y + C, >= 0 inside, at pixel centres,
+    // and colour planes c = k + dx*x + dy*y
+    float A[3], B[3], C[3];
+    float k[4], dx[4], dy[4];
+    // TEXT
+    int text, len, height;
+} SwCommand;
+
+struct SwFont {
+    int height;
+};
+
+static const struct SwFont sw_fonts[] = {{24}, {32}};
+
+static uint32_t* sw_fb = NULL;          // RGBA8, row 0 at the top
+static uint32_t* sw_ownFb = NULL;       // allocated by swInit()
+static int sw_width = 0, sw_height = 0;
+
+static SwCommand* sw_cmds = NULL;
+static int sw_cmdCount = 0, sw_cmdCap = 0;
+static char* sw_textPool = NULL;
+static int sw_textLen = 0, sw_textCap = 0;
+
+static SwMatrix sw_stack[2][SW_STACK_DEPTH];
+static int sw_depth[2] = {0, 0};
+static int sw_matrixMode = 0;           // 0 = modelview, 1 = projection
+static SwMatrix sw_mvp;                 // viewport * projection * modelview
+static int sw_mvpDirty = 1;
+static int sw_viewport[4] = {0, 0, 0, 0};
+
+static float sw_color[4] = {1, 1, 1, 1};
+static float sw_clear[4] = {0, 0, 0, 1};
+static int sw_blend = 0;
+static float sw_lineWidth = 1.0f, sw_pointSize = 1.0f;
+
+static GLenum sw_prim;
+static SwVertex sw_verts[SW_MAX_VERTS];
+static int sw_vertCount = 0;
+
+static const struct SwFont* sw_font = &sw_fonts[0];
+static COLORREF sw_textColor = 0xFFFFFF;
+
+//              Matrices
+
+static SwMatrix swMul(SwMatrix m, SwMatrix n) {
+    SwMatrix r;
+    r.a = m.a * n.a + m.c * n.b;
+    r.b = m.b * n.a + m.d * n.b;
+    r.c = m.a * n.c + m.c * n.d;
+    r.d = m.b * n.c + m.d * n.d;
+    r.e = m.a * n.e + m.c * n.f + m.e;
+    r.f = m.b * n.e + m.d * n.f + m.f;
+    return r;
+}
+
+static SwMatrix* swTop() {
+    return &sw_stack[sw_matrixMode][sw_depth[sw_matrixMode]];
+}
+
+static void swApply(SwMatrix n) {
+    SwMatrix* t = swTop();
+    *t = swMul(*t, n);
+    sw_mvpDirty = 1;
+}
+
+static void swUpdateMvp() {
+    // NDC -> framebuffer pixels with y flipped so row 0 is the top
+    float vx = (float)sw_viewport[0], vy = (float)sw_viewport[1];
+    float vw = (float)sw_viewport[2], vh = (float)sw_viewport[3];
+    SwMatrix vp = {vw * 0.5f, 0, 0, -vh * 0.5f,
+                   vx + vw * 0.5f, (float)sw_height - (vy + vh * 0.5f)};
+    sw_mvp = swMul(vp, swMul(sw_stack[1][sw_depth[1]], sw_stack[0][sw_depth[0]]));
+    sw_mvpDirty = 0;
+}
+
+void glMatrixMode(GLenum mode) { sw_matrixMode = (mode == GL_PROJECTION); }
+
+void glLoadIdentity() {
+    SwMatrix id = {1, 0, 0, 1, 0, 0};
+    *swTop() = id;
+    sw_mvpDirty = 1;
+}
+
+void glPushMatrix() {
+    int m = sw_matrixMode;
+    if (sw_depth[m] + 1 >= SW_STACK_DEPTH) return;
+    sw_stack[m][sw_depth[m] + 1] = sw_stack[m][sw_depth[m]];
+    sw_depth[m]++;
+}
+
+void glPopMatrix() {
+    if (sw_depth[sw_matrixMode] > 0) sw_depth[sw_matrixMode]--;
+    sw_mvpDirty = 1;
+}
+
+void glOrtho(GLdouble l, GLdouble r, GLdouble b, GLdouble t, GLdouble n, GLdouble f) {
+    (void)n; (void)f;
+    SwMatrix o = {(float)(2.0 / (r - l)), 0, 0, (float)(2.0 / (t - b)),
+                  (float)(-(r + l) / (r - l)), (float)(-(t + b) / (t - b))};
+    swApply(o);
+}
+
+void glTranslatef(GLfloat x, GLfloat y, GLfloat z) {
+    (void)z;
+    SwMatrix t = {1, 0, 0, 1, x, y};
+    swApply(t);
+}
+
+// Only rotation about the z axis is meaningful in 2D
+void glRotatef(GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+    (void)x; (void)y;
+    if (z < 0) angle = -angle;
+    float r = angle * 3.14159265358979323846f / 180.0f;
+    float c = cosf(r), s = sinf(r);
+    SwMatrix m = {c, s, -s, c, 0, 0};
+    swApply(m);
+}
+
+void glScalef(GLfloat x, GLfloat y, GLfloat z) {
+    (void)z;
+    SwMatrix m = {x, 0, 0, y, 0, 0};
+    swApply(m);
+}
+
+void glViewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+    sw_viewport[0] = x; sw_viewport[1] = y;
+    sw_viewport[2] = w; sw_viewport[3] = h;
+    sw_mvpDirty = 1;
+}
+
+//              State setters
+
+void glColor3f(GLfloat r, GLfloat g, GLfloat b) {
+    sw_color[0] = r; sw_color[1] = g; sw_color[2] = b; sw_color[3] = 1.0f;
+}
+
+void glColor4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    sw_color[0] = r; sw_color[1] = g; sw_color[2] = b; sw_color[3] = a;
+}
+
+void glEnable(GLenum cap)  { if (cap == GL_BLEND) sw_blend = 1; }
+void glDisable(GLenum cap) { if (cap == GL_BLEND) sw_blend = 0; }
+void glBlendFunc(GLenum s, GLenum d) { (void)s; (void)d; }
+void glHint(GLenum target, GLenum mode) { (void)target; (void)mode; }
+void glShadeModel(GLenum mode) { (void)mode; }
+void glLineWidth(GLfloat w) { sw_lineWidth = w; }
+void glPointSize(GLfloat s) { sw_pointSize = s; }
+
+void glClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    sw_clear[0] = r; sw_clear[1] = g; sw_clear[2] = b; sw_clear[3] = a;
+}
+
+//              Command recording
+
+static uint32_t swPack(const float* c) {
+    uint32_t p = 0xFF000000u;
+    for (int i = 0; i < 3; i++) {
+        float v = c[i] < 0.0f ? 0.0f : (c[i] > 1.0f ? 1.0f : c[i]);
+        p |= (uint32_t)(v * 255.0f + 0.5f) << (8 * i);
+    }
+    return p;
+}
+
+static SwCommand* swPush(SwCommandType type) {
+    if (sw_cmdCount == sw_cmdCap) {
+        int cap = sw_cmdCap ? sw_cmdCap * 2 : 1024;
+        SwCommand* n = realloc(sw_cmds, sizeof(SwCommand) * cap);
+        if (!n) return NULL;
+        sw_cmds = n;
+        sw_cmdCap = cap;
+    }
+    SwCommand* c = &sw_cmds[sw_cmdCount++];
+    c->type = type;
+    return c;
+}
+
+// A full clear hides everything recorded before it, so those are dropped
+void glClear(GLbitfield mask) {
+    if (!(mask & GL_COLOR_BUFFER_BIT)) return;
+    sw_cmdCount = 0;
+    sw_textLen = 0;
+    SwCommand* c = swPush(SW_CMD_CLEAR);
+    if (!c) return;
+    c->x0 = 0; c->y0 = 0; c->x1 = sw_width; c->y1 = sw_height;
+    c->color = swPack(sw_clear);
+}
+
+static void swTriangle(const SwVertex* v0, const SwVertex* v1, const SwVertex* v2) {
+    float area = (v1->x - v0->x) * (v2->y - v0->y) - (v2->x - v0->x) * (v1->y - v0->y);
+    if (fabsf(area) < 1e-6f) return;
+    if (area < 0) { const SwVertex* t = v1; v1 = v2; v2 = t; area = -area; }
+
+    float minX = fminf(v0->x, fminf(v1->x, v2->x)), maxX = fmaxf(v0->x, fmaxf(v1->x, v2->x));
+    float minY = fminf(v0->y, fminf(v1->y, v2->y)), maxY = fmaxf(v0->y, fmaxf(v1->y, v2->y));
+    int x0 = (int)floorf(minX), x1 = (int)ceilf(maxX);
+    int y0 = (int)floorf(minY), y1 = (int)ceilf(maxY);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > sw_width)  x1 = sw_width;
+    if (y1 > sw_height) y1 = sw_height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    SwCommand* c = swPush(SW_CMD_TRI);
+    if (!c) return;
+    c->x0 = x0; c->y0 = y0; c->x1 = x1; c->y1 = y1;
+
+    // Edge i is opposite vertex i, so E_i / area is that vertex's weight
+    const SwVertex* v[3] = {v0, v1, v2};
+    for (int i = 0; i < 3; i++) {
+        const SwVertex* p = v[(i + 1) % 3];
+        const SwVertex* q = v[(i + 2) % 3];
+        c->A[i] = p->y - q->y;
+        c->B[i] = q->x - p->x;
+        c->C[i] = p->x * q->y - q->x * p->y;
+    }
+
+    int flat = 1, opaque = 1;
+    for (int ch = 0; ch < 4; ch++) {
+        c->k[ch] = c->dx[ch] = c->dy[ch] = 0.0f;
+        for (int i = 0; i < 3; i++) {
+            c->k[ch]  += c->C[i] * v[i]->c[ch] / area;
+            c->dx[ch] += c->A[i] * v[i]->c[ch] / area;
+            c->dy[ch] += c->B[i] * v[i]->c[ch] / area;
+        }
+        if (v0->c[ch] != v1->c[ch] || v0->c[ch] != v2->c[ch]) flat = 0;
+    }
+    for (int i = 0; i < 3; i++) if (v[i]->c[3] < 0.999f) opaque = 0;
+
+    c->flat = flat;
+    c->blend = sw_blend && !opaque;
+    c->color = swPack(v0->c);
+    if (flat) {
+        // Constant colour: drop the planes so the span fill can use k directly
+        for (int ch = 0; ch < 4; ch++) { c->k[ch] = v0->c[ch]; c->dx[ch] = c->dy[ch] = 0.0f; }
+    }
+}
+
+static void swQuad(const SwVertex* a, const SwVertex* b, const SwVertex* c, const SwVertex* d) {
+    swTriangle(a, b, c);
+    swTriangle(a, c, d);
+}
+
+static void swLine(const SwVertex* a, const SwVertex* b) {
+    float dx = b->x - a->x, dy = b->y - a->y;
+    float len = sqrtf(dx * dx + dy * dy);
+    if (len < 1e-6f) return;
+    float h = (sw_lineWidth < 1.0f ? 1.0f : sw_lineWidth) * 0.5f;
+    float nx = -dy / len * h, ny = dx / len * h;
+    SwVertex q[4] = {*a, *b, *b, *a};
+    q[0].x += nx; q[0].y += ny;
+    q[1].x += nx; q[1].y += ny;
+    q[2].x -= nx; q[2].y -= ny;
+    q[3].x -= nx; q[3].y -= ny;
+    swQuad(&q[0], &q[1], &q[2], &q[3]);
+}
+
+static void swPoint(const SwVertex* p) {
+    float h = (sw_pointSize < 1.0f ? 1.0f : sw_pointSize) * 0.5f;
+    SwVertex q[4] = {*p, *p, *p, *p};
+    q[0].x -= h; q[0].y -= h;
+    q[1].x += h; q[1].y -= h;
+    q[2].x += h; q[2].y += h;
+    q[3].x -= h; q[3].y += h;
+    swQuad(&q[0], &q[1], &q[2], &q[3]);
+}
+
+void glBegin(GLenum mode) {
+    sw_prim = mode;
+    sw_vertCount = 0;
+    if (sw_mvpDirty) swUpdateMvp();
+}
+
+void glVertex2f(GLfloat x, GLfloat y) {
+    if (sw_vertCount >= SW_MAX_VERTS) return;
+    SwVertex* v = &sw_verts[sw_vertCount++];
+    v->x = sw_mvp.a * x + sw_mvp.c * y + sw_mvp.e;
+    v->y = sw_mvp.b * x + sw_mvp.d * y + sw_mvp.f;
+    memcpy(v->c, sw_color, sizeof(v->c));
+}
+
+void glEnd() {
+    SwVertex* v = sw_verts;
+    int n = sw_vertCount;
+    switch (sw_prim) {
+        case GL_POINTS:
+            for (int i = 0; i < n; i++) swPoint(&v[i]);
+            break;
+        case GL_LINES:
+            for (int i = 0; i + 1 < n; i += 2) swLine(&v[i], &v[i + 1]);
+            break;
+        case GL_LINE_STRIP:
+        case GL_LINE_LOOP:
+            for (int i = 0; i + 1 < n; i++) swLine(&v[i], &v[i + 1]);
+            if (sw_prim == GL_LINE_LOOP && n > 2) swLine(&v[n - 1], &v[0]);
+            break;
+        case GL_TRIANGLES:
+            for (int i = 0; i + 2 < n; i += 3) swTriangle(&v[i], &v[i + 1], &v[i + 2]);
+            break;
+        case GL_TRIANGLE_STRIP:
+            for (int i = 2; i < n; i++) swTriangle(&v[i - 2], &v[i - 1], &v[i]);
+            break;
+        case GL_TRIANGLE_FAN:
+            for (int i = 2; i < n; i++) swTriangle(&v[0], &v[i - 1], &v[i]);
+            break;
+        case GL_QUADS:
+            for (int i = 0; i + 3 < n; i += 4) swQuad(&v[i], &v[i + 1], &v[i + 2], &v[i + 3]);
+            break;
+    }
+    sw_vertCount = 0;
+}
+
+//              GDI / WGL stand-ins
+
+int SwapBuffers(HDC dc) { (void)dc; return 1; }
+int wglMakeCurrent(HDC dc, HGLRC rc) { (void)dc; (void)rc; return 1; }
+int SetBkMode(HDC dc, int mode) { (void)dc; (void)mode; return TRANSPARENT; }
+
+COLORREF SetTextColor(HDC dc, COLORREF color) {
+    (void)dc;
+    COLORREF old = sw_textColor;
+    sw_textColor = color;
+    return old;
+}
+
+HGDIOBJ SelectObject(HDC dc, HGDIOBJ obj) {
+    (void)dc;
+    HGDIOBJ old = sw_font;
+    if (obj) sw_font = obj;
+    return old;
+}
+
+// Fonts are picked by cell height; anything but 32 gets the 24 px face
+HFONT swCreateFont(int height) {
+    return height >= 32 ? &sw_fonts[1] : &sw_fonts[0];
+}
+
+// (x, y) is the top-left corner of the text in framebuffer pixels
+int TextOutA(HDC dc, int x, int y, const char* s, int len) {
+    (void)dc;
+    if (len <= 0) return 1;
+    if (sw_textLen + len > sw_textCap) {
+        int cap = sw_textCap ? sw_textCap * 2 : 4096;
+        while (cap < sw_textLen + len) cap *= 2;
+        char* n = realloc(sw_textPool, cap);
+        if (!n) return 0;
+        sw_textPool = n;
+        sw_textCap = cap;
+    }
+    memcpy(sw_textPool + sw_textLen, s, len);
+
+    int h = sw_font->height;
+    int adv = (GLYPH_W * h + GLYPH_H / 2) / GLYPH_H;
+    SwCommand* c = swPush(SW_CMD_TEXT);
+    if (!c) return 0;
+    c->x0 = x < 0 ? 0 : x;
+    c->y0 = y < 0 ? 0 : y;
+    c->x1 = x + adv * len > sw_width ? sw_width : x + adv * len;
+    c->y1 = y + h > sw_height ? sw_height : y + h;
+    c->text = sw_textLen;
+    c->len = len;
+    c->height = h;
+    c->color = 0xFF000000u | (sw_textColor & 0xFFFFFF);
+    // Keep the unclipped origin for glyph placement
+    c->A[0] = (float)x;
+    c->A[1] = (float)y;
+    sw_textLen += len;
+    if (c->x0 >= c->x1 || c->y0 >= c->y1) sw_cmdCount--;
+    return 1;
+}
+
+//              Rasterisation
+
+static void swFillConst(uint32_t* row, int lo, int hi, uint32_t color) {
+    int i = lo;
+#if defined(__SSE2__)
+    __m128i v = _mm_set1_epi32((int)color);
+    for (; i + 4 <= hi; i += 4) _mm_storeu_si128((__m128i*)(row + i), v);
+#endif
+    for (; i < hi; i++) row[i] = color;
+}
+
+// Blend a span against the framebuffer; colour planes evaluated at (x, y)
+// pixel centres. Flat commands have zero gradients.
+static void swFillSpan(const SwCommand* c, uint32_t* row, int lo, int hi, float py) {
+    float base[4], step[4];
+    for (int ch = 0; ch < 4; ch++) {
+        base[ch] = c->k[ch] + c->dy[ch] * py + c->dx[ch] * (lo + 0.5f);
+        step[ch] = c->dx[ch];
+    }
+    int i = lo;
+#if defined(__SSE2__)
+    __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+    __m128 r = _mm_add_ps(_mm_set1_ps(base[0]), _mm_mul_ps(lane, _mm_set1_ps(step[0])));
+    __m128 g = _mm_add_ps(_mm_set1_ps(base[1]), _mm_mul_ps(lane, _mm_set1_ps(step[1])));
+    __m128 b = _mm_add_ps(_mm_set1_ps(base[2]), _mm_mul_ps(lane, _mm_set1_ps(step[2])));
+    __m128 a = _mm_add_ps(_mm_set1_ps(base[3]), _mm_mul_ps(lane, _mm_set1_ps(step[3])));
+    __m128 sr = _mm_set1_ps(step[0] * 4), sg = _mm_set1_ps(step[1] * 4);
+    __m128 sb = _mm_set1_ps(step[2] * 4), sa = _mm_set1_ps(step[3] * 4);
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), s255 = _mm_set1_ps(255.0f);
+    __m128i mask = _mm_set1_epi32(0xFF), alpha = _mm_set1_epi32((int)0xFF000000u);
+    for (; i + 4 <= hi; i += 4) {
+        __m128 cr = _mm_mul_ps(_mm_min_ps(_mm_max_ps(r, zero), one), s255);
+        __m128 cg = _mm_mul_ps(_mm_min_ps(_mm_max_ps(g, zero), one), s255);
+        __m128 cb = _mm_mul_ps(_mm_min_ps(_mm_max_ps(b, zero), one), s255);
+        if (c->blend) {
+            __m128 ca = _mm_min_ps(_mm_max_ps(a, zero), one);
+            __m128i d = _mm_loadu_si128((const __m128i*)(row + i));
+            __m128 dr = _mm_cvtepi32_ps(_mm_and_si128(d, mask));
+            __m128 dg = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(d, 8), mask));
+            __m128 db = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(d, 16), mask));
+            cr = _mm_add_ps(dr, _mm_mul_ps(_mm_sub_ps(cr, dr), ca));
+            cg = _mm_add_ps(dg, _mm_mul_ps(_mm_sub_ps(cg, dg), ca));
+            cb = _mm_add_ps(db, _mm_mul_ps(_mm_sub_ps(cb, db), ca));
+        }
+        __m128i px = _mm_or_si128(_mm_cvtps_epi32(cr),
+                     _mm_or_si128(_mm_slli_epi32(_mm_cvtps_epi32(cg), 8),
+                     _mm_or_si128(_mm_slli_epi32(_mm_cvtps_epi32(cb), 16), alpha)));
+        _mm_storeu_si128((__m128i*)(row + i), px);
+        r = _mm_add_ps(r, sr); g = _mm_add_ps(g, sg);
+        b = _mm_add_ps(b, sb); a = _mm_add_ps(a, sa);
+    }
+#endif
+    for (; i < hi; i++) {
+        float t = (float)(i - lo);
+        float s[4];
+        for (int ch = 0; ch < 4; ch++) {
+            float v = base[ch] + step[ch] * t;
+            s[ch] = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+        }
+        uint32_t d = row[i], p = 0xFF000000u;
+        for (int ch = 0; ch < 3; ch++) {
+            float v = s[ch] * 255.0f;
+            if (c->blend) {
+                float dv = (float)((d >> (8 * ch)) & 0xFF);
+                v = dv + (v - dv) * s[3];
+            }
+            p |= (uint32_t)(v + 0.5f) << (8 * ch);
+        }
+        row[i] = p;
+    }
+}
+
+static void swRasterTri(const SwCommand* c, int tx0, int ty0, int tx1, int ty1) {
+    int ya = c->y0 > ty0 ? c->y0 : ty0, yb = c->y1 < ty1 ? c->y1 : ty1;
+    int xa = c->x0 > tx0 ? c->x0 : tx0, xb = c->x1 < tx1 ? c->x1 : tx1;
+    int solid = c->flat && !c->blend;
+
+    for (int y = ya; y < yb; y++) {
+        float py = y + 0.5f;
+        float lo = (float)xa, hi = (float)xb;
+        int empty = 0;
+        for (int e = 0; e < 3; e++) {
+            float rest = c->B[e] * py + c->C[e];
+            if (c->A[e] > 0) {
+                // Left edge, inclusive: A*(i+0.5) + rest >= 0
+                float t = ceilf(-rest / c->A[e] - 0.5f);
+                if (t > lo) lo = t;
+            }
+            else if (c->A[e] < 0) {
+                // Right edge, exclusive so shared edges are drawn once
+                float t = ceilf(-rest / c->A[e] - 0.5f);
+                if (t < hi) hi = t;
+            }
+            else if (rest < 0 || (rest == 0 && c->B[e] <= 0)) {
+                empty = 1;
+            }
+        }
+        if (empty || lo >= hi) continue;
+
+        uint32_t* row = sw_fb + (size_t)y * sw_width;
+        if (solid) swFillConst(row, (int)lo, (int)hi, c->color);
+        else       swFillSpan(c, row, (int)lo, (int)hi, py);
+    }
+}
+
+static void swRasterText(const SwCommand* c, int tx0, int ty0, int tx1, int ty1) {
+    int ox = (int)c->A[0], oy = (int)c->A[1];
+    int h = c->height;
+    int adv = (GLYPH_W * h + GLYPH_H / 2) / GLYPH_H;
+    int ya = c->y0 > ty0 ? c->y0 : ty0, yb = c->y1 < ty1 ? c->y1 : ty1;
+
+    for (int k = 0; k < c->len; k++) {
+        int gx = ox + k * adv;
+        int xa = gx > tx0 ? gx : tx0, xb = gx + adv < tx1 ? gx + adv : tx1;
+        if (xa >= xb) continue;
+        unsigned ch = (unsigned char)sw_textPool[c->text + k];
+        if (ch < 32 || ch > 126) ch = '?';
+        const uint16_t* glyph = font_glyphs[ch - 32];
+        for (int y = ya; y < yb; y++) {
+            uint16_t bits = glyph[(y - oy) * GLYPH_H / h];
+            if (!bits) continue;
+            uint32_t* row = sw_fb + (size_t)y * sw_width;
+            for (int x = xa; x < xb; x++)
+                if (bits & (0x8000 >> ((x - gx) * GLYPH_W / adv))) row[x] = c->color;
+        }
+    }
+}
+
+static void swRasterTile(int tile) {
+    int tilesX = (sw_width + SW_TILE_W - 1) / SW_TILE_W;
+    int tx0 = (tile % tilesX) * SW_TILE_W, ty0 = (tile / tilesX) * SW_TILE_H;
+    int tx1 = tx0 + SW_TILE_W, ty1 = ty0 + SW_TILE_H;
+    if (tx1 > sw_width)  tx1 = sw_width;
+    if (ty1 > sw_height) ty1 = sw_height;
+
+    for (int i = 0; i < sw_cmdCount; i++) {
+        const SwCommand* c = &sw_cmds[i];
+        if (c->x1 <= tx0 || c->x0 >= tx1 || c->y1 <= ty0 || c->y0 >= ty1) continue;
+        switch (c->type) {
+            case SW_CMD_CLEAR:
+                for (int y = ty0; y < ty1; y++)
+                    swFillConst(sw_fb + (size_t)y * sw_width, tx0, tx1, c->color);
+                break;
+            case SW_CMD_TRI:
+                swRasterTri(c, tx0, ty0, tx1, ty1);
+                break;
+            case SW_CMD_TEXT:
+                swRasterText(c, tx0, ty0, tx1, ty1);
+                break;
+        }
+    }
+}
+
+//              Worker threads
+
+static int sw_threads = 1;
+static int sw_tileCount = 0;
+static int sw_nextTile = 0;
+
+#ifndef _WIN32
+static pthread_t sw_workers[SW_MAX_THREADS];
+static pthread_mutex_t sw_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sw_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sw_idle = PTHREAD_COND_INITIALIZER;
+static int sw_frame = 0, sw_busy = 0, sw_quit = 0;
+#endif
+
+static void swRunTiles() {
+    int t;
+    while ((t = __atomic_fetch_add(&sw_nextTile, 1, __ATOMIC_RELAXED)) < sw_tileCount)
+        swRasterTile(t);
+}
+
+#ifndef _WIN32
+static void* swWorker(void* arg) {
+    (void)arg;
+    int seen = 0;
+    pthread_mutex_lock(&sw_lock);
+    for (;;) {
+        while (sw_frame == seen && !sw_quit) pthread_cond_wait(&sw_wake, &sw_lock);
+        if (sw_quit) break;
+        seen = sw_frame;
+        pthread_mutex_unlock(&sw_lock);
+
+        swRunTiles();
+
+        pthread_mutex_lock(&sw_lock);
+        if (--sw_busy == 0) pthread_cond_signal(&sw_idle);
+    }
+    pthread_mutex_unlock(&sw_lock);
+    return NULL;
+}
+#endif
+
+//              Public API
+
+// Allocate a width x height framebuffer and start threads - 1 helpers.
+// Returns 0 on failure.
+int swInit(int width, int height, int threads) {
+    sw_fb = sw_ownFb = calloc((size_t)width * height, sizeof(uint32_t));
+    if (!sw_fb) return 0;
+    sw_width = width;
+    sw_height = height;
+    sw_tileCount = ((width + SW_TILE_W - 1) / SW_TILE_W) * ((height + SW_TILE_H - 1) / SW_TILE_H);
+    glViewport(0, 0, width, height);
+    for (int m = 0; m < 2; m++) {
+        sw_matrixMode = m;
+        glLoadIdentity();
+    }
+    sw_matrixMode = 0;
+
+#ifdef _WIN32
+    (void)threads;
+    sw_threads = 1;
+#else
+    if (threads < 1) threads = 1;
+    if (threads > SW_MAX_THREADS) threads = SW_MAX_THREADS;
+    sw_threads = 1;
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&sw_workers[i], NULL, swWorker, NULL) != 0) break;
+        sw_threads++;
+    }
+#endif
+    return 1;
+}
+
+// Make swFinish() rasterise into fb (sw_width * sw_height pixels, owned by
+// the caller) instead of the built-in framebuffer; NULL switches back
+void swSetTarget(uint32_t* fb) {
+    sw_fb = fb ? fb : sw_ownFb;
+}
+
+// Rasterise everything recorded since the last swFinish() into sw_fb
+void swFinish() {
+    sw_nextTile = 0;
+#ifndef _WIN32
+    if (sw_threads > 1) {
+        pthread_mutex_lock(&sw_lock);
+        sw_busy = sw_threads - 1;
+        sw_frame++;
+        pthread_cond_broadcast(&sw_wake);
+        pthread_mutex_unlock(&sw_lock);
+
+        swRunTiles();
+
+        pthread_mutex_lock(&sw_lock);
+        while (sw_busy > 0) pthread_cond_wait(&sw_idle, &sw_lock);
+        pthread_mutex_unlock(&sw_lock);
+    }
+    else
+#endif
+    swRunTiles();
+
+    sw_cmdCount = 0;
+    sw_textLen = 0;
+}
+
+void swShutdown() {
+#ifndef _WIN32
+    pthread_mutex_lock(&sw_lock);
+    sw_quit = 1;
+    pthread_cond_broadcast(&sw_wake);
+    pthread_mutex_unlock(&sw_lock);
+    for (int i = 0; i < sw_threads - 1; i++) pthread_join(sw_workers[i], NULL);
+    sw_quit = 0;
+#endif
+    sw_threads = 1;
+    free(sw_ownFb);
+    free(sw_cmds);
+    free(sw_textPool);
+    sw_fb = sw_ownFb = NULL;
+    sw_cmds = NULL;
+    sw_textPool = NULL;
+    sw_cmdCount = sw_cmdCap = sw_textLen = sw_textCap = 0;
+}
+
+#endif // SOFTGL_H
@@ -0,0 +1,112 @@
+// Measures how the arena tick grows with player and ball count.
+//
+// Every paddle is computer controlled. For each players x balls pair the
+// arena is warmed up and then updateArena() is timed over many ticks. The
+// AI looks at every ball for every paddle and each ball is tested against
+// one paddle, so the cost should follow players x balls plus balls.
+// Hits and goals per 1000 ticks show the AI is still defending.
+//
+// A second table scatters level pieces (levelScatter) over an 8-player
+// arena and times the tick with the BVH and with every piece tested
+// (level_brute). Probes are BVH nodes plus pieces looked at per ball per
+// tick and should grow with the log of the piece count. The balls must
+// come out the same either way; the exit status is 1 if they do not.
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/arenabench.c -o arenabench -lm
+// Examples:
+//   ./arenabench
+//   ./arenabench --ticks 200000 --difficulty medium
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [--ticks N] [--seed N] [--difficulty medium|hard]\n", prog);
+}
+
+// Warm up, then time ticks of updateArena(); ns per tick
+static double run(int players, int balls, unsigned seed, int ticks, unsigned* hits, unsigned* goals) {
+    srand(seed);
+    initArena(players, balls, 0);
+    for (int i = 0; i < 600; i++) updateArena();
+    unsigned hits0 = arena.hits, goals0 = arena.goals;
+
+    double t0 = nowSeconds();
+    for (int i = 0; i < ticks; i++) updateArena();
+    double t = nowSeconds() - t0;
+
+    *hits = arena.hits - hits0;
+    *goals = arena.goals - goals0;
+    return t * 1e9 / ticks;
+}
+
+int main(int argc, char** argv) {
+    static const int playerCounts[] = {4, 6, 8, 12, 16};
+    static const int ballCounts[] = {1, 8, 32, 64};
+    int ticks = 100000, failed = 0;
+    unsigned seed = 1;
+
+    currentDifficulty = DIFFICULTY_HARD;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--ticks") && i + 1 < argc)     ticks = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--difficulty") && i + 1 < argc) {
+            const char* d = argv[++i];
+            if (!strcmp(d, "medium"))    currentDifficulty = DIFFICULTY_MEDIUM;
+            else if (!strcmp(d, "hard")) currentDifficulty = DIFFICULTY_HARD;
+            else { usage(argv[0]); return 2; }
+        }
+        else { usage(argv[0]); return 2; }
+    }
+    if (ticks < 1) { usage(argv[0]); return 2; }
+
+    currentMode = MODE_ARENA;
+    game_running = 1;
+
+    printf("%d ticks per run, budget %.1f ms per tick at 60 Hz\n\n", ticks, 1000.0 / 60);
+    printf("players  balls   ns/tick     ticks/s   budget  hits/1k  goals/1k\n");
+    for (size_t p = 0; p < sizeof(playerCounts) / sizeof(playerCounts[0]); p++) {
+        for (size_t b = 0; b < sizeof(ballCounts) / sizeof(ballCounts[0]); b++) {
+            unsigned hits, goals;
+            double ns = run(playerCounts[p], ballCounts[b], seed, ticks, &hits, &goals);
+            printf("%7d  %5d  %8.1f  %10.0f  %6.4f%%  %7.1f  %8.1f\n",
+                   arena.players, arena.balls, ns, 1e9 / ns, ns / (1e9 / 60) * 100,
+                   hits * 1000.0 / ticks, goals * 1000.0 / ticks);
+        }
+    }
+
+    static const int pieceCounts[] = {16, 64, 256, 1024};
+    static const int levelBalls[] = {8, 64};
+    int levelTicks = ticks / 10 > 0 ? ticks / 10 : 1;
+    printf("\nlevel pieces, 8 players, %d ticks per run\n\n", levelTicks);
+    printf(" pieces  balls   ns/tick  probes/ball  brute ns  speedup  state\n");
+    for (size_t n = 0; n < sizeof(pieceCounts) / sizeof(pieceCounts[0]); n++) {
+        for (size_t b = 0; b < sizeof(levelBalls) / sizeof(levelBalls[0]); b++) {
+            unsigned hits, goals;
+            levelScatter(pieceCounts[n], seed, ARENA_RADIUS * cosf(PI / 8) - 80);
+            double ns = run(8, levelBalls[b], seed, levelTicks, &hits, &goals);
+            double probes = (double)arena.probed / ((600.0 + levelTicks) * arena.balls);
+            Arena bvh = arena;
+
+            level_brute = 1;
+            double bruteNs = run(8, levelBalls[b], seed, levelTicks, &hits, &goals);
+            level_brute = 0;
+            Arena brute = arena;
+            memcpy(brute.probes, bvh.probes, sizeof(bvh.probes));
+            brute.probed = bvh.probed;
+            int same = memcmp(&bvh, &brute, sizeof(bvh)) == 0;
+            failed |= !same;
+            printf("%7d  %5d  %8.1f  %11.1f  %8.1f  %6.2fx  %s\n", level.pieces, arena.balls,
+                   ns, probes, bruteNs, bruteNs / ns, same ? "identical" : "DIFFERS");
+        }
+    }
+    levelClear();
+    return failed;
+}
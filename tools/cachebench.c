@@ -0,0 +1,181 @@
+// Measures what the per-tick systems cost in memory traffic.
+//
+// match  plays one AI-vs-AI match with effects on (particles, trails,
+//        power-up animation) and times update(). Besides time it reports
+//        the entity component bytes the systems read per tick, counted
+//        from the live entities.
+// rooms  steps many matches the way tools/server.c does (matchLoad,
+//        update, matchSave; effects off) so the state stops fitting in
+//        cache and the size of MatchState shows up in the miss counts.
+//
+// Cache misses are read with perf_event_open (L1D read misses and
+// last-level misses, user space only). Virtual machines often hide the
+// hardware counters; only time is shown then.
+//
+// Build (Linux):
+//   gcc -O2 tools/cachebench.c -o cachebench -lm
+// Examples:
+//   ./cachebench
+//   ./cachebench --ticks 500000 --rooms 50000
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//              Counters
+
+static int counterFd[2] = {-1, -1};
+static const char* counterName[2] = {"L1D read misses", "LLC misses"};
+
+static int openCounter(uint32_t type, uint64_t config) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = type;
+    a.config = config;
+    a.disabled = 1;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+static void countersOpen(void) {
+    counterFd[0] = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                               (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    counterFd[1] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    if (counterFd[0] < 0 && counterFd[1] < 0)
+        printf("hardware cache counters unavailable (%s); showing time only\n\n", strerror(errno));
+}
+
+static void countersStart(void) {
+    for (int i = 0; i < 2; i++)
+        if (counterFd[i] >= 0) {
+            ioctl(counterFd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counterFd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+}
+
+// Prints the misses per unit of work since countersStart()
+static void countersReport(double units, const char* unit) {
+    for (int i = 0; i < 2; i++) {
+        uint64_t v = 0;
+        if (counterFd[i] < 0) continue;
+        ioctl(counterFd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counterFd[i], &v, sizeof(v)) != sizeof(v)) continue;
+        printf("  %-18s %10.2f per %s\n", counterName[i], v / units, unit);
+    }
+}
+
+//              Scenarios
+
+static void setupMatch(unsigned seed) {
+    srand(seed);
+    fx_seed = seed;
+    currentMode = MODE_PVP;
+    currentDifficulty = DIFFICULTY_HARD;
+    pvp_ball_speed = 16.0f;
+    player1_control = CONTROL_AUTO;
+    player2_control = CONTROL_AUTO;
+    clearParticles();
+    powerup_timer = 0.0f;
+    animation_time = 0.0f;
+    sim_tick = 0;
+    initGame();
+    resetBall(&balls[0]);
+    game_running = 1;
+}
+
+// Component bytes the per-tick systems read with the current live set
+static double entityBytes(void) {
+    double bytes = sizeof(balls) + sizeof(powerups);
+    for (int i = 0; i < 3; i++) if (balls[i].active) bytes += sizeof(BallFx);
+    for (int i = 0; i < MAX_POWERUPS; i++) if (powerups[i].active) bytes += sizeof(PowerUpFx);
+    return bytes + particle_pool.count * (double)sizeof(ParticleBody);
+}
+
+static void benchMatch(int ticks) {
+    setupMatch(1);
+    sim_cosmetics = 1;
+    for (int i = 0; i < 600; i++) update();
+
+    double bytes = 0, particles = 0, t = 0;
+    countersStart();
+    for (int i = 0; i < ticks; i++) {
+        double t0 = nowSeconds();
+        update();
+        t += nowSeconds() - t0;
+        bytes += entityBytes();
+        particles += particle_pool.count;
+    }
+    printf("match, effects on: %d ticks\n", ticks);
+    printf("  %-18s %10.1f ns per tick\n", "update()", t * 1e9 / ticks);
+    printf("  %-18s %10.1f per tick (%.1f live particles)\n", "entity bytes read",
+           bytes / ticks, particles / ticks);
+    countersReport(ticks, "tick");
+}
+
+static void benchRooms(int rooms, int ticks) {
+    MatchState* state = malloc(sizeof(MatchState) * (size_t)rooms);
+    if (!state) { fprintf(stderr, "out of memory\n"); exit(1); }
+
+    sim_cosmetics = 0;
+    for (int r = 0; r < rooms; r++) {
+        setupMatch((unsigned)r + 1);
+        matchSave(&state[r]);
+    }
+
+    countersStart();
+    double t0 = nowSeconds();
+    for (int k = 0; k < ticks; k++)
+        for (int r = 0; r < rooms; r++) {
+            matchLoad(&state[r]);
+            update();
+            matchSave(&state[r]);
+        }
+    double t = nowSeconds() - t0;
+    double steps = (double)rooms * ticks;
+
+    printf("rooms, effects off: %d rooms x %d ticks, %zu-byte MatchState (%.1f MB)\n",
+           rooms, ticks, sizeof(MatchState), sizeof(MatchState) * (double)rooms / (1 << 20));
+    printf("  %-18s %10.1f ns per room-tick\n", "load+update+save", t * 1e9 / steps);
+    countersReport(steps, "room-tick");
+    free(state);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [--ticks N] [--rooms N] [--room-ticks N]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int ticks = 200000, rooms = 20000, roomTicks = 50;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--ticks") && i + 1 < argc)           ticks = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--rooms") && i + 1 < argc)      rooms = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--room-ticks") && i + 1 < argc) roomTicks = atoi(argv[++i]);
+        else { usage(argv[0]); return 2; }
+    }
+    if (ticks < 1 || rooms < 1 || roomTicks < 1) { usage(argv[0]); return 2; }
+
+    printf("Ball %zu B + BallFx %zu B, PowerUp %zu B + PowerUpFx %zu B, "
+           "ParticleBody %zu B + ParticleTint %zu B\n\n",
+           sizeof(Ball), sizeof(BallFx), sizeof(PowerUp), sizeof(PowerUpFx),
+           sizeof(ParticleBody), sizeof(ParticleTint));
+
+    countersOpen();
+    benchMatch(ticks);
+    printf("\n");
+    benchRooms(rooms, roomTicks);
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Throughput of the vectorised RL environments (envCreate / envStepAll).
+//
+// Each worker process owns --envs environments and steps them all --steps
+// times with one of the built-in policies:
+//   track   aim the paddle at the first ball's x (read from the observation)
+//   random  a new uniform action every step
+//   idle    stay in the middle
+// Workers are processes because the simulation lives in globals. Reports
+// env-steps per second for all workers together, plus episodes and the
+// share of points the policy won, as a check that it really plays.
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/envbench.c -o envbench -lm
+// Examples:
+//   ./envbench
+//   ./envbench --envs 4096 --steps 2000 --workers 8 --policy random
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+#include <sys/wait.h>
+
+typedef struct {
+    double seconds;
+    long steps, episodes, points, won;
+} Result;
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static Result run(int envs, int steps, int policy, unsigned seed) {
+    Result r = {0};
+    VecEnv env;
+    if (!envCreate(&env, envs, DIFFICULTY_MEDIUM, seed)) { fprintf(stderr, "out of memory\n"); exit(1); }
+
+    float* obs = malloc(sizeof(float) * ENV_OBS * (size_t)envs);
+    float* actions = malloc(sizeof(float) * (size_t)envs);
+    float* reward = malloc(sizeof(float) * (size_t)envs);
+    uint8_t* done = malloc((size_t)envs);
+    if (!obs || !actions || !reward || !done) { fprintf(stderr, "out of memory\n"); exit(1); }
+
+    float scale = orthoRight / (orthoRight - paddle_width / 2);
+    envReset(&env, obs);
+    double t0 = nowSeconds();
+    for (int s = 0; s < steps; s++) {
+        for (int i = 0; i < envs; i++) {
+            const float* o = obs + (size_t)i * ENV_OBS;
+            if (policy == 0)      actions[i] = o[1] * scale;
+            else if (policy == 1) actions[i] = rand() / (float)RAND_MAX * 2.0f - 1.0f;
+            else                  actions[i] = 0;
+        }
+        envStepAll(&env, actions, obs, reward, done);
+        for (int i = 0; i < envs; i++) {
+            r.episodes += done[i];
+            r.points += reward[i] != 0;
+            r.won += reward[i] > 0;
+        }
+    }
+    r.seconds = nowSeconds() - t0;
+    r.steps = (long)steps * envs;
+
+    free(obs); free(actions); free(reward); free(done);
+    envDestroy(&env);
+    return r;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [--envs N] [--steps N] [--workers N] [--policy track|random|idle]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    static const char* policies[] = {"track", "random", "idle"};
+    int envs = 1024, steps = 1000, workers = 1, policy = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--envs") && i + 1 < argc)         envs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--steps") && i + 1 < argc)   steps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--workers") && i + 1 < argc) workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--policy") && i + 1 < argc) {
+            const char* p = argv[++i];
+            for (policy = 0; policy < 3 && strcmp(p, policies[policy]); policy++) {}
+            if (policy == 3) { usage(argv[0]); return 2; }
+        }
+        else { usage(argv[0]); return 2; }
+    }
+    if (envs < 1 || steps < 1 || workers < 1) { usage(argv[0]); return 2; }
+
+    int fds[2];
+    if (pipe(fds) != 0) { perror("pipe"); return 1; }
+    for (int w = 0; w < workers; w++) {
+        pid_t pid = fork();
+        if (pid < 0) { perror("fork"); return 1; }
+        if (pid == 0) {
+            close(fds[0]);
+            Result r = run(envs, steps, policy, (unsigned)w + 1);
+            if (write(fds[1], &r, sizeof(r)) != sizeof(r)) _exit(1);
+            _exit(0);
+        }
+    }
+    close(fds[1]);
+
+    Result total = {0}, r;
+    while (read(fds[0], &r, sizeof(r)) == sizeof(r)) {
+        if (r.seconds > total.seconds) total.seconds = r.seconds;
+        total.steps += r.steps;
+        total.episodes += r.episodes;
+        total.points += r.points;
+        total.won += r.won;
+    }
+    while (wait(NULL) > 0) {}
+
+    printf("%d worker%s x %d envs x %d steps, policy %s, %zu-byte MatchState per env\n",
+           workers, workers == 1 ? "" : "s", envs, steps, policies[policy], sizeof(MatchState));
+    printf("%.2f M env-steps/s (%.1f ns per env-step per worker)\n",
+           total.steps / total.seconds / 1e6, total.seconds * 1e9 / (total.steps / workers));
+    printf("%ld episodes, %.1f steps each, policy won %.1f%% of points\n",
+           total.episodes, total.episodes ? (double)total.steps / total.episodes : 0.0,
+           total.points ? total.won * 100.0 / total.points : 0.0);
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Checks and benchmarks the event-driven engine (advanceTicks) against the
+// fixed-step engine (update() once per tick).
+//
+// Each scenario is played twice from the same seed. Gameplay state is
+// hashed at regular checkpoints and must match bit for bit; cosmetic state
+// (particles, trails, animation time) is left out of the comparison.
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/eventsim.c -o eventsim -lm
+// Usage:
+//   ./eventsim [ticks] [checkpoint]
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+typedef struct {
+    const char* name;
+    GameMode mode;
+    DifficultyLevel difficulty;
+    ControlMode p1, p2;
+} Scenario;
+
+static const Scenario scenarios[] = {
+    {"AI vs AI, medium",       MODE_PVP, DIFFICULTY_MEDIUM, CONTROL_AUTO,  CONTROL_AUTO},
+    {"AI vs AI, hard",         MODE_PVP, DIFFICULTY_HARD,   CONTROL_AUTO,  CONTROL_AUTO},
+    {"PvC, idle player",       MODE_PVC, DIFFICULTY_HARD,   CONTROL_MOUSE, CONTROL_AUTO},
+    {"scripted idle paddles",  MODE_PVP, DIFFICULTY_MEDIUM, CONTROL_MOUSE, CONTROL_MOUSE}
+};
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void setup(const Scenario* s, unsigned seed) {
+    srand(seed);
+    fx_seed = seed;
+    currentMode = s->mode;
+    currentDifficulty = s->difficulty;
+    pvp_ball_speed = 16.0f;
+    player1_control = s->p1;
+    player2_control = s->p2;
+    clearParticles();
+    powerup_timer = 0.0f;
+    animation_time = 0.0f;
+    max_ball_speed = 0.0f;
+    powerups_collected = 0;
+    achievements_unlocked = 0;
+    for (int i = 0; i < ACHIEVEMENT_COUNT; i++) achievements[i].unlocked = achievements[i].progress = 0;
+    sim_tick = 0;
+    initGame();
+    resetBall(&balls[0]);
+    game_running = 1;
+}
+
+static unsigned long long fnv(unsigned long long h, const void* p, size_t n) {
+    const unsigned char* c = p;
+    for (size_t i = 0; i < n; i++) { h ^= c[i]; h *= 1099511628211ULL; }
+    return h;
+}
+
+#define HASH(v) (h = fnv(h, &(v), sizeof(v)))
+
+static unsigned long long stateHash() {
+    unsigned long long h = 1469598103934665603ULL;
+    HASH(sim_tick); HASH(player1_score); HASH(player2_score);
+    for (int i = 0; i < 3; i++) {
+        Ball* b = &balls[i];
+        HASH(b->active);
+        if (!b->active) continue;
+        HASH(b->x); HASH(b->y); HASH(b->vx); HASH(b->vy);
+        HASH(b->radius); HASH(b->type);
+        HASH(b->originX); HASH(b->originY); HASH(b->originTick);
+    }
+    for (int i = 0; i < MAX_POWERUPS; i++) {
+        HASH(powerups[i].active);
+        if (powerups[i].active) { HASH(powerups[i].x); HASH(powerups[i].y); HASH(powerups[i].type); }
+    }
+    HASH(player1_paddle_x); HASH(player2_paddle_x);
+    HASH(player1_target_x); HASH(player2_target_x);
+    HASH(player1_paddle_speed); HASH(player2_paddle_speed);
+    HASH(player1_big_paddle); HASH(player2_big_paddle);
+    HASH(powerup_timer); HASH(slow_time_factor); HASH(combo_multiplier);
+    for (int k = 0; k < TIMER_KINDS; k++)
+        for (int a = 0; a < TIMER_ARGS; a++) {
+            int expire = timerExpiry((TimerKind)k, a);
+            HASH(expire);
+        }
+    HASH(consecutive_hits); HASH(total_hits);
+    HASH(ball_speed); HASH(activeBalls);
+    HASH(max_ball_speed); HASH(powerups_collected); HASH(achievements_unlocked);
+    return h;
+}
+
+int main(int argc, char** argv) {
+    int ticks = argc > 1 ? atoi(argv[1]) : 1000000;
+    int checkpoint = argc > 2 ? atoi(argv[2]) : 1000;
+    if (ticks <= 0 || checkpoint <= 0) { fprintf(stderr, "usage: %s [ticks] [checkpoint]\n", argv[0]); return 2; }
+    int nChecks = (ticks + checkpoint - 1) / checkpoint;
+    unsigned long long* ref = malloc(sizeof(*ref) * nChecks);
+    int failures = 0;
+
+    printf("%-24s %12s %12s %9s  %s\n", "scenario", "fixed t/s", "event t/s", "speedup", "result");
+
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        const Scenario* sc = &scenarios[s];
+
+        setup(sc, 42 + (unsigned)s);
+        double t0 = nowSeconds();
+        for (int c = 0; c < nChecks; c++) {
+            int n = (c == nChecks - 1) ? ticks - c * checkpoint : checkpoint;
+            for (int i = 0; i < n; i++) update();
+            ref[c] = stateHash();
+        }
+        double tFixed = nowSeconds() - t0;
+        int refRand = rand();
+        int refScore1 = player1_score, refScore2 = player2_score;
+
+        setup(sc, 42 + (unsigned)s);
+        int firstBad = -1;
+        t0 = nowSeconds();
+        for (int c = 0; c < nChecks; c++) {
+            int n = (c == nChecks - 1) ? ticks - c * checkpoint : checkpoint;
+            advanceTicks(n, 0);
+            if (firstBad < 0 && stateHash() != ref[c]) firstBad = c;
+        }
+        double tEvent = nowSeconds() - t0;
+        int ok = firstBad < 0 && rand() == refRand;
+        if (!ok) failures++;
+
+        printf("%-24s %12.0f %12.0f %8.1fx  %s (score %d:%d)",
+               sc->name, ticks / tFixed, ticks / tEvent, tFixed / tEvent,
+               ok ? "tick-exact" : "MISMATCH", refScore1, refScore2);
+        if (firstBad >= 0) printf(" first diff before tick %d", (firstBad + 1) * checkpoint);
+        printf("\n");
+    }
+
+    free(ref);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,639 @@
+// Replay tool and video exporter for pong_replay.prp files.
+//
+// record plays matches headlessly with replay recording on (AI vs AI, and
+//        a scripted keyboard player vs the computer), for test material;
+//        the game itself records every match to pong_replay.prp
+// list   re-simulates every match in a replay file and prints its result
+// video  re-simulates one match with update() and draws every tick with
+//        display() through softgl.h, then encodes raw YUV4MPEG2 ("-" for
+//        stdout) or a numbered PNG sequence. The simulation thread renders
+//        into a ring of --queue frame buffers (rasterising on --threads
+//        tile workers) while --encoders threads convert and write them in
+//        order, so memory stays flat however long the match is
+//
+// Video runs at the game's tick rate, 62.5 frames/s. Pauses are skipped.
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/export.c -o export -lm -lpthread
+// Examples:
+//   ./export record demo.prp 4 --minutes 10
+//   ./export list pong_replay.prp
+//   ./export video pong_replay.prp 0 match.y4m --threads 2 --encoders 2
+//   ./export video demo.prp 3 'frames/%06d.png'
+//   ./export video demo.prp 3 - | ffmpeg -i - match.mp4
+
+#define PONG_SOFTRENDER
+#include "../pingpong.c"
+
+#define MATCH_POINTS 5                  // record: first to 5 unless --minutes
+#define SERVE_EVERY  3000               // record: pause and re-serve this often
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//              Replay playback
+
+static int readHeader(FILE* f, ReplayHeader* h) {
+    return fread(h, sizeof(*h), 1, f) == 1 && h->magic == REPLAY_MAGIC;
+}
+
+static void startMatch(const ReplayHeader* h) {
+    srand(h->seed);
+    fx_seed = h->seed;
+    currentMode = (GameMode)h->mode;
+    currentDifficulty = (DifficultyLevel)h->difficulty;
+    player1_control = (ControlMode)h->p1Control;
+    player2_control = (ControlMode)h->p2Control;
+    pvp_ball_speed = h->pvpBallSpeed;
+    powerup_timer = h->powerupTimer;
+    animation_time = h->animationTime;
+    windowWidth = h->width;
+    windowHeight = h->height;
+    updateOrthoBounds();
+    clearParticles();
+    key_a_pressed = key_d_pressed = key_left_pressed = key_right_pressed = 0;
+    game_running = 0;
+    initGame();
+}
+
+// Apply stream bytes up to and including the next tick byte; the caller
+// then runs update(). Returns 0 at the end of the match. Tick bytes never
+// have bit 0x40 set, so the 'P' of the next header cannot be one
+static int replayStep(FILE* f) {
+    for (;;) {
+        int b = getc(f);
+        if (b == EOF) return 0;
+        if (b == (int)(REPLAY_MAGIC & 0xFF)) { ungetc(b, f); return 0; }
+        if (b & REPLAY_OP) {
+            switch (b) {
+                case REPLAY_SERVE:   serveBall(); break;
+                case REPLAY_RESTART: restartMatch(); break;
+                case REPLAY_RESIZE: {
+                    uint16_t size[2];
+                    if (fread(size, sizeof(size), 1, f) != 1) return 0;
+                    windowWidth = size[0];
+                    windowHeight = size[1];
+                    updateOrthoBounds();
+                    correctPaddlePositions();
+                    break;
+                }
+                case REPLAY_CONTROL: {
+                    int c = getc(f);
+                    if (c == EOF) return 0;
+                    player2_control = (ControlMode)c;
+                    break;
+                }
+                default: return 0;
+            }
+            continue;
+        }
+        key_a_pressed     = (b & REPLAY_KEY_A) != 0;
+        key_d_pressed     = (b & REPLAY_KEY_D) != 0;
+        key_left_pressed  = (b & REPLAY_KEY_LEFT) != 0;
+        key_right_pressed = (b & REPLAY_KEY_RIGHT) != 0;
+        if ((b & REPLAY_MOUSE1) && fread(&player1_target_x, sizeof(float), 1, f) != 1) return 0;
+        if ((b & REPLAY_MOUSE2) && fread(&player2_target_x, sizeof(float), 1, f) != 1) return 0;
+        return 1;
+    }
+}
+
+// Skip to the header of match `index`
+static int seekMatch(FILE* f, int index, ReplayHeader* h) {
+    for (int m = 0; readHeader(f, h); m++) {
+        if (m == index) return 1;
+        int b;
+        while ((b = getc(f)) != EOF && b != (int)(REPLAY_MAGIC & 0xFF)) {
+            if (b == REPLAY_RESIZE) fseek(f, 4, SEEK_CUR);
+            else if (b == REPLAY_CONTROL) getc(f);
+            else if (!(b & REPLAY_OP)) fseek(f, ((b & REPLAY_MOUSE1) ? 4 : 0) + ((b & REPLAY_MOUSE2) ? 4 : 0), SEEK_CUR);
+        }
+        if (b == EOF) return 0;
+        ungetc(b, f);
+    }
+    return 0;
+}
+
+static const char* modeName(int mode) {
+    return mode == MODE_PVP ? "PvP" : "PvC";
+}
+
+static const char* difficultyName(int difficulty) {
+    return difficulty == DIFFICULTY_HARD ? "hard" : "medium";
+}
+
+//              record
+
+static unsigned scriptSeed = 1;         // the scripted player's own RNG
+
+static int scriptRand(void) {
+    scriptSeed = scriptSeed * 1103515245u + 12345u;
+    return (int)((scriptSeed >> 16) & 0x7FFF);
+}
+
+static int record(const char* path, int matches, int minutes, unsigned seed) {
+    remove(path);
+    replay_path = path;
+    srand(seed);
+    scriptSeed = seed;
+    double t0 = nowSeconds();
+    long long total = 0;
+
+    for (int m = 0; m < matches; m++) {
+        int scripted = m & 1;
+        currentMode = scripted ? MODE_PVC : MODE_PVP;
+        currentDifficulty = (m & 2) ? DIFFICULTY_HARD : DIFFICULTY_MEDIUM;
+        player1_control = scripted ? CONTROL_KEYBOARD_1 : CONTROL_AUTO;
+        player2_control = CONTROL_AUTO;
+        pvp_ball_speed = (currentDifficulty == DIFFICULTY_MEDIUM) ? 16.0f : 18.0f;
+        key_a_pressed = key_d_pressed = 0;
+        initGame();
+        serveBall();
+
+        int limit = minutes > 0 ? (int)(minutes * 60 / 0.016f) : 0;
+        int ticks = 0;
+        while (limit ? ticks < limit
+                     : player1_score < MATCH_POINTS && player2_score < MATCH_POINTS) {
+            if (scripted && scriptRand() % 12 == 0) {
+                int k = scriptRand() % 3;
+                key_a_pressed = (k == 0);
+                key_d_pressed = (k == 1);
+            }
+            if (ticks > 0 && ticks % SERVE_EVERY == 0) serveBall();
+            update();
+            ticks++;
+        }
+        game_running = 0;
+        total += ticks;
+        printf("match %d: %s %s, %d ticks, %d:%d\n", m, modeName(currentMode),
+               difficultyName(currentDifficulty), ticks, player1_score, player2_score);
+    }
+    currentMode = MODE_MENU;
+    initGame();                         // flushes the last match
+    replayClose();
+
+    double dt = nowSeconds() - t0;
+    printf("%d matches, %lld ticks (%.1f min of play) in %.2f s\n",
+           matches, total, total * 0.016 / 60, dt);
+    return 0;
+}
+
+//              list
+
+static int list(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) { perror(path); return 1; }
+    ReplayHeader h;
+    int m = 0;
+    while (readHeader(f, &h)) {
+        startMatch(&h);
+        int ticks = 0;
+        while (replayStep(f)) {
+            update();
+            ticks++;
+        }
+        printf("match %d: %s %s, %dx%d, %d ticks (%.1f s), %d:%d\n", m++,
+               modeName(h.mode), difficultyName(h.difficulty), h.width, h.height,
+               ticks, ticks * 0.016, player1_score, player2_score);
+    }
+    fclose(f);
+    if (m == 0) { fprintf(stderr, "%s: no matches\n", path); return 1; }
+    return 0;
+}
+
+//              Encoders
+
+static int videoW, videoH;              // render size
+static int outW, outH;                  // rounded up to even for 4:2:0
+
+// BT.601 full-range 4:2:0, as tagged by C420jpeg. Coefficients are 15-bit
+// fixed point; chroma is taken from the sum of each 2x2 block
+#define Y4M_LUMA(r, g, b) ((9798 * (r) + 19235 * (g) + 3736 * (b) + 16384) >> 15)
+#define Y4M_CB(r, g, b)   (((-5529 * (r) - 10855 * (g) + 16384 * (b) + (1 << 16)) >> 17) + 128)
+#define Y4M_CR(r, g, b)   (((16384 * (r) - 13720 * (g) -  2664 * (b) + (1 << 16)) >> 17) + 128)
+
+#if defined(__SSE2__)
+// Two rows of four pixels: four luma bytes per row, two Cb and two Cr
+static void y4mBlock4(const uint32_t* r0, const uint32_t* r1,
+                      uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i kY  = _mm_setr_epi16(9798, 19235, 3736, 0, 9798, 19235, 3736, 0);
+    const __m128i kCb = _mm_setr_epi16(-5529, -10855, 16384, 0, -5529, -10855, 16384, 0);
+    const __m128i kCr = _mm_setr_epi16(16384, -13720, -2664, 0, 16384, -13720, -2664, 0);
+    __m128i a = _mm_loadu_si128((const __m128i*)r0);
+    __m128i b = _mm_loadu_si128((const __m128i*)r1);
+    __m128i aLo = _mm_unpacklo_epi8(a, zero), aHi = _mm_unpackhi_epi8(a, zero);
+    __m128i bLo = _mm_unpacklo_epi8(b, zero), bHi = _mm_unpackhi_epi8(b, zero);
+
+    // madd leaves (r*kr + g*kg, b*kb) per pixel; fold the pairs
+    #define Y4M_FOLD(lo, hi) _mm_add_epi32( \
+        _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0))), \
+        _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1))))
+    const __m128i half = _mm_set1_epi32(16384);
+    __m128i ya = _mm_srai_epi32(_mm_add_epi32(Y4M_FOLD(_mm_madd_epi16(aLo, kY), _mm_madd_epi16(aHi, kY)), half), 15);
+    __m128i yb = _mm_srai_epi32(_mm_add_epi32(Y4M_FOLD(_mm_madd_epi16(bLo, kY), _mm_madd_epi16(bHi, kY)), half), 15);
+    __m128i y8 = _mm_packus_epi16(_mm_packs_epi32(ya, yb), zero);
+    uint32_t lumaA = (uint32_t)_mm_cvtsi128_si32(y8);
+    uint32_t lumaB = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(y8, 4));
+    memcpy(y0, &lumaA, 4);
+    memcpy(y1, &lumaB, 4);
+
+    __m128i lo = _mm_add_epi16(aLo, bLo), hi = _mm_add_epi16(aHi, bHi);
+    __m128i sums = _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)),
+                                      _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+    __m128i c = Y4M_FOLD(_mm_madd_epi16(sums, kCb), _mm_madd_epi16(sums, kCr));
+    #undef Y4M_FOLD
+    c = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(c, _mm_set1_epi32(1 << 16)), 17), _mm_set1_epi32(128));
+    uint32_t chroma = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(c, c), zero));
+    u[0] = (uint8_t)chroma;
+    u[1] = (uint8_t)(chroma >> 8);
+    v[0] = (uint8_t)(chroma >> 16);
+    v[1] = (uint8_t)(chroma >> 24);
+}
+#endif
+
+static size_t encodeY4M(const uint32_t* fb, uint8_t* out) {
+    memcpy(out, "FRAME\n", 6);
+    uint8_t* Y = out + 6;
+    uint8_t* U = Y + (size_t)outW * outH;
+    uint8_t* V = U + (size_t)(outW / 2) * (outH / 2);
+
+    for (int y = 0; y < outH; y += 2) {
+        const uint32_t* r0 = fb + (size_t)(y < videoH ? y : videoH - 1) * videoW;
+        const uint32_t* r1 = fb + (size_t)(y + 1 < videoH ? y + 1 : videoH - 1) * videoW;
+        uint8_t* y0 = Y + (size_t)y * outW;
+        uint8_t* y1 = y0 + outW;
+        uint8_t* u = U + (size_t)(y / 2) * (outW / 2);
+        uint8_t* v = V + (size_t)(y / 2) * (outW / 2);
+        int x = 0;
+#if defined(__SSE2__)
+        for (; x + 4 <= videoW; x += 4)
+            y4mBlock4(r0 + x, r1 + x, y0 + x, y1 + x, u + x / 2, v + x / 2);
+#endif
+        // Tail, padding the odd column/row by repeating the last one
+        for (; x < outW; x += 2) {
+            int xa = x < videoW ? x : videoW - 1;
+            int xb = x + 1 < videoW ? x + 1 : videoW - 1;
+            uint32_t p[4] = {r0[xa], r0[xb], r1[xa], r1[xb]};
+            int rs = 0, gs = 0, bs = 0;
+            for (int i = 0; i < 4; i++) {
+                int r = p[i] & 0xFF, g = (p[i] >> 8) & 0xFF, b = (p[i] >> 16) & 0xFF;
+                uint8_t luma = (uint8_t)Y4M_LUMA(r, g, b);
+                if (i < 2) y0[x + i] = luma;
+                else       y1[x + i - 2] = luma;
+                rs += r; gs += g; bs += b;
+            }
+            u[x / 2] = (uint8_t)Y4M_CB(rs, gs, bs);
+            v[x / 2] = (uint8_t)Y4M_CR(rs, gs, bs);
+        }
+    }
+    return 6 + (size_t)outW * outH + 2 * (size_t)(outW / 2) * (outH / 2);
+}
+
+// PNG with a single fixed-Huffman deflate block. Rows use the Up filter,
+// which turns the mostly static background into runs of zeros, and runs
+// are coded as distance-1 matches; no zlib needed
+static uint16_t huffCode[288];          // bit-reversed fixed literal/length codes
+static uint8_t huffLen[288];
+static uint16_t lenSym[259], lenExtra[259];
+static uint8_t lenBits[259];
+
+static void initDeflate(void) {
+    static const uint16_t base[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,
+                                      35,43,51,59,67,83,99,115,131,163,195,227,258};
+    static const uint8_t extra[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,
+                                      3,3,3,3,4,4,4,4,5,5,5,5,0};
+    for (int s = 0; s < 288; s++) {
+        int code, n;
+        if      (s < 144) { code = 0x30 + s;          n = 8; }
+        else if (s < 256) { code = 0x190 + (s - 144); n = 9; }
+        else if (s < 280) { code = s - 256;           n = 7; }
+        else              { code = 0xC0 + (s - 280);  n = 8; }
+        int rev = 0;
+        for (int i = 0; i < n; i++) rev |= ((code >> i) & 1) << (n - 1 - i);
+        huffCode[s] = (uint16_t)rev;
+        huffLen[s] = (uint8_t)n;
+    }
+    for (int i = 0; i < 29; i++) {
+        int last = (i == 28) ? 258 : base[i + 1] - 1;
+        for (int len = base[i]; len <= last; len++) {
+            lenSym[len] = (uint16_t)(257 + i);
+            lenExtra[len] = (uint16_t)(len - base[i]);
+            lenBits[len] = extra[i];
+        }
+    }
+}
+
+typedef struct {
+    uint8_t* o;
+    uint64_t bits;
+    int n;
+} BitWriter;
+
+static void putBits(BitWriter* w, uint32_t v, int n) {
+    w->bits |= (uint64_t)v << w->n;
+    w->n += n;
+    while (w->n >= 8) {
+        *w->o++ = (uint8_t)w->bits;
+        w->bits >>= 8;
+        w->n -= 8;
+    }
+}
+
+static void putSymbol(BitWriter* w, int s) {
+    putBits(w, huffCode[s], huffLen[s]);
+}
+
+static uint8_t* deflateRuns(const uint8_t* d, size_t n, uint8_t* o) {
+    BitWriter w = {o, 0, 0};
+    putBits(&w, 1, 1);                  // BFINAL
+    putBits(&w, 1, 2);                  // fixed Huffman
+    size_t i = 0;
+    while (i < n) {
+        size_t run = 0, max = n - i < 258 ? n - i : 258;
+        if (i > 0 && d[i] == d[i - 1]) {
+            uint64_t pattern = d[i] * 0x0101010101010101ULL, word;
+            while (run + 8 <= max && (memcpy(&word, d + i + run, 8), word == pattern)) run += 8;
+            while (run < max && d[i + run] == d[i - 1]) run++;
+        }
+        if (run >= 3) {
+            putSymbol(&w, lenSym[run]);
+            if (lenBits[run]) putBits(&w, lenExtra[run], lenBits[run]);
+            putBits(&w, 0, 5);          // distance 1
+            i += run;
+        } else {
+            putSymbol(&w, d[i++]);
+        }
+    }
+    putSymbol(&w, 256);
+    if (w.n) putBits(&w, 0, 8 - w.n);
+    return w.o;
+}
+
+static uint32_t adler32(const uint8_t* d, size_t n) {
+    uint32_t a = 1, b = 0;
+    while (n) {
+        size_t k = n < 5552 ? n : 5552;
+        n -= k;
+        while (k--) { a += *d++; b += a; }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+static uint8_t* putBE32(uint8_t* o, uint32_t v) {
+    o[0] = (uint8_t)(v >> 24); o[1] = (uint8_t)(v >> 16); o[2] = (uint8_t)(v >> 8); o[3] = (uint8_t)v;
+    return o + 4;
+}
+
+static uint8_t* putChunk(uint8_t* o, const char* type, const uint8_t* data, uint32_t len) {
+    o = putBE32(o, len);
+    memcpy(o, type, 4);
+    if (data != o + 4 && len) memmove(o + 4, data, len);
+    uint32_t crc = checksum32(o, 4 + (size_t)len, 0);
+    return putBE32(o + 4 + len, crc);
+}
+
+static size_t pngRawSize(void) {
+    return (size_t)videoH * (1 + 3 * (size_t)videoW);
+}
+
+// scratch holds pngRawSize() bytes; out must fit pngRawSize() * 9/8 + 1024
+static size_t encodePNG(const uint32_t* fb, uint8_t* scratch, uint8_t* out) {
+    size_t stride = 1 + 3 * (size_t)videoW;
+    for (int y = 0; y < videoH; y++) {
+        const uint32_t* src = fb + (size_t)y * videoW;
+        const uint32_t* up = y ? src - videoW : NULL;
+        uint8_t* row = scratch + y * stride;
+        row[0] = up ? 2 : 0;            // Up, or None for the first row
+        for (int x = 0; x < videoW; x++) {
+            uint32_t p = src[x], q = up ? up[x] : 0;
+            row[1 + 3 * x + 0] = (uint8_t)(p - q);
+            row[1 + 3 * x + 1] = (uint8_t)((p >> 8) - (q >> 8));
+            row[1 + 3 * x + 2] = (uint8_t)((p >> 16) - (q >> 16));
+        }
+    }
+
+    uint8_t* o = out;
+    memcpy(o, "\x89PNG\r\n\x1a\n", 8);
+    o += 8;
+    uint8_t ihdr[13];
+    putBE32(ihdr, (uint32_t)videoW);
+    putBE32(ihdr + 4, (uint32_t)videoH);
+    ihdr[8] = 8;                        // bit depth
+    ihdr[9] = 2;                        // truecolour
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    o = putChunk(o, "IHDR", ihdr, sizeof(ihdr));
+
+    uint8_t* idat = o + 8;              // build the payload in place
+    idat[0] = 0x78;                     // zlib, 32K window
+    idat[1] = 0x01;
+    uint8_t* e = deflateRuns(scratch, pngRawSize(), idat + 2);
+    e = putBE32(e, adler32(scratch, pngRawSize()));
+    o = putChunk(o, "IDAT", idat, (uint32_t)(e - idat));
+    o = putChunk(o, "IEND", NULL, 0);
+    return (size_t)(o - out);
+}
+
+//              video
+
+typedef struct {
+    uint32_t* fb;
+    int busy;                           // rendered and not yet encoded
+} Slot;
+
+static Slot* slots;
+static int queueLen;
+static pthread_mutex_t q_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t q_cond = PTHREAD_COND_INITIALIZER;
+static int framesReady = 0, nextTake = 0, nextWrite = 0, producerDone = 0;
+
+static const char* pngPattern = NULL;   // NULL = Y4M to y4mOut
+static FILE* y4mOut = NULL;
+static int writeFailed = 0;
+
+static void* encoder(void* arg) {
+    (void)arg;
+    size_t outCap = pngPattern ? pngRawSize() + pngRawSize() / 8 + 1024
+                               : 6 + (size_t)outW * outH * 3 / 2;
+    uint8_t* out = malloc(outCap);
+    uint8_t* scratch = pngPattern ? malloc(pngRawSize()) : NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&q_lock);
+        while (nextTake == framesReady && !producerDone) pthread_cond_wait(&q_cond, &q_lock);
+        if (nextTake == framesReady) {
+            pthread_mutex_unlock(&q_lock);
+            break;
+        }
+        int f = nextTake++;
+        pthread_mutex_unlock(&q_lock);
+
+        Slot* s = &slots[f % queueLen];
+        size_t n = pngPattern ? encodePNG(s->fb, scratch, out) : encodeY4M(s->fb, out);
+
+        pthread_mutex_lock(&q_lock);
+        s->busy = 0;
+        pthread_cond_broadcast(&q_cond);
+        if (pngPattern) {
+            pthread_mutex_unlock(&q_lock);
+            char path[1024];
+            snprintf(path, sizeof(path), pngPattern, f);
+            FILE* pf = fopen(path, "wb");
+            if (!pf || fwrite(out, 1, n, pf) != n) writeFailed = 1;
+            if (pf) fclose(pf);
+        } else {
+            // One stream: frames go out in order
+            while (nextWrite != f) pthread_cond_wait(&q_cond, &q_lock);
+            pthread_mutex_unlock(&q_lock);
+            if (fwrite(out, 1, n, y4mOut) != n) writeFailed = 1;
+            pthread_mutex_lock(&q_lock);
+            nextWrite++;
+            pthread_cond_broadcast(&q_cond);
+            pthread_mutex_unlock(&q_lock);
+        }
+    }
+
+    free(out);
+    free(scratch);
+    return NULL;
+}
+
+static int video(const char* path, int index, const char* target,
+                 int threads, int encoders, int queue) {
+    FILE* f = fopen(path, "rb");
+    if (!f) { perror(path); return 1; }
+    ReplayHeader h;
+    if (!seekMatch(f, index, &h)) {
+        fprintf(stderr, "%s: no match %d\n", path, index);
+        fclose(f);
+        return 1;
+    }
+
+    videoW = h.width  >= 16 ? h.width  : WINDOW_WIDTH;
+    videoH = h.height >= 16 ? h.height : WINDOW_HEIGHT;
+    outW = (videoW + 1) & ~1;
+    outH = (videoH + 1) & ~1;
+    if (!initSoftRenderer(videoW, videoH, threads)) { fprintf(stderr, "out of memory\n"); return 1; }
+    initDeflate();
+    startMatch(&h);
+
+    if (strchr(target, '%')) {
+        pngPattern = target;
+    } else {
+        y4mOut = strcmp(target, "-") ? fopen(target, "wb") : stdout;
+        if (!y4mOut) { perror(target); return 1; }
+        setvbuf(y4mOut, NULL, _IOFBF, 1 << 20);
+        fprintf(y4mOut, "YUV4MPEG2 W%d H%d F125:2 Ip A1:1 C420jpeg\n", outW, outH);
+    }
+
+    queueLen = queue;
+    slots = calloc((size_t)queueLen, sizeof(Slot));
+    for (int i = 0; i < queueLen; i++) {
+        slots[i].fb = malloc((size_t)videoW * videoH * sizeof(uint32_t));
+        if (!slots[i].fb) { fprintf(stderr, "out of memory\n"); return 1; }
+    }
+    pthread_t workers[64];
+    for (int i = 0; i < encoders; i++) pthread_create(&workers[i], NULL, encoder, NULL);
+
+    double t0 = nowSeconds(), tSim = 0, tRender = 0, tWait = 0;
+    int frames = 0;
+    for (;;) {
+        double t1 = nowSeconds();
+        if (!replayStep(f)) break;
+        update();
+
+        // display() uses windowWidth for text; keep it at the video size
+        // even if the window was resized during the match
+        int ww = windowWidth, wh = windowHeight;
+        windowWidth = videoW;
+        windowHeight = videoH;
+        double t2 = nowSeconds();
+        display();
+        windowWidth = ww;
+        windowHeight = wh;
+
+        Slot* s = &slots[frames % queueLen];
+        double t3 = nowSeconds();
+        pthread_mutex_lock(&q_lock);
+        while (s->busy) pthread_cond_wait(&q_cond, &q_lock);
+        pthread_mutex_unlock(&q_lock);
+        double t4 = nowSeconds();
+
+        swSetTarget(s->fb);
+        swFinish();
+
+        pthread_mutex_lock(&q_lock);
+        s->busy = 1;
+        framesReady = ++frames;
+        pthread_cond_broadcast(&q_cond);
+        pthread_mutex_unlock(&q_lock);
+
+        double t5 = nowSeconds();
+        tSim += t2 - t1;
+        tRender += (t3 - t2) + (t5 - t4);
+        tWait += t4 - t3;
+    }
+
+    pthread_mutex_lock(&q_lock);
+    producerDone = 1;
+    pthread_cond_broadcast(&q_cond);
+    pthread_mutex_unlock(&q_lock);
+    for (int i = 0; i < encoders; i++) pthread_join(workers[i], NULL);
+    if (y4mOut && y4mOut != stdout) fclose(y4mOut);
+    else if (y4mOut) fflush(y4mOut);
+    double wall = nowSeconds() - t0;
+
+    double played = frames * 0.016;
+    fprintf(stderr, "match %d: %d frames (%.1f s of play) at %dx%d in %.2f s: "
+            "%.0f frames/s, %.1fx real time\n",
+            index, frames, played, videoW, videoH, wall, frames / wall, played / wall);
+    fprintf(stderr, "  simulate %.2f s, render %.2f s, waiting for encoders %.2f s, final score %d:%d\n",
+            tSim, tRender, tWait, player1_score, player2_score);
+
+    for (int i = 0; i < queueLen; i++) free(slots[i].fb);
+    free(slots);
+    swShutdown();
+    fclose(f);
+    if (writeFailed) { fprintf(stderr, "write failed\n"); return 1; }
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s record FILE MATCHES [--minutes N] [--seed N]\n"
+        "       %s list FILE\n"
+        "       %s video FILE MATCH OUT.y4m|-|PATTERN%%d.png\n"
+        "             [--threads N] [--encoders N] [--queue N]\n", prog, prog, prog);
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 4 && !strcmp(argv[1], "record")) {
+        int minutes = 0;
+        unsigned seed = 1;
+        for (int i = 4; i < argc; i++) {
+            if (!strcmp(argv[i], "--minutes") && i + 1 < argc)   minutes = atoi(argv[++i]);
+            else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+            else { usage(argv[0]); return 2; }
+        }
+        return record(argv[2], atoi(argv[3]), minutes, seed);
+    }
+    if (argc == 3 && !strcmp(argv[1], "list"))
+        return list(argv[2]);
+    if (argc >= 5 && !strcmp(argv[1], "video")) {
+        int threads = 1, encoders = 2, queue = 8;
+        for (int i = 5; i < argc; i++) {
+            if (!strcmp(argv[i], "--threads") && i + 1 < argc)       threads = atoi(argv[++i]);
+            else if (!strcmp(argv[i], "--encoders") && i + 1 < argc) encoders = atoi(argv[++i]);
+            else if (!strcmp(argv[i], "--queue") && i + 1 < argc)    queue = atoi(argv[++i]);
+            else { usage(argv[0]); return 2; }
+        }
+        if (encoders < 1 || encoders > 64 || queue < 1) { usage(argv[0]); return 2; }
+        return video(argv[2], atoi(argv[3]), argv[4], threads, encoders, queue);
+    }
+    usage(argv[0]);
+    return 2;
+}
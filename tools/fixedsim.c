@@ -0,0 +1,125 @@
+// Cross-build determinism check for the fixed-point physics core (F5).
+//
+// Plays a batch of seeded AI-vs-AI matches on fixStep() and hashes the
+// final state of every match into one value. The hash is compared with
+// FIXED_GOLDEN, which every compiler, optimisation level and FPU mode
+// must reproduce; the exit status is 1 on a mismatch. The same matches
+// are then played on the float update() (effects off) and that hash is
+// printed next to it: it is expected to move between builds.
+// Both paths are timed for a throughput comparison. The float path also
+// runs power-ups and up to three balls, so it does somewhat more work.
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/fixedsim.c -o fixedsim -lm
+// Examples:
+//   ./fixedsim
+//   ./fixedsim --matches 200 --ticks 20000
+// Cross-build check (each must print "matches golden"):
+//   gcc -O0 tools/fixedsim.c -o fixedsim-O0 -lm && ./fixedsim-O0
+//   gcc -O3 -march=native -ffast-math tools/fixedsim.c -o fixedsim-fast -lm && ./fixedsim-fast
+//   gcc -O2 -mfpmath=387 tools/fixedsim.c -o fixedsim-x87 -lm && ./fixedsim-x87
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+// Hash of the default run (64 matches x 10000 ticks, both difficulties)
+#define FIXED_GOLDEN 0xa60d94aacdffb340ULL
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static uint64_t mix(uint64_t h, uint64_t v) {
+    for (int i = 0; i < 8; i++) { h ^= (v >> (i * 8)) & 0xFF; h *= 1099511628211ULL; }
+    return h;
+}
+
+// Match m: PvP at difficulty m % 2, ball speed 12-22
+static void setupMatch(int m) {
+    currentMode = MODE_PVP;
+    currentDifficulty = (DifficultyLevel)(m % 2);
+    pvp_ball_speed = 12.0f + m % 11;
+    player1_control = CONTROL_AUTO;
+    player2_control = CONTROL_AUTO;
+    srand((unsigned)m + 1);
+    initGame();
+}
+
+static uint64_t runFixed(int matches, int ticks, double* seconds, long* points) {
+    uint64_t h = 1469598103934665603ULL;
+    FixMatch m;
+    *seconds = 0;
+    *points = 0;
+    for (int i = 0; i < matches; i++) {
+        setupMatch(i);
+        fixInit(&m, (uint32_t)i * 2654435761u + 1, 3);
+        double t0 = nowSeconds();
+        for (int k = 0; k < ticks; k++) fixStep(&m, 0, 0);
+        *seconds += nowSeconds() - t0;
+        *points += m.score[0] + m.score[1];
+        h = mix(h, fixHash(&m));
+    }
+    return h;
+}
+
+static uint64_t runFloat(int matches, int ticks, double* seconds, long* points) {
+    uint64_t h = 1469598103934665603ULL;
+    *seconds = 0;
+    *points = 0;
+    sim_cosmetics = 0;
+    for (int i = 0; i < matches; i++) {
+        setupMatch(i);
+        player1_score = player2_score = 0;
+        sim_tick = 0;
+        resetBall(&balls[0]);
+        game_running = 1;
+        double t0 = nowSeconds();
+        for (int k = 0; k < ticks; k++) update();
+        *seconds += nowSeconds() - t0;
+        *points += player1_score + player2_score;
+
+        float v[6] = {balls[0].x, balls[0].y, balls[0].vx, balls[0].vy,
+                      player1_paddle_x, player2_paddle_x};
+        uint32_t bits;
+        for (int j = 0; j < 6; j++) { memcpy(&bits, &v[j], 4); h = mix(h, bits); }
+        h = mix(h, (uint64_t)player1_score << 32 | (uint32_t)player2_score);
+    }
+    return h;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [--matches N] [--ticks N]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int matches = 64, ticks = 10000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--matches") && i + 1 < argc)    matches = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--ticks") && i + 1 < argc) ticks = atoi(argv[++i]);
+        else { usage(argv[0]); return 2; }
+    }
+    if (matches < 1 || ticks < 1) { usage(argv[0]); return 2; }
+
+    double fixS, floatS;
+    long fixPoints, floatPoints;
+    uint64_t fixH = runFixed(matches, ticks, &fixS, &fixPoints);
+    uint64_t floatH = runFloat(matches, ticks, &floatS, &floatPoints);
+    double steps = (double)matches * ticks;
+
+    printf("%d matches x %d ticks, FixMatch %zu bytes\n", matches, ticks, sizeof(FixMatch));
+    printf("fixed  %016llx  %7.1f ns/tick  %6.2f points/1k ticks\n",
+           (unsigned long long)fixH, fixS * 1e9 / steps, fixPoints * 1000.0 / steps);
+    printf("float  %016llx  %7.1f ns/tick  %6.2f points/1k ticks\n",
+           (unsigned long long)floatH, floatS * 1e9 / steps, floatPoints * 1000.0 / steps);
+
+    if (matches != 64 || ticks != 10000) return 0;
+    if (fixH != FIXED_GOLDEN) {
+        printf("fixed hash MISMATCH, expected %016llx\n", (unsigned long long)FIXED_GOLDEN);
+        return 1;
+    }
+    printf("fixed hash matches golden\n");
+    return 0;
+}
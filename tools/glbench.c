@@ -0,0 +1,196 @@
+// Render benchmark on a real GL driver through an offscreen EGL context
+// (eglgl.h), for Linux CI and render nodes without a window or GPU: there
+// Mesa's llvmpipe runs the same GL calls the game makes under WGL.
+//
+// Plays a fixed script of scenes, each seeded and stepped one tick per
+// frame, and times display() up to glFinish() for every frame:
+//   menu        the main menu
+//   difficulty  the difficulty screen
+//   game        an AI-vs-AI match, a power-up spawned every 60 frames
+//   overlay     the same match with the F7 performance overlay
+//   arena       12 AI paddles, 6 balls and 200 level pieces
+//   mosaic      the spectator grid of --matches AI matches (default 64),
+//               batched: one triangle batch and one glyph-atlas batch
+//   mosaic-naive  the same grid with every tile set up and drawn the way
+//               display() draws a single match, for comparison
+// Per scene it reports frame time percentiles, immediate-mode draw calls
+// and vertices per frame, framebuffer pixels per second and a hash of the
+// last frame read back. The overlay prints this run's timings, so that
+// scene hashes its last frame redrawn without the overlay. --fixed-function
+// draws balls and power-ups without the GL 3.3 shaders (F6 in the game).
+//
+// Build (Linux with EGL, e.g. Mesa):
+//   gcc -O2 tools/glbench.c -o glbench -lm -lpthread -lEGL -lGL
+// Examples:
+//   ./glbench
+//   ./glbench --frames 3000 --size 1920x1080
+//   ./glbench --scene arena --dump arena.ppm     # --dump needs --scene
+//   ./glbench --scene mosaic --matches 16 --size 1920x1080
+//   LIBGL_ALWAYS_SOFTWARE=1 ./glbench --fixed-function
+
+#define PONG_EGLRENDER
+#include "../pingpong.c"
+
+typedef struct {
+    const char* name;
+    int menu;           // 1 = a menu screen: no ticks, only the animation clock
+} Scene;
+
+static const Scene scenes[] = {
+    {"menu", 1}, {"difficulty", 1}, {"game", 0}, {"overlay", 0}, {"arena", 0},
+    {"mosaic", 0}, {"mosaic-naive", 0},
+};
+#define SCENES ((int)(sizeof(scenes) / sizeof(scenes[0])))
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int compareDouble(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t frameHash(const uint32_t* fb, int pixels) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int i = 0; i < pixels; i++) { h ^= fb[i] & 0xFFFFFF; h *= 1099511628211ULL; }
+    return h;
+}
+
+static int writePPM(const char* path, const uint32_t* fb, int width, int height) {
+    FILE* f = fopen(path, "wb");
+    if (!f) { perror(path); return 0; }
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    for (int i = 0; i < width * height; i++) {
+        unsigned char rgb[3] = {(unsigned char)fb[i], (unsigned char)(fb[i] >> 8), (unsigned char)(fb[i] >> 16)};
+        fwrite(rgb, 1, 3, f);
+    }
+    fclose(f);
+    return 1;
+}
+
+// The same start for every run: seeded, effects and overlay as the scene wants
+static void setupScene(const Scene* s, unsigned seed, int matches) {
+    srand(seed);
+    fx_seed = seed;
+    animation_time = 0;
+    perf.on = !strcmp(s->name, "overlay");
+    levelClear();
+
+    if (!strcmp(s->name, "menu"))            currentMode = MODE_MENU;
+    else if (!strcmp(s->name, "difficulty")) currentMode = MODE_DIFFICULTY_SELECT;
+    else if (!strcmp(s->name, "arena"))      currentMode = MODE_ARENA;
+    else if (!strncmp(s->name, "mosaic", 6)) currentMode = MODE_MOSAIC;
+    else                                     currentMode = MODE_PVP;
+
+    player1_control = CONTROL_AUTO;
+    player2_control = CONTROL_AUTO;
+    currentDifficulty = DIFFICULTY_HARD;
+    initGame();
+    resetBall(&balls[0]);
+    game_running = !s->menu;
+    if (currentMode == MODE_ARENA) {
+        levelScatter(200, seed, ARENA_RADIUS * cosf(PI / 12) - 80);
+        initArena(12, 6, 0);
+    }
+    mosaic_naive = !strcmp(s->name, "mosaic-naive");
+    if (currentMode == MODE_MOSAIC) mosaicInit(matches);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s [--frames N] [--size WxH] [--seed N] [--scene NAME]\n"
+        "          [--matches N] [--fixed-function] [--dump FILE.ppm]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int frames = 1200, width = WINDOW_WIDTH, height = WINDOW_HEIGHT, matches = MOSAIC_MAX;
+    unsigned seed = 1;
+    const char* only = NULL;
+    const char* dump = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)     frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)  seed = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--scene") && i + 1 < argc) only = argv[++i];
+        else if (!strcmp(argv[i], "--dump") && i + 1 < argc)  dump = argv[++i];
+        else if (!strcmp(argv[i], "--matches") && i + 1 < argc) matches = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--fixed-function"))        shader_fx = 0;
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) { usage(argv[0]); return 2; }
+        }
+        else { usage(argv[0]); return 2; }
+    }
+    if (frames < 1 || width < 16 || height < 16 || matches < 1 || matches > MOSAIC_MAX || (dump && !only)) {
+        usage(argv[0]);
+        return 2;
+    }
+    int found = !only;
+    for (int s = 0; s < SCENES && !found; s++) found = !strcmp(only, scenes[s].name);
+    if (!found) { usage(argv[0]); return 2; }
+
+    if (!initEglRenderer(width, height)) { fprintf(stderr, "no EGL / OpenGL context\n"); return 1; }
+    double* times = malloc(sizeof(double) * frames);
+    uint32_t* fb = malloc(sizeof(uint32_t) * (size_t)width * height);
+    if (!times || !fb) { fprintf(stderr, "out of memory\n"); return 1; }
+
+    printf("%s | %s\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+    printf("%dx%d, %d frames a scene, effects %s\n\n", width, height, frames,
+           shaderFx.ready && shader_fx ? "GL 3.3 shaders" : "fixed-function");
+    printf("scene         p50 ms   p90 ms   p99 ms   max ms  draws/frame  verts/frame  Mpixels/s  last frame\n");
+
+    for (int s = 0; s < SCENES; s++) {
+        if (only && strcmp(only, scenes[s].name)) continue;
+        setupScene(&scenes[s], seed, matches);
+        for (int i = 0; i < 60; i++) {      // warm the driver's caches and shader variants
+            if (game_running) update();
+            display();
+        }
+        glFinish();
+
+        double total = 0;
+        unsigned long long draws = 0, verts = 0;
+        for (int f = 0; f < frames; f++) {
+            double tick0 = nowSeconds();
+            if (game_running) {
+                if (currentMode == MODE_PVP && f % 60 == 0) spawnPowerUp();
+                update();
+            } else {
+                animation_time += 0.016f;
+            }
+            if (perf.on) perfTick((nowSeconds() - tick0) * 1000.0);
+
+            perf.drawCalls = perf.vertices = 0;
+            double t0 = nowSeconds();
+            display();
+            glFinish();
+            times[f] = nowSeconds() - t0;
+            total += times[f];
+            draws += perf.drawCalls;
+            verts += perf.vertices;
+        }
+
+        eglglRead(fb);
+        int dumped = dump && writePPM(dump, fb, width, height);
+        if (perf.on) {                      // timings differ run to run; hash the match alone
+            perf.on = 0;
+            display();
+            glFinish();
+            eglglRead(fb);
+        }
+        qsort(times, frames, sizeof(double), compareDouble);
+        printf("%-10s  %8.3f %8.3f %8.3f %8.3f  %11.1f  %11.1f  %9.1f  %016llx\n", scenes[s].name,
+               times[frames / 2] * 1e3, times[frames * 9 / 10] * 1e3, times[frames * 99 / 100] * 1e3,
+               times[frames - 1] * 1e3, (double)draws / frames, (double)verts / frames,
+               (double)width * height * frames / total / 1e6,
+               (unsigned long long)frameHash(fb, width * height));
+        if (dumped) printf("wrote %s\n", dump);
+    }
+
+    free(times);
+    free(fb);
+    eglglShutdown();
+    return 0;
+}
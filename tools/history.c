@@ -0,0 +1,526 @@
+// Match-history generator and query tool for pong_history.pch files.
+//
+// gen      plays AI-vs-AI matches headlessly (event-driven engine, all
+//          cores) with history recording on, and writes a history file
+// query    scans one or more history files and prints aggregates: win rate
+//          by mode/difficulty, rally and combo stats, power-ups by type
+//          and a hit-offset heatmap. Only the columns a query needs are
+//          decoded; the scans run on SSE2 when available
+// timeline prints the score timeline of one match
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/history.c -o history -lm
+// Examples:
+//   ./history gen matches.pch 100000 --jobs 8
+//   ./history query matches.pch
+//   ./history query matches.pch rally
+//   ./history timeline matches.pch 42
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define MATCH_POINTS  5                 // first to 5, same as "Hard Win"
+#define MATCH_TICKS   (60 * 60 * 5)     // give up after 5 minutes of play
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//              gen
+
+typedef struct {
+    GameMode mode;
+    DifficultyLevel difficulty;
+} MatchConfig;
+
+static const MatchConfig configs[] = {
+    {MODE_PVP, DIFFICULTY_MEDIUM},
+    {MODE_PVP, DIFFICULTY_HARD},
+    {MODE_PVC, DIFFICULTY_MEDIUM},
+    {MODE_PVC, DIFFICULTY_HARD}
+};
+
+static void playMatch(const MatchConfig* c, unsigned seed) {
+    srand(seed);
+    fx_seed = seed;
+    currentMode = c->mode;
+    currentDifficulty = c->difficulty;
+    pvp_ball_speed = (c->difficulty == DIFFICULTY_MEDIUM) ? 16.0f : 18.0f;
+    player1_control = CONTROL_AUTO;
+    player2_control = CONTROL_AUTO;
+    powerup_timer = 0.0f;
+    initGame();                         // also closes the previous match row
+    resetBall(&balls[0]);
+    game_running = 1;
+
+    int start = sim_tick;
+    while (player1_score < MATCH_POINTS && player2_score < MATCH_POINTS) {
+        int left = MATCH_TICKS - (sim_tick - start);
+        if (left <= 0 || advanceTicks(left, 1) == 0) break;
+    }
+    game_running = 0;
+}
+
+static int gen(const char* path, int matches, int jobs, unsigned seed) {
+    char part[512];
+    double t0 = nowSeconds();
+
+    for (int w = 0; w < jobs; w++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            snprintf(part, sizeof(part), "%s.part%d", path, w);
+            remove(part);
+            history_path = part;
+            history_block_matches = HISTORY_MAX_MATCHES;
+            for (int m = w; m < matches; m += jobs)
+                playMatch(&configs[m % 4], seed + (unsigned)m * 7919u);
+            historyEndMatch();
+            historyFlush();
+            _exit(0);
+        }
+        if (pid < 0) { perror("fork"); return 1; }
+    }
+    while (wait(NULL) > 0) {}
+
+    // Blocks are self-contained, so the parts just get concatenated
+    FILE* out = fopen(path, "ab");
+    if (!out) { perror(path); return 1; }
+    static char buf[1 << 16];
+    for (int w = 0; w < jobs; w++) {
+        snprintf(part, sizeof(part), "%s.part%d", path, w);
+        FILE* in = fopen(part, "rb");
+        if (!in) continue;
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+        fclose(in);
+        remove(part);
+    }
+    long size = ftell(out);
+    fclose(out);
+
+    printf("%d matches in %.1f s (%.0f matches/s), %s is %.1f MB\n",
+           matches, nowSeconds() - t0, matches / (nowSeconds() - t0), path, size / 1048576.0);
+    return 0;
+}
+
+//              Block reader
+
+// Decoded columns of the current block, indexed like historyColumns[]
+static void* cols[HISTORY_COLUMNS];
+static int blockRows[HT_COUNT];
+
+static uint64_t statBlocks, statBad, statBytes, statRawBytes;
+static double statDecode, statScan;
+
+static const uint8_t* getVarint(const uint8_t* p, const uint8_t* end, uint32_t* v) {
+    uint32_t x = 0;
+    int shift = 0;
+    while (p < end) {
+        uint8_t b = *p++;
+        x |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) { *v = x; return p; }
+        shift += 7;
+        if (shift > 28) break;
+    }
+    return NULL;
+}
+
+static int decodeColumn(const uint8_t* p, uint32_t len, int enc, int width, int rows, void* out) {
+    const uint8_t* end = p + len;
+    if (width == 1) {
+        uint8_t* o = out;
+        if (enc == HENC_RAW8) {
+            if ((int)len != rows) return 0;
+            memcpy(o, p, rows);
+            return 1;
+        }
+        if (enc != HENC_RLE8) return 0;
+        int n = 0;
+        while (p + 1 < end) {
+            int run = p[0];
+            if (n + run > rows) return 0;
+            memset(o + n, p[1], run);
+            n += run;
+            p += 2;
+        }
+        return n == rows;
+    }
+
+    uint32_t* o = out;
+    uint32_t prev = 0;
+    for (int i = 0; i < rows; i++) {
+        uint32_t x;
+        if (!(p = getVarint(p, end, &x))) return 0;
+        if (enc == HENC_DELTA) {
+            prev += (x >> 1) ^ (uint32_t)-(int32_t)(x & 1);
+            x = prev;
+        }
+        o[i] = x;
+    }
+    return p == end;
+}
+
+// Calls scan() for every intact block, with the columns in `mask` decoded
+static void walkBlocks(const char* path, uint64_t mask, void (*scan)(void)) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return; }
+    struct stat st;
+    fstat(fd, &st);
+    if (st.st_size == 0) { close(fd); return; }
+    const uint8_t* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) { perror(path); return; }
+
+    size_t off = 0;
+    while (off + 32 <= (size_t)st.st_size) {
+        uint32_t head[8];
+        memcpy(head, base + off, sizeof(head));
+        if (head[0] != HISTORY_MAGIC || head[1] < 32 || off + head[1] > (size_t)st.st_size) {
+            statBad++;                  // torn tail from a crash: stop here
+            break;
+        }
+        const uint8_t* blk = base + off;
+        off += head[1];
+        if (checksum32(blk + 32, head[1] - 32, 0) != head[6]) { statBad++; continue; }
+
+        double t0 = nowSeconds();
+        int ok = 1;
+        for (int t = 0; t < HT_COUNT; t++) {
+            blockRows[t] = (int)head[2 + t];
+            if (blockRows[t] > HISTORY_MAX_ROWS) ok = 0;
+        }
+        const uint8_t* p = blk + 32;
+        const uint8_t* end = blk + head[1];
+        for (int c = 0; c < HISTORY_COLUMNS && c < (int)head[7] && ok; c++) {
+            uint32_t len;
+            if (p + 5 > end) { ok = 0; break; }
+            memcpy(&len, p + 1, 4);
+            if (p + 5 + len > end) { ok = 0; break; }
+            const HistoryColumn* hc = &historyColumns[c];
+            int rows = blockRows[hc->table];
+            statRawBytes += (uint64_t)rows * hc->width;
+            if (mask >> c & 1)
+                ok = decodeColumn(p + 5, len, p[0], hc->width, rows, cols[c]);
+            p += 5 + len;
+        }
+        statDecode += nowSeconds() - t0;
+        if (!ok) { statBad++; continue; }
+
+        statBlocks++;
+        statBytes += head[1];
+        t0 = nowSeconds();
+        scan();
+        statScan += nowSeconds() - t0;
+    }
+    munmap((void*)base, st.st_size);
+}
+
+static int columnIndex(const char* name) {
+    for (int c = 0; c < HISTORY_COLUMNS; c++)
+        if (!strcmp(historyColumns[c].name, name)) return c;
+    fprintf(stderr, "unknown column %s\n", name);
+    exit(1);
+}
+
+#define COL(name) (1ULL << columnIndex(name))
+#define U8(name)  ((const uint8_t*)cols[columnIndex(name)])
+#define U32(name) ((const uint32_t*)cols[columnIndex(name)])
+
+//              Vectorised scans
+
+// counts[k] += number of rows with key[i] == k, for k < 32
+static void countKeys32(const uint8_t* key, int n, uint64_t* counts) {
+    int i = 0;
+#if defined(__SSE2__)
+    // Byte-wide counters in registers, folded into 64-bit totals with
+    // psadbw before they can overflow (every 255 chunks)
+    while (i + 16 <= n) {
+        __m128i acc[32];
+        for (int k = 0; k < 32; k++) acc[k] = _mm_setzero_si128();
+        int stop = i + 255 * 16;
+        if (stop > n) stop = n;
+        for (; i + 16 <= stop; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(key + i));
+            for (int k = 0; k < 32; k++)
+                acc[k] = _mm_sub_epi8(acc[k], _mm_cmpeq_epi8(v, _mm_set1_epi8((char)k)));
+        }
+        for (int k = 0; k < 32; k++) {
+            __m128i s = _mm_sad_epu8(acc[k], _mm_setzero_si128());
+            counts[k] += (uint64_t)_mm_cvtsi128_si32(s) + (uint64_t)_mm_extract_epi16(s, 4);
+        }
+    }
+#endif
+    for (; i < n; i++) if (key[i] < 32) counts[key[i]]++;
+}
+
+// Sum and count of v[i] over rows where flag[i] == 0
+static void sumWhereZero(const uint32_t* v, const uint8_t* flag, int n,
+                         uint64_t* sum, uint64_t* count) {
+    int i = 0;
+    uint64_t s = 0, c = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    while (i + 4 <= n) {
+        // 32-bit lane sums can't overflow within 4096 rows of rally lengths
+        __m128i vs = zero, vc = zero;
+        int stop = i + 4096;
+        if (stop > n) stop = n;
+        for (; i + 4 <= stop; i += 4) {
+            int32_t f4;
+            memcpy(&f4, flag + i, 4);
+            __m128i f = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(f4), zero), zero);
+            __m128i keep = _mm_cmpeq_epi32(f, zero);
+            vs = _mm_add_epi32(vs, _mm_and_si128(keep, _mm_loadu_si128((const __m128i*)(v + i))));
+            vc = _mm_sub_epi32(vc, keep);
+        }
+        uint32_t a[4], b[4];
+        _mm_storeu_si128((__m128i*)a, vs);
+        _mm_storeu_si128((__m128i*)b, vc);
+        for (int k = 0; k < 4; k++) { s += a[k]; c += b[k]; }
+    }
+#endif
+    for (; i < n; i++) if (!flag[i]) { s += v[i]; c++; }
+    *sum += s;
+    *count += c;
+}
+
+//              Queries
+
+static uint64_t qMatches, qGroup[4], qWins[4], qDraws[4];
+static uint64_t qHits, qHeat[32];
+static uint64_t qPoints, qBonus, qRallySum, qRallyCount, qComboSum, qRallyMax, qComboMax;
+static uint64_t qPickups[8];
+static uint8_t keyBuf[HISTORY_MAX_ROWS];
+
+static void scanWinrate(void) {
+    int n = blockRows[HT_MATCH];
+    const uint8_t* mode = U8("match.mode");
+    const uint8_t* diff = U8("match.difficulty");
+    const uint8_t* s1 = U8("match.score1");
+    const uint8_t* s2 = U8("match.score2");
+    // key = group * 4 + outcome (0 loss, 1 win, 2 draw); groups as in configs[]
+    for (int i = 0; i < n; i++) {
+        int g = (mode[i] == MODE_PVC) * 2 + (diff[i] == DIFFICULTY_HARD);
+        int o = s1[i] > s2[i] ? 1 : (s1[i] == s2[i] ? 2 : 0);
+        keyBuf[i] = (uint8_t)(g * 4 + o);
+    }
+    uint64_t counts[32] = {0};
+    countKeys32(keyBuf, n, counts);
+    for (int g = 0; g < 4; g++) {
+        qGroup[g] += counts[g * 4] + counts[g * 4 + 1] + counts[g * 4 + 2];
+        qWins[g]  += counts[g * 4 + 1];
+        qDraws[g] += counts[g * 4 + 2];
+    }
+    qMatches += n;
+}
+
+static void scanHeatmap(void) {
+    int n = blockRows[HT_HIT];
+    const uint8_t* player = U8("hit.player");
+    const uint8_t* offset = U8("hit.offset");
+    // key = (player - 1) * 16 + bin, with the int8 offset split into 16 bins
+    for (int i = 0; i < n; i++)
+        keyBuf[i] = (uint8_t)(((player[i] - 1) & 1) << 4 | (uint8_t)(offset[i] ^ 0x80) >> 4);
+    countKeys32(keyBuf, n, qHeat);
+    qHits += n;
+}
+
+static void scanRally(void) {
+    int n = blockRows[HT_POINT];
+    const uint32_t* rally = U32("point.rally");
+    const uint8_t* bonus = U8("point.bonus");
+    const uint8_t* combo = U8("point.combo");
+    sumWhereZero(rally, bonus, n, &qRallySum, &qRallyCount);
+    for (int i = 0; i < n; i++) {
+        if (bonus[i]) { qBonus++; continue; }
+        if (rally[i] > qRallyMax) qRallyMax = rally[i];
+        if (combo[i] > qComboMax) qComboMax = combo[i];
+        qComboSum += combo[i];
+    }
+    qPoints += n;
+}
+
+static void scanPickups(void) {
+    int n = blockRows[HT_PICKUP];
+    const uint8_t* type = U8("pickup.type");
+    uint64_t counts[32] = {0};
+    countKeys32(type, n, counts);
+    for (int k = 0; k < 8; k++) qPickups[k] += counts[k];
+}
+
+static int want[4];                     // winrate, heatmap, rally, pickups
+
+static void scanAll(void) {
+    if (want[0]) scanWinrate();
+    if (want[1]) scanHeatmap();
+    if (want[2]) scanRally();
+    if (want[3]) scanPickups();
+}
+
+static void printResults(void) {
+    static const char* groupNames[4] = {"PvP medium", "PvP hard", "PvC medium", "PvC hard"};
+    static const char* pickupNames[8] = {"-", "big paddle", "slow ball", "extra points",
+                                         "slow time", "fast paddle", "invisible ball", "split ball"};
+    if (want[0]) {
+        printf("\nbottom-player win rate by mode and difficulty (%llu matches)\n",
+               (unsigned long long)qMatches);
+        for (int g = 0; g < 4; g++) {
+            if (!qGroup[g]) continue;
+            printf("  %-11s %6.1f%%  draws %5.1f%%  (%llu matches)\n", groupNames[g],
+                   100.0 * qWins[g] / qGroup[g], 100.0 * qDraws[g] / qGroup[g],
+                   (unsigned long long)qGroup[g]);
+        }
+    }
+    if (want[2]) {
+        printf("\nrallies (%llu points, %llu from power-ups)\n",
+               (unsigned long long)qPoints, (unsigned long long)qBonus);
+        printf("  average rally  %.2f hits (longest %llu)\n",
+               qRallyCount ? (double)qRallySum / qRallyCount : 0.0, (unsigned long long)qRallyMax);
+        printf("  average combo  %.2f at the point (longest %llu)\n",
+               qRallyCount ? (double)qComboSum / qRallyCount : 0.0, (unsigned long long)qComboMax);
+    }
+    if (want[3]) {
+        printf("\npower-ups collected by type\n");
+        for (int k = 1; k < 8; k++)
+            printf("  %-15s %llu\n", pickupNames[k], (unsigned long long)qPickups[k]);
+    }
+    if (want[1]) {
+        printf("\nhit heatmap (%llu hits; offset from paddle centre, left to right)\n",
+               (unsigned long long)qHits);
+        for (int p = 0; p < 2; p++) {
+            uint64_t peak = 1;
+            for (int b = 0; b < 16; b++) if (qHeat[p * 16 + b] > peak) peak = qHeat[p * 16 + b];
+            printf("  %-6s ", p ? "top" : "bottom");
+            for (int b = 0; b < 16; b++) {
+                static const char shades[] = " .:-=+*#%@";
+                printf("%c", shades[(int)(9.0 * qHeat[p * 16 + b] / peak + 0.5)]);
+            }
+            printf("  |");
+            for (int b = 0; b < 16; b++) printf(" %llu", (unsigned long long)qHeat[p * 16 + b]);
+            printf("\n");
+        }
+    }
+}
+
+static int query(int nFiles, char** files, const char* which) {
+    uint64_t mask = 0;
+    if (!which || !strcmp(which, "winrate")) {
+        want[0] = 1;
+        mask |= COL("match.mode") | COL("match.difficulty") | COL("match.score1") | COL("match.score2");
+    }
+    if (!which || !strcmp(which, "heatmap")) {
+        want[1] = 1;
+        mask |= COL("hit.player") | COL("hit.offset");
+    }
+    if (!which || !strcmp(which, "rally")) {
+        want[2] = 1;
+        mask |= COL("point.rally") | COL("point.bonus") | COL("point.combo");
+    }
+    if (!which || !strcmp(which, "pickups")) {
+        want[3] = 1;
+        mask |= COL("pickup.type");
+    }
+    if (!mask) { fprintf(stderr, "unknown query %s\n", which); return 2; }
+
+    for (int c = 0; c < HISTORY_COLUMNS; c++) cols[c] = malloc(HISTORY_MAX_ROWS * 4);
+
+    double t0 = nowSeconds();
+    for (int f = 0; f < nFiles; f++) walkBlocks(files[f], mask, scanAll);
+    double total = nowSeconds() - t0;
+
+    printResults();
+    printf("\n%llu blocks, %.1f MB on disk (%.1fx smaller than raw columns)",
+           (unsigned long long)statBlocks, statBytes / 1048576.0,
+           statBytes ? (double)statRawBytes / statBytes : 0.0);
+    if (statBad) printf(", %llu damaged blocks skipped", (unsigned long long)statBad);
+    printf("\n%.3f s total: decode %.3f s, scan %.3f s\n", total, statDecode, statScan);
+    return 0;
+}
+
+//              timeline
+
+static int timelineTarget, timelineSeen, timelineDone;
+
+static void scanTimeline(void) {
+    int n = blockRows[HT_MATCH];
+    if (timelineDone || timelineTarget >= timelineSeen + n) { timelineSeen += n; return; }
+
+    const uint32_t* pointsPer = U32("match.points");
+    int m = timelineTarget - timelineSeen, first = 0;
+    for (int i = 0; i < m; i++) first += (int)pointsPer[i];
+
+    const uint32_t* tick = U32("point.tick");
+    const uint8_t* scorer = U8("point.scorer");
+    const uint8_t* value = U8("point.value");
+    const uint32_t* rally = U32("point.rally");
+    const uint8_t* bonus = U8("point.bonus");
+    const uint8_t* mode = U8("match.mode");
+    const uint8_t* diff = U8("match.difficulty");
+
+    printf("match %d: %s, %s, %u ticks\n", timelineTarget,
+           mode[m] == MODE_PVC ? "PvC" : "PvP", diff[m] == DIFFICULTY_HARD ? "hard" : "medium",
+           U32("match.ticks")[m]);
+    int s1 = 0, s2 = 0;
+    for (int i = first; i < first + (int)pointsPer[m]; i++) {
+        if (scorer[i] == 1) s1 += value[i]; else s2 += value[i];
+        printf("  %7.2f s  %-6s +%d  %2d:%-2d  %s %u\n", tick[i] * 0.016f,
+               scorer[i] == 1 ? "bottom" : "top", value[i], s1, s2,
+               bonus[i] ? "power-up, rally so far" : "rally", rally[i]);
+    }
+    timelineDone = 1;
+}
+
+static int timeline(const char* path, int match) {
+    for (int c = 0; c < HISTORY_COLUMNS; c++) cols[c] = malloc(HISTORY_MAX_ROWS * 4);
+    timelineTarget = match;
+    walkBlocks(path, COL("match.points") | COL("match.mode") | COL("match.difficulty") |
+                     COL("match.ticks") | COL("point.tick") | COL("point.scorer") |
+                     COL("point.value") | COL("point.rally") | COL("point.bonus"), scanTimeline);
+    if (!timelineDone) { fprintf(stderr, "only %d matches in %s\n", timelineSeen, path); return 1; }
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s gen FILE MATCHES [--jobs N] [--seed N]\n"
+        "       %s query FILE... [winrate|heatmap|rally|pickups]\n"
+        "       %s timeline FILE MATCH\n", prog, prog, prog);
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 4 && !strcmp(argv[1], "gen")) {
+        int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        unsigned seed = 1;
+        for (int i = 4; i < argc; i++) {
+            if (!strcmp(argv[i], "--jobs") && i + 1 < argc) jobs = atoi(argv[++i]);
+            else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+            else { usage(argv[0]); return 2; }
+        }
+        if (jobs < 1) jobs = 1;
+        return gen(argv[2], atoi(argv[3]), jobs, seed);
+    }
+    if (argc >= 3 && !strcmp(argv[1], "query")) {
+        const char* which = NULL;
+        int nFiles = argc - 2;
+        const char* last = argv[argc - 1];
+        if (!strcmp(last, "winrate") || !strcmp(last, "heatmap") ||
+            !strcmp(last, "rally") || !strcmp(last, "pickups")) {
+            which = last;
+            nFiles--;
+        }
+        if (nFiles < 1) { usage(argv[0]); return 2; }
+        return query(nFiles, argv + 2, which);
+    }
+    if (argc == 4 && !strcmp(argv[1], "timeline"))
+        return timeline(argv[2], atoi(argv[3]));
+
+    usage(argv[0]);
+    return 2;
+}
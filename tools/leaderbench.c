@@ -0,0 +1,180 @@
+// Load and latency test for the leaderboard file (LeaderHeader in
+// pingpong.c).
+//
+// Fills a fresh file with --entries random results spread over every
+// board, inserting on this thread to time the O(log n) insert, then times
+// rank and top-10 queries and checks them against sorted copies of the
+// same values. After that it submits through the game's queue in bursts
+// and reports how long leaderSubmit() held the caller, and finally
+// reopens the file cleanly and after a simulated crash (clean flag
+// cleared), which rebuilds every board, and checks nothing changed. The
+// exit status is 1 if any check fails.
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/leaderbench.c -o leaderbench -lm
+// Examples:
+//   ./leaderbench
+//   ./leaderbench --entries 2000000 --file /tmp/board.plb --keep
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void sleepMs(int ms) {
+    struct timespec t = {0, ms * 1000000L};
+    nanosleep(&t, NULL);
+}
+
+static uint32_t rng = 12345;
+
+static uint32_t next(void) {
+    rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+    return rng;
+}
+
+static int descending(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// Keys of every entry, sorted best first as the board ranks them
+static uint32_t* sorted[LEADER_BOARDS];
+static uint32_t sortedCount[LEADER_BOARDS];
+
+// 1 + values strictly better, by binary search
+static uint32_t expectedRank(int b, uint32_t value) {
+    uint32_t key = leaderKey(b, value), lo = 0, hi = sortedCount[b];
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (sorted[b][mid] > key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo + 1;
+}
+
+// Every board's size and top 10 against the sorted copies
+static int checkBoards(const char* when) {
+    int bad = 0;
+    for (int b = 0; b < LEADER_BOARDS; b++) {
+        LeaderEntry top[10];
+        int n = leaderTop(b, top, 10);
+        int want = sortedCount[b] < 10 ? (int)sortedCount[b] : 10;
+        bad |= leader->count[b] != sortedCount[b] || n != want;
+        for (int i = 0; i < n && i < want; i++) bad |= leaderKey(b, top[i].value) != sorted[b][i];
+    }
+    printf("%-28s %s\n", when, bad ? "MISMATCH" : "boards match");
+    return bad;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [--entries N] [--file PATH] [--keep]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int entries = 1000000, keep = 0, failed = 0;
+    const char* path = "leaderbench.plb";
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--entries") && i + 1 < argc)   entries = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--file") && i + 1 < argc) path = argv[++i];
+        else if (!strcmp(argv[i], "--keep"))                 keep = 1;
+        else { usage(argv[0]); return 2; }
+    }
+    if (entries < 1) { usage(argv[0]); return 2; }
+
+    const int submits = 2048;
+    remove(path);
+    if (!leaderOpen(path)) { perror(path); return 1; }
+    for (int b = 0; b < LEADER_BOARDS; b++)
+        sorted[b] = malloc(sizeof(uint32_t) * ((size_t)(entries + submits) / LEADER_BOARDS + 1));
+
+    // Scores, rallies and speeds in a narrow range, so many keys tie
+    double t0 = nowSeconds();
+    int inserted = 0;
+    for (int i = 0; i < entries; i++) {
+        int b = i % LEADER_BOARDS;
+        uint32_t v = next() % 50000;
+        if (!leaderInsert(b, v, (uint32_t)i)) break;
+        sorted[b][sortedCount[b]++] = leaderKey(b, v);
+        inserted++;
+    }
+    double insertS = nowSeconds() - t0;
+    for (int b = 0; b < LEADER_BOARDS; b++) qsort(sorted[b], sortedCount[b], sizeof(uint32_t), descending);
+
+    printf("%d entries over %d boards, %.1f MB file (%.1f bytes per entry)\n", inserted, LEADER_BOARDS,
+           leader->used / 1048576.0, (leader->used - LEADER_FIRST_NODE) / (double)inserted);
+    if (inserted < entries) printf("file full after %d entries\n", inserted);
+    printf("insert  %8.0f ns\n", insertS * 1e9 / inserted);
+
+    const int queries = 200000;
+    uint32_t sum = 0;
+    int wrong = 0;
+    t0 = nowSeconds();
+    for (int i = 0; i < queries; i++) sum += leaderRank(i % LEADER_BOARDS, next() % 50000);
+    printf("rank    %8.0f ns\n", (nowSeconds() - t0) * 1e9 / queries);
+
+    LeaderEntry top[10];
+    t0 = nowSeconds();
+    for (int i = 0; i < queries; i++) sum += (uint32_t)leaderTop(i % LEADER_BOARDS, top, 10);
+    printf("top 10  %8.0f ns\n", (nowSeconds() - t0) * 1e9 / queries);
+
+    for (int i = 0; i < 20000; i++) {
+        int b = i % LEADER_BOARDS;
+        uint32_t v = next() % 50000;
+        wrong += leaderRank(b, v) != expectedRank(b, v);
+    }
+    printf("%-28s %s\n", "ranks (20000 sampled)", wrong ? "MISMATCH" : "match");
+    failed |= wrong != 0;
+    failed |= checkBoards("after inserts");
+
+    // The game's path: bursts from this thread, inserts on the writer
+    double worst = 0, total = 0;
+    unsigned dropped = leader_dropped;
+    for (int i = 0; i < submits; i++) {
+        int b = i % LEADER_BOARDS;
+        uint32_t v = next() % 50000;
+        double s0 = nowSeconds();
+        leaderSubmit(b, v);
+        double s = nowSeconds() - s0;
+        total += s;
+        if (s > worst) worst = s;
+        sorted[b][sortedCount[b]++] = leaderKey(b, v);
+        if (i % 32 == 31)
+            while (__atomic_load_n(&leader_done, __ATOMIC_ACQUIRE) != leader_queued) sleepMs(1);
+    }
+    printf("submit  %8.0f ns average, %.1f us worst, %u dropped\n",
+           total * 1e9 / submits, worst * 1e6, leader_dropped - dropped);
+    failed |= leader_dropped != dropped;
+    for (int b = 0; b < LEADER_BOARDS; b++) qsort(sorted[b], sortedCount[b], sizeof(uint32_t), descending);
+
+    t0 = nowSeconds();
+    leaderClose();
+    double closeS = nowSeconds() - t0;
+    t0 = nowSeconds();
+    if (!leaderOpen(path)) { perror(path); return 1; }
+    printf("close   %8.1f ms, clean reopen %.1f ms\n", closeS * 1e3, (nowSeconds() - t0) * 1e3);
+    failed |= checkBoards("after clean reopen");
+    leaderClose();
+
+    // A crash leaves the flag at 0; the next open relinks every entry
+    int fd = open(path, O_RDWR);
+    uint32_t dirty = 0;
+    if (fd < 0 || pwrite(fd, &dirty, sizeof(dirty), offsetof(LeaderHeader, clean)) != sizeof(dirty)) {
+        perror(path);
+        return 1;
+    }
+    close(fd);
+    t0 = nowSeconds();
+    if (!leaderOpen(path)) { perror(path); return 1; }
+    printf("rebuild %8.1f ms\n", (nowSeconds() - t0) * 1e3);
+    failed |= checkBoards("after crash reopen");
+    leaderClose();
+
+    if (!keep) remove(path);
+    return failed || sum == 0;
+}
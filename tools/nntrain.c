@@ -0,0 +1,312 @@
+// Trains the experimental learned paddle policy (CONTROL_NEURAL) and writes
+// pong_policy.bin. The result is slower than updateAI() and a weaker player;
+// --bench and the evaluation matches print by how much.
+//
+// The network is fitted by behaviour cloning: headless AI-vs-AI matches are
+// played with updateAI(), and the MLP learns to reproduce the paddle target
+// updateAI() picks from the same observation. The float network is then
+// quantised to int8 in the format read by loadPolicy().
+//
+// Build (Linux / any POSIX box; -mavx2 picks the AVX2 kernel):
+//   gcc -O2 -mavx2 tools/nntrain.c -o nntrain -lm
+// Examples:
+//   ./nntrain --difficulty hard --samples 200000 --epochs 8 --out pong_policy.bin
+//   ./nntrain --bench pong_policy.bin
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+#define MAX_SAMPLES 1000000
+
+// Float copy of the network used for training
+typedef struct {
+    float w1[NN_HIDDEN][NN_INPUTS], b1[NN_HIDDEN];
+    float w2[NN_HIDDEN][NN_HIDDEN], b2[NN_HIDDEN];
+    float w3[NN_HIDDEN], b3;
+} FloatNet;
+
+static int16_t (*sampleIn)[NN_INPUTS];
+static float* sampleOut;
+static int sampleCount = 0;
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static float frand(void) {
+    return rand() / (float)RAND_MAX;
+}
+
+// Start a headless AI-vs-AI match
+static void startMatch(DifficultyLevel d, unsigned seed) {
+    srand(seed);
+    currentDifficulty = d;
+    currentMode = MODE_PVP;
+    pvp_ball_speed = (d == DIFFICULTY_MEDIUM) ? 16.0f : 18.0f;
+    player1_control = player2_control = CONTROL_AUTO;
+    clearParticles();
+    powerup_timer = 0.0f;
+    animation_time = 0.0f;
+    initGame();
+    resetBall(&balls[0]);
+    game_running = 1;
+}
+
+//              Data collection
+
+static void collect(DifficultyLevel d, int wanted) {
+    float half = orthoRight - paddle_width/2;
+    unsigned seed = 1;
+
+    while (sampleCount < wanted) {
+        startMatch(d, seed++);
+        for (int t = 0; t < 60 * 60 * 3 && sampleCount < wanted; t++) {
+            if (player1_score >= 10 || player2_score >= 10) break;
+
+            int16_t in1[NN_INPUTS], in2[NN_INPUTS];
+            nnFeatures(1, in1);
+            nnFeatures(2, in2);
+            update();
+
+            // Label: the target updateAI() chose from this observation
+            memcpy(sampleIn[sampleCount], in1, sizeof(in1));
+            sampleOut[sampleCount++] = player1_target_x / half;
+            if (sampleCount < wanted) {
+                memcpy(sampleIn[sampleCount], in2, sizeof(in2));
+                sampleOut[sampleCount++] = player2_target_x / half;
+            }
+        }
+    }
+}
+
+//              Training (plain SGD with momentum on MSE)
+
+static float clip01(float v) { return v < 0 ? 0 : (v > 1 ? 1 : v); }
+
+static float forward(const FloatNet* n, const float* x, float* h1, float* h2) {
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        float a = n->b1[j];
+        for (int i = 0; i < NN_INPUTS; i++) a += n->w1[j][i] * x[i];
+        h1[j] = clip01(a);
+    }
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        float a = n->b2[j];
+        for (int i = 0; i < NN_HIDDEN; i++) a += n->w2[j][i] * h1[i];
+        h2[j] = clip01(a);
+    }
+    float y = n->b3;
+    for (int i = 0; i < NN_HIDDEN; i++) y += n->w3[i] * h2[i];
+    return y;
+}
+
+static void train(FloatNet* n, int epochs, float lr) {
+    static FloatNet vel;
+    float scale = 1.0f / 127.0f;
+
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        for (int i = 0; i < NN_INPUTS; i++) n->w1[j][i] = (frand() - 0.5f) * 2.0f * sqrtf(3.0f / NN_INPUTS);
+        for (int i = 0; i < NN_HIDDEN; i++) n->w2[j][i] = (frand() - 0.5f) * 2.0f * sqrtf(3.0f / NN_HIDDEN);
+        n->w3[j] = (frand() - 0.5f) * 2.0f * sqrtf(3.0f / NN_HIDDEN);
+        n->b1[j] = n->b2[j] = 0.1f;
+    }
+    n->b3 = 0;
+
+    int* order = malloc(sizeof(int) * sampleCount);
+    for (int i = 0; i < sampleCount; i++) order[i] = i;
+
+    for (int e = 0; e < epochs; e++) {
+        for (int i = sampleCount - 1; i > 0; i--) {
+            int j = rand() % (i + 1), t = order[i];
+            order[i] = order[j]; order[j] = t;
+        }
+
+        double loss = 0;
+        for (int s = 0; s < sampleCount; s++) {
+            float x[NN_INPUTS], h1[NN_HIDDEN], h2[NN_HIDDEN];
+            for (int i = 0; i < NN_INPUTS; i++) x[i] = sampleIn[order[s]][i] * scale;
+
+            float y = forward(n, x, h1, h2);
+            float err = y - sampleOut[order[s]];
+            loss += err * err;
+
+            // Backprop; the clipped ReLU passes gradient only inside (0, 1)
+            float g2[NN_HIDDEN], g1[NN_HIDDEN] = {0};
+            for (int j = 0; j < NN_HIDDEN; j++) {
+                g2[j] = (h2[j] > 0 && h2[j] < 1) ? err * n->w3[j] : 0;
+                vel.w3[j] = 0.9f * vel.w3[j] - lr * err * h2[j];
+                n->w3[j] += vel.w3[j];
+            }
+            vel.b3 = 0.9f * vel.b3 - lr * err;
+            n->b3 += vel.b3;
+
+            for (int j = 0; j < NN_HIDDEN; j++) {
+                if (g2[j] == 0) continue;
+                for (int i = 0; i < NN_HIDDEN; i++) {
+                    g1[i] += g2[j] * n->w2[j][i];
+                    vel.w2[j][i] = 0.9f * vel.w2[j][i] - lr * g2[j] * h1[i];
+                    n->w2[j][i] += vel.w2[j][i];
+                }
+                vel.b2[j] = 0.9f * vel.b2[j] - lr * g2[j];
+                n->b2[j] += vel.b2[j];
+            }
+
+            for (int j = 0; j < NN_HIDDEN; j++) {
+                if (!(h1[j] > 0 && h1[j] < 1) || g1[j] == 0) continue;
+                for (int i = 0; i < NN_INPUTS; i++) {
+                    vel.w1[j][i] = 0.9f * vel.w1[j][i] - lr * g1[j] * x[i];
+                    n->w1[j][i] += vel.w1[j][i];
+                }
+                vel.b1[j] = 0.9f * vel.b1[j] - lr * g1[j];
+                n->b1[j] += vel.b1[j];
+            }
+        }
+        printf("epoch %d  mse %.5f\n", e, loss / sampleCount);
+        fflush(stdout);
+        lr *= 0.7f;
+    }
+    free(order);
+}
+
+//              Quantisation and file output
+
+static float maxAbs(const float* v, int n) {
+    float m = 1e-6f;
+    for (int i = 0; i < n; i++) m = fmaxf(m, fabsf(v[i]));
+    return m;
+}
+
+static int writeLayer(FILE* f, const float* w, const float* b, int nOut, int nIn) {
+    float ws = maxAbs(w, nOut * nIn) / 127.0f;
+    float scale = ws / 127.0f;          // input activations are x * 127
+    int ok = fwrite(&scale, sizeof(float), 1, f) == 1;
+    for (int j = 0; j < nOut; j++) {
+        int32_t q = (int32_t)lrintf(b[j] / scale);
+        ok = ok && fwrite(&q, sizeof(q), 1, f) == 1;
+    }
+    for (int i = 0; i < nOut * nIn; i++) {
+        int8_t q = (int8_t)lrintf(w[i] / ws);
+        ok = ok && fwrite(&q, 1, 1, f) == 1;
+    }
+    return ok;
+}
+
+static int savePolicy(const FloatNet* n, const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return 0;
+    unsigned char hdr[8] = {'P', 'N', 'N', '1', NN_INPUTS, NN_HIDDEN, 0, 0};
+    int ok = fwrite(hdr, 1, 8, f) == 8 &&
+             writeLayer(f, &n->w1[0][0], n->b1, NN_HIDDEN, NN_INPUTS) &&
+             writeLayer(f, &n->w2[0][0], n->b2, NN_HIDDEN, NN_HIDDEN) &&
+             writeLayer(f, n->w3, &n->b3, 1, NN_HIDDEN);
+    return fclose(f) == 0 && ok;
+}
+
+//              Evaluation and benchmark
+
+// Win rate of the learned policy (top) against updateAI() (bottom)
+static void playoff(DifficultyLevel d, int matches) {
+    int wins = 0, losses = 0;
+    for (int m = 0; m < matches; m++) {
+        startMatch(d, 100000u + m);
+        player2_control = CONTROL_NEURAL;
+        for (int t = 0; t < 60 * 60 * 5; t++) {
+            if (player1_score >= 5 || player2_score >= 5) break;
+            update();
+        }
+        if (player2_score > player1_score) wins++;
+        else if (player1_score > player2_score) losses++;
+    }
+    printf("neural vs updateAI: %d wins, %d losses, %d draws\n", wins, losses, matches - wins - losses);
+}
+
+static void bench(DifficultyLevel d) {
+    enum { CALLS = 200000, BATCH = 64 };
+    startMatch(d, 7);
+    for (int t = 0; t < 30; t++) update();
+
+    float saveTarget = player2_target_x;
+    double t0 = nowSeconds();
+    for (int i = 0; i < CALLS; i++) { player2_target_x = saveTarget; updateAI(2); }
+    double tAI = (nowSeconds() - t0) / CALLS;
+
+    player2_control = CONTROL_NEURAL;
+    t0 = nowSeconds();
+    for (int i = 0; i < CALLS; i++) updateNeuralAI(2);
+    double tNN = (nowSeconds() - t0) / CALLS;
+
+    static int16_t in[BATCH][NN_INPUTS];
+    float out[BATCH];
+    for (int k = 0; k < BATCH; k++) nnFeatures(1 + (k & 1), in[k]);
+    t0 = nowSeconds();
+    for (int i = 0; i < CALLS / BATCH; i++) nnForwardBatch((const int16_t (*)[NN_INPUTS])in, out, BATCH);
+    double tBatch = (nowSeconds() - t0) / ((CALLS / BATCH) * BATCH);
+
+    const char* kernel =
+#if defined(__AVX2__)
+        "AVX2";
+#elif defined(__SSE2__)
+        "SSE2";
+#else
+        "scalar";
+#endif
+    printf("kernel %s\n", kernel);
+    printf("updateAI()        %8.1f ns/call\n", tAI * 1e9);
+    printf("updateNeuralAI()  %8.1f ns/call\n", tNN * 1e9);
+    printf("nnForwardBatch()  %8.1f ns/paddle (batch %d)\n", tBatch * 1e9, BATCH);
+}
+
+int main(int argc, char** argv) {
+    DifficultyLevel d = DIFFICULTY_HARD;
+    int samples = 200000, epochs = 8, matches = 100;
+    const char* out = NN_POLICY_FILE;
+    const char* benchFile = NULL;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if      (!strcmp(argv[i], "--difficulty")) d = strcmp(argv[i + 1], "medium") ? DIFFICULTY_HARD : DIFFICULTY_MEDIUM;
+        else if (!strcmp(argv[i], "--samples"))    samples = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--epochs"))     epochs = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--matches"))    matches = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--out"))        out = argv[i + 1];
+        else if (!strcmp(argv[i], "--bench"))      benchFile = argv[i + 1];
+        else { fprintf(stderr, "unknown option %s\n", argv[i]); return 2; }
+    }
+
+    if (benchFile) {
+        if (!loadPolicy(benchFile)) { fprintf(stderr, "cannot load %s\n", benchFile); return 1; }
+        bench(d);
+        playoff(d, matches);
+        return 0;
+    }
+
+    if (samples > MAX_SAMPLES) samples = MAX_SAMPLES;
+    sampleIn  = malloc(sizeof(*sampleIn) * samples);
+    sampleOut = malloc(sizeof(float) * samples);
+    if (!sampleIn || !sampleOut) { fprintf(stderr, "out of memory\n"); return 1; }
+
+    collect(d, samples);
+    printf("collected %d samples\n", sampleCount);
+
+    static FloatNet net;
+    srand(1);
+    train(&net, epochs, 0.002f);
+
+    if (!savePolicy(&net, out)) { fprintf(stderr, "cannot write %s\n", out); return 1; }
+    if (!loadPolicy(out)) { fprintf(stderr, "cannot read back %s\n", out); return 1; }
+
+    // Agreement between the float network and the int8 kernels
+    double qerr = 0;
+    for (int s = 0; s < sampleCount; s += 97) {
+        float x[NN_INPUTS], h1[NN_HIDDEN], h2[NN_HIDDEN], q;
+        for (int i = 0; i < NN_INPUTS; i++) x[i] = sampleIn[s][i] / 127.0f;
+        float f = fmaxf(-1.0f, fminf(1.0f, forward(&net, x, h1, h2)));
+        nnForwardBatch((const int16_t (*)[NN_INPUTS])&sampleIn[s], &q, 1);
+        qerr += fabsf(f - q);
+    }
+    printf("wrote %s; mean |float - int8| = %.4f\n", out, qerr / ((sampleCount + 96) / 97));
+
+    bench(d);
+    playoff(d, matches);
+    return 0;
+}
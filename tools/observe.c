@@ -0,0 +1,209 @@
+// Reads and drives a running game through its shared state segment
+// (SharedState in pingpong.c).
+//
+// host   stands in for the game when there is no window: plays AI-vs-AI
+//        matches (a new one every --match-ticks) at 60 ticks/s, or flat out
+//        with --fast, publishing every tick, and reports what the publish
+//        costs next to update()
+// watch  prints the live match ten times a second. With --spin it reads
+//        back to back instead and reports reads per second, how many had to
+//        retry because they overlapped a publish, and frames whose ball
+//        position does not lie on its recorded path (a torn copy would)
+// bot    claims paddle --paddle 1|2 and keeps it under the nearest incoming
+//        ball. The claim takes effect when the next match starts and is
+//        released on exit
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/observe.c -o observe -lm
+// Examples:
+//   ./observe host --fast --seconds 10 &
+//   ./observe watch --spin --seconds 5
+//   ./observe bot --paddle 1 --seconds 30
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+#include <signal.h>
+
+static volatile sig_atomic_t stop = 0;
+
+static void onSignal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void sleepSeconds(double s) {
+    struct timespec t = {(time_t)s, (long)((s - (time_t)s) * 1e9)};
+    nanosleep(&t, NULL);
+}
+
+//              host
+
+static void newMatch(void) {
+    currentMode = MODE_PVP;
+    currentDifficulty = DIFFICULTY_HARD;
+    initGame();
+    resetBall(&balls[0]);
+    game_running = 1;
+}
+
+static int host(double seconds, int fast, int matchTicks) {
+    if (!shareOpen(SHARE_NAME, 1)) { perror("shm_open " SHARE_NAME); return 1; }
+    srand((unsigned)time(NULL));
+    player1_control = player2_control = CONTROL_AUTO;
+    sim_cosmetics = 0;
+    newMatch();
+
+    // The publish on its own, for the per-tick cost
+    const int reps = 200000;
+    double t0 = nowSeconds();
+    for (int i = 0; i < reps; i++) sharePublish();
+    double publish = (nowSeconds() - t0) / reps;
+
+    printf("hosting %s: %zu-byte frame, publish %.1f ns per tick\n",
+           SHARE_NAME, sizeof(MatchState), publish * 1e9);
+    fflush(stdout);
+
+    long ticks = 0;
+    double updateTime = 0, start = nowSeconds(), next = start;
+    while (!stop && nowSeconds() - start < seconds) {
+        if (matchTicks && sim_tick >= matchTicks) {
+            newMatch();
+            sim_tick = 0;
+        }
+        double u0 = nowSeconds();
+        update();                       // publishes at the end
+        updateTime += nowSeconds() - u0;
+        ticks++;
+        if (!fast) {
+            next += 1.0 / 60;
+            double wait = next - nowSeconds();
+            if (wait > 0) sleepSeconds(wait);
+        }
+    }
+    printf("%ld ticks, update() with publish %.1f ns per tick (publish %.1f%% of it)\n",
+           ticks, updateTime * 1e9 / ticks, publish * 100 / (updateTime / ticks));
+    shareClose();
+    return 0;
+}
+
+//              watch
+
+// Every engine lands a ball at origin + v * ticks since the last bounce, so
+// a frame that mixes two ticks shows up here
+static int ballOffPath(const MatchState* s) {
+    for (int i = 0; i < 3; i++) {
+        const Ball* b = &s->balls[i];
+        if (!b->active) continue;
+        float n = (float)(s->tick - b->originTick);
+        if (b->x != b->originX + b->vx * n || b->y != b->originY + b->vy * n) return 1;
+    }
+    return 0;
+}
+
+static int watch(double seconds, int spin) {
+    if (!shareOpen(SHARE_NAME, 0)) { fprintf(stderr, "no game is publishing %s\n", SHARE_NAME); return 1; }
+    MatchState s;
+    long reads = 0, retried = 0, offPath = 0;
+    double start = nowSeconds(), nextPrint = start;
+
+    while (!stop && nowSeconds() - start < seconds) {
+        int tries = shareRead(share, &s);
+        reads++;
+        retried += tries > 1;
+        offPath += ballOffPath(&s);
+
+        double now = nowSeconds();
+        if (now >= nextPrint) {
+            printf("tick %7d  %d:%d  ball %7.1f %7.1f  paddles %7.1f %7.1f  controls %d %d\n",
+                   s.tick, s.score[0], s.score[1], s.balls[0].x, s.balls[0].y,
+                   s.paddleX[0], s.paddleX[1], s.control[0], s.control[1]);
+            nextPrint = now + (spin ? 1.0 : 0.1);
+        }
+        if (!spin) sleepSeconds(0.1);
+    }
+    double t = nowSeconds() - start;
+    printf("%ld reads (%.0f/s), %ld retried, %ld off-path frames\n",
+           reads, reads / t, retried, offPath);
+    shareClose();
+    return offPath ? 1 : 0;
+}
+
+//              bot
+
+// Where the nearest ball heading for paddle k will cross its line, folded
+// off the side walls of the default field
+static float botTarget(const MatchState* s, int k) {
+    float lineY = k == 0 ? orthoBottom + 2 * s->paddleHeight : orthoTop - 2 * s->paddleHeight;
+    float best = 1e9f, x = 0;
+    for (int i = 0; i < 3; i++) {
+        const Ball* b = &s->balls[i];
+        if (!b->active || (k == 0 ? b->vy >= 0 : b->vy <= 0)) continue;
+        float t = (lineY - b->y) / b->vy;
+        if (t < 0 || t >= best) continue;
+        float w = orthoRight - orthoLeft - 2 * b->radius;
+        float p = fmodf(b->x + b->vx * t - orthoLeft - b->radius, 2 * w);
+        if (p < 0) p += 2 * w;
+        best = t;
+        x = orthoLeft + b->radius + (p > w ? 2 * w - p : p);
+    }
+    return x;
+}
+
+static int bot(double seconds, int paddle) {
+    if (!shareOpen(SHARE_NAME, 0)) { fprintf(stderr, "no game is publishing %s\n", SHARE_NAME); return 1; }
+    int k = paddle - 1;
+    __atomic_store_n(&share->claim[k], 1, __ATOMIC_RELEASE);
+    printf("claimed paddle %d; it is ours from the next match\n", paddle);
+    fflush(stdout);
+
+    MatchState s;
+    double start = nowSeconds();
+    while (!stop && nowSeconds() - start < seconds) {
+        shareRead(share, &s);
+        float t = botTarget(&s, k);
+        __atomic_store(&share->target[k], &t, __ATOMIC_RELEASE);
+        sleepSeconds(0.002);
+    }
+    printf("score %d:%d\n", s.score[0], s.score[1]);
+    __atomic_store_n(&share->claim[k], 0, __ATOMIC_RELEASE);
+    shareClose();
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s host  [--seconds S] [--fast] [--match-ticks N]\n"
+        "       %s watch [--seconds S] [--spin]\n"
+        "       %s bot   [--seconds S] [--paddle 1|2]\n", prog, prog, prog);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) { usage(argv[0]); return 2; }
+    double seconds = 1e9;
+    int fast = 0, spin = 0, paddle = 1, matchTicks = 3600;
+
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--seconds") && i + 1 < argc)          seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--fast"))                        fast = 1;
+        else if (!strcmp(argv[i], "--spin"))                        spin = 1;
+        else if (!strcmp(argv[i], "--paddle") && i + 1 < argc)      paddle = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--match-ticks") && i + 1 < argc) matchTicks = atoi(argv[++i]);
+        else { usage(argv[0]); return 2; }
+    }
+    if (seconds <= 0 || paddle < 1 || paddle > 2 || matchTicks < 0) { usage(argv[0]); return 2; }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    if (!strcmp(argv[1], "host"))  return host(seconds, fast, matchTicks);
+    if (!strcmp(argv[1], "watch")) return watch(seconds, spin);
+    if (!strcmp(argv[1], "bot"))   return bot(seconds, paddle);
+    usage(argv[0]);
+    return 2;
+}
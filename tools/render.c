@@ -0,0 +1,143 @@
+// Renders game frames on the CPU with softgl.h and reports throughput.
+//
+// An AI-vs-AI match is simulated one tick per frame and drawn with the
+// game's own display(). Only rendering (display() + swFinish()) is timed.
+// The hash of the last frame can be compared between runs as a golden
+// image; --dump writes it as a binary PPM. --quality picks a fixed row of
+// qualityLevels (the governor only runs in the game). --overlay draws the
+// performance overlay (F7 in the game) with update() timed as the tick.
+// --screen arena plays an all-AI arena with --players paddles instead,
+// on the pieces of --level FILE or --pieces N scattered at random.
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/render.c -o render -lm -lpthread
+// Examples:
+//   ./render --frames 2000 --threads 1
+//   ./render --screen menu --dump menu.ppm
+//   ./render --frames 2000 --quality 0
+//   ./render --overlay --dump overlay.ppm
+//   ./render --screen arena --players 12 --dump arena.ppm
+//   ./render --screen arena --pieces 200 --dump level.ppm
+
+#define PONG_SOFTRENDER
+#include "../pingpong.c"
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int writePPM(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) { perror(path); return 0; }
+    fprintf(f, "P6\n%d %d\n255\n", sw_width, sw_height);
+    unsigned char* row = malloc((size_t)sw_width * 3);
+    for (int y = 0; y < sw_height; y++) {
+        const uint32_t* src = sw_fb + (size_t)y * sw_width;
+        for (int x = 0; x < sw_width; x++) {
+            row[x * 3 + 0] = (unsigned char)(src[x]);
+            row[x * 3 + 1] = (unsigned char)(src[x] >> 8);
+            row[x * 3 + 2] = (unsigned char)(src[x] >> 16);
+        }
+        fwrite(row, 1, (size_t)sw_width * 3, f);
+    }
+    free(row);
+    fclose(f);
+    return 1;
+}
+
+static unsigned long long frameHash(void) {
+    unsigned long long h = 1469598103934665603ULL;
+    const unsigned char* p = (const unsigned char*)sw_fb;
+    for (size_t i = 0; i < (size_t)sw_width * sw_height * 4; i++) { h ^= p[i]; h *= 1099511628211ULL; }
+    return h;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s [--frames N] [--threads N] [--size WxH] [--warmup TICKS]\n"
+        "          [--screen game|menu|difficulty|speed|arena] [--dump FILE.ppm]\n"
+        "          [--seed N] [--quality 0-%d] [--overlay] [--players 4-16]\n"
+        "          [--level FILE | --pieces N]\n", prog, QUALITY_LEVELS - 1);
+}
+
+int main(int argc, char** argv) {
+    int frames = 1000, threads = 1, width = WINDOW_WIDTH, height = WINDOW_HEIGHT;
+    int warmup = 600, pieces = 0;
+    unsigned seed = 1;
+    const char* screen = "game";
+    const char* dump = NULL;
+    const char* levelPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)       frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--warmup") && i + 1 < argc)  warmup = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)    seed = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--screen") && i + 1 < argc)  screen = argv[++i];
+        else if (!strcmp(argv[i], "--dump") && i + 1 < argc)    dump = argv[++i];
+        else if (!strcmp(argv[i], "--quality") && i + 1 < argc) quality.level = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--overlay"))                 perf.on = 1;
+        else if (!strcmp(argv[i], "--players") && i + 1 < argc) arena_players = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--level") && i + 1 < argc)   levelPath = argv[++i];
+        else if (!strcmp(argv[i], "--pieces") && i + 1 < argc)  pieces = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) { usage(argv[0]); return 2; }
+        }
+        else { usage(argv[0]); return 2; }
+    }
+    if (frames < 1 || width < 16 || height < 16 ||
+        quality.level < 0 || quality.level >= QUALITY_LEVELS ||
+        arena_players < ARENA_MIN_PLAYERS || arena_players > ARENA_MAX_PLAYERS ||
+        pieces < 0 || pieces > LEVEL_MAX_PIECES) { usage(argv[0]); return 2; }
+
+    if (!initSoftRenderer(width, height, threads)) { fprintf(stderr, "out of memory\n"); return 1; }
+
+    srand(seed);
+    fx_seed = seed;
+    if      (!strcmp(screen, "menu"))       currentMode = MODE_MENU;
+    else if (!strcmp(screen, "difficulty")) currentMode = MODE_DIFFICULTY_SELECT;
+    else if (!strcmp(screen, "speed"))      currentMode = MODE_SPEED_SELECT;
+    else if (!strcmp(screen, "game"))       currentMode = MODE_PVP;
+    else if (!strcmp(screen, "arena"))      currentMode = MODE_ARENA;
+    else { usage(argv[0]); return 2; }
+
+    player1_control = CONTROL_AUTO;
+    player2_control = CONTROL_AUTO;
+    initGame();
+    resetBall(&balls[0]);
+    game_running = (currentMode == MODE_PVP);
+    if (currentMode == MODE_ARENA) {
+        if (levelPath && levelLoad(levelPath) < 0) { perror(levelPath); return 1; }
+        if (pieces) levelScatter(pieces, seed, ARENA_RADIUS * cosf(PI / arena_players) - 80);
+        initArena(arena_players, arena_players / 2, 0);
+        game_running = 1;
+    }
+    for (int i = 0; i < warmup; i++) {
+        if (game_running) update();
+        else animation_time += 0.016f;
+    }
+
+    double render = 0;
+    for (int f = 0; f < frames; f++) {
+        double tick0 = nowSeconds();
+        if (game_running) update();
+        else animation_time += 0.016f;
+        if (perf.on) perfTick((nowSeconds() - tick0) * 1000.0);
+
+        double t0 = nowSeconds();
+        display();
+        swFinish();
+        render += nowSeconds() - t0;
+    }
+
+    printf("%dx%d %s, quality %d, %d thread%s: %.0f frames/s (%.3f ms/frame)\n",
+           width, height, screen, quality.level, sw_threads, sw_threads == 1 ? "" : "s",
+           frames / render, render * 1000.0 / frames);
+    printf("last frame hash %016llx\n", frameHash());
+    if (dump && writePPM(dump)) printf("wrote %s\n", dump);
+
+    swShutdown();
+    return 0;
+}
@@ -0,0 +1,696 @@
+// Authoritative multi-room game server and bot load generator (Linux).
+//
+// serve  runs --workers event loops (default: one per core), each on its
+//        own UDP port (--port + k). A loop waits in epoll on its socket and
+//        a 16 ms timerfd; every tick it steps all of its rooms with
+//        update() (loading and saving each room's MatchState around the
+//        call) and sends every client a state packet. Packets are read and
+//        written in batches with recvmmsg/sendmmsg. Workers are processes
+//        rather than threads because the simulation lives in globals
+// load   joins bots to the server (PvC rooms, plus PvP rooms with
+//        --pvp), drives their paddles from the received state and prints
+//        the server's tick-latency percentiles every second. --ramp adds
+//        rooms step by step until a tick misses its deadline and reports
+//        the most rooms per core that held the 16 ms rate
+//
+// A tick misses its deadline when it completes after the next tick was due.
+// Tick latency is measured from when the tick was due to when all rooms are
+// stepped and their packets are handed to the kernel.
+//
+// Build (Linux):
+//   gcc -O2 tools/server.c -o server -lm
+// Examples:
+//   ./server serve --workers 4 &
+//   ./server load --workers 4 --rooms 2000 --seconds 10
+//   ./server load --workers 4 --ramp 250 --pvp 0.5
+
+#define _GNU_SOURCE                     // recvmmsg / sendmmsg
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+#include <errno.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+#define NET_MAGIC     0x4E474E50u       // "PNGN"
+#define TICK_NS       16000000LL
+#define BATCH         64                // datagrams per recvmmsg/sendmmsg
+#define HIST_US       100000            // latency histogram range (100 ms)
+#define IDLE_TICKS    (5 * 1000 / 16)   // drop clients silent for 5 s
+#define MAX_WORKERS   64
+#define MAX_PACKET    128
+
+typedef enum {
+    NET_JOIN,                           // client -> server
+    NET_JOINED,                         // server -> client
+    NET_INPUT,                          // client -> server, paddle target
+    NET_LEAVE,                          // client -> server
+    NET_STATE,                          // server -> client, every tick
+    NET_STATS,                          // load -> server
+    NET_STATS_REPLY                     // server -> load
+} NetType;
+
+// Client -> server
+typedef struct {
+    uint32_t magic;
+    uint8_t type, mode, difficulty, player;
+    uint32_t room, token;               // from NET_JOINED
+    uint32_t client;                    // client's own id, echoed back
+    uint32_t seq;
+    uint32_t sentUs;                    // echoed back in NET_STATE
+    float target;
+} NetInput;
+
+// Server -> client
+typedef struct {
+    uint32_t magic;
+    uint8_t type, player, score1, score2;
+    uint32_t room, token;
+    uint32_t client;
+    uint32_t tick, seq;                 // seq = last input applied
+    uint32_t echoUs;
+    float paddle[2];
+    float ball[3][2];
+    uint8_t ballActive, pad[3];
+} NetState;
+
+typedef struct {
+    uint32_t magic;
+    uint8_t type, pad[3];
+    uint32_t rooms, clients, ticks, misses;
+    uint32_t p50, p90, p99, p999, maxUs;    // tick latency since the last query
+    uint32_t busyPermille;
+    uint64_t rxPackets, txPackets;
+} NetStats;
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int64_t nowNs(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static int udpSocket(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    int size = 8 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    struct sockaddr_in a = {0};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_ANY);
+    a.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&a, sizeof(a)) < 0) { close(fd); return -1; }
+    return fd;
+}
+
+//              Batched UDP I/O
+
+typedef struct {
+    struct mmsghdr msgs[BATCH];
+    struct iovec iov[BATCH];
+    struct sockaddr_in addr[BATCH];
+    uint8_t buf[BATCH][MAX_PACKET];
+    int count;
+    uint64_t sent;
+} SendBatch;
+
+static void sendFlush(int fd, SendBatch* b) {
+    int done = 0;
+    while (done < b->count) {
+        int n = sendmmsg(fd, b->msgs + done, (unsigned)(b->count - done), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;                      // socket buffer full: drop, as UDP would
+        }
+        done += n;
+    }
+    b->sent += (uint64_t)done;
+    b->count = 0;
+}
+
+static void* sendSlot(int fd, SendBatch* b, const struct sockaddr_in* to, size_t len) {
+    if (b->count == BATCH) sendFlush(fd, b);
+    int i = b->count++;
+    b->addr[i] = *to;
+    b->iov[i].iov_base = b->buf[i];
+    b->iov[i].iov_len = len;
+    memset(&b->msgs[i], 0, sizeof(b->msgs[i]));
+    b->msgs[i].msg_hdr.msg_name = &b->addr[i];
+    b->msgs[i].msg_hdr.msg_namelen = sizeof(b->addr[i]);
+    b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+    b->msgs[i].msg_hdr.msg_iovlen = 1;
+    return b->buf[i];
+}
+
+typedef struct {
+    struct mmsghdr msgs[BATCH];
+    struct iovec iov[BATCH];
+    struct sockaddr_in addr[BATCH];
+    uint8_t buf[BATCH][MAX_PACKET];
+} RecvBatch;
+
+static int recvBatch(int fd, RecvBatch* b) {
+    for (int i = 0; i < BATCH; i++) {
+        b->iov[i].iov_base = b->buf[i];
+        b->iov[i].iov_len = sizeof(b->buf[i]);
+        memset(&b->msgs[i].msg_hdr, 0, sizeof(b->msgs[i].msg_hdr));
+        b->msgs[i].msg_hdr.msg_name = &b->addr[i];
+        b->msgs[i].msg_hdr.msg_namelen = sizeof(b->addr[i]);
+        b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+        b->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int n = recvmmsg(fd, b->msgs, BATCH, 0, NULL);
+    return n < 0 ? 0 : n;
+}
+
+//              serve
+
+typedef struct {
+    int used;
+    int players;                        // clients needed: 1 (PvC) or 2 (PvP)
+    int joined;
+    uint32_t token;
+    MatchState state;
+    struct sockaddr_in addr[2];
+    float target[2];
+    uint32_t client[2], seq[2], echo[2];
+    int lastHeard[2];                   // worker tick of the last packet
+} Room;
+
+static Room* rooms;
+static int roomCap = 0, roomCount = 0, clientCount = 0;
+static int* freeRooms;
+static int freeCount = 0;
+static int waitingRoom[2] = {-1, -1};   // PvP room with one player, per difficulty
+static int workerTick = 0;
+
+static uint32_t latencyHist[HIST_US + 1];
+static uint32_t statTicks = 0, statMisses = 0;
+static int64_t statBusyNs = 0, statSince = 0;
+static uint64_t rxPackets = 0;
+
+static int allocRoom(void) {
+    if (freeCount) return freeRooms[--freeCount];
+    if (roomCap == 0 || roomCount == roomCap) {
+        int cap = roomCap ? roomCap * 2 : 1024;
+        Room* r = realloc(rooms, (size_t)cap * sizeof(Room));
+        int* f = realloc(freeRooms, (size_t)cap * sizeof(int));
+        if (!r || !f) return -1;
+        rooms = r;
+        freeRooms = f;
+        roomCap = cap;
+    }
+    return roomCount++;
+}
+
+static void closeRoom(int id) {
+    Room* r = &rooms[id];
+    if (!r->used) return;
+    clientCount -= r->joined;
+    r->used = 0;
+    for (int d = 0; d < 2; d++) if (waitingRoom[d] == id) waitingRoom[d] = -1;
+    freeRooms[freeCount++] = id;
+}
+
+// Set up a fresh match on the globals and store it in the room
+static void startRoom(Room* r, GameMode mode, DifficultyLevel difficulty) {
+    currentMode = mode;
+    currentDifficulty = difficulty;
+    pvp_ball_speed = (difficulty == DIFFICULTY_MEDIUM) ? 16.0f : 18.0f;
+    player1_control = CONTROL_MOUSE;
+    player2_control = (mode == MODE_PVP) ? CONTROL_MOUSE : CONTROL_AUTO;
+    sim_tick = 0;
+    initGame();
+    serveBall();
+    matchSave(&r->state);
+    r->target[0] = r->target[1] = 0.0f;
+}
+
+static void onJoin(int fd, SendBatch* out, const NetInput* in, const struct sockaddr_in* from) {
+    GameMode mode = in->mode == MODE_PVP ? MODE_PVP : MODE_PVC;
+    DifficultyLevel difficulty = in->difficulty == DIFFICULTY_HARD ? DIFFICULTY_HARD : DIFFICULTY_MEDIUM;
+    int id, player;
+
+    if (mode == MODE_PVP && waitingRoom[difficulty] >= 0) {
+        id = waitingRoom[difficulty];
+        waitingRoom[difficulty] = -1;
+        player = 1;
+    } else {
+        id = allocRoom();
+        if (id < 0) return;
+        Room* r = &rooms[id];
+        memset(r, 0, sizeof(*r));
+        r->used = 1;
+        r->players = (mode == MODE_PVP) ? 2 : 1;
+        r->token = (uint32_t)rand() * 2654435761u + 1;
+        startRoom(r, mode, difficulty);
+        if (mode == MODE_PVP) waitingRoom[difficulty] = id;
+        player = 0;
+    }
+
+    Room* r = &rooms[id];
+    r->addr[player] = *from;
+    r->client[player] = in->client;
+    r->lastHeard[player] = workerTick;
+    r->joined++;
+    clientCount++;
+
+    NetState* s = sendSlot(fd, out, from, sizeof(NetState));
+    memset(s, 0, sizeof(*s));
+    s->magic = NET_MAGIC;
+    s->type = NET_JOINED;
+    s->player = (uint8_t)player;
+    s->room = (uint32_t)id;
+    s->token = r->token;
+    s->client = in->client;
+}
+
+static void onStats(int fd, SendBatch* out, const struct sockaddr_in* from) {
+    NetStats* s = sendSlot(fd, out, from, sizeof(NetStats));
+    memset(s, 0, sizeof(*s));
+    s->magic = NET_MAGIC;
+    s->type = NET_STATS_REPLY;
+    s->rooms = (uint32_t)(roomCount - freeCount);
+    s->clients = (uint32_t)clientCount;
+    s->ticks = statTicks;
+    s->misses = statMisses;
+
+    // Percentiles of the ticks since the previous query
+    uint32_t* want[4] = {&s->p50, &s->p90, &s->p99, &s->p999};
+    const double q[4] = {0.5, 0.9, 0.99, 0.999};
+    uint64_t seen = 0;
+    int k = 0;
+    for (int us = 0; us <= HIST_US && statTicks; us++) {
+        seen += latencyHist[us];
+        while (k < 4 && seen >= (uint64_t)(q[k] * statTicks + 0.5) && seen) *want[k++] = (uint32_t)us;
+        if (latencyHist[us]) s->maxUs = (uint32_t)us;
+    }
+    int64_t now = nowNs();
+    s->busyPermille = now > statSince ? (uint32_t)(statBusyNs * 1000 / (now - statSince)) : 0;
+    s->rxPackets = rxPackets;
+    s->txPackets = out->sent;
+
+    memset(latencyHist, 0, sizeof(latencyHist));
+    statTicks = statMisses = 0;
+    statBusyNs = 0;
+    statSince = now;
+}
+
+static void onPacket(int fd, SendBatch* out, const uint8_t* buf, int len, const struct sockaddr_in* from) {
+    const NetInput* in = (const NetInput*)buf;
+    if (len < (int)sizeof(NetInput) || in->magic != NET_MAGIC) return;
+    rxPackets++;
+
+    if (in->type == NET_JOIN)  { onJoin(fd, out, in, from); return; }
+    if (in->type == NET_STATS) { onStats(fd, out, from); return; }
+
+    if (in->room >= (uint32_t)roomCount || in->player > 1) return;
+    Room* r = &rooms[in->room];
+    if (!r->used || r->token != in->token || in->player >= r->joined) return;
+
+    if (in->type == NET_LEAVE) { closeRoom((int)in->room); return; }
+    if (in->type == NET_INPUT && in->seq > r->seq[in->player]) {
+        r->target[in->player] = in->target;
+        r->seq[in->player] = in->seq;
+        r->echo[in->player] = in->sentUs;
+        r->addr[in->player] = *from;
+        r->lastHeard[in->player] = workerTick;
+    }
+}
+
+static void stepRooms(int fd, SendBatch* out) {
+    workerTick++;
+    for (int id = 0; id < roomCount; id++) {
+        Room* r = &rooms[id];
+        if (!r->used) continue;
+        int idle = 0;
+        for (int p = 0; p < r->joined; p++)
+            if (workerTick - r->lastHeard[p] > IDLE_TICKS) idle = 1;
+        if (idle) { closeRoom(id); continue; }
+        if (r->joined < r->players) continue;   // PvP room still waiting
+
+        matchLoad(&r->state);
+        player1_target_x = r->target[0];
+        if (r->players == 2) player2_target_x = r->target[1];
+        update();
+        matchSave(&r->state);
+
+        for (int p = 0; p < r->players; p++) {
+            NetState* s = sendSlot(fd, out, &r->addr[p], sizeof(NetState));
+            s->magic = NET_MAGIC;
+            s->type = NET_STATE;
+            s->player = (uint8_t)p;
+            s->score1 = (uint8_t)player1_score;
+            s->score2 = (uint8_t)player2_score;
+            s->room = (uint32_t)id;
+            s->token = r->token;
+            s->client = r->client[p];
+            s->tick = (uint32_t)sim_tick;
+            s->seq = r->seq[p];
+            s->echoUs = r->echo[p];
+            s->paddle[0] = player1_paddle_x;
+            s->paddle[1] = player2_paddle_x;
+            s->ballActive = 0;
+            for (int i = 0; i < 3; i++) {
+                s->ball[i][0] = balls[i].x;
+                s->ball[i][1] = balls[i].y;
+                if (balls[i].active) s->ballActive |= (uint8_t)(1 << i);
+            }
+            memset(s->pad, 0, sizeof(s->pad));
+        }
+    }
+    sendFlush(fd, out);
+}
+
+static int serveWorker(uint16_t port) {
+    int fd = udpSocket(port);
+    if (fd < 0) { perror("bind"); return 1; }
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    struct itimerspec its = {{0, TICK_NS}, {0, TICK_NS}};
+    timerfd_settime(tfd, 0, &its, NULL);
+    int64_t due = nowNs() + TICK_NS;    // when the next tick is due
+    statSince = nowNs();
+
+    int ep = epoll_create1(0);
+    struct epoll_event ev = {.events = EPOLLIN};
+    ev.data.fd = fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+    ev.data.fd = tfd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, tfd, &ev);
+
+    srand(port);
+    sim_cosmetics = 0;
+    static SendBatch out;
+    static RecvBatch in;
+
+    for (;;) {
+        struct epoll_event events[2];
+        int n = epoll_wait(ep, events, 2, -1);
+        if (n < 0 && errno != EINTR) break;
+        for (int e = 0; e < n; e++) {
+            if (events[e].data.fd == fd) {
+                int got;
+                while ((got = recvBatch(fd, &in)) > 0) {
+                    for (int i = 0; i < got; i++)
+                        onPacket(fd, &out, in.buf[i], (int)in.msgs[i].msg_len, &in.addr[i]);
+                    if (got < BATCH) break;
+                }
+                sendFlush(fd, &out);
+            } else {
+                uint64_t expirations = 0;
+                if (read(tfd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+                // Late ticks are still run, back to back, and count as misses
+                for (uint64_t k = 0; k < expirations; k++) {
+                    int64_t t0 = nowNs();
+                    stepRooms(fd, &out);
+                    int64_t t1 = nowNs();
+                    int64_t us = (t1 - due) / 1000;
+                    if (us < 0) us = 0;
+                    latencyHist[us > HIST_US ? HIST_US : us]++;
+                    if (t1 > due + TICK_NS) statMisses++;
+                    statTicks++;
+                    statBusyNs += t1 - t0;
+                    due += TICK_NS;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int serve(uint16_t port, int workers) {
+    pid_t pids[MAX_WORKERS];
+    for (int k = 0; k < workers; k++) {
+        pids[k] = fork();
+        if (pids[k] == 0) {
+            // Workers exit with the parent so a Ctrl-C stops the whole server.
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() == 1) _exit(0);
+            _exit(serveWorker((uint16_t)(port + k)));
+        }
+    }
+    printf("serving on UDP ports %d-%d, %d worker%s\n",
+           port, port + workers - 1, workers, workers == 1 ? "" : "s");
+    fflush(stdout);
+    int status = 0;
+    for (int k = 0; k < workers; k++) waitpid(pids[k], &status, 0);
+    return 0;
+}
+
+//              load
+
+typedef struct {
+    uint32_t room, token;
+    int worker;
+    uint8_t player, mode;
+    uint32_t seq, acked;
+    int joined;
+    float target;
+} Bot;
+
+static Bot* bots;
+static int botCount = 0;
+static uint32_t rttHist[HIST_US + 1];
+static uint32_t rttCount = 0;
+static uint64_t statePackets = 0;
+
+static uint32_t nowUs(void) {
+    return (uint32_t)(nowNs() / 1000);
+}
+
+static void fillInput(NetInput* in, const Bot* b, int type) {
+    NetInput v = {NET_MAGIC, (uint8_t)type, b->mode, DIFFICULTY_MEDIUM, b->player,
+                  b->room, b->token, (uint32_t)(b - bots), b->seq, nowUs(), b->target};
+    *in = v;
+}
+
+static void onBotPacket(const uint8_t* buf, int len) {
+    const NetState* s = (const NetState*)buf;
+    if (len < (int)sizeof(NetState) || s->magic != NET_MAGIC) return;
+    if (s->client >= (uint32_t)botCount) return;
+    Bot* b = &bots[s->client];
+    if (s->type == NET_JOINED) {
+        b->room = s->room;
+        b->token = s->token;
+        b->player = s->player;
+        b->joined = 1;
+        return;
+    }
+    if (s->type != NET_STATE) return;
+    statePackets++;
+    if (s->seq != b->acked) {
+        // First state that includes a new input: input-to-state latency
+        b->acked = s->seq;
+        uint32_t rtt = nowUs() - s->echoUs;
+        rttHist[rtt > HIST_US ? HIST_US : rtt]++;
+        rttCount++;
+    }
+}
+
+static uint32_t rttPercentile(double q) {
+    uint64_t seen = 0;
+    for (int us = 0; us <= HIST_US; us++) {
+        seen += rttHist[us];
+        if (rttCount && seen >= (uint64_t)(q * rttCount + 0.5)) return (uint32_t)us;
+    }
+    return 0;
+}
+
+static int queryStats(int fd, const struct sockaddr_in* to, int workers, NetStats* out) {
+    for (int k = 0; k < workers; k++) {
+        NetInput q = {0};
+        q.magic = NET_MAGIC;
+        q.type = NET_STATS;
+        sendto(fd, &q, sizeof(q), 0, (const struct sockaddr*)&to[k], sizeof(to[k]));
+    }
+    int got = 0;
+    double deadline = nowSeconds() + 1.0;
+    while (got < workers && nowSeconds() < deadline) {
+        NetStats s;
+        struct sockaddr_in from;
+        socklen_t fl = sizeof(from);
+        ssize_t n = recvfrom(fd, &s, sizeof(s), 0, (struct sockaddr*)&from, &fl);
+        if (n == (ssize_t)sizeof(s) && s.magic == NET_MAGIC && s.type == NET_STATS_REPLY) {
+            int k = ntohs(from.sin_port) - ntohs(to[0].sin_port);
+            if (k >= 0 && k < workers) { out[k] = s; got++; }
+        } else if (n < 0) {
+            usleep(1000);
+        }
+    }
+    return got == workers;
+}
+
+static int load(const char* host, uint16_t port, int workers, int roomsWanted, int ramp,
+                double pvpShare, int seconds, int inputEvery) {
+    struct sockaddr_in to[MAX_WORKERS];
+    for (int k = 0; k < workers; k++) {
+        memset(&to[k], 0, sizeof(to[k]));
+        to[k].sin_family = AF_INET;
+        to[k].sin_port = htons((uint16_t)(port + k));
+        if (inet_pton(AF_INET, host, &to[k].sin_addr) != 1) { fprintf(stderr, "bad host %s\n", host); return 2; }
+    }
+
+    // Bots share a few sockets; the server addresses them by room and player
+    enum { SOCKETS = 8 };
+    int fds[SOCKETS];
+    for (int i = 0; i < SOCKETS; i++)
+        if ((fds[i] = udpSocket(0)) < 0) { perror("socket"); return 1; }
+    int statsFd = udpSocket(0);
+
+    int maxRooms = ramp ? 1 << 18 : roomsWanted;
+    bots = calloc((size_t)maxRooms * 2, sizeof(Bot));
+    int roomsMade = 0, pvpMade = 0;
+    int best = -1, levelReports = 0, levelMisses = 0;
+    double pvpCarry = 0;
+    static RecvBatch in;
+    static SendBatch out;
+
+    int64_t nextTick = nowNs();
+    double start = nowSeconds(), nextReport = start + 1.0, nextRamp = start;
+    int level = ramp ? 0 : roomsWanted, tick = 0;
+    printf("%8s %8s %9s %8s %8s %8s %8s %7s %6s %10s %10s\n", "time", "rooms", "clients",
+           "tick p50", "p99", "p99.9", "max", "misses", "busy", "rtt p50", "rtt p99");
+
+    for (;;) {
+        double now = nowSeconds();
+        if (!ramp && now - start >= seconds) break;
+
+        // Ramp: a level holds if every room was ticking and no tick missed
+        // its deadline while it ran; then add the next step
+        if (ramp && now >= nextRamp) {
+            if (level > 0) {
+                if (levelReports == 0 || levelMisses > 0) break;
+                best = level;
+            }
+            level += ramp * workers;
+            nextRamp = now + 3.0;
+            levelReports = levelMisses = 0;
+        }
+        while (roomsMade < level && roomsMade < maxRooms) {
+            int k = roomsMade % workers;
+            pvpCarry += pvpShare;
+            int pvp = pvpCarry >= 1.0;
+            if (pvp) pvpCarry -= 1.0;
+            for (int p = 0; p < (pvp ? 2 : 1); p++) {
+                int i = botCount++;
+                Bot* b = &bots[i];
+                b->worker = k;
+                b->mode = pvp ? MODE_PVP : MODE_PVC;
+                fillInput(sendSlot(fds[i % SOCKETS], &out, &to[k], sizeof(NetInput)), b, NET_JOIN);
+                sendFlush(fds[i % SOCKETS], &out);
+            }
+            pvpMade += pvp;
+            roomsMade++;
+        }
+
+        // Drain state packets
+        for (int i = 0; i < SOCKETS; i++) {
+            int got;
+            while ((got = recvBatch(fds[i], &in)) > 0) {
+                for (int m = 0; m < got; m++) onBotPacket(in.buf[m], (int)in.msgs[m].msg_len);
+                if (got < BATCH) break;
+            }
+        }
+
+        // Inputs at the game's tick rate (every inputEvery ticks)
+        if (nowNs() >= nextTick) {
+            nextTick += TICK_NS;
+            tick++;
+            for (int sock = 0; sock < SOCKETS; sock++) {
+                for (int i = sock; i < botCount; i += SOCKETS) {
+                    Bot* b = &bots[i];
+                    if (!b->joined || (i + tick) % inputEvery) continue;
+                    b->seq++;
+                    b->target = 300.0f * sinf(tick * 0.05f + i);
+                    fillInput(sendSlot(fds[sock], &out, &to[b->worker], sizeof(NetInput)), b, NET_INPUT);
+                }
+                sendFlush(fds[sock], &out);
+            }
+        }
+
+        if (now >= nextReport) {
+            nextReport += 1.0;
+            NetStats st[MAX_WORKERS];
+            if (!queryStats(statsFd, to, workers, st)) { printf("no stats reply\n"); continue; }
+            uint32_t rooms = 0, clients = 0, misses = 0, p50 = 0, p99 = 0, p999 = 0, mx = 0, busy = 0;
+            for (int k = 0; k < workers; k++) {
+                rooms += st[k].rooms; clients += st[k].clients; misses += st[k].misses;
+                if (st[k].p50 > p50) p50 = st[k].p50;
+                if (st[k].p99 > p99) p99 = st[k].p99;
+                if (st[k].p999 > p999) p999 = st[k].p999;
+                if (st[k].maxUs > mx) mx = st[k].maxUs;
+                busy += st[k].busyPermille;
+            }
+            printf("%7.0fs %8u %9u %6uus %6uus %6uus %6uus %7u %5.0f%% %8uus %8uus\n",
+                   now - start, rooms, clients, p50, p99, p999, mx, misses,
+                   busy / 10.0 / workers, rttPercentile(0.5), rttPercentile(0.99));
+            fflush(stdout);
+            memset(rttHist, 0, sizeof(rttHist));
+            rttCount = 0;
+
+            levelMisses += (int)misses;
+            if ((int)rooms >= level) levelReports++;
+        }
+        usleep(200);
+    }
+
+    if (ramp)
+        printf("max rooms per core at a 16 ms tick without deadline misses: %d\n",
+               best > 0 ? best / workers : 0);
+
+    for (int i = 0; i < botCount; i++) {
+        if (!bots[i].joined) continue;
+        fillInput(sendSlot(fds[i % SOCKETS], &out, &to[bots[i].worker], sizeof(NetInput)), &bots[i], NET_LEAVE);
+        sendFlush(fds[i % SOCKETS], &out);
+    }
+    printf("%d rooms (%d PvP), %d bots, %llu state packets received\n",
+           roomsMade, pvpMade, botCount, (unsigned long long)statePackets);
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s serve [--port N] [--workers N]\n"
+        "       %s load [--host ADDR] [--port N] [--workers N] [--rooms N | --ramp STEP]\n"
+        "             [--pvp SHARE] [--seconds N] [--input-every TICKS]\n", prog, prog);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) { usage(argv[0]); return 2; }
+    int port = 7777, workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int rooms = 1000, ramp = 0, seconds = 10, inputEvery = 1;
+    double pvp = 0.0;
+    const char* host = "127.0.0.1";
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--port") && i + 1 < argc)             port = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--workers") && i + 1 < argc)     workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--host") && i + 1 < argc)        host = argv[++i];
+        else if (!strcmp(argv[i], "--rooms") && i + 1 < argc)       rooms = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--ramp") && i + 1 < argc)        ramp = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--pvp") && i + 1 < argc)         pvp = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc)     seconds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--input-every") && i + 1 < argc) inputEvery = atoi(argv[++i]);
+        else { usage(argv[0]); return 2; }
+    }
+    if (workers < 1 || workers > MAX_WORKERS || rooms < 1 || inputEvery < 1 || pvp < 0 || pvp > 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    if (!strcmp(argv[1], "serve")) return serve((uint16_t)port, workers);
+    if (!strcmp(argv[1], "load"))  return load(host, (uint16_t)port, workers, rooms, ramp, pvp, seconds, inputEvery);
+    usage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,376 @@
+// Headless self-play tuner for the AI difficulty presets.
+//
+// Runs AI-vs-bot and AI-vs-AI matches on every core and fits aiParams[]
+// with a separable CMA-ES so that the AI hits a target win rate against a
+// scripted bot and a target average rally length against itself.
+// Prints the tuned row, ready to paste into aiParams[] in pingpong.c.
+//
+// Build (Linux / any POSIX box):
+//   gcc -O2 tools/tune.c -o tune -lm
+// Example:
+//   ./tune --difficulty medium --win 0.5 --rally 3 --generations 40
+
+#define PONG_HEADLESS
+#include "../pingpong.c"
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define TUNE_DIMS     11
+#define MAX_LAMBDA    64
+#define MATCH_POINTS  5                 // first to 5, same as "Hard Win"
+#define MATCH_TICKS   (60 * 60 * 5)     // give up after 5 minutes of play
+
+// One tunable field of AIParams with its search range
+typedef struct {
+    const char* name;
+    float lo, hi;
+    int isInt;
+} TuneDim;
+
+static const TuneDim dims[TUNE_DIMS] = {
+    {"reaction",    0.5f,  1.6f,  0},
+    {"accuracy",    0.5f,  1.0f,  0},
+    {"errChance",   0.0f,  0.6f,  0},
+    {"maxErr",      0.0f,  120.0f, 0},
+    {"speedMult",   0.6f,  2.2f,  0},
+    {"adapt",       0.0f,  0.5f,  0},
+    {"bounceBlend", 0.0f,  1.0f,  0},
+    {"snapDist",    0.0f,  100.0f, 0},
+    {"rallyHits",   1.0f,  20.0f, 1},
+    {"learnHits",   10.0f, 200.0f, 1},
+    {"learnRate",   0.0f,  0.02f, 0}
+};
+
+// Result of one match, written by a worker into shared memory
+typedef struct {
+    int aiWon;
+    int points;
+    int hits;
+    int ticks;
+} MatchResult;
+
+// Command-line settings
+static DifficultyLevel tuneDifficulty = DIFFICULTY_MEDIUM;
+static float targetWin   = 0.5f;
+static float targetRally = 3.0f;
+static float botSpeed    = 2.0f;
+static int generations   = 30;
+static int lambda        = 0;
+static int botMatches    = 48;
+static int selfMatches   = 24;
+static int jobs          = 0;
+static unsigned seed     = 12345;
+
+//              Small private RNG (keeps rand() for the game itself)
+
+static unsigned long long rngState = 88172645463325252ULL;
+
+static unsigned long long rngNext(unsigned long long* s) {
+    *s ^= *s << 13; *s ^= *s >> 7; *s ^= *s << 17;
+    return *s;
+}
+
+static float rngUniform(unsigned long long* s) {
+    return (rngNext(s) >> 40) / (float)(1 << 24);
+}
+
+static float rngGauss(unsigned long long* s) {
+    float u1 = rngUniform(s) + 1e-7f, u2 = rngUniform(s);
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * PI * u2);
+}
+
+//              Parameter mapping
+
+static void toParams(const float* u, AIParams* out) {
+    *out = aiParams[tuneDifficulty];
+    float v[TUNE_DIMS];
+    for (int i = 0; i < TUNE_DIMS; i++) {
+        float c = fmaxf(0.0f, fminf(1.0f, u[i]));
+        v[i] = dims[i].lo + c * (dims[i].hi - dims[i].lo);
+        if (dims[i].isInt) v[i] = floorf(v[i] + 0.5f);
+    }
+    out->reaction    = v[0];  out->accuracy  = v[1];
+    out->errChance   = v[2];  out->maxErr    = v[3];
+    out->speedMult   = v[4];  out->adapt     = v[5];
+    out->bounceBlend = v[6];  out->snapDist  = v[7];
+    out->rallyHits   = (int)v[8];
+    out->learnHits   = (int)v[9];
+    out->learnRate   = v[10];
+}
+
+static void fromParams(const AIParams* p, float* u) {
+    float v[TUNE_DIMS] = {
+        p->reaction, p->accuracy, p->errChance, p->maxErr, p->speedMult,
+        p->adapt, p->bounceBlend, p->snapDist, (float)p->rallyHits,
+        (float)p->learnHits, p->learnRate
+    };
+    for (int i = 0; i < TUNE_DIMS; i++)
+        u[i] = (v[i] - dims[i].lo) / (dims[i].hi - dims[i].lo);
+}
+
+//              Match runner
+
+// Scripted bottom paddle: chases the lowest incoming ball with limited speed
+static void botControl(unsigned long long* rng) {
+    Ball* target = NULL;
+    for (int i = 0; i < 3; i++) {
+        if (!balls[i].active || balls[i].vy >= 0) continue;
+        if (!target || balls[i].y < target->y) target = &balls[i];
+    }
+    float want = target ? target->x + (rngUniform(rng) - 0.5f) * 40.0f : 0.0f;
+    float d = want - player1_target_x;
+    if (d >  botSpeed) d =  botSpeed;
+    if (d < -botSpeed) d = -botSpeed;
+    player1_target_x += d;
+}
+
+// Plays one match; vsBot selects AI-vs-bot (PvC) or AI-vs-AI (PvP, both AUTO)
+static MatchResult playMatch(const AIParams* params, int vsBot, unsigned matchSeed) {
+    MatchResult res = {0, 0, 0, 0};
+    unsigned long long rng = 0x9E3779B97F4A7C15ULL ^ matchSeed;
+
+    srand(matchSeed);
+    aiParams[tuneDifficulty] = *params;
+    currentDifficulty = tuneDifficulty;
+    currentMode = vsBot ? MODE_PVC : MODE_PVP;
+    pvp_ball_speed = (tuneDifficulty == DIFFICULTY_MEDIUM) ? 16.0f : 18.0f;
+    player1_control = vsBot ? CONTROL_MOUSE : CONTROL_AUTO;
+    player2_control = CONTROL_AUTO;
+
+    clearParticles();
+    powerup_timer = 0.0f;
+    animation_time = 0.0f;
+    initGame();
+    resetBall(&balls[0]);
+    game_running = 1;
+
+    float lastVy[3];
+    int wasActive[3];
+    for (int i = 0; i < 3; i++) { lastVy[i] = balls[i].vy; wasActive[i] = balls[i].active; }
+
+    while (res.ticks < MATCH_TICKS &&
+           player1_score < MATCH_POINTS && player2_score < MATCH_POINTS) {
+        if (vsBot) botControl(&rng);
+        update();
+        res.ticks++;
+
+        // A vertical velocity flip on a ball that stayed alive is a paddle hit
+        for (int i = 0; i < 3; i++) {
+            if (balls[i].active && wasActive[i] && (balls[i].vy > 0) != (lastVy[i] > 0))
+                res.hits++;
+            lastVy[i] = balls[i].vy;
+            wasActive[i] = balls[i].active;
+        }
+    }
+
+    game_running = 0;
+    res.points = player1_score + player2_score;
+    res.aiWon  = player2_score > player1_score;
+    return res;
+}
+
+//              Parallel evaluation
+
+// Evaluates every candidate on the same match seeds, split across forked
+// workers. The game keeps its state in globals, so processes (not threads)
+// give each worker its own copy.
+static void evaluate(float (*pop)[TUNE_DIMS], int n, unsigned genSeed,
+                     MatchResult* shared, float* fitness, float* winOut, float* rallyOut) {
+    int perCand = botMatches + selfMatches;
+    int total = n * perCand;
+
+    for (int w = 0; w < jobs; w++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            for (int j = w; j < total; j += jobs) {
+                int c = j / perCand, m = j % perCand;
+                AIParams params;
+                toParams(pop[c], &params);
+                shared[j] = playMatch(&params, m < botMatches, genSeed + (unsigned)m * 7919u);
+            }
+            _exit(0);
+        }
+        if (pid < 0) { perror("fork"); exit(1); }
+    }
+    while (wait(NULL) > 0) {}
+
+    for (int c = 0; c < n; c++) {
+        float wins = 0, hits = 0, points = 0;
+        for (int m = 0; m < perCand; m++) {
+            MatchResult* r = &shared[c * perCand + m];
+            if (m < botMatches) wins += r->aiWon;
+            else { hits += r->hits; points += r->points; }
+        }
+        float win = botMatches ? wins / botMatches : targetWin;
+        float rally = points > 0 ? hits / points : targetRally;
+        float ew = (win - targetWin) / 0.05f;
+        float er = (rally - targetRally) / (0.1f * targetRally + 0.5f);
+        fitness[c] = ew * ew + er * er;
+        if (winOut)   winOut[c] = win;
+        if (rallyOut) rallyOut[c] = rally;
+    }
+}
+
+//              Separable CMA-ES
+
+static void printRow(const AIParams* p) {
+    printf("    {%.3ff, %.3ff, %.3ff, %.1ff, %.3ff, %.2ff, %.3ff, %.3ff, %.1ff, %d, %.2ff, %d, %.4ff, %.2ff, %.2ff}, // %s\n",
+           p->reaction, p->accuracy, p->errChance, p->maxErr, p->speedMult,
+           p->anticipate, p->adapt, p->bounceBlend, p->snapDist, p->rallyHits,
+           p->rallyReactionMax, p->learnHits, p->learnRate, p->learnMax,
+           p->learnReactionMax, tuneDifficulty == DIFFICULTY_HARD ? "Hard" : "Medium");
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s [--difficulty medium|hard] [--win F] [--rally F] [--bot-speed F]\n"
+        "          [--generations N] [--lambda N] [--bot-matches N] [--self-matches N]\n"
+        "          [--jobs N] [--seed N]\n", prog);
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!v) usage(argv[0]);
+        if      (!strcmp(a, "--difficulty"))   tuneDifficulty = strcmp(v, "hard") ? DIFFICULTY_MEDIUM : DIFFICULTY_HARD;
+        else if (!strcmp(a, "--win"))          targetWin = (float)atof(v);
+        else if (!strcmp(a, "--rally"))        targetRally = (float)atof(v);
+        else if (!strcmp(a, "--bot-speed"))    botSpeed = (float)atof(v);
+        else if (!strcmp(a, "--generations"))  generations = atoi(v);
+        else if (!strcmp(a, "--lambda"))       lambda = atoi(v);
+        else if (!strcmp(a, "--bot-matches"))  botMatches = atoi(v);
+        else if (!strcmp(a, "--self-matches")) selfMatches = atoi(v);
+        else if (!strcmp(a, "--jobs"))         jobs = atoi(v);
+        else if (!strcmp(a, "--seed"))         seed = (unsigned)strtoul(v, NULL, 10);
+        else usage(argv[0]);
+        i++;
+    }
+
+    const int n = TUNE_DIMS;
+    if (jobs <= 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs <= 0) jobs = 1;
+    if (lambda <= 0) lambda = 4 + (int)(3.0f * logf((float)n));
+    if (lambda > MAX_LAMBDA) lambda = MAX_LAMBDA;
+    if (botMatches < 0) botMatches = 0;
+    if (selfMatches < 0) selfMatches = 0;
+    if (botMatches + selfMatches == 0) usage(argv[0]);
+    rngState ^= (unsigned long long)seed * 0x2545F4914F6CDD1DULL;
+
+    // Strategy parameters (Hansen's defaults, sep-CMA learning rates)
+    int mu = lambda / 2;
+    float w[MAX_LAMBDA], wsum = 0, w2 = 0;
+    for (int i = 0; i < mu; i++) { w[i] = logf(mu + 0.5f) - logf(i + 1.0f); wsum += w[i]; }
+    for (int i = 0; i < mu; i++) { w[i] /= wsum; w2 += w[i] * w[i]; }
+    float mueff = 1.0f / w2;
+    float cs   = (mueff + 2) / (n + mueff + 5);
+    float ds   = 1 + 2 * fmaxf(0, sqrtf((mueff - 1) / (n + 1)) - 1) + cs;
+    float cc   = 4.0f / (n + 4);
+    float c1   = 2.0f / ((n + 1.3f) * (n + 1.3f) + mueff) * (n + 2) / 3.0f;
+    float cmu  = fminf(1 - c1, 2 * (mueff - 2 + 1 / mueff) / ((n + 2) * (n + 2) + mueff) * (n + 2) / 3.0f);
+    float chiN = sqrtf((float)n) * (1 - 1.0f / (4 * n) + 1.0f / (21 * n * n));
+
+    float mean[TUNE_DIMS], C[TUNE_DIMS], ps[TUNE_DIMS] = {0}, pc[TUNE_DIMS] = {0};
+    float sigma = 0.2f;
+    fromParams(&aiParams[tuneDifficulty], mean);
+    for (int i = 0; i < n; i++) C[i] = 1.0f;
+
+    int perCand = botMatches + selfMatches;
+    MatchResult* shared = mmap(NULL, sizeof(MatchResult) * (size_t)(lambda + 1) * perCand,
+                               PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) { perror("mmap"); return 1; }
+
+    float best[TUNE_DIMS];
+    float bestFit = 1e30f, bestWin = 0, bestRally = 0;
+    memcpy(best, mean, sizeof(best));
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    long long matches = 0;
+
+    printf("tuning %s: target win %.2f vs bot (speed %.1f), rally %.1f; lambda %d, %d jobs\n",
+           tuneDifficulty == DIFFICULTY_HARD ? "Hard" : "Medium",
+           targetWin, botSpeed, targetRally, lambda, jobs);
+
+    for (int g = 0; g < generations; g++) {
+        float z[MAX_LAMBDA][TUNE_DIMS], x[MAX_LAMBDA][TUNE_DIMS];
+        float fit[MAX_LAMBDA], win[MAX_LAMBDA], rally[MAX_LAMBDA];
+        int order[MAX_LAMBDA];
+
+        for (int k = 0; k < lambda; k++)
+            for (int i = 0; i < n; i++) {
+                z[k][i] = rngGauss(&rngState);
+                x[k][i] = mean[i] + sigma * sqrtf(C[i]) * z[k][i];
+            }
+
+        unsigned genSeed = seed + (unsigned)g * 1000003u;
+        evaluate(x, lambda, genSeed, shared, fit, win, rally);
+        matches += (long long)lambda * perCand;
+
+        for (int k = 0; k < lambda; k++) order[k] = k;
+        for (int a = 1; a < lambda; a++)
+            for (int b = a; b > 0 && fit[order[b]] < fit[order[b - 1]]; b--) {
+                int t = order[b]; order[b] = order[b - 1]; order[b - 1] = t;
+            }
+
+        if (fit[order[0]] < bestFit) {
+            bestFit = fit[order[0]];
+            bestWin = win[order[0]];
+            bestRally = rally[order[0]];
+            memcpy(best, x[order[0]], sizeof(best));
+        }
+
+        // Recombination and path updates
+        float zw[TUNE_DIMS] = {0}, yw[TUNE_DIMS] = {0};
+        for (int r = 0; r < mu; r++)
+            for (int i = 0; i < n; i++) {
+                zw[i] += w[r] * z[order[r]][i];
+                yw[i] += w[r] * sqrtf(C[i]) * z[order[r]][i];
+            }
+
+        float psLen = 0;
+        for (int i = 0; i < n; i++) {
+            mean[i] += sigma * yw[i];
+            ps[i] = (1 - cs) * ps[i] + sqrtf(cs * (2 - cs) * mueff) * zw[i];
+            psLen += ps[i] * ps[i];
+        }
+        psLen = sqrtf(psLen);
+        int hs = psLen / sqrtf(1 - powf(1 - cs, 2.0f * (g + 1))) < (1.4f + 2.0f / (n + 1)) * chiN;
+
+        for (int i = 0; i < n; i++) {
+            pc[i] = (1 - cc) * pc[i] + hs * sqrtf(cc * (2 - cc) * mueff) * yw[i];
+            float rankMu = 0;
+            for (int r = 0; r < mu; r++) {
+                float y = sqrtf(C[i]) * z[order[r]][i];
+                rankMu += w[r] * y * y;
+            }
+            C[i] = (1 - c1 - cmu) * C[i]
+                 + c1 * (pc[i] * pc[i] + (1 - hs) * cc * (2 - cc) * C[i])
+                 + cmu * rankMu;
+        }
+        sigma *= expf((cs / ds) * (psLen / chiN - 1));
+        if (sigma > 0.5f) sigma = 0.5f;
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        printf("gen %3d  best %.3f (win %.2f rally %.2f)  sigma %.3f  %.0f matches/min\n",
+               g, fit[order[0]], win[order[0]], rally[order[0]], sigma,
+               secs > 0 ? matches * 60.0 / secs : 0.0);
+        fflush(stdout);
+    }
+
+    // Re-check the winner on fresh seeds before reporting it
+    float finalFit, finalWin, finalRally;
+    evaluate(&best, 1, seed ^ 0xA5A5A5u, shared, &finalFit, &finalWin, &finalRally);
+
+    AIParams tuned;
+    toParams(best, &tuned);
+    printf("\nbest: score %.3f, win %.2f, rally %.2f (fresh seeds: win %.2f, rally %.2f)\n",
+           bestFit, bestWin, bestRally, finalWin, finalRally);
+    printf("tuned aiParams row:\n");
+    printRow(&tuned);
+    return 0;
+}